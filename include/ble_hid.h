@@ -4,6 +4,8 @@
  *
  * BTstack の HOG (HID over GATT) プロファイルを使用。
  * キーボード + マウス のコンポジットHIDデバイス。
+ * スロットごとに1台、最大3台のホストと同時接続し、
+ * 入力レポートはアクティブスロットの接続にのみ送信する。
  *
  * キーボード (Report ID 1):
  *   Boot Protocol (6KRO) と Report Protocol (NKRO) のデュアル対応。
@@ -18,6 +20,35 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/**
+ * スロット別リンク情報 (接続ごとにネゴシエーション結果を記録)
+ */
+typedef struct {
+    uint8_t  tx_phy;           /* 送信PHY (1=1M, 2=2M, 3=Coded, 0=不明) */
+    uint8_t  rx_phy;           /* 受信PHY */
+    uint16_t max_tx_octets;    /* DLE 最大送信オクテット (27=DLEなし) */
+    uint16_t max_rx_octets;    /* DLE 最大受信オクテット */
+    uint16_t att_mtu;          /* ATT MTU */
+    uint16_t conn_interval;    /* 接続間隔 (1.25ms単位) */
+    uint32_t throughput_nps;   /* 最終スループット計測結果 (通知/秒, 0=未計測) */
+    uint32_t reconnect_ms;     /* 起動/スロット切替 → 最初の入力レポート (ms) */
+    uint8_t  reconnect_phase;  /* 接続時のアドバタイジング段階 (0=高デューティDirected,
+                                  1=低デューティDirected, 2=フィルタ, 3=一般) */
+} ble_hid_link_info_t;
+
+/**
+ * レポート投入 (send_report 呼出し) → BLE送信 までの遅延統計
+ */
+typedef struct {
+    uint32_t samples;          /* 送信したレポート数 */
+    uint64_t total_us;         /* 遅延の合計 (平均 = total_us / samples) */
+    uint32_t max_us;           /* 最大遅延 */
+    /* 投入 → 送信先の接続イベント (推定) までの時間 (入力のサンプル時刻ではなく投入時刻から) */
+    uint32_t event_samples;    /* 接続イベント位相が既知だったレポート数 */
+    uint64_t event_total_us;
+    uint32_t event_max_us;
+} ble_hid_latency_stats_t;
+
 /**
  * BLEスタック初期化、GATTサービス登録、アドバタイジング開始
  * cyw43_arch_init() を含む。失敗時は内部でエラー処理。
@@ -25,51 +56,36 @@
 void ble_hid_init(void);
 
 /**
- * キーボードHIDレポートを送信
- * 接続中かつ送信可能な場合のみ送信。
- * それ以外はバッファリングして CAN_SEND_NOW で送信。
- *
- * Boot Protocol: report = 8バイト標準フォーマット (Report IDなし)
- * Report Protocol: report = 22バイトNKRO (内部でReport ID 1を付与)
- *
- * @param report レポートデータ
- * @param len    レポート長 (Boot: 8, NKRO: 22)
+ * hid_pipeline に BLE シンクを登録 (hid_pipeline_init() の後に呼ぶ)
+ * 入力レポートはパイプラインのフレームをアクティブスロットの接続へそのまま通知する。
+ * Boot Protocol の接続にはキーボードを Boot 形式で積ませ、マウスは積ませない。
+ * @return シンク番号
  */
-void ble_hid_send_report(const uint8_t *report, uint8_t len);
+int ble_hid_attach_pipeline(void);
 
 /**
- * マウスHIDレポートを送信
- * Report Protocol モードでのみ動作。Boot Protocolでは無視。
- *
- * @param buttons ボタンビットマスク (MOUSE_BTN_LEFT/RIGHT/MIDDLE)
- * @param delta_x X移動量 (-127 to 127)
- * @param delta_y Y移動量 (-127 to 127)
- * @param wheel   ホイール移動量 (-127 to 127)
+ * アクティブスロットのホストが接続中かどうか
  */
-void ble_hid_send_mouse_report(uint8_t buttons, int8_t delta_x,
-                                int8_t delta_y, int8_t wheel);
+bool ble_hid_is_connected(void);
 
 /**
- * BLE接続中かどうか
+ * 送信待ちのレポートが無いか (全接続, スループット計測中は false)
+ * Flash 書込みなど割り込みを止める処理の実行判定に使う。
  */
-bool ble_hid_is_connected(void);
+bool ble_hid_is_tx_idle(void);
 
 /**
- * 現在のプロトコルモードを取得
- * @return 0=Boot Protocol, 1=Report Protocol
+ * アクティブスロット接続のプロトコルモードを取得
+ * @return 0=Boot Protocol, 1=Report Protocol (未接続時は1)
  */
 uint8_t ble_hid_get_protocol_mode(void);
 
 /**
  * BLEイベントをポーリング処理 (メインループから毎回呼ぶ)
+ * バックグラウンドビルドでは何もしない (イベントは IRQ 駆動で処理済み)。
  */
 void ble_hid_poll(void);
 
-/**
- * 全キー解放レポートを送信
- */
-void ble_hid_send_key_release(void);
-
 /**
  * バッテリーレベル更新
  * @param level バッテリー残量 (0-100)
@@ -77,9 +93,62 @@ void ble_hid_send_key_release(void);
 void ble_hid_update_battery(uint8_t level);
 
 /**
- * 現在の接続を切断し、再アドバタイジングを開始
- * デバイススロット切替時に使用。
+ * アクティブスロット変更を BLE 層に通知
+ * device_slot_switch() の後に呼ぶ。旧スロットの接続には全キー解放を送り、
+ * 接続は維持したまま入力レポートの送信先を新スロットの接続に切り替える。
+ * 新スロットが未接続なら、そのボンディング先へ向けてアドバタイジングを開始する。
+ * 呼出し時点から最初の入力レポートまでの切替時間を計測する。
+ * @param prev_slot 切替前のスロット番号
+ */
+void ble_hid_switch_slot(uint8_t prev_slot);
+
+/**
+ * 指定スロットのホストが接続中 (入力レポート購読済み) か
+ */
+bool ble_hid_slot_is_connected(uint8_t slot);
+
+/**
+ * レポート投入 → 送信の遅延統計を取得
+ * @param stats 出力先
+ * @param reset true なら取得後にリセット
+ */
+void ble_hid_get_latency_stats(ble_hid_latency_stats_t *stats, bool reset);
+
+/**
+ * アクティブスロット接続の次の接続イベント時刻 (推定) を取得
+ * 送信完了イベント (Number Of Completed Packets) の受信時刻を位相の基準とし、
+ * 接続間隔を足して次の接続イベントを予測する。
+ * @param anchor_us 次の接続イベント時刻 (time_us_32() 基準)
+ * @return false: 未接続、または位相が未知 (しばらく送信が無い)
+ */
+bool ble_hid_get_next_anchor(uint32_t *anchor_us);
+
+/**
+ * アクティブスロット接続の接続間隔を取得
+ * @return 接続間隔 (us)。未接続なら 0。
+ */
+uint32_t ble_hid_get_conn_interval_us(void);
+
+/**
+ * スロットのリンク情報を取得
+ * 最後に接続したときの PHY / DLE / MTU / 接続間隔を返す。
+ * @return リンク情報。無効なスロット番号なら NULL。
+ */
+const ble_hid_link_info_t *ble_hid_get_link_info(uint8_t slot);
+
+/**
+ * スループット計測を開始
+ * 現在のキー状態のキーボードレポート (ホストから見える入力は変わらない) を
+ * CAN_SEND_NOW ごとに送り続け、duration_ms 経過後に達成した通知数/秒をリンク情報に記録する。
+ * 通常のキー入力は計測中も優先して送信される。
+ * @param duration_ms 計測時間 (ミリ秒)
+ * @return true: 開始, false: 未接続または計測中
+ */
+bool ble_hid_throughput_test_start(uint32_t duration_ms);
+
+/**
+ * スループット計測中かどうか
  */
-void ble_hid_disconnect_and_readvertise(void);
+bool ble_hid_throughput_test_is_active(void);
 
 #endif /* BLE_HID_H */
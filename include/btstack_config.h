@@ -25,6 +25,8 @@
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_LE_SECURE_CONNECTIONS
 #define ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
+#define ENABLE_LE_DATA_LENGTH_EXTENSION  /* DLE: 1パケットに NKRO レポートを収める */
+#define ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION  /* ボンドのIRKをコントローラの解決リストへ */
 
 /* ============================================================
  * 暗号化
@@ -35,9 +37,13 @@
 /* ============================================================
  * 接続パラメータ
  * ============================================================ */
-#define MAX_NR_HCI_CONNECTIONS           1    /* キーボードは1台のみ接続 */
+#define MAX_NR_HCI_CONNECTIONS           3    /* スロットごとに1接続 (3台同時接続) */
 #define MAX_NR_SM_LOOKUP_ENTRIES         3    /* ボンディングデバイス数 */
 #define MAX_NR_L2CAP_CHANNELS            4
+#define MAX_NR_GATT_CLIENTS              3    /* MTU交換用 (接続ごと) */
+#define MAX_NR_WHITELIST_ENTRIES         3    /* フィルタ受理リスト (スロット数) */
+#define MAX_NR_LE_DEVICE_DB_ENTRIES      3    /* ボンドDB = スロット数 */
+#define NVM_NUM_DEVICE_DB_ENTRIES        3    /* TLV 上のボンドDB = スロット数 */
 #define MAX_ATT_DB_SIZE                  512
 
 /* ============================================================
@@ -56,4 +62,9 @@
  * ============================================================ */
 #define MAX_ATT_MTU                      64
 
+/* ============================================================
+ * ACL ペイロード (DLE 最大 251 オクテット + L2CAPヘッダ)
+ * ============================================================ */
+#define HCI_ACL_PAYLOAD_SIZE             (251 + 4)
+
 #endif /* BTSTACK_CONFIG_H */
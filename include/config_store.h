@@ -0,0 +1,84 @@
+/**
+ * @file config_store.h
+ * @brief 設定値ストア API (型付き KV, スキーマバージョン + CRC + 既定値)
+ *
+ * 再ビルドせずに変更したい調整値 (デバウンス時間, トラックボール感度,
+ * バッテリー監視間隔, スロットLED色, 接続パラメータ) を Flash に保存する。
+ *
+ * 全キーの値を1つのレコード ('JKCF') にまとめて flash_log に保存する:
+ *   version(2) + count(1) + reserved(1) + values[count](4 each) + crc(2)
+ * 読み出しは検証済みの値を RAM にコピーしておき、flash_log の世代が変わったときだけ
+ * 読み直すため、config_get() は配列参照とほぼ同じコスト。
+ * 書込みは flash_log の保留テーブル経由で、アイドル時にまとめて Flash へ反映される。
+ *
+ * スキーマ:
+ *   キーは末尾にのみ追加する (番号を変えない)。古いファームウェアで保存した
+ *   レコード (count が少ない) を読むと、足りないキーは既定値になる。
+ *   新しいスキーマ (version が大きい) のレコードや CRC 不一致・範囲外の値を
+ *   含むレコードは無視し、全キー既定値で動作する。
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* スキーマバージョン (キーの意味や値の単位を変えたら上げる) */
+#define CONFIG_SCHEMA_VERSION  1
+
+/* 設定キー (番号は保存形式の一部: 末尾にのみ追加すること) */
+typedef enum {
+    CFG_DEBOUNCE_MS = 0,           /* キーデバウンス時間 (ms) */
+    CFG_TRACKBALL_SENSITIVITY,     /* トラックボール感度倍率 */
+    CFG_BATTERY_CHECK_INTERVAL_MS, /* バッテリー監視間隔 (ms) */
+    CFG_SLOT0_COLOR,               /* スロット0 LED色 (0xRRGGBB) */
+    CFG_SLOT1_COLOR,               /* スロット1 LED色 */
+    CFG_SLOT2_COLOR,               /* スロット2 LED色 */
+    CFG_CONN_INTERVAL_MIN,         /* 接続間隔 最小 (1.25ms単位) */
+    CFG_CONN_INTERVAL_MAX,         /* 接続間隔 最大 (1.25ms単位) */
+    CFG_CONN_LATENCY,              /* スレーブレイテンシ (接続イベント数) */
+    CFG_SUPERVISION_TIMEOUT,       /* 監視タイムアウト (10ms単位) */
+    CFG_DEBOUNCE_ADAPT,            /* キー単位の適応デバウンス (0=固定, 1=適応) */
+    CFG_KEY_COUNT
+} config_key_t;
+
+/**
+ * 初期化 (flash_log_init() の後に呼ぶ)
+ * 保存済みレコードを検証し、無効なら既定値で動作する。
+ */
+void config_init(void);
+
+/**
+ * 設定値を取得 (保存値、なければ既定値)
+ */
+uint32_t config_get(config_key_t key);
+
+/**
+ * 設定値を変更 (範囲外なら false)
+ * Flash への反映は flash_log のコミット時。
+ */
+bool config_set(config_key_t key, uint32_t value);
+
+/**
+ * 全キーを既定値に戻す (保存レコードを削除)
+ */
+void config_reset(void);
+
+/**
+ * キー名 (シリアルコンソール用, 例: "debounce_ms")
+ */
+const char *config_key_name(config_key_t key);
+
+/**
+ * キー名からキーを検索
+ * @return キー。見つからなければ CFG_KEY_COUNT。
+ */
+config_key_t config_find_key(const char *name);
+
+/**
+ * スロットLED色を R, G, B に分解して取得
+ */
+void config_get_slot_color(uint8_t slot, uint8_t *r, uint8_t *g, uint8_t *b);
+
+#endif /* CONFIG_STORE_H */
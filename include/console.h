@@ -0,0 +1,29 @@
+/**
+ * @file console.h
+ * @brief USB シリアルコンソール API (設定変更コマンド)
+ *
+ * USB CDC (stdio) から1行ずつコマンドを受け付ける。受信はノンブロッキングで、
+ * メインループから console_poll() を呼ぶたびに届いている文字だけを処理する。
+ *
+ * コマンド:
+ *   cfg                 : 全設定値を表示
+ *   cfg <name> <value>  : 設定値を変更 (10進 or 0x16進)
+ *   cfg reset           : 全設定を既定値に戻す
+ *   sched               : タスクごとの実行時間/デッドラインミスを表示 (表示後リセット)
+ *   power               : 省電力ステートごとの滞在時間/起床レイテンシを表示 (表示後リセット)
+ *   perf [reset]        : 実行時カウンタを表示 (reset: 表示と同時にリセット)
+ *   trace               : 未読のトレースレコードを "#T" 行で出力 (tools/trace_decode.py で復元)
+ *   trace on|off        : トレースの連続出力を有効/無効
+ *   debounce [reset]    : キーごとのデバウンス時間/バウンス時間の分布を表示
+ *                         (reset: 表示後に統計と学習したデバウンス時間を初期化)
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+/**
+ * 受信済みの文字を処理し、1行そろったらコマンドを実行
+ */
+void console_poll(void);
+
+#endif /* CONSOLE_H */
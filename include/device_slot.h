@@ -8,6 +8,7 @@
  * 各スロットは接続先デバイスのBDアドレスとアドレスタイプを保持。
  * 空スロットは新規ペアリングモードでアドバタイジング。
  * 使用済みスロットはDirected Advertisingで高速再接続。
+ * 各スロットのホストとは同時に接続を保持し、切替時に切断しない。
  *
  * スロットLED: WS2812B (NeoPixel) ×3 on GP22
  *   GP26/GP27 はトラックボール I2C に使用するため、
@@ -27,15 +28,36 @@
 /**
  * スロット情報
  */
+/* ボンド未割当を表す le_device_db エントリ番号 */
+#define DEVICE_SLOT_NO_BOND  (-1)
+
 typedef struct {
-    uint8_t  bd_addr[BD_ADDR_LEN]; /* 接続先BDアドレス */
+    uint8_t  bd_addr[BD_ADDR_LEN]; /* 接続先IDアドレス (public / static random) */
     uint8_t  addr_type;            /* アドレスタイプ (0=public, 1=random) */
     bool     paired;               /* ペアリング済みフラグ */
+    int8_t   db_index;             /* 対応する le_device_db エントリ (LTK/IRK) */
 } device_slot_info_t;
 
+/**
+ * 永続ストレージ初期化
+ * flash_log を BTstack の TLV として登録し、le_device_db もそこへ向ける。
+ * 初回起動時は pico_flash_bank TLV の内容 (ボンド + スロット) を移行する。
+ * 続けてスロット情報を読み込む (ボンドと食い違うスロット, 孤立したボンドは削除)。
+ * cyw43_arch_init() の後、HCI 起動前に呼ぶこと (ble_hid_init() 内で呼ぶ)。
+ * @return false: flash_log が使えず pico_flash_bank TLV のまま
+ */
+bool device_slot_storage_init(void);
+
+/**
+ * 保留中のスロット情報/ボンド情報を Flash に書き込む
+ * 書込み中は割り込みが止まるため、キー入力と BLE 送信の無いときに呼ぶこと。
+ */
+void device_slot_commit_storage(void);
+
 /**
  * デバイススロット初期化
- * Flashからスロット情報を読み込み、WS2812B LEDを初期化。
+ * WS2812B LEDを初期化し、アクティブスロットの色を表示する。
+ * スロット情報は ble_hid_init() 内で読み込まれるため、ble_hid_init() の後に呼ぶこと。
  */
 void device_slot_init(void);
 
@@ -53,10 +75,21 @@ uint8_t device_slot_get_active(void);
 bool device_slot_switch(uint8_t slot);
 
 /**
- * 現在のスロットにペアリング情報を保存
- * BLEペアリング完了時に呼ぶ。Flashに永続化。
+ * 指定スロットにペアリング結果 (ボンド) を割り当て
+ * BLEペアリング完了時に、その接続が属するスロットを指定して呼ぶ。
+ * ID アドレスはボンドDBから取得し、TLV に永続化する。
+ * スロットが以前指していたボンドや、同じボンドを指す他スロットは解除される。
+ * @param slot     スロット番号 (0-2)
+ * @param db_index le_device_db エントリ番号 (sm_le_device_index())
  */
-void device_slot_save_pairing(const uint8_t *bd_addr, uint8_t addr_type);
+void device_slot_save_pairing(uint8_t slot, int db_index);
+
+/**
+ * ボンド (le_device_db エントリ) に対応するスロットを検索
+ * RPA で再接続したホストを IRK 解決後にスロットへ対応付けるのに使用。
+ * @return スロット番号。該当なしなら -1。
+ */
+int8_t device_slot_find_by_bond(int db_index);
 
 /**
  * 現在のスロットのペアリング情報を取得
@@ -64,8 +97,20 @@ void device_slot_save_pairing(const uint8_t *bd_addr, uint8_t addr_type);
  */
 const device_slot_info_t *device_slot_get_info(uint8_t slot);
 
+/**
+ * スロットのポインタ加速カーブを取得
+ * @return pointer_curve_t (未設定なら POINTER_CURVE_DEFAULT)
+ */
+uint8_t device_slot_get_pointer_curve(uint8_t slot);
+
+/**
+ * スロットのポインタ加速カーブを設定 (TLV に永続化)
+ */
+void device_slot_set_pointer_curve(uint8_t slot, uint8_t curve);
+
 /**
  * 現在のスロットのペアリングを解除 (Fn+長押し等で使用)
+ * 対応するボンド (LTK/IRK) も削除する。
  */
 void device_slot_clear_current(void);
 
@@ -78,9 +123,22 @@ void device_slot_update_leds(void);
 
 /**
  * スロットLEDを点滅表示 (切替直後のフィードバック)
+ * 点滅は led_anim で再生され、この関数はすぐに戻る。
  * @param slot 点滅するスロット番号
  * @param blink_count 点滅回数 (1-3)
  */
 void device_slot_blink_led(uint8_t slot, uint8_t blink_count);
 
+/**
+ * 新規ペアリング待ち表示 (アクティブスロットLEDの速い点滅)
+ * 毎ループ呼んでよい。切替時の点滅中はそれが終わってから開始する。
+ * @param pairing true: 表示開始, false: 表示終了
+ */
+void device_slot_set_pairing_indicator(bool pairing);
+
+/**
+ * バッテリー低下警告 (アクティブスロットLEDの赤点滅)
+ */
+void device_slot_show_battery_warning(void);
+
 #endif /* DEVICE_SLOT_H */
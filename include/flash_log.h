@@ -0,0 +1,118 @@
+/**
+ * @file flash_log.h
+ * @brief ログ構造 Flash ストア API (複数セクタ, 追記型, ウェアレベリング)
+ *
+ * タグ (32bit) + 値のレコードを Flash の複数セクタへ追記していく。
+ * 同じタグは新しいレコード (シーケンス番号が大きい方) が有効。
+ * 各レコードは CRC で検証し、書込み途中の電源断で壊れたレコードは無視する。
+ *
+ * 1回の書込みは 1ページ (256B) のプログラムのみで、セクタ消去は
+ * 書込み先セクタが満杯になったときのコンパクション (最古セクタの有効レコード
+ * 退避 → 消去) でだけ発生する。セクタは順番に使うため消去回数は全セクタに分散する。
+ *
+ * 起動時に全セクタを1回走査して「タグ → 最新レコードのアドレス」の索引を作るため、
+ * 読み出しは索引を引いて XIP 領域を参照するだけで済む。
+ *
+ * BTstack の TLV (btstack_tlv_t) として登録でき、ボンドDB (le_device_db) と
+ * デバイススロット情報を同じログに保存する。
+ *
+ * 書込み/削除は RAM に保留され (同じタグは合体)、flash_log_commit() で Flash に反映する。
+ * Flash 操作中は割り込みが止まるため、呼出し側はキー入力や BLE 送信の無い
+ * アイドル時にコミットする。読み出しは保留中の値を含めて最新を返す。
+ * 保留テーブルが満杯なら書込みは拒否する (書込み呼出しの中ではコミットしない)。
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "btstack_tlv.h"
+
+/* 1レコードの値の最大長 (ヘッダ込みで1ページに収まる長さ) */
+#define FLASH_LOG_MAX_VALUE  200
+
+/* 保留テーブルの段数 (ファームウェアが保存する全タグを1回のコミットで書ける数) */
+#define FLASH_LOG_PENDING_MAX  16
+
+/* ストア統計 */
+typedef struct {
+    uint32_t records;        /* 有効なタグ数 */
+    uint32_t used_bytes;     /* 書込み先セクタの使用量 */
+    uint32_t page_programs;  /* ページプログラム回数 (起動後) */
+    uint32_t sector_erases;  /* セクタ消去回数 (起動後) */
+    uint32_t compactions;    /* コンパクション回数 (起動後) */
+    uint32_t pending;        /* 保留中の書込み数 */
+    uint32_t commits;        /* コミット回数 */
+    uint32_t pending_full;   /* 保留テーブル満杯で拒否した書込み数 */
+    uint32_t commit_last_us; /* 直近コミットの割り込み停止時間 */
+    uint32_t commit_max_us;  /* コミットの割り込み停止時間 (最大) */
+    uint64_t commit_total_us;/* コミットの割り込み停止時間 (合計) */
+} flash_log_stats_t;
+
+/**
+ * 初期化: 全セクタを走査して索引と書込み位置を復元
+ * 有効なヘッダを持たないセクタは消去して予備セクタにする。
+ * @return true: 使用可能
+ */
+bool flash_log_init(void);
+
+/**
+ * レコードが1つも無いか (初回起動・移行判定用)
+ */
+bool flash_log_is_empty(void);
+
+/**
+ * 値への直接ポインタを取得 (コミット済みなら XIP 領域, コピーなし)
+ * ポインタは次の書込み/削除/コミットまで有効 (コンパクションで移動するため)。
+ * @param len 値の長さ (NULL可)
+ * @return 値の先頭。タグが無ければ NULL。
+ */
+const uint8_t *flash_log_get_ptr(uint32_t tag, uint16_t *len);
+
+/**
+ * 値を読み出し
+ * @return 値の長さ (buffer_size より長い場合も実際の長さ)。無ければ 0。
+ */
+int flash_log_read(uint32_t tag, uint8_t *buffer, uint32_t buffer_size);
+
+/**
+ * 値を書込み (保留テーブルに積む。同じ内容なら何もしない)
+ * @return true: 成功
+ */
+bool flash_log_write(uint32_t tag, const uint8_t *data, uint16_t len);
+
+/**
+ * タグを削除 (保留テーブルに積み、コミット時に削除レコードを追記)
+ */
+bool flash_log_delete(uint32_t tag);
+
+/**
+ * 未コミットの書込みがあるか
+ */
+bool flash_log_has_pending(void);
+
+/**
+ * 保留中の書込みを Flash に反映 (flash_safe_execute 経由, 割り込み停止を伴う)
+ * 割り込み停止時間は統計 (commit_last_us / commit_max_us) に記録する。
+ * @return false: Flash 操作失敗 (未反映分は保留に残る)
+ */
+bool flash_log_commit(void);
+
+/**
+ * 変更世代 (書込み/削除/コミットのたびに増える)
+ * flash_log_get_ptr() で得たポインタを保持する側が、再取得の要否を判定するのに使う。
+ */
+uint32_t flash_log_generation(void);
+
+/**
+ * 統計を取得
+ */
+void flash_log_get_stats(flash_log_stats_t *stats);
+
+/**
+ * BTstack TLV インタフェースを取得 (context は NULL で登録する)
+ */
+const btstack_tlv_t *flash_log_tlv_instance(void);
+
+#endif /* FLASH_LOG_H */
@@ -0,0 +1,19 @@
+/**
+ * @file hid_descriptor.h
+ * @brief HID Report Descriptor (BLE / USB 共通)
+ *
+ * BLE (HOG) と USB の両トランスポートが同じディスクリプタを使い、
+ * レポート形式 (Report ID 1: NKRO キーボード, Report ID 2: マウス) を共有する。
+ */
+
+#ifndef HID_DESCRIPTOR_H
+#define HID_DESCRIPTOR_H
+
+#include <stdint.h>
+
+/* USB のコンフィグレーションディスクリプタで定数として使うため長さはマクロで持つ */
+#define HID_REPORT_DESCRIPTOR_LEN  138
+
+extern const uint8_t hid_report_descriptor[HID_REPORT_DESCRIPTOR_LEN];
+
+#endif /* HID_DESCRIPTOR_H */
@@ -177,7 +177,7 @@
 #define HID_REPORT_ID_MOUSE     2
 
 /* マウスレポートサイズ (Report ID含まず) */
-#define MOUSE_REPORT_SIZE       4   /* buttons(1) + X(1) + Y(1) + wheel(1) */
+#define MOUSE_REPORT_SIZE       5   /* buttons(1) + X(1) + Y(1) + wheel(1) + pan(1) */
 #define BOOT_MOUSE_REPORT_SIZE  3   /* buttons(1) + X(1) + Y(1) */
 
 /* マウスボタンビット */
@@ -0,0 +1,192 @@
+/**
+ * @file hid_pipeline.h
+ * @brief HID レポートパイプライン (トランスポート非依存)
+ *
+ * キー状態・マウス移動量の保持、送信待ちレポートの上書き/加算、送信順序を1か所で扱い、
+ * 送信先 (BLE HOG, USB, ホスト側シミュレータ) はシンクとして登録する。
+ *
+ * 生産側 (メインループ):
+ *   hid_pipeline_set_keys() / hid_pipeline_add_mouse() がアクティブシンク用の送信フレーム
+ *   (Report ID 付きの送信可能なバイト列) をパイプライン内のバッファに直接組み立て、
+ *   シンクの notify() を呼ぶ。送信待ちはキーボード/マウスそれぞれ2件まで持ち、
+ *   1回の送信の間に押して離したキーやクリックも失わない。
+ *
+ * 消費側 (シンク):
+ *   送信できるようになったら hid_pipeline_peek() でフレームへの参照を受け取り、
+ *   そのままトランスポートへ渡してから hid_pipeline_consume() で取り除く (コピーしない)。
+ *   peek から consume までの間に生産側に割り込まれないこと
+ *   (割り込み/async_context から呼ぶ, または生産側と同じスレッドで呼ぶ)。
+ *
+ * フレーム形式:
+ *   HID_FRAME_KEYBOARD      : [Report ID 1][modifier][NKRO bitmap 21]
+ *   HID_FRAME_BOOT_KEYBOARD : [modifier][0][keycode x6]   (Report ID なし)
+ *   HID_FRAME_MOUSE         : [Report ID 2][buttons][X][Y][wheel][pan]
+ *
+ * Pico SDK に依存しない (ホストの単体ビルドでも動く)。
+ * 割り込み禁止や時刻取得は hid_pipeline_port_t で注入する。
+ */
+
+#ifndef HID_PIPELINE_H
+#define HID_PIPELINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hid_keycodes.h"
+
+#define HID_PIPELINE_MAX_SINKS  3
+#define HID_SINK_NONE           (-1)
+
+typedef enum {
+    HID_FRAME_KEYBOARD = 0,
+    HID_FRAME_BOOT_KEYBOARD,
+    HID_FRAME_MOUSE,
+} hid_frame_kind_t;
+
+/* hid_pipeline_peek() の対象 */
+#define HID_FRAME_MASK_KEYBOARD  0x01   /* キーボード (NKRO / Boot の保留中のほう) */
+#define HID_FRAME_MASK_MOUSE     0x02
+#define HID_FRAME_MASK_ALL       (HID_FRAME_MASK_KEYBOARD | HID_FRAME_MASK_MOUSE)
+
+/**
+ * 送信フレーム (パイプライン内バッファへの参照)
+ */
+typedef struct {
+    hid_frame_kind_t kind;
+    const uint8_t *data;       /* 送信可能なバイト列 (Report ID 込み, Boot は ID なし) */
+    uint8_t len;
+    uint32_t post_us;          /* 最初に投入された時刻 (上書き/加算しても変わらない) */
+} hid_frame_t;
+
+/**
+ * 送信先
+ */
+typedef struct {
+    const char *name;
+    bool (*is_ready)(void *ctx);     /* ホストが入力レポートを受け取れる */
+    bool (*wants_boot)(void *ctx);   /* キーボードを Boot 形式で送る (NULL = 常に NKRO) */
+    void (*notify)(void *ctx);       /* 送信待ちフレームができた (生産側から呼ばれる) */
+    void *ctx;
+} hid_sink_t;
+
+/**
+ * プラットフォーム依存部 (NULL のメンバは何もしない / 0 を返す)
+ */
+typedef struct {
+    uint32_t (*lock)(void);               /* 消費側を止める (割り込み禁止など) */
+    void     (*unlock)(uint32_t state);
+    uint32_t (*now_us)(void);             /* フレームの投入時刻 */
+    void     (*on_queued)(bool coalesced); /* 計測用: フレーム投入 (coalesced = 未送信分へ上書き/加算) */
+} hid_pipeline_port_t;
+
+/**
+ * シンクごとの統計
+ */
+typedef struct {
+    uint32_t queued;       /* 投入されたフレーム */
+    uint32_t coalesced;    /* 未送信フレームへの上書き/加算 */
+    uint32_t sent;         /* consume されたフレーム */
+    uint32_t dropped;      /* 切替/破棄で送らずに捨てたフレーム */
+} hid_pipeline_stats_t;
+
+/**
+ * 初期化 (シンクの登録も全て消える)
+ * @param port プラットフォーム依存部 (呼出し側で保持し続けること, NULL 可)
+ */
+void hid_pipeline_init(const hid_pipeline_port_t *port);
+
+/**
+ * シンクを登録
+ * @param sink シンク (呼出し側で保持し続けること)
+ * @return シンク番号, 登録できなければ HID_SINK_NONE
+ */
+int hid_pipeline_add_sink(const hid_sink_t *sink);
+
+/**
+ * 入力レポートの送信先を切り替える
+ * 旧シンクには全キー解放を、新シンクには現在のキー状態を積む。
+ * @param sink シンク番号 (HID_SINK_NONE で送信停止)
+ */
+void hid_pipeline_set_active(int sink);
+
+/**
+ * 現在の送信先
+ */
+int hid_pipeline_get_active(void);
+
+/**
+ * アクティブシンクのホストが入力レポートを受け取れるか
+ */
+bool hid_pipeline_is_ready(void);
+
+/**
+ * キー状態を更新し、アクティブシンクへキーボードフレームを積む
+ * @param nkro modifier + NKRO ビットマップ (NKRO_REPORT_SIZE バイト)
+ */
+void hid_pipeline_set_keys(const uint8_t *nkro);
+
+/**
+ * 全キー解放をアクティブシンクへ積む (キー状態もクリア)
+ */
+void hid_pipeline_release_keys(void);
+
+/**
+ * 現在のキー状態をキーボードレポートとして組み立てる (シンクには積まない)
+ * 送信待ちを増やさずに同じ状態を再送したいとき (スループット計測など) に使う。
+ * @param boot true: Boot 形式 (BOOT_REPORT_SIZE), false: NKRO 形式 (Report ID 付き)
+ * @param buf  出力先 (1 + NKRO_REPORT_SIZE バイト以上)
+ * @return 組み立てたバイト数
+ */
+uint8_t hid_pipeline_build_keys(bool boot, uint8_t *buf);
+
+/**
+ * マウス入力をアクティブシンクへ積む
+ * 未送信のマウスフレームに移動量を加算する。そのフレームで押した/離したボタンが
+ * 戻る場合 (1回の送信の間のクリック) は次のフレームとして積む。
+ * Boot 形式のシンクには積まない。
+ */
+void hid_pipeline_add_mouse(uint8_t buttons, int8_t dx, int8_t dy, int8_t wheel, int8_t pan);
+
+/**
+ * シンクの送信待ちフレームを参照する (キーボード優先, 種類ごとに古い順)
+ * @param sink  シンク番号
+ * @param mask  HID_FRAME_MASK_* (対象の種類)
+ * @param frame 出力先
+ * @return false: 対象の送信待ちなし
+ */
+bool hid_pipeline_peek(int sink, uint8_t mask, hid_frame_t *frame);
+
+/**
+ * peek したフレームを送信済みとして取り除く
+ */
+void hid_pipeline_consume(int sink, hid_frame_kind_t kind);
+
+/**
+ * シンクの送信待ちフレームを捨てる
+ * @param mask HID_FRAME_MASK_*
+ */
+void hid_pipeline_discard(int sink, uint8_t mask);
+
+/**
+ * シンクに送信待ちフレームがあるか
+ * @param mask HID_FRAME_MASK_*
+ */
+bool hid_pipeline_has_pending(int sink, uint8_t mask);
+
+/**
+ * 全シンクの送信待ちが無いか
+ */
+bool hid_pipeline_is_idle(void);
+
+/**
+ * シンクの統計を取得
+ * @param reset true なら取得後にリセット
+ */
+void hid_pipeline_get_stats(int sink, hid_pipeline_stats_t *stats, bool reset);
+
+/**
+ * シンク名 (範囲外なら "?")
+ */
+const char *hid_pipeline_sink_name(int sink);
+
+#endif /* HID_PIPELINE_H */
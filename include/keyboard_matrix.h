@@ -4,6 +4,11 @@
  *
  * 8行×14列マトリクスのGPIOスキャンと、キー単位のデバウンス処理。
  * Boot Protocol (6KRO) と NKRO ビットマップ両方のレポート生成に対応。
+ *
+ * 適応デバウンス (CFG_DEBOUNCE_ADAPT):
+ *   キーごとにバウンス継続時間 (最初の生エッジから最後のエッジまで) のヒストグラムを取り、
+ *   デバウンス時間をキー単位で調整する。長いバウンスやチャタリングはすぐに延長し、
+ *   安定したキーは DEBOUNCE_ADAPT_EPOCH サンプルごとに少しずつ短縮する。
  */
 
 #ifndef KEYBOARD_MATRIX_H
@@ -14,9 +19,31 @@
 #include "keymap.h"
 #include "hid_keycodes.h"
 
-/* デバウンス時間 (ミリ秒) */
+/* デバウンス時間の既定値 (ミリ秒, config_store の CFG_DEBOUNCE_MS で変更可) */
 #define DEBOUNCE_MS  20
 
+/* 適応デバウンスの既定値 (config_store の CFG_DEBOUNCE_ADAPT で変更可) */
+#define DEBOUNCE_ADAPT_ENABLED    1
+
+#define DEBOUNCE_ADAPT_MIN_MS     3    /* 短縮の下限 */
+#define DEBOUNCE_ADAPT_MAX_MS     40   /* 延長の上限 (CFG_DEBOUNCE_MS の方が大きければそちら) */
+#define DEBOUNCE_ADAPT_MARGIN_MS  2    /* 観測したバウンス時間に足す余裕 */
+#define DEBOUNCE_ADAPT_EPOCH      16   /* 短縮を判断するサンプル数 */
+#define DEBOUNCE_QUIET_MS         10   /* この間エッジが無ければバウンス終了 */
+#define DEBOUNCE_CHATTER_MS       15   /* 前回の確定からこれより短い確定はチャタリング */
+#define DEBOUNCE_HIST_AGE         256  /* ヒストグラムの合計がこれに達したら半減 (古い分を忘れる) */
+
+/* バウンス時間ヒストグラムのビン数 (上限は matrix_debounce_bin_limit_ms()) */
+#define DEBOUNCE_HIST_BINS        8
+
+/* キー単位のデバウンス統計 (診断用) */
+typedef struct {
+    uint8_t  window_ms;                   /* 現在のデバウンス時間 */
+    uint16_t hist[DEBOUNCE_HIST_BINS];    /* バウンス時間の分布 (古い分は半減済み) */
+    uint16_t chatter;                     /* チャタリングとして検出した確定の回数 */
+    uint32_t samples;                     /* 記録したバウンスの総数 */
+} matrix_debounce_stats_t;
+
 /**
  * マトリクスGPIOピンを初期化
  * 行ピン: GP0-GP7 (OUTPUT, HIGH)
@@ -52,6 +79,11 @@ void matrix_build_nkro_report(uint8_t *report);
  */
 bool matrix_key_is_pressed(uint8_t row, uint8_t col);
 
+/**
+ * いずれかのキーが押されているか (デバウンス済み, Fn を含む)
+ */
+bool matrix_any_key_pressed(void);
+
 /**
  * Fnキーが現在押されているか
  */
@@ -64,4 +96,53 @@ bool matrix_fn_is_pressed(void);
  */
 int8_t matrix_get_fn_slot_action(void);
 
+/**
+ * Fn + 指定キーが押されているか (Fnレイヤーのコマンド検出用)
+ * @param keycode 判定するHIDキーコード
+ */
+bool matrix_fn_combo_is_pressed(uint8_t keycode);
+
+/**
+ * キー単位のデバウンス統計を取得
+ * @return false: 範囲外
+ */
+bool matrix_get_debounce_stats(uint8_t row, uint8_t col, matrix_debounce_stats_t *stats);
+
+/**
+ * デバウンス統計をクリアし、全キーのデバウンス時間を CFG_DEBOUNCE_MS に戻す
+ */
+void matrix_reset_debounce_stats(void);
+
+/**
+ * ヒストグラムのビンの上限 (ミリ秒, このビンは 上限未満)。最後のビンは上限なしで 0 を返す
+ */
+uint8_t matrix_debounce_bin_limit_ms(uint8_t bin);
+
+/* 起床コールバック (GPIO 割り込みから呼ばれる) */
+typedef void (*matrix_wake_cb_t)(void);
+
+/**
+ * キー押下による起床待ちを開始 (スキャンを止めている間に使う)
+ * 全行をLOWに駆動し、列ピンのLOWレベル割り込みを有効化する。
+ * 割り込みが入ると起床待ちを解除して行をHIGHに戻し、cb を呼ぶ。
+ * @param cb 起床時のコールバック (割り込みコンテキスト, NULL 可)
+ * @return false: キーが押されているため起床待ちにできない
+ */
+bool matrix_wake_arm(matrix_wake_cb_t cb);
+
+/**
+ * 起床待ちを解除して通常スキャンに戻す
+ */
+void matrix_wake_disarm(void);
+
+/**
+ * 起床待ち中か (割り込みが入ると false になる)
+ */
+bool matrix_wake_is_armed(void);
+
+/**
+ * DORMANT 中の起床要因に列ピンを登録/解除 (matrix_wake_arm() の後に呼ぶ)
+ */
+void matrix_wake_set_dormant(bool enable);
+
 #endif /* KEYBOARD_MATRIX_H */
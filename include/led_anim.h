@@ -0,0 +1,85 @@
+/**
+ * @file led_anim.h
+ * @brief LED アニメーション API (ノンブロッキング キーフレーム再生)
+ *
+ * WS2812B の各LEDに「ベース色」と「アニメーション」を持たせ、
+ * led_anim_tick() の呼び出しごとに経過時間からキーフレームを進めて色を決める。
+ * 再生中もメインループは止まらない。アニメーション終了後はベース色に戻る。
+ *
+ * キーフレームは明るさ (0-255) と継続時間で表し、色は再生時に指定する。
+ * 同じシーケンスをスロット色の点滅にもバッテリー警告の赤点滅にも使える。
+ */
+
+#ifndef LED_ANIM_H
+#define LED_ANIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* キーフレーム */
+typedef struct {
+    uint8_t  level;        /* 明るさ (0-255, 再生色に掛ける) */
+    uint8_t  fade;         /* 1: 次のキーフレームへ線形補間, 0: 保持 */
+    uint16_t duration_ms;  /* このキーフレームの継続時間 */
+} led_keyframe_t;
+
+/* シーケンス (キーフレーム列) */
+typedef struct {
+    const led_keyframe_t *frames;
+    uint8_t count;
+} led_sequence_t;
+
+/* 繰り返し回数: 停止されるまで繰り返す */
+#define LED_ANIM_REPEAT_FOREVER  0
+
+/* 定義済みシーケンス */
+extern const led_sequence_t LED_SEQ_BLINK;         /* 150ms 点灯 / 150ms 消灯 */
+extern const led_sequence_t LED_SEQ_PULSE;         /* 1s 周期でフェードイン/アウト */
+extern const led_sequence_t LED_SEQ_BATTERY_WARN;  /* 短い2回点滅 + 長い消灯 */
+extern const led_sequence_t LED_SEQ_PAIRING;       /* 速い点滅 (新規ペアリング待ち) */
+
+/**
+ * 初期化 (全LEDのベース色を消灯、アニメーションなし)
+ * ws2812_init() の後に呼ぶこと。
+ */
+void led_anim_init(void);
+
+/**
+ * ベース色を設定 (アニメーションしていないときの色)
+ */
+void led_anim_set_base(uint16_t led, uint8_t r, uint8_t g, uint8_t b);
+
+/**
+ * アニメーションを開始 (同じLEDの再生中アニメーションは置き換え)
+ * @param led    LED番号
+ * @param seq    シーケンス
+ * @param r,g,b  再生色 (キーフレームの明るさを掛ける)
+ * @param repeat 繰り返し回数 (LED_ANIM_REPEAT_FOREVER で無限)
+ */
+void led_anim_play(uint16_t led, const led_sequence_t *seq,
+                   uint8_t r, uint8_t g, uint8_t b, uint8_t repeat);
+
+/**
+ * アニメーションを停止してベース色に戻す
+ */
+void led_anim_stop(uint16_t led);
+
+/**
+ * 指定LEDでシーケンスを再生中か
+ * @param seq NULL なら任意のシーケンス
+ */
+bool led_anim_is_playing(uint16_t led, const led_sequence_t *seq);
+
+/**
+ * いずれかのLEDでアニメーションを再生中か
+ */
+bool led_anim_any_playing(void);
+
+/**
+ * アニメーションを進めて LED に反映 (メインループ/スケジューラから定期的に呼ぶ)
+ * 色が変化したときだけ ws2812_show() する。
+ * @param now_ms 現在時刻 (ミリ秒)
+ */
+void led_anim_tick(uint32_t now_ms);
+
+#endif /* LED_ANIM_H */
@@ -0,0 +1,77 @@
+/**
+ * @file perf.h
+ * @brief 実行時パフォーマンスカウンタ API
+ *
+ * 各モジュールが件数カウンタと時間計測 (回数/合計/最大) を加算し、
+ * USB シリアルの perf コマンドとベンダー GATT キャラクタリスティック
+ * (perf_service.c) からまとめて読み出す。
+ * 読み出し時にリセットすれば、経過時間 (elapsed_ms) で割ってレートを出せる。
+ *
+ * 加算は割り込み/BTstack コンテキストからも呼ばれるため、件数は排他アクセス命令で、
+ * 時間計測は割り込み禁止区間で更新する (どちらも数命令)。
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* 件数カウンタ (末尾にのみ追加: GATT の読み出し形式に並び順が出る) */
+typedef enum {
+    PERF_CNT_LOOP_TICKS = 0,     /* スケジューラのティック数 */
+    PERF_CNT_DEBOUNCE_COMMITS,   /* デバウンスで確定したキー状態変化 */
+    PERF_CNT_REPORTS_QUEUED,     /* パイプラインに積んだレポート (BLE/USB) */
+    PERF_CNT_REPORTS_SENT,       /* 通知として送信したレポート */
+    PERF_CNT_REPORTS_COALESCED,  /* 未送信レポートへの上書き/加算 (BLE/USB) */
+    PERF_CNT_I2C_ERRORS,         /* トラックボール I2C の中断/読み取り不足 */
+    PERF_CNT_RECONNECTS,         /* ボンド済みホストとの再接続 */
+    PERF_CNT_USB_REPORTS_SENT,   /* USB HID で送信したレポート */
+    PERF_CNT_DEBOUNCE_CHATTER,   /* デバウンス確定がチャタリングと判定された回数 */
+    PERF_CNT_COUNT
+} perf_counter_t;
+
+/* 時間計測 (末尾にのみ追加) */
+typedef enum {
+    PERF_TIME_LOOP = 0,          /* 1ティックでタスクを実行していた時間 */
+    PERF_TIME_SCAN_JITTER,       /* マトリクススキャン間隔の周期からのずれ */
+    PERF_TIME_CAN_SEND_WAIT,     /* CAN_SEND_NOW 要求から許可まで */
+    PERF_TIME_FLASH_COMMIT,      /* Flash コミットで割り込みを止めていた時間 */
+    PERF_TIME_COUNT
+} perf_timer_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+} perf_time_stat_t;
+
+typedef struct {
+    uint32_t elapsed_ms;                     /* 前回リセットからの経過時間 */
+    uint32_t counters[PERF_CNT_COUNT];
+    perf_time_stat_t times[PERF_TIME_COUNT];
+} perf_snapshot_t;
+
+/**
+ * 件数カウンタを1加算
+ */
+void perf_count(perf_counter_t counter);
+
+/**
+ * 時間計測に1サンプル加算
+ */
+void perf_add_time(perf_timer_t timer, uint32_t us);
+
+/**
+ * 全カウンタを取得
+ * @param reset true なら取得と同時にリセット (取りこぼしなし)
+ */
+void perf_snapshot(perf_snapshot_t *snap, bool reset);
+
+/**
+ * 名前 (コンソール表示用)
+ */
+const char *perf_counter_name(perf_counter_t counter);
+const char *perf_timer_name(perf_timer_t timer);
+
+#endif /* PERF_H */
@@ -0,0 +1,30 @@
+/**
+ * @file perf_service.h
+ * @brief 実行時カウンタ ベンダー GATT サービス
+ *
+ * サービス UUID        : 4A503130-3650-4552-4600-000000000001
+ * キャラクタリスティック: 4A503130-3650-4552-4600-000000000002 (READ/WRITE, 暗号化必須)
+ *
+ * 読み出し形式 (リトルエンディアン, ATT MTU を超える分は Read Blob で続きを読む):
+ *   u8  version (PERF_SERVICE_VERSION)
+ *   u8  counter_count
+ *   u8  timer_count
+ *   u8  reset_on_read
+ *   u32 elapsed_ms
+ *   u32 counters[counter_count]            (perf_counter_t の順)
+ *   { u32 count, u32 max_us, u64 total_us } [timer_count]  (perf_timer_t の順)
+ *
+ * 書き込み: 1バイト。0x01 で以降の読み出し (オフセット0) ごとにリセット, 0x00 で解除。
+ */
+
+#ifndef PERF_SERVICE_H
+#define PERF_SERVICE_H
+
+#define PERF_SERVICE_VERSION  1
+
+/**
+ * サービスを ATT サーバに登録 (att_server_init() の後に呼ぶ)
+ */
+void perf_service_init(void);
+
+#endif /* PERF_SERVICE_H */
@@ -0,0 +1,98 @@
+/**
+ * @file pointer_accel.h
+ * @brief ポインタ加速 API (固定小数点ルックアップテーブル)
+ *
+ * トラックボールのサンプルデルタを加速カーブで拡大し、マウスレポート用の
+ * int8_t デルタに変換する。ゲインは Q8 (256 = 1.0倍) のテーブルで表し、
+ * ホットパスでは浮動小数点を使わない。
+ *
+ * 1カウント未満の端数と、int8_t に収まらなかった超過分は次のレポートへ
+ * 持ち越すため、低速の精密操作でも高速操作でも移動量が失われない。
+ */
+
+#ifndef POINTER_ACCEL_H
+#define POINTER_ACCEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* 加速カーブ */
+typedef enum {
+    POINTER_CURVE_LINEAR = 0,   /* 加速なし (感度倍率で固定) */
+    POINTER_CURVE_MILD,         /* 低速は等倍、高速で緩やかに加速 */
+    POINTER_CURVE_STRONG,       /* 低速は減速 (精密操作)、高速で大きく加速 */
+    POINTER_CURVE_COUNT
+} pointer_curve_t;
+
+/* 既定カーブ (スロット設定が未保存の場合) */
+#define POINTER_CURVE_DEFAULT  POINTER_CURVE_MILD
+
+/* スクロール状態 (ホイール単位未満の累積) */
+typedef struct {
+    int32_t acc_v;     /* 垂直累積 (カウント) */
+    int32_t acc_h;     /* 水平累積 (カウント) */
+} pointer_scroll_t;
+
+/* 加速状態 (カーブ + 端数の持ち越し) */
+typedef struct {
+    uint8_t curve;     /* pointer_curve_t */
+    uint8_t sensitivity; /* 感度倍率 (既定 TRACKBALL_SENSITIVITY) */
+    int32_t rem_x;     /* X 持ち越し (Q8) */
+    int32_t rem_y;     /* Y 持ち越し (Q8) */
+} pointer_accel_t;
+
+/**
+ * 加速状態を初期化
+ * @param curve 加速カーブ (範囲外なら既定カーブ)
+ */
+void pointer_accel_init(pointer_accel_t *accel, uint8_t curve);
+
+/**
+ * 加速カーブを変更 (持ち越し分は破棄)
+ */
+void pointer_accel_set_curve(pointer_accel_t *accel, uint8_t curve);
+
+/**
+ * 感度倍率を変更 (0 は 1 として扱う)
+ */
+void pointer_accel_set_sensitivity(pointer_accel_t *accel, uint8_t sensitivity);
+
+/**
+ * サンプルデルタに加速を適用
+ * @param dx, dy   トラックボールのデルタ (カウント)
+ * @param out_x, out_y レポート用デルタ (-127..127)
+ * @return true: 出力が非ゼロ
+ */
+bool pointer_accel_apply(pointer_accel_t *accel, int16_t dx, int16_t dy,
+                         int8_t *out_x, int8_t *out_y);
+
+/**
+ * 1カウント以上の持ち越しが残っているか
+ * (入力が止まった後も pointer_accel_apply(0, 0) で出し切るために使う)
+ */
+bool pointer_accel_pending(const pointer_accel_t *accel);
+
+/**
+ * スクロール累積をリセット (スクロールモード開始時)
+ */
+void pointer_scroll_reset(pointer_scroll_t *scroll);
+
+/**
+ * サンプルデルタをホイール出力に変換
+ * ボールの移動を TRACKBALL_SCROLL_DIVIDER カウント = 1ノッチとして累積し、
+ * 1ノッチ以上たまった分だけ出力する (残りは持ち越し)。
+ * 各サンプルは大きい方の軸にだけ加算し、斜めのぶれを抑える。
+ * @param dx, dy     トラックボールのデルタ (カウント)
+ * @param wheel      垂直ホイール (正=上, ボールを上へ転がす方向)
+ * @param pan        水平ホイール (正=右)
+ * @return true: 出力が非ゼロ (レポート送信が必要)
+ */
+bool pointer_scroll_apply(pointer_scroll_t *scroll, int16_t dx, int16_t dy,
+                          int8_t *wheel, int8_t *pan);
+
+/**
+ * カーブ名 (デバッグ表示用)
+ */
+const char *pointer_accel_curve_name(uint8_t curve);
+
+#endif /* POINTER_ACCEL_H */
@@ -0,0 +1,82 @@
+/**
+ * @file power_mgr.h
+ * @brief 省電力ステート管理 API
+ *
+ * 入力と BLE 接続状態から電力ステートを選び、マトリクススキャンと周期処理を間引く。
+ *
+ *   ACTIVE      : 入力あり (POWER_IDLE_TIMEOUT_MS 以内)。1kHz スキャン
+ *   IDLE        : 接続中・入力なし。スキャン停止, キー押下の GPIO 割り込みで起床
+ *   ADVERTISING : 未接続・入力なし。IDLE と同じく割り込み待ち + LED 表示を最小化
+ *   DORMANT     : 未接続のまま POWER_DORMANT_TIMEOUT_MS 入力なし (USB 給電時を除く)。
+ *                 無線を止めて XOSC DORMANT に入り、キー押下で起床して再起動する
+ *
+ * 起床レイテンシ (ステートごとに計測):
+ *   IDLE        : 起床割り込み → 最初の HID レポート送信要求
+ *   ADVERTISING : 起床割り込み → ホストとの接続確立 (レポートを送れるようになるまで)
+ *   DORMANT     : 再起動 → ホストとの接続確立
+ */
+
+#ifndef POWER_MGR_H
+#define POWER_MGR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    POWER_ACTIVE = 0,
+    POWER_IDLE,
+    POWER_ADVERTISING,
+    POWER_DORMANT,
+    POWER_STATE_COUNT
+} power_state_t;
+
+/* ステートごとの統計 */
+typedef struct {
+    uint32_t entries;        /* このステートに入った回数 */
+    uint32_t residency_ms;   /* 滞在時間の合計 */
+    uint32_t wakes;          /* 起床レイテンシを計測できた回数 */
+    uint32_t wake_last_us;
+    uint32_t wake_max_us;
+    uint64_t wake_total_us;
+} power_state_stats_t;
+
+/**
+ * 初期化 (タスク登録後に呼ぶ)
+ * DORMANT からの再起動であれば起床レイテンシの計測を始める。
+ * @param matrix_task マトリクススキャンタスクのID (省電力中は周期実行を止める)
+ */
+void power_mgr_init(int matrix_task);
+
+/**
+ * ステート遷移の判定 (マトリクスタスクとサービスタスクから呼ぶ)
+ * DORMANT に入る場合は戻らない (起床時に再起動する)。
+ */
+void power_mgr_update(uint64_t now_us);
+
+/**
+ * キー/トラックボール入力があったことを通知
+ */
+void power_mgr_note_input(uint64_t now_us);
+
+/**
+ * HID レポートを送信したことを通知 (起床レイテンシ計測の終点)
+ */
+void power_mgr_note_report(uint64_t now_us);
+
+/**
+ * 現在のステート
+ */
+power_state_t power_mgr_get_state(void);
+
+/**
+ * ステート名 (ログ/コンソール表示用)
+ */
+const char *power_mgr_state_name(power_state_t state);
+
+/**
+ * ステートごとの統計を取得
+ * @param reset true なら取得後にリセット
+ */
+void power_mgr_get_stats(power_state_t state, power_state_stats_t *stats, bool reset);
+
+#endif /* POWER_MGR_H */
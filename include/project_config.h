@@ -12,20 +12,104 @@
 #define BATTERY_ADC_PIN      28   /* バッテリー電圧監視 (ADC2) */
 #define BATTERY_ADC_CHANNEL  2
 
+/* バッテリー低下警告のしきい値 (%) */
+#define BATTERY_WARN_LEVEL   15
+
 /* バッテリー監視間隔 (ミリ秒) */
 #define BATTERY_CHECK_INTERVAL_MS  60000
 
 /* ============================================================
  * トラックボール設定
  * ============================================================ */
-#define TRACKBALL_POLL_INTERVAL_US  1000  /* ポーリング間隔 (1ms) */
+#define TRACKBALL_POLL_INTERVAL_US  1000  /* サンプリング間隔の下限 (1ms) */
+#define TRACKBALL_SAMPLES_PER_CONN_EVENT 2 /* 接続間隔あたりのサンプル数 */
+#define TRACKBALL_IDLE_INTERVAL_US  10000 /* 未接続時のサンプリング間隔 (10ms) */
+#define TRACKBALL_PHASE_TOLERANCE_US 200  /* 接続イベント位相とのずれ許容値 */
 #define TRACKBALL_SENSITIVITY       2     /* 感度倍率 (1-4) */
+#define TRACKBALL_I2C_FREQ          400000 /* 400kHz Fast-mode (不安定なら 100000) */
+#define TRACKBALL_INT_PIN           -1    /* INTピン (GPIO番号, -1=未使用で常時ポーリング) */
+#define TRACKBALL_INT_FALLBACK_MS   100   /* INT使用時の取りこぼし救済ポーリング間隔 */
+#define TRACKBALL_SCROLL_DIVIDER    8     /* スクロールモード: 1ノッチあたりのカウント数 */
+
+/* ============================================================
+ * Flash ストレージ (ログ構造ストア, BTstack TLV 領域の直前)
+ * ============================================================ */
+#define FLASH_LOG_SECTORS           4     /* 使用セクタ数 (4KB単位, 1つは常に予備) */
+#define FLASH_COMMIT_IDLE_MS        500   /* 最後のキー操作からこの時間経過後にコミット */
+
+/* ============================================================
+ * BLE リンク設定
+ * ============================================================ */
+/* BTstack 実行モード (CMake オプション JP106_BLE_BACKGROUND で切替) */
+#ifndef BLE_BACKGROUND_SERVICING
+#define BLE_BACKGROUND_SERVICING    1     /* 1=IRQ駆動バックグラウンド, 0=ポーリング */
+#endif
+
+/* 接続パラメータ既定値 (config_store で上書き可) */
+#define BLE_CONN_INTERVAL_MIN       6     /* 7.5ms (1.25ms単位) */
+#define BLE_CONN_INTERVAL_MAX       9     /* 11.25ms */
+#define BLE_CONN_LATENCY            25
+#define BLE_SUPERVISION_TIMEOUT     200   /* 2s (10ms単位) */
+
+#define BLE_PREFER_2M_PHY           1     /* 接続後に LE 2M PHY を要求 */
+#define BLE_DLE_TX_OCTETS           251   /* DLE 要求オクテット数 (27-251) */
+#define BLE_DLE_TX_TIME_US          2120  /* DLE 要求送信時間 (251オクテット@1M) */
+#define BLE_THROUGHPUT_TEST_MS      5000  /* Fn+T スループット計測時間 */
+
+/* 再接続アドバタイジング段階 (ペアリング済みスロット) */
+#define BLE_ADV_DIRECTED_HIGH_MS    1300  /* 高デューティ Directed (仕様上限1.28s) */
+#define BLE_ADV_DIRECTED_LOW_MS     5000  /* 低デューティ Directed */
+#define BLE_ADV_FILTER_MS           30000 /* フィルタ受理リスト → 以降は一般 */
+#define BLE_ADV_FAST_INTERVAL_MIN   0x0020  /* 20ms  (0.625ms単位) */
+#define BLE_ADV_FAST_INTERVAL_MAX   0x0030  /* 30ms */
+#define BLE_ADV_SLOW_INTERVAL_MIN   0x0030  /* 30ms */
+#define BLE_ADV_SLOW_INTERVAL_MAX   0x0060  /* 60ms */
+
+/* 接続イベント直前の入力サンプリング */
+#define BLE_ANCHOR_SCHEDULING       1     /* 1=マウスレポートを接続イベント直前まで保留 */
+#define BLE_PRE_ANCHOR_SEND_US      1000  /* 接続イベントの何us前にコントローラへ渡すか */
+#define BLE_PRE_ANCHOR_SAMPLE_US    2000  /* 接続イベントの何us前にトラックボールを読むか */
+#define BLE_ANCHOR_MAX_AGE_MS       1000  /* この間送信が無ければ位相推定を破棄 */
+
+/* ============================================================
+ * USB HID (有線接続時, usb_hid)
+ * ============================================================ */
+#define USB_VID                     0xCAFE  /* 開発用 (TinyUSB サンプルと同じ)。配布時は変更 */
+#define USB_PID                     0x4005  /* CDC + HID */
+#define USB_MANUFACTURER            "JP106"
+#define USB_PRODUCT                 "JP106 Keyboard"
+#define USB_HID_POLL_INTERVAL_MS    1     /* HID IN エンドポイントのポーリング間隔 (1kHz) */
+#define USB_VBUS_POLL_MS            100   /* VBUS (CYW43 GPIO) の確認間隔 */
+
+/* ============================================================
+ * タスクスケジューラ (周期 / 相対デッドライン, us)
+ * ============================================================ */
+#define SCHED_BLE_PERIOD_US         500   /* BTstack ポーリング (ポーリングビルドのみ) */
+#define SCHED_MATRIX_PERIOD_US      1000  /* マトリクススキャン 1kHz */
+#define SCHED_MATRIX_DEADLINE_US    500
+#define SCHED_TRACKBALL_DEADLINE_US 1000  /* 読み取り完了で起動 */
+#define SCHED_BATTERY_DEADLINE_US   100000
+#define SCHED_LED_PERIOD_US         10000 /* LED アニメーション 100Hz */
+#define SCHED_SERVICE_PERIOD_US     10000 /* コンソール + Flash コミット判定 */
+
+/* ============================================================
+ * 省電力 (power_mgr)
+ * ============================================================ */
+#define POWER_IDLE_TIMEOUT_MS      2000    /* 入力なし → スキャン停止 (キー割り込みで起床) */
+#define POWER_DORMANT_TIMEOUT_MS   300000  /* 未接続かつ入力なし → DORMANT (5分) */
+#define POWER_LOW_TASK_PERIOD_US   100000  /* 省電力中の LED/サービスタスク周期 */
+#define POWER_ADV_BLINK_MS         2000    /* ADVERTISING 中のオンボードLED点灯間隔 */
 
 /* ============================================================
  * デバッグ設定
  * ============================================================ */
 #define DEBUG_ENABLED 1
 
+/* バイナリトレース (trace.h): ホットパスのログは printf ではなくこちらに記録する */
+#define TRACE_ENABLED         1
+#define TRACE_BUF_RECORDS     256   /* リングバッファのレコード数 (2のべき乗, 1件 32 bytes) */
+#define TRACE_DRAIN_PER_POLL  16    /* trace on 時に1回のサービスタスクで出力する件数 */
+
 #if DEBUG_ENABLED
     #define DEBUG_PRINT(fmt, ...) printf("[DEBUG] " fmt "\n", ##__VA_ARGS__)
 #else
@@ -0,0 +1,80 @@
+/**
+ * @file scheduler.h
+ * @brief 協調型デッドラインスケジューラ API
+ *
+ * メインループの処理をタスク (周期 + 相対デッドライン) に分け、
+ * 実行時刻が来たタスクだけを実行する。複数のタスクが同時に実行可能なときは
+ * 絶対デッドライン (リリース時刻 + デッドライン) の早い順に実行する (EDF)。
+ * タスクは協調型で、実行中に割り込まれない (最後まで走りきる)。
+ *
+ * 1ティックで現在時刻を1回だけ取得し、全タスクに同じ時刻を渡す。
+ * 実行可能なタスクが無い間は次のリリース時刻まで WFE で待つ
+ * (割り込みで起床したら時刻を確認し直す)。
+ *
+ * 統計: タスクごとの実行回数, 実行時間 (合計/最大), 開始遅れ (最大),
+ * デッドラインミス (リリースからデッドラインまでに開始できなかった回数)。
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* 登録できるタスク数 */
+#define SCHED_MAX_TASKS  8
+
+/* タスク関数 (now_us: ティック開始時刻, 起動からの us) */
+typedef void (*sched_task_fn_t)(uint64_t now_us);
+
+/* タスク統計 */
+typedef struct {
+    const char *name;
+    uint32_t period_us;
+    uint32_t runs;           /* 実行回数 */
+    uint32_t misses;         /* デッドラインミス回数 (周期の取りこぼしを含む) */
+    uint32_t run_max_us;     /* 実行時間の最大 */
+    uint64_t run_total_us;   /* 実行時間の合計 */
+    uint32_t late_max_us;    /* リリースから開始までの遅れの最大 */
+} sched_task_stats_t;
+
+/**
+ * タスクを登録
+ * @param name        名前 (統計表示用)
+ * @param fn          タスク関数
+ * @param period_us   周期 (0 = 周期実行しない, sched_trigger() でのみ実行)
+ * @param deadline_us 相対デッドライン (リリースから開始までの許容時間)
+ * @return タスクID。登録できなければ -1。
+ */
+int sched_add_task(const char *name, sched_task_fn_t fn,
+                   uint32_t period_us, uint32_t deadline_us);
+
+/**
+ * 周期を変更 (次回リリースは現在のリリース時刻 + 新しい周期)
+ */
+void sched_set_period(int task, uint32_t period_us);
+
+/**
+ * 次のティックで実行させる (イベント駆動の処理用, 割り込みから呼んでよい)
+ */
+void sched_trigger(int task);
+
+/**
+ * 1ティック実行: 実行時刻が来たタスクを EDF 順に実行し、
+ * 次のリリース時刻まで (または割り込みが来るまで) 待つ
+ */
+void sched_run_tick(void);
+
+/**
+ * タスク統計を取得
+ * @param reset true なら取得後にリセット
+ * @return false: タスクIDが無効
+ */
+bool sched_get_stats(int task, sched_task_stats_t *stats, bool reset);
+
+/**
+ * 登録済みタスク数
+ */
+int sched_task_count(void);
+
+#endif /* SCHEDULER_H */
@@ -0,0 +1,111 @@
+/**
+ * @file trace.h
+ * @brief バイナリトレース (リングバッファ) API
+ *
+ * TRACE(名前, 引数...) はイベントID・タイムスタンプ・整数引数だけを
+ * RAM のリングバッファに書き込む (printf の書式処理も USB 出力もしない)。
+ * 割り込み/BTstack コンテキストからも呼べ、ホットパスに残したままにできる。
+ *
+ * 書式化はホスト側で行う: コンソールの trace コマンド (または trace on の連続出力) が
+ * "#T <時刻> <ID> <引数>..." の行を出し、tools/trace_decode.py が
+ * include/trace_ids.h の書式で文字列に戻す。
+ *
+ * バッファが一杯になると古いレコードから上書きし、読み出し時に欠落数を報告する。
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "project_config.h"
+#include "hardware/timer.h"
+
+#define TRACE_ARGS_MAX  4
+
+_Static_assert((TRACE_BUF_RECORDS & (TRACE_BUF_RECORDS - 1)) == 0,
+               "TRACE_BUF_RECORDS must be a power of two");
+
+/* イベントID (trace_ids.h の並び順) */
+typedef enum {
+#define TRACE_EVENT(name, fmt) TRACE_##name,
+#define TRACE_ENUM(name, ...)
+#include "trace_ids.h"
+#undef TRACE_EVENT
+#undef TRACE_ENUM
+    TRACE_ID_COUNT
+} trace_id_t;
+
+/* レコード (固定長) */
+typedef struct {
+    uint32_t ts_us;
+    uint16_t id;
+    uint8_t  nargs;
+    uint8_t  reserved;
+    uint32_t args[TRACE_ARGS_MAX];
+    volatile uint32_t seq;   /* 書込み完了の印 (通し番号 + 1) */
+} trace_record_t;
+
+extern trace_record_t trace_buf[TRACE_BUF_RECORDS];
+extern uint32_t trace_head;
+
+static inline void trace_emit(uint16_t id, uint8_t nargs,
+                              uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t seq = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+    trace_record_t *r = &trace_buf[seq & (TRACE_BUF_RECORDS - 1)];
+    r->seq = 0;
+    r->ts_us = time_us_32();
+    r->id = id;
+    r->nargs = nargs;
+    r->args[0] = a0;
+    r->args[1] = a1;
+    r->args[2] = a2;
+    r->args[3] = a3;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    r->seq = seq + 1;
+}
+
+/* 引数の数と、足りない分を 0 で埋めた4引数 */
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define TRACE_NARGS(...) TRACE_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define TRACE_PAD_(_0, a, b, c, d, ...) \
+    (uint32_t)(a), (uint32_t)(b), (uint32_t)(c), (uint32_t)(d)
+#define TRACE_PAD(...) TRACE_PAD_(0, ##__VA_ARGS__, 0, 0, 0, 0)
+
+#if TRACE_ENABLED
+    #define TRACE(name, ...) \
+        trace_emit(TRACE_##name, TRACE_NARGS(__VA_ARGS__), TRACE_PAD(__VA_ARGS__))
+#else
+    #define TRACE(name, ...) ((void)0)
+#endif
+
+/**
+ * 未読のレコードを1件取り出す (メインループから呼ぶ)
+ * @return false: 未読なし
+ */
+bool trace_read(trace_record_t *rec);
+
+/**
+ * 上書きで失われたレコード数を取得してクリア
+ */
+uint32_t trace_take_dropped(void);
+
+/**
+ * 未読のレコードを "#T" 行として stdout に出力
+ * @param max_records 出力する最大件数
+ * @return 出力した件数
+ */
+uint32_t trace_dump(uint32_t max_records);
+
+/**
+ * 連続出力の有効/無効 (trace_poll() で少しずつ出力)
+ */
+void trace_set_streaming(bool enable);
+
+/**
+ * 連続出力が有効なら未読レコードを少しずつ出力 (サービスタスクから呼ぶ)
+ */
+void trace_poll(void);
+
+#endif /* TRACE_H */
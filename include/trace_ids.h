@@ -0,0 +1,86 @@
+/**
+ * @file trace_ids.h
+ * @brief トレースイベント定義 (ファームウェアとホスト側デコーダで共有)
+ *
+ * TRACE_EVENT(名前, "書式")
+ *   - 引数は整数のみ, 最大 TRACE_ARGS_MAX (4) 個。記録は 32bit 単位
+ *   - 書式は printf 互換 (%d %u %x %X と幅指定)。%{列挙名} は TRACE_ENUM の名前に置き換える
+ *   - ID は並び順で決まる。デコーダは同じリビジョンのこのファイルを読むこと
+ *
+ * TRACE_ENUM(列挙名, "値0の名前", "値1の名前", ...)
+ *   - デコーダ専用 (ファームウェアでは展開されない)
+ *
+ * このファイルは include ガードを持たない (X マクロとして複数回展開する)。
+ */
+
+/* ---- 列挙名 (デコーダ用) ---- */
+TRACE_ENUM(adv_phase, "directed-high", "directed-low", "filter-list", "general", "background", "off")
+TRACE_ENUM(phy, "?", "1M", "2M", "Coded")
+TRACE_ENUM(enabled, "disabled", "enabled")
+TRACE_ENUM(protocol, "Boot (6KRO)", "Report (NKRO+Mouse)")
+TRACE_ENUM(power_state, "active", "idle", "advertising", "dormant")
+TRACE_ENUM(curve, "linear", "mild", "strong")
+TRACE_ENUM(transport, "BLE", "USB")
+TRACE_ENUM(present, "removed", "present")
+
+/* ---- main ---- */
+TRACE_EVENT(KEY_DEBUG,          "Key: mod=0x%02X keys=%08lX%04lX")
+TRACE_EVENT(SLOT_SWITCH,        "Slot switch: %u -> %u")
+TRACE_EVENT(POINTER_CURVE,      "Pointer curve: slot %u -> %{curve}")
+TRACE_EVENT(FLASH_COMMIT,       "Flash commit: blocked %lu us (max %lu us, %lu commits, idle %lu ms)")
+TRACE_EVENT(TB_SAMPLE_STATS,    "Trackball sampling: interval=%lu us samples=%lu skipped=%lu")
+TRACE_EVENT(TB_SAMPLE_JITTER,   "Trackball sampling: jitter avg=%lu max=%lu us")
+
+/* ---- ble_hid ---- */
+TRACE_EVENT(BLE_RECONNECT,      "BLE reconnect (slot %u): first report after %lu ms (via %{adv_phase})")
+TRACE_EVENT(BLE_ADV_STOPPED,    "BLE advertising stopped (%u connections)")
+TRACE_EVENT(BLE_ADV_STARTED,    "BLE advertising started (slot %u, %{adv_phase})")
+TRACE_EVENT(BLE_CONNECTED,      "BLE connected (slot %u, peer=%06lX%06lX type=%u)")
+TRACE_EVENT(BLE_INPUT_REPORT,   "BLE HID input report %{enabled} (slot %u)")
+TRACE_EVENT(BLE_BOOT_REPORT,    "BLE HID boot keyboard report %{enabled} (slot %u)")
+TRACE_EVENT(BLE_PROTOCOL_MODE,  "BLE protocol mode (slot %u): %{protocol}")
+TRACE_EVENT(BLE_CONN_INTERVAL,  "BLE connection interval (slot %u): %u (x1.25ms)")
+TRACE_EVENT(BLE_PHY,            "BLE PHY (slot %u): tx=%{phy} rx=%{phy}")
+TRACE_EVENT(BLE_DATA_LENGTH,    "BLE data length (slot %u): tx=%u rx=%u")
+TRACE_EVENT(BLE_MTU,            "BLE ATT MTU (slot %u): %u")
+TRACE_EVENT(BLE_MTU_PERIPHERAL, "BLE ATT MTU (slot %u, peripheral request): %u")
+TRACE_EVENT(BLE_DISCONNECTED,   "BLE disconnected (slot %u)")
+TRACE_EVENT(BLE_JUST_WORKS,     "BLE pairing: Just Works confirmed")
+TRACE_EVENT(BLE_IDENTITY,       "BLE identity resolved: slot %u -> %u")
+TRACE_EVENT(BLE_UNKNOWN_REJECTED, "BLE unidentified peer rejected (advertised slot in use)")
+TRACE_EVENT(BLE_PAIRED,         "BLE pairing complete (slot %u)")
+TRACE_EVENT(BLE_PAIR_FAILED,    "BLE pairing failed (status=%u)")
+TRACE_EVENT(BLE_SLOT_SWITCHED,  "BLE slot %u -> %u: switched without reconnect")
+TRACE_EVENT(BLE_SLOT_WAITING,   "BLE slot %u -> %u: waiting for connection")
+TRACE_EVENT(BLE_THROUGHPUT_START, "BLE throughput test started (slot %u, %lu ms)")
+TRACE_EVENT(BLE_THROUGHPUT,     "BLE throughput (slot %u): %lu notifications in %lu ms = %lu/s")
+TRACE_EVENT(BLE_THROUGHPUT_PHY, "BLE throughput link: PHY %{phy}/%{phy}, DLE %u/%u")
+TRACE_EVENT(BLE_THROUGHPUT_MTU, "BLE throughput link: MTU %u, interval %u (x1.25ms)")
+TRACE_EVENT(BLE_SEND_LATENCY,   "BLE report latency (post -> send): avg %lu us, max %lu us (%lu samples)")
+TRACE_EVENT(BLE_EVENT_LATENCY,  "BLE report latency (post -> connection event): avg %lu us, max %lu us (%lu samples)")
+
+/* ---- device_slot / flash_log ---- */
+TRACE_EVENT(SLOT_SAVED,         "TLV: slot %u saved (bond=%d)")
+TRACE_EVENT(SLOT_ACTIVE_SAVED,  "TLV: active slot saved (%u)")
+TRACE_EVENT(SLOT_COMMIT_FAILED, "TLV: flash commit failed, will retry")
+TRACE_EVENT(SLOT_SWITCHED,      "Slot switched to %u (paired=%u)")
+TRACE_EVENT(SLOT_PAIRING_SAVED, "Slot %u: pairing saved (bond=%d addr=%06lX%06lX)")
+TRACE_EVENT(SLOT_CURVE_SAVED,   "TLV: slot %u pointer curve saved (%{curve})")
+TRACE_EVENT(SLOT_CLEARED,       "Slot %u: pairing cleared")
+TRACE_EVENT(FLASHLOG_PENDING,   "FlashLog: pending table full, write of 0x%08lx rejected until commit")
+TRACE_EVENT(FLASHLOG_REJECTED,  "FlashLog: index full, write of 0x%08lx rejected")
+
+/* ---- trackball ---- */
+TRACE_EVENT(TB_SAMPLE_INTERVAL, "Trackball: sampling every %lu us")
+
+/* ---- power_mgr ---- */
+TRACE_EVENT(POWER_STATE,        "Power: %{power_state} -> %{power_state}")
+TRACE_EVENT(POWER_WAKE,         "Power: wake from %{power_state} -> ready in %lu us")
+
+/* ---- usb_hid ---- */
+TRACE_EVENT(USB_MOUNTED,        "USB: configured by host")
+TRACE_EVENT(USB_UNMOUNTED,      "USB: unconfigured")
+TRACE_EVENT(USB_SUSPENDED,      "USB: suspended")
+TRACE_EVENT(USB_RESUMED,        "USB: resumed")
+TRACE_EVENT(USB_VBUS,           "USB: VBUS %{present}")
+TRACE_EVENT(HID_TRANSPORT,      "HID transport: %{transport} -> %{transport}")
@@ -10,6 +10,10 @@
  *   SCL = GP27 (I2C1)
  *
  * I2Cアドレス: 0x0A (デフォルト)
+ * INTピン: TRACKBALL_INT_PIN (オプション, アクティブLOW)
+ *
+ * 初期化 (デバイス検出) 以外の I2C 転送は割り込み駆動で行い、
+ * 呼び出し元をバスの完了待ちでブロックしない。
  */
 
 #ifndef TRACKBALL_H
@@ -20,10 +24,10 @@
 
 /* I2C設定 */
 #define TRACKBALL_I2C         i2c1
+#define TRACKBALL_I2C_IRQ     I2C1_IRQ
 #define TRACKBALL_SDA_PIN     26
 #define TRACKBALL_SCL_PIN     27
 #define TRACKBALL_I2C_ADDR    0x0A
-#define TRACKBALL_I2C_FREQ    100000  /* 100kHz */
 
 /* Pimoroni Trackball レジスタ */
 #define TRACKBALL_REG_LED_RED     0x00
@@ -35,6 +39,11 @@
 #define TRACKBALL_REG_UP          0x06
 #define TRACKBALL_REG_DOWN        0x07
 #define TRACKBALL_REG_SWITCH      0x08
+#define TRACKBALL_REG_INT         0xF9
+
+/* REG_INT ビット */
+#define TRACKBALL_INT_TRIGGERED   0x01
+#define TRACKBALL_INT_OUT_EN      0x02
 
 /* トラックボール状態 */
 typedef struct {
@@ -44,6 +53,18 @@ typedef struct {
     bool    changed;    /* 前回読み取りから変化あり */
 } trackball_state_t;
 
+/* サンプリングタイマー統計 */
+typedef struct {
+    uint32_t interval_us;     /* 現在のサンプリング間隔 */
+    uint32_t samples;         /* タイマー発火回数 */
+    uint64_t jitter_total_us; /* 予定時刻からの発火遅れの合計 */
+    uint32_t jitter_max_us;   /* 予定時刻からの発火遅れの最大 */
+    uint32_t skipped;         /* 前回の読み取りが未完了で見送った回数 */
+} trackball_sample_stats_t;
+
+/* 読み取り完了コールバック (I2C 割り込みから呼ばれる) */
+typedef void (*trackball_sample_cb_t)(void);
+
 /**
  * トラックボール初期化 (I2C設定 + デバイス検出)
  * @return true: 初期化成功 (デバイス検出), false: 未接続
@@ -52,13 +73,52 @@ bool trackball_init(void);
 
 /**
  * トラックボール状態を読み取り
- * I2Cからデルタとボタン状態を取得。
- * デルタは前回読み取りからの累積移動量。
+ * 割り込みで完了済みのサンプルを取り出す。
+ * 読み取りの発行はサンプリングタイマー (INTピン使用時は INT 割り込みと
+ * 救済ポーリング) が行うため、呼び出し頻度はサンプルレートに影響しない。
+ * デルタは前回呼び出し以降に完了したサンプルの累積移動量。
+ * バス転送の完了は待たない。
  */
 void trackball_read(trackball_state_t *state);
 
+/**
+ * 読み取り完了時のコールバックを設定
+ * 接続イベント直前に合わせた読み取りを待たずに取り出せるよう、
+ * 完了したサンプルを消費するタスクを起こすのに使う。
+ * @param cb 割り込みコンテキストで呼ばれる (sched_trigger() など割り込み安全な処理のみ, NULL 可)
+ */
+void trackball_set_sample_callback(trackball_sample_cb_t cb);
+
+/**
+ * レジスタ読み取りを非同期に発行 (転送中なら完了後に実行)
+ */
+void trackball_request_sample(void);
+
+/**
+ * サンプリングタイマーの間隔を変更 (INTピン未使用時)
+ * BLE 接続間隔に合わせて呼ぶ。同じ間隔なら何もしない。
+ * @param interval_us サンプリング間隔 (TRACKBALL_POLL_INTERVAL_US 未満は切り上げ)
+ */
+void trackball_set_sample_interval(uint32_t interval_us);
+
+/**
+ * サンプリングタイマーの位相を合わせる (INTピン未使用時)
+ * 以降の読み取りが at_us (+ 周期の整数倍) に発行されるよう、
+ * ずれが TRACKBALL_PHASE_TOLERANCE_US を超えていればタイマーを付け替える。
+ * @param at_us 目標時刻 (time_us_32() 基準, 接続イベント直前)
+ */
+void trackball_align_sample_phase(uint32_t at_us);
+
+/**
+ * サンプリングタイマーの統計を取得
+ * @param reset true なら取得後にリセット
+ */
+void trackball_get_sample_stats(trackball_sample_stats_t *stats, bool reset);
+
 /**
  * トラックボールLEDを設定
+ * 書き込みはキューに入り、バスが空き次第割り込みから送信される。
+ * 未送信の設定は最新値で上書きされる。
  * @param r 赤 (0-255)
  * @param g 緑 (0-255)
  * @param b 青 (0-255)
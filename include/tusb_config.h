@@ -0,0 +1,33 @@
+/**
+ * @file tusb_config.h
+ * @brief TinyUSB 設定 (コンポジット: CDC シリアル + HID)
+ *
+ * CDC は pico_stdio_usb (printf / コンソール) がそのまま使う。
+ * HID は usb_hid.c が BLE と同じレポートディスクリプタで使う。
+ */
+
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+#ifndef CFG_TUSB_RHPORT0_MODE
+#define CFG_TUSB_RHPORT0_MODE   OPT_MODE_DEVICE
+#endif
+
+#define CFG_TUD_ENABLED         1
+#define CFG_TUD_ENDPOINT0_SIZE  64
+
+/* クラスドライバ */
+#define CFG_TUD_CDC             1
+#define CFG_TUD_HID             1
+#define CFG_TUD_MSC             0
+#define CFG_TUD_MIDI            0
+#define CFG_TUD_VENDOR          0
+
+/* CDC FIFO (stdio_usb の既定と同じ) */
+#define CFG_TUD_CDC_RX_BUFSIZE  256
+#define CFG_TUD_CDC_TX_BUFSIZE  256
+
+/* HID: Report ID + NKRO (23 bytes) が1パケットに入る大きさ */
+#define CFG_TUD_HID_EP_BUFSIZE  32
+
+#endif /* TUSB_CONFIG_H */
@@ -0,0 +1,58 @@
+/**
+ * @file usb_hid.h
+ * @brief USB HID トランスポート API (有線接続)
+ *
+ * TinyUSB の HID インターフェースから、BLE と同じレポート形式
+ * (hid_descriptor.h: Report ID 1 = NKRO キーボード, Report ID 2 = マウス) で送信する。
+ * ポーリング間隔は USB_HID_POLL_INTERVAL_MS (1ms)。
+ *
+ * トランスポートの選択:
+ *   VBUS あり (CYW43 の WL_GPIO2) かつホストにエニュメレーション済み・非サスペンドなら
+ *   usb_hid_is_active() が true になり、入力レポートは USB に送る。
+ *   充電器のみ (エニュメレーションなし) やホストのサスペンド中は BLE を使う。
+ *
+ * 実行コンテキスト:
+ *   tud_task() は pico_stdio_usb の低優先度割り込みで実行される。
+ *   hid_pipeline のシンクとして登録し、フレームが積まれた時点でエンドポイントが空いていれば
+ *   その場で送信する (割り込み禁止区間で数us)。残りは送信完了コールバックで送る。
+ */
+
+#ifndef USB_HID_H
+#define USB_HID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * TinyUSB 初期化 (stdio_init_all() より前に呼ぶ)
+ */
+void usb_hid_init(void);
+
+/**
+ * VBUS の確認 (USB_VBUS_POLL_MS ごと, cyw43_arch_init() の後にサービスタスクから呼ぶ)
+ * @param now_ms 現在時刻 (ms)
+ */
+void usb_hid_update(uint32_t now_ms);
+
+/**
+ * VBUS (USB 給電) があるか (最後に確認した値)
+ */
+bool usb_hid_vbus_present(void);
+
+/**
+ * 入力レポートを USB で送るべきか (VBUS あり + エニュメレーション済み + 非サスペンド)
+ */
+bool usb_hid_is_active(void);
+
+/**
+ * hid_pipeline へシンクとして登録 (hid_pipeline_init() の後に呼ぶ)
+ * @return シンク番号 (hid_pipeline_set_active() に渡す)
+ */
+int usb_hid_attach_pipeline(void);
+
+/**
+ * 送信待ちのレポートが無いか
+ */
+bool usb_hid_is_tx_idle(void);
+
+#endif /* USB_HID_H */
@@ -4,31 +4,42 @@
  *
  * PIO を使用して WS2812B LEDチェーンを駆動。
  * スロット表示用に3個のLEDをGP22で制御。
+ *
+ * フレーム送信は DMA で PIO TX FIFO へ流し込み、呼び出し元を待たせない。
+ * ws2812_show() は描画バッファを送信バッファへコピーして即座に戻る。
+ * 送信中に show() された場合は、送信完了後に最新のフレームを続けて送る。
  */
 
 #ifndef WS2812_LED_H
 #define WS2812_LED_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /* WS2812B チェーン設定 */
 #define WS2812_PIN       22   /* GP22: データ出力 */
-#define WS2812_NUM_LEDS  3    /* スロット表示用3個 */
+#ifndef WS2812_NUM_LEDS
+#define WS2812_NUM_LEDS  3    /* スロット表示用3個 (キーごと/アンダーグロー用に拡張可) */
+#endif
 #define WS2812_FREQ      800000  /* 800kHz */
+#define WS2812_RESET_US  300     /* ラッチ (リセット) 期間: WS2812B は 280us 以上 */
+
+/* フレーム送信完了コールバック (割り込みコンテキストから呼ばれる) */
+typedef void (*ws2812_done_cb_t)(void);
 
 /**
- * WS2812B ドライバ初期化 (PIOセットアップ)
+ * WS2812B ドライバ初期化 (PIO + DMA セットアップ)
  */
 void ws2812_init(void);
 
 /**
  * 指定LEDの色を設定 (バッファのみ、送信はshow()で)
- * @param index LED番号 (0-2)
+ * @param index LED番号 (0 - WS2812_NUM_LEDS-1)
  * @param r 赤 (0-255)
  * @param g 緑 (0-255)
  * @param b 青 (0-255)
  */
-void ws2812_set_pixel(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
+void ws2812_set_pixel(uint16_t index, uint8_t r, uint8_t g, uint8_t b);
 
 /**
  * 全LEDを消灯に設定 (バッファのみ)
@@ -36,8 +47,21 @@ void ws2812_set_pixel(uint8_t index, uint8_t r, uint8_t g, uint8_t b);
 void ws2812_clear(void);
 
 /**
- * バッファの色データをLEDチェーンに送信
+ * バッファの色データをLEDチェーンに送信 (非ブロッキング)
+ * 描画バッファの内容をこの時点で確定し、DMA 送信を開始 (送信中なら予約) する。
  */
 void ws2812_show(void);
 
+/**
+ * フレーム送信中 (ラッチ期間を含む) かどうか
+ */
+bool ws2812_is_busy(void);
+
+/**
+ * フレーム送信完了コールバックを設定
+ * ラッチ期間が終わり、送ったフレームが LED に反映された時点で呼ばれる。
+ * @param cb コールバック (NULL で解除)
+ */
+void ws2812_set_done_callback(ws2812_done_cb_t cb);
+
 #endif /* WS2812_LED_H */
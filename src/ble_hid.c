@@ -17,14 +17,44 @@
  *
  * フロー制御:
  *   BLE は任意のタイミングで送信不可。CAN_SEND_NOW イベントを待ち、
- *   その時点でバッファ済みレポートを送信する。
+ *   その時点で hid_pipeline に積まれたフレームを参照のまま通知する (コピーしない)。
  *   キーボードレポートがマウスレポートより優先。
+ *
+ * リンク最適化:
+ *   接続後に LE 2M PHY と Data Length Extension を要求し、
+ *   ATT MTU が NKRO レポートに足りなければ MTU 交換を行う。
+ *   ネゴシエーション結果はスロット別に記録する。
+ *
+ * 再接続 (ペアリング済みスロット):
+ *   高デューティ Directed → 低デューティ Directed → フィルタ受理リスト付き
+ *   Undirected → 一般 Undirected の順に段階的に切り替える。
+ *   起動/スロット切替から最初の入力レポート送信までの時間を計測する。
+ *
+ * マルチ接続:
+ *   スロットごとに1本、最大 MAX_DEVICE_SLOTS 本の接続を同時に保持する。
+ *   プロトコルモード・入力レポート購読状態・送信バッファは接続ごとに持ち、
+ *   スロット切替はレポート送信先の接続を変えるだけ (切断しない)。
+ *   アクティブスロット接続中は、未接続のペアリング済みスロットに向けて
+ *   フィルタ受理リスト付きアドバタイジングを続け、バックグラウンドで再接続する。
+ *
+ * 実行コンテキスト:
+ *   BTstack は cyw43_arch の async_context 上で動作する。
+ *   バックグラウンドビルド (BLE_BACKGROUND_SERVICING=1) では IRQ 駆動で
+ *   イベントが到着次第処理され、メインループのブロッキングに影響されない。
+ *   メインループからの API 呼出しは async_context のロックを取得する。
+ *   入力レポートは hid_pipeline に積まれ、シンクの notify で送信ワーカーに通知するだけで戻る。
  */
 
 #include "ble_hid.h"
 #include "hid_keycodes.h"
+#include "hid_descriptor.h"
+#include "hid_pipeline.h"
 #include "project_config.h"
 #include "device_slot.h"
+#include "config_store.h"
+#include "perf.h"
+#include "perf_service.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -32,6 +62,7 @@
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
 #include "pico/btstack_cyw43.h"
+#include "pico/async_context.h"
 
 #include "btstack.h"
 #include "ble/gatt-service/battery_service_server.h"
@@ -41,168 +72,482 @@
 /* ビルド時自動生成 (hog_keyboard.gatt → hog_keyboard.h) */
 #include "hog_keyboard.h"
 
-/* ============================================================
- * HID Report Descriptor (コンポジット: キーボード + マウス)
- *
- * Report ID 1: キーボード
- *   byte 0:     modifier keys (8 bits)
- *   bytes 1-21: NKRO bitmap (168 bits, usage 0x00-0xA7)
- *
- * Report ID 2: マウス
- *   byte 0:     buttons (3 bits + 5 padding)
- *   byte 1:     X movement (int8)
- *   byte 2:     Y movement (int8)
- *   byte 3:     wheel (int8)
- * ============================================================ */
-static const uint8_t hid_report_descriptor[] = {
-    /* ===== Keyboard Collection (Report ID 1) ===== */
-    0x05, 0x01,        /* Usage Page (Generic Desktop) */
-    0x09, 0x06,        /* Usage (Keyboard) */
-    0xA1, 0x01,        /* Collection (Application) */
-    0x85, 0x01,        /*   Report ID (1) */
-
-    /* --- Modifier byte (8 bits) --- */
-    0x05, 0x07,        /*   Usage Page (Keyboard/Keypad) */
-    0x19, 0xE0,        /*   Usage Minimum (Left Control) */
-    0x29, 0xE7,        /*   Usage Maximum (Right GUI) */
-    0x15, 0x00,        /*   Logical Minimum (0) */
-    0x25, 0x01,        /*   Logical Maximum (1) */
-    0x75, 0x01,        /*   Report Size (1 bit) */
-    0x95, 0x08,        /*   Report Count (8) */
-    0x81, 0x02,        /*   Input (Data, Variable, Absolute) */
-
-    /* --- NKRO bitmap (168 bits = 21 bytes) --- */
-    0x95, 0xA8,        /*   Report Count (168) */
-    0x75, 0x01,        /*   Report Size (1 bit) */
-    0x15, 0x00,        /*   Logical Minimum (0) */
-    0x25, 0x01,        /*   Logical Maximum (1) */
-    0x05, 0x07,        /*   Usage Page (Keyboard/Keypad) */
-    0x19, 0x00,        /*   Usage Minimum (0x00) */
-    0x29, 0xA7,        /*   Usage Maximum (0xA7) */
-    0x81, 0x02,        /*   Input (Data, Variable, Absolute) */
-
-    /* --- LED output report (5 bits + 3 padding) --- */
-    0x95, 0x05,        /*   Report Count (5) */
-    0x75, 0x01,        /*   Report Size (1 bit) */
-    0x05, 0x08,        /*   Usage Page (LEDs) */
-    0x19, 0x01,        /*   Usage Minimum (Num Lock) */
-    0x29, 0x05,        /*   Usage Maximum (Kana) */
-    0x91, 0x02,        /*   Output (Data, Variable, Absolute) */
-    0x95, 0x01,        /*   Report Count (1) */
-    0x75, 0x03,        /*   Report Size (3 bits) */
-    0x91, 0x01,        /*   Output (Constant) - padding */
-
-    0xC0,              /* End Collection (Keyboard) */
-
-    /* ===== Mouse Collection (Report ID 2) ===== */
-    0x05, 0x01,        /* Usage Page (Generic Desktop) */
-    0x09, 0x02,        /* Usage (Mouse) */
-    0xA1, 0x01,        /* Collection (Application) */
-    0x85, 0x02,        /*   Report ID (2) */
-    0x09, 0x01,        /*   Usage (Pointer) */
-    0xA1, 0x00,        /*   Collection (Physical) */
-
-    /* --- Buttons (3 bits + 5 padding) --- */
-    0x05, 0x09,        /*     Usage Page (Button) */
-    0x19, 0x01,        /*     Usage Minimum (Button 1) */
-    0x29, 0x03,        /*     Usage Maximum (Button 3) */
-    0x15, 0x00,        /*     Logical Minimum (0) */
-    0x25, 0x01,        /*     Logical Maximum (1) */
-    0x75, 0x01,        /*     Report Size (1 bit) */
-    0x95, 0x03,        /*     Report Count (3) */
-    0x81, 0x02,        /*     Input (Data, Variable, Absolute) */
-    0x95, 0x01,        /*     Report Count (1) */
-    0x75, 0x05,        /*     Report Size (5 bits) */
-    0x81, 0x01,        /*     Input (Constant) - padding */
-
-    /* --- X, Y movement (2 bytes, signed) --- */
-    0x05, 0x01,        /*     Usage Page (Generic Desktop) */
-    0x09, 0x30,        /*     Usage (X) */
-    0x09, 0x31,        /*     Usage (Y) */
-    0x15, 0x81,        /*     Logical Minimum (-127) */
-    0x25, 0x7F,        /*     Logical Maximum (127) */
-    0x75, 0x08,        /*     Report Size (8 bits) */
-    0x95, 0x02,        /*     Report Count (2) */
-    0x81, 0x06,        /*     Input (Data, Variable, Relative) */
-
-    /* --- Wheel (1 byte, signed) --- */
-    0x09, 0x38,        /*     Usage (Wheel) */
-    0x15, 0x81,        /*     Logical Minimum (-127) */
-    0x25, 0x7F,        /*     Logical Maximum (127) */
-    0x75, 0x08,        /*     Report Size (8 bits) */
-    0x95, 0x01,        /*     Report Count (1) */
-    0x81, 0x06,        /*     Input (Data, Variable, Relative) */
-
-    0xC0,              /*   End Collection (Physical) */
-    0xC0,              /* End Collection (Mouse) */
-};
-
 /* ============================================================
  * BLE 状態管理
  * ============================================================ */
-static hci_con_handle_t con_handle = HCI_CON_HANDLE_INVALID;
-static uint8_t protocol_mode = 1;   /* 0=Boot, 1=Report */
-static bool can_send_now = false;
+#define SLOT_NONE  0xFF
+
+/* NKRO レポート (Report ID付き) を1通知で送るのに必要な MTU */
+#define REQUIRED_ATT_MTU  (3 + 1 + NKRO_REPORT_SIZE)
+
+/* 接続ごとの HID 状態 */
+typedef struct {
+    hci_con_handle_t handle;          /* HCI接続ハンドル (INVALID=空き) */
+    uint8_t  slot;                    /* 紐付くデバイススロット (SLOT_NONE=ID 解決待ち) */
+    bool     reports_enabled;         /* ホストが入力レポートを購読済み (CCCD) */
+    uint8_t  protocol_mode;           /* 0=Boot, 1=Report */
+    bool     can_send_now;
+    bool     dle_request_pending;
+
+    /* ピアアドレス (接続時のスロット検索用) */
+    bd_addr_t peer_addr;
+    uint8_t   peer_addr_type;
+
+    /* 入力レポートはアクティブスロットの接続だけが hid_pipeline から受け取る */
+    bool     release_pending;         /* 全キー解放を送る (スロット切替時, 全接続) */
+    bool     mouse_hold;              /* 接続イベント直前まで送信を保留中 */
+    bool     mouse_released;          /* 保留解除済み (送信待ち) */
+    uint32_t mouse_release_us;        /* 保留解除時刻 */
+
+    /* 接続イベント位相 (送信完了イベントの受信時刻) */
+    uint32_t anchor_us;
+    bool     anchor_valid;
+
+    /* CAN_SEND_NOW 待ち時間の計測 */
+    bool     can_send_requested;
+    uint32_t can_send_request_us;
+
+    /* スロット未割当の間のリンク情報 (割当時に link_info へ移す) */
+    ble_hid_link_info_t unassigned_link;
+} ble_conn_t;
+
+static ble_conn_t conns[MAX_NR_HCI_CONNECTIONS];
 static uint8_t battery_level = 100;
 static bool btstack_ready = false;
 
-/* 接続中ピアアドレスのキャッシュ (ペアリング完了時に使用) */
-static bd_addr_t peer_addr;
-static uint8_t peer_addr_type;
-
-/* キーボード送信バッファ (優先度: 高) */
-#define MAX_KB_REPORT_SIZE  (1 + NKRO_REPORT_SIZE)  /* Report ID + NKRO */
-static uint8_t pending_kb_report[MAX_KB_REPORT_SIZE];
-static uint8_t pending_kb_len = 0;
-static bool kb_pending = false;
-static bool kb_is_boot = false;  /* Boot Protocolフラグ */
-
-/* マウス送信バッファ (優先度: 低) */
-#define MAX_MOUSE_REPORT_SIZE  (1 + MOUSE_REPORT_SIZE)  /* Report ID + Mouse */
-static uint8_t pending_mouse_report[MAX_MOUSE_REPORT_SIZE];
-static bool mouse_pending = false;
+/* リンク情報 (スロット別) */
+static ble_hid_link_info_t link_info[MAX_DEVICE_SLOTS];
+
+/* スループット計測 (アクティブスロットの接続で実施) */
+static btstack_timer_source_t throughput_timer;
+static bool throughput_active = false;
+static uint8_t throughput_slot = 0;
+static uint32_t throughput_count = 0;
+static uint32_t throughput_start_ms = 0;
+
+/* アドバタイジング段階 (ペアリング済みスロットの高速再接続) */
+typedef enum {
+    ADV_PHASE_DIRECTED_HIGH = 0,  /* 高デューティ Directed (最大1.28s) */
+    ADV_PHASE_DIRECTED_LOW,       /* 低デューティ Directed */
+    ADV_PHASE_FILTER,             /* フィルタ受理リスト付き Undirected */
+    ADV_PHASE_GENERAL,            /* 一般 Undirected (新規ペアリング) */
+    ADV_PHASE_BACKGROUND,         /* 非アクティブスロットのバックグラウンド再接続 */
+    ADV_PHASE_OFF,                /* 停止 (全スロット接続済み等) */
+} adv_phase_t;
+
+static adv_phase_t adv_phase = ADV_PHASE_OFF;
+static uint8_t adv_slot = 0;      /* アドバタイジング対象スロット */
+static btstack_timer_source_t adv_timer;
+
+/* 再接続時間計測 (起動/スロット切替 → 最初の入力レポート) */
+static bool reconnect_timing = false;
+static uint8_t reconnect_slot = 0;
+static uint32_t reconnect_start_ms = 0;
+
+/* レポート投入 → 送信までの遅延統計 */
+static ble_hid_latency_stats_t latency_stats;
+
+/* hid_pipeline のシンク番号 */
+static int ble_sink = HID_SINK_NONE;
+
+/* BTstack を実行する async_context と送信ワーカー */
+static async_context_t *ble_context = NULL;
+static void send_worker_func(async_context_t *context, async_when_pending_worker_t *worker);
+static async_when_pending_worker_t send_worker = { .do_work = send_worker_func };
+static void anchor_worker_func(async_context_t *context, async_at_time_worker_t *worker);
+static async_at_time_worker_t anchor_worker = { .do_work = anchor_worker_func };
+
+#define BLE_LOCK()    async_context_acquire_lock_blocking(ble_context)
+#define BLE_UNLOCK()  async_context_release_lock(ble_context)
 
 /* コールバック登録 */
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 static btstack_packet_callback_registration_t sm_event_callback_registration;
 
+static void packet_handler(uint8_t packet_type, uint16_t channel,
+                           uint8_t *packet, uint16_t size);
+static void start_advertising(void);
+static void link_try_request_data_length(void);
+
 /* ============================================================
- * 内部関数: 送信処理
+ * 内部関数: 接続テーブル
  * ============================================================ */
 
-static void send_pending_reports(void) {
-    if (!can_send_now) return;
-    if (con_handle == HCI_CON_HANDLE_INVALID) return;
+static ble_conn_t *conn_for_handle(hci_con_handle_t handle) {
+    if (handle == HCI_CON_HANDLE_INVALID) return NULL;
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        if (conns[i].handle == handle) return &conns[i];
+    }
+    return NULL;
+}
 
-    /* キーボードレポート優先 */
-    if (kb_pending) {
-        can_send_now = false;
-        kb_pending = false;
+/* 接続のリンク情報 (スロット未割当なら接続ごとの仮置き) */
+static ble_hid_link_info_t *conn_link(ble_conn_t *conn) {
+    return (conn->slot < MAX_DEVICE_SLOTS) ? &link_info[conn->slot] : &conn->unassigned_link;
+}
 
-        if (kb_is_boot) {
-            hids_device_send_boot_keyboard_input_report(
-                con_handle, pending_kb_report, pending_kb_len);
-        } else {
-            hids_device_send_input_report(
-                con_handle, pending_kb_report, pending_kb_len);
+static ble_conn_t *conn_for_slot(uint8_t slot) {
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        if (conns[i].handle != HCI_CON_HANDLE_INVALID && conns[i].slot == slot) {
+            return &conns[i];
+        }
+    }
+    return NULL;
+}
+
+/* レポート送信先: アクティブスロットの接続 (入力レポート購読済みのみ) */
+static ble_conn_t *active_conn(void) {
+    ble_conn_t *conn = conn_for_slot(device_slot_get_active());
+    if (!conn || !conn->reports_enabled) return NULL;
+    return conn;
+}
+
+static ble_conn_t *conn_alloc(hci_con_handle_t handle) {
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        if (conns[i].handle == HCI_CON_HANDLE_INVALID) {
+            memset(&conns[i], 0, sizeof(ble_conn_t));
+            conns[i].handle = handle;
+            conns[i].slot = SLOT_NONE;
+            conns[i].protocol_mode = 1;  /* 接続直後は Report Protocol */
+            return &conns[i];
         }
+    }
+    return NULL;
+}
+
+static void conn_free(ble_conn_t *conn) {
+    memset(conn, 0, sizeof(ble_conn_t));
+    conn->handle = HCI_CON_HANDLE_INVALID;
+    conn->slot = SLOT_NONE;
+}
 
-        /* マウスも保留中なら次の CAN_SEND_NOW を要求 */
-        if (mouse_pending) {
-            hids_device_request_can_send_now_event(con_handle);
+/* 接続済み (購読前を含む) 接続数 */
+static int conn_count(void) {
+    int n = 0;
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        if (conns[i].handle != HCI_CON_HANDLE_INVALID) n++;
+    }
+    return n;
+}
+
+/* ピアアドレスからペアリング済みスロットを検索 */
+static uint8_t slot_for_peer(const bd_addr_t addr, uint8_t addr_type) {
+    for (uint8_t i = 0; i < MAX_DEVICE_SLOTS; i++) {
+        const device_slot_info_t *info = device_slot_get_info(i);
+        if (info->paired && info->addr_type == addr_type &&
+            memcmp(info->bd_addr, addr, BD_ADDR_LEN) == 0) {
+            return i;
         }
+    }
+    return SLOT_NONE;
+}
+
+/* ============================================================
+ * 内部関数: 送信処理
+ * ============================================================ */
+
+/* CAN_SEND_NOW を要求 (要求から許可までの待ち時間を計測) */
+static void request_can_send(ble_conn_t *conn) {
+    if (!conn->can_send_requested) {
+        conn->can_send_requested = true;
+        conn->can_send_request_us = time_us_32();
+    }
+    hids_device_request_can_send_now_event(conn->handle);
+}
+
+/* 送信済み通知を計測カウンタに加算 (再接続時間の計測終了も兼ねる) */
+static void count_notification(ble_conn_t *conn) {
+    if (throughput_active && conn->slot == throughput_slot) throughput_count++;
+
+    if (reconnect_timing && conn->slot == reconnect_slot) {
+        reconnect_timing = false;
+        uint32_t elapsed = btstack_run_loop_get_time_ms() - reconnect_start_ms;
+        conn_link(conn)->reconnect_ms = elapsed;
+        TRACE(BLE_RECONNECT, conn->slot, elapsed, conn_link(conn)->reconnect_phase);
+    }
+}
+
+static bool throughput_running_on(const ble_conn_t *conn) {
+    return throughput_active && conn->slot == throughput_slot;
+}
+
+/* 全キー解放を接続のプロトコルモードで送信 */
+static void send_release(ble_conn_t *conn) {
+    if (conn->protocol_mode == 0) {
+        static const uint8_t empty_boot[BOOT_REPORT_SIZE] = {0};
+        hids_device_send_boot_keyboard_input_report(
+            conn->handle, empty_boot, sizeof(empty_boot));
+    } else {
+        static const uint8_t empty_nkro[1 + NKRO_REPORT_SIZE] = {
+            HID_REPORT_ID_KEYBOARD,
+        };
+        hids_device_send_input_report(conn->handle, empty_nkro, sizeof(empty_nkro));
+    }
+}
+
+/*
+ * スループット計測用の埋め草: 現在のキー状態を接続のプロトコルモードで再送する
+ * (ホストから見える入力は変わらない)。アクティブでない接続のホストには
+ * 切替時に全キー解放を送っているので、解放をそのまま再送する。
+ */
+static void send_throughput_filler(ble_conn_t *conn) {
+    conn->can_send_now = false;
+    if (conn != active_conn()) {
+        send_release(conn);
+    } else if (conn->protocol_mode == 0) {
+        uint8_t report[1 + NKRO_REPORT_SIZE];
+        uint8_t len = hid_pipeline_build_keys(true, report);
+        hids_device_send_boot_keyboard_input_report(conn->handle, report, len);
+    } else {
+        uint8_t report[1 + NKRO_REPORT_SIZE];
+        uint8_t len = hid_pipeline_build_keys(false, report);
+        hids_device_send_input_report(conn->handle, report, len);
+    }
+    count_notification(conn);
+    request_can_send(conn);
+}
+
+/* ============================================================
+ * 内部関数: 接続イベント位相
+ *
+ * コントローラの接続イベント時刻はホストから直接見えないため、
+ * 送信完了イベント (Number Of Completed Packets) の受信時刻を位相の基準とし、
+ * 接続間隔の整数倍で次の接続イベントを予測する。受信時刻は実際の接続イベントより
+ * HCI 転送分だけ遅れるが、その分は BLE_PRE_ANCHOR_*_US の余裕に含める。
+ * 送信が途絶えるとクロック誤差で位相がずれるため、BLE_ANCHOR_MAX_AGE_MS で破棄する。
+ * ============================================================ */
+
+static uint32_t conn_interval_us(ble_conn_t *conn) {
+    return (uint32_t)conn_link(conn)->conn_interval * 1250;
+}
+
+static bool conn_next_anchor(ble_conn_t *conn, uint32_t now, uint32_t *anchor) {
+    uint32_t interval = conn_interval_us(conn);
+    if (!conn->anchor_valid || interval == 0) return false;
+
+    uint32_t elapsed = now - conn->anchor_us;
+    if (elapsed > (uint32_t)BLE_ANCHOR_MAX_AGE_MS * 1000) return false;
+
+    *anchor = conn->anchor_us + (elapsed / interval + 1) * interval;
+    return true;
+}
+
+/* マウスレポートを次の接続イベント直前まで保留 (間に合わないなら即送信) */
+static void hold_mouse_until_anchor(ble_conn_t *conn) {
+#if BLE_ANCHOR_SCHEDULING
+    if (throughput_running_on(conn)) return;
+
+    uint32_t now = time_us_32();
+    uint32_t anchor;
+    if (!conn_next_anchor(conn, now, &anchor)) return;
+
+    uint32_t release = anchor - BLE_PRE_ANCHOR_SEND_US;
+    int32_t delay = (int32_t)(release - now);
+    if (delay <= 0) return;
+
+    conn->mouse_hold = true;
+    conn->mouse_release_us = release;
+    async_context_remove_at_time_worker(ble_context, &anchor_worker);
+    async_context_add_at_time_worker_at(ble_context, &anchor_worker,
+                                        make_timeout_time_us((uint64_t)delay));
+#else
+    UNUSED(conn);
+#endif
+}
+
+/* 投入 → 送信の遅延と、送信先の接続イベントまでの時間を記録 */
+static void record_send_latency(ble_conn_t *conn, uint32_t post_us) {
+    uint32_t now = time_us_32();
+    uint32_t latency = now - post_us;
+    latency_stats.samples++;
+    latency_stats.total_us += latency;
+    if (latency > latency_stats.max_us) latency_stats.max_us = latency;
+
+    uint32_t anchor;
+    if (conn_next_anchor(conn, now, &anchor)) {
+        uint32_t to_event = anchor - post_us;
+        latency_stats.event_samples++;
+        latency_stats.event_total_us += to_event;
+        if (to_event > latency_stats.event_max_us) latency_stats.event_max_us = to_event;
+    }
+}
+
+/* この接続が今受け取るフレームの種類 (接続イベント直前の保留中はマウスを除く) */
+static uint8_t conn_frame_mask(const ble_conn_t *conn) {
+    if (conn != active_conn()) return 0;
+    return HID_FRAME_MASK_KEYBOARD | (conn->mouse_hold ? 0 : HID_FRAME_MASK_MOUSE);
+}
+
+static bool conn_has_work(const ble_conn_t *conn) {
+    return conn->release_pending ||
+           hid_pipeline_has_pending(ble_sink, conn_frame_mask(conn));
+}
+
+static void send_pending_reports(ble_conn_t *conn) {
+    if (!conn->can_send_now) return;
+
+    /* スロット切替時の全キー解放を最優先 */
+    if (conn->release_pending) {
+        conn->can_send_now = false;
+        conn->release_pending = false;
+        send_release(conn);
+        count_notification(conn);
+        perf_count(PERF_CNT_REPORTS_SENT);
+        if (conn_has_work(conn) || throughput_running_on(conn)) request_can_send(conn);
         return;
     }
 
-    /* マウスレポート */
-    if (mouse_pending) {
-        can_send_now = false;
-        mouse_pending = false;
+    /* パイプラインのフレームをそのまま通知 (キーボード優先) */
+    hid_frame_t frame;
+    if (hid_pipeline_peek(ble_sink, conn_frame_mask(conn), &frame)) {
+        conn->can_send_now = false;
+        if (frame.kind == HID_FRAME_BOOT_KEYBOARD) {
+            hids_device_send_boot_keyboard_input_report(conn->handle, frame.data, frame.len);
+        } else {
+            hids_device_send_input_report(conn->handle, frame.data, frame.len);
+        }
+        hid_pipeline_consume(ble_sink, frame.kind);
+        if (frame.kind == HID_FRAME_MOUSE) conn->mouse_released = false;
+
+        record_send_latency(conn, frame.post_us);
+        count_notification(conn);
+        perf_count(PERF_CNT_REPORTS_SENT);
 
-        hids_device_send_input_report(
-            con_handle, pending_mouse_report, MAX_MOUSE_REPORT_SIZE);
+        /* まだ送信待ちがあれば次の CAN_SEND_NOW を要求 */
+        if (conn_has_work(conn) || throughput_running_on(conn)) request_can_send(conn);
         return;
     }
+
+    /* スループット計測中: 実レポートが無ければ現在のキー状態の再送で埋める */
+    if (throughput_running_on(conn)) {
+        send_throughput_filler(conn);
+    }
+}
+
+/* 保留中レポートの送信を開始 (送信可能なら即送信、不可なら CAN_SEND_NOW 要求) */
+static void kick_send(ble_conn_t *conn) {
+    if (!conn_has_work(conn)) return;
+
+    if (conn->can_send_now) {
+        send_pending_reports(conn);
+    } else {
+        request_can_send(conn);
+    }
+}
+
+/* 送信ワーカー: パイプラインに積まれたフレームを async_context 内で送信開始 */
+static void send_worker_func(async_context_t *context, async_when_pending_worker_t *worker) {
+    UNUSED(context);
+    UNUSED(worker);
+
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        ble_conn_t *conn = &conns[i];
+        if (conn->handle == HCI_CON_HANDLE_INVALID) continue;
+        /* 新しいマウスフレームは接続イベント直前まで保留 (より新しい入力で加算可) */
+        if (conn == active_conn() && !conn->mouse_hold && !conn->mouse_released &&
+            hid_pipeline_has_pending(ble_sink, HID_FRAME_MASK_MOUSE)) {
+            hold_mouse_until_anchor(conn);
+        }
+        kick_send(conn);
+    }
+    link_try_request_data_length();
+}
+
+/* 保留解除: 接続イベント直前にマウスレポートをコントローラへ渡す */
+static void anchor_worker_func(async_context_t *context, async_at_time_worker_t *worker) {
+    UNUSED(context);
+    UNUSED(worker);
+
+    uint32_t now = time_us_32();
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        ble_conn_t *conn = &conns[i];
+        if (conn->handle == HCI_CON_HANDLE_INVALID || !conn->mouse_hold) continue;
+        if ((int32_t)(now - conn->mouse_release_us) < 0) continue;
+
+        conn->mouse_hold = false;
+        conn->mouse_released = true;
+        kick_send(conn);
+    }
+}
+
+/* 全キー解放レポートを指定接続に送信 */
+static void send_key_release_to(ble_conn_t *conn) {
+    conn->release_pending = true;
+    kick_send(conn);
+}
+
+/* アクティブな接続が無くなったらパイプラインの送信待ちを捨てる */
+static void discard_if_no_active(void) {
+    if (!active_conn()) hid_pipeline_discard(ble_sink, HID_FRAME_MASK_ALL);
+}
+
+/* ============================================================
+ * 内部関数: リンク最適化 (PHY / DLE / MTU)
+ * ============================================================ */
+
+/* DLE 要求 (HCIコマンドが送信可能になるまで保留) */
+static void link_try_request_data_length(void) {
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        ble_conn_t *conn = &conns[i];
+        if (conn->handle == HCI_CON_HANDLE_INVALID || !conn->dle_request_pending) continue;
+        if (!hci_can_send_command_packet_now()) return;
+
+        hci_send_cmd(&hci_le_set_data_length, conn->handle,
+                     BLE_DLE_TX_OCTETS, BLE_DLE_TX_TIME_US);
+        conn->dle_request_pending = false;
+    }
+}
+
+/* 接続完了直後に PHY / DLE を要求 (ホスト非対応なら現状維持で完了する) */
+static void link_start_negotiation(ble_conn_t *conn) {
+    ble_hid_link_info_t *info = conn_link(conn);
+    info->tx_phy = 1;
+    info->rx_phy = 1;
+    info->max_tx_octets = 27;
+    info->max_rx_octets = 27;
+    info->att_mtu = ATT_DEFAULT_MTU;
+
+#if BLE_PREFER_2M_PHY
+    /* TX/RX とも 2M を要求。ホスト非対応なら 1M のまま */
+    gap_le_set_phy(conn->handle, 0, 0x02, 0x02, 0);
+#endif
+    conn->dle_request_pending = true;
+    link_try_request_data_length();
+}
+
+/* MTU が NKRO レポートに不足する場合のみ、こちらから MTU 交換を行う */
+static void link_check_mtu(ble_conn_t *conn) {
+    uint16_t mtu = att_server_get_mtu(conn->handle);
+    conn_link(conn)->att_mtu = mtu;
+    if (mtu < REQUIRED_ATT_MTU) {
+        gatt_client_send_mtu_negotiation(&packet_handler, conn->handle);
+    }
+}
+
+/* スループット計測終了 (btstack タイマーから呼ばれる) */
+static void throughput_timeout_handler(btstack_timer_source_t *ts) {
+    UNUSED(ts);
+    if (!throughput_active) return;
+    throughput_active = false;
+
+    uint32_t elapsed = btstack_run_loop_get_time_ms() - throughput_start_ms;
+    if (elapsed == 0) elapsed = 1;
+    uint32_t nps = (uint32_t)(((uint64_t)throughput_count * 1000) / elapsed);
+
+    ble_hid_link_info_t *info = &link_info[throughput_slot];
+    info->throughput_nps = nps;
+    TRACE(BLE_THROUGHPUT, throughput_slot, throughput_count, elapsed, nps);
+    TRACE(BLE_THROUGHPUT_PHY, info->tx_phy, info->rx_phy,
+          info->max_tx_octets, info->max_rx_octets);
+    TRACE(BLE_THROUGHPUT_MTU, info->att_mtu, info->conn_interval);
+    if (latency_stats.samples > 0) {
+        TRACE(BLE_SEND_LATENCY, latency_stats.total_us / latency_stats.samples,
+              latency_stats.max_us, latency_stats.samples);
+    }
+    if (latency_stats.event_samples > 0) {
+        TRACE(BLE_EVENT_LATENCY, latency_stats.event_total_us / latency_stats.event_samples,
+              latency_stats.event_max_us, latency_stats.event_samples);
+    }
 }
 
 /* ============================================================
@@ -224,25 +569,258 @@ static const uint8_t adv_data[] = {
 /* ============================================================
  * 内部関数: アドバタイジング開始
  * ============================================================ */
+
+/* Directed 可能なアドレスか (public / static random のみ。RPA は変化するため不可) */
+static bool slot_addr_is_directable(const device_slot_info_t *info) {
+    if (!info || !info->paired) return false;
+    if (info->addr_type == BD_ADDR_TYPE_LE_PUBLIC) return true;
+    /* static random: 上位2ビット = 0b11 (アドレスはリトルエンディアン格納) */
+    return (info->addr_type == BD_ADDR_TYPE_LE_RANDOM) &&
+           ((info->bd_addr[0] & 0xC0) == 0xC0);
+}
+
+/* バックグラウンド再接続の対象スロット (非アクティブ・未接続・ペアリング済み) */
+static bool slot_needs_background_reconnect(uint8_t slot) {
+    if (slot == device_slot_get_active()) return false;
+    if (conn_for_slot(slot)) return false;
+    return slot_addr_is_directable(device_slot_get_info(slot));
+}
+
+/* 現在の段階のパラメータでアドバタイジングを (再) 設定 */
+static void adv_apply_phase(void) {
+    const device_slot_info_t *info = device_slot_get_info(adv_slot);
+    bd_addr_t direct_addr;
+    bd_addr_t null_addr = {0};
+    uint32_t duration_ms = 0;  /* 0 = 次の段階なし */
+
+    gap_advertisements_enable(0);
+    btstack_run_loop_remove_timer(&adv_timer);
+
+    switch (adv_phase) {
+        case ADV_PHASE_DIRECTED_HIGH:
+            /* ADV_DIRECT_IND (高デューティ): 間隔指定は無視される */
+            memcpy(direct_addr, info->bd_addr, BD_ADDR_LEN);
+            gap_advertisements_set_params(0x0020, 0x0020, 0x01,
+                                          info->addr_type, direct_addr, 0x07, 0x00);
+            duration_ms = BLE_ADV_DIRECTED_HIGH_MS;
+            break;
+
+        case ADV_PHASE_DIRECTED_LOW:
+            /* ADV_DIRECT_IND (低デューティ) */
+            memcpy(direct_addr, info->bd_addr, BD_ADDR_LEN);
+            gap_advertisements_set_params(BLE_ADV_FAST_INTERVAL_MIN, BLE_ADV_FAST_INTERVAL_MAX,
+                                          0x04, info->addr_type, direct_addr, 0x07, 0x00);
+            duration_ms = BLE_ADV_DIRECTED_LOW_MS;
+            break;
+
+        case ADV_PHASE_FILTER:
+            /* ADV_IND + 接続要求はフィルタ受理リストのみ許可 */
+            gap_whitelist_clear();
+            gap_whitelist_add((bd_addr_type_t)info->addr_type, info->bd_addr);
+            gap_advertisements_set_params(BLE_ADV_FAST_INTERVAL_MIN, BLE_ADV_FAST_INTERVAL_MAX,
+                                          0x00, 0, null_addr, 0x07, 0x02);
+            gap_advertisements_set_data(sizeof(adv_data), adv_data);
+            duration_ms = BLE_ADV_FILTER_MS;
+            break;
+
+        case ADV_PHASE_BACKGROUND:
+            /* 未接続のペアリング済みスロット全てをフィルタ受理リストに登録 */
+            gap_whitelist_clear();
+            for (uint8_t i = 0; i < MAX_DEVICE_SLOTS; i++) {
+                if (!slot_needs_background_reconnect(i)) continue;
+                const device_slot_info_t *bg = device_slot_get_info(i);
+                gap_whitelist_add((bd_addr_type_t)bg->addr_type, bg->bd_addr);
+            }
+            gap_advertisements_set_params(BLE_ADV_SLOW_INTERVAL_MIN, BLE_ADV_SLOW_INTERVAL_MAX,
+                                          0x00, 0, null_addr, 0x07, 0x02);
+            gap_advertisements_set_data(sizeof(adv_data), adv_data);
+            break;
+
+        case ADV_PHASE_OFF:
+            TRACE(BLE_ADV_STOPPED, conn_count());
+            return;
+
+        default:
+            /* ADV_IND: 誰からでも接続可 (新規ペアリング / ボンド喪失ホスト) */
+            gap_advertisements_set_params(BLE_ADV_SLOW_INTERVAL_MIN, BLE_ADV_SLOW_INTERVAL_MAX,
+                                          0x00, 0, null_addr, 0x07, 0x00);
+            gap_advertisements_set_data(sizeof(adv_data), adv_data);
+            break;
+    }
+
+    gap_advertisements_enable(1);
+
+    if (duration_ms > 0) {
+        btstack_run_loop_set_timer(&adv_timer, duration_ms);
+        btstack_run_loop_add_timer(&adv_timer);
+    }
+    TRACE(BLE_ADV_STARTED, adv_slot, adv_phase);
+}
+
+/* 次の段階へ (タイムアウトまたは高デューティ Directed 終了時) */
+static void adv_advance_phase(void) {
+    if (adv_phase >= ADV_PHASE_GENERAL) return;
+    if (conn_for_slot(adv_slot)) return;
+    adv_phase++;
+    adv_apply_phase();
+}
+
+static void adv_timeout_handler(btstack_timer_source_t *ts) {
+    UNUSED(ts);
+    adv_advance_phase();
+}
+
+/*
+ * 接続状態に応じてアドバタイジングを選択:
+ *   アクティブスロット未接続 → そのスロット向けに段階的アドバタイジング
+ *   アクティブスロット接続済み → 他のペアリング済みスロットをバックグラウンド再接続
+ *   それ以外 (空き接続なし等) → 停止
+ */
 static void start_advertising(void) {
     if (!btstack_ready) return;
 
-    gap_advertisements_set_data(sizeof(adv_data), adv_data);
-    gap_advertisements_enable(1);
-    DEBUG_PRINT("BLE advertising started (slot %d)", device_slot_get_active());
+    uint8_t active = device_slot_get_active();
+    if (conn_count() >= MAX_NR_HCI_CONNECTIONS) {
+        adv_phase = ADV_PHASE_OFF;
+    } else if (!conn_for_slot(active)) {
+        adv_slot = active;
+        adv_phase = slot_addr_is_directable(device_slot_get_info(active))
+                        ? ADV_PHASE_DIRECTED_HIGH : ADV_PHASE_GENERAL;
+    } else {
+        adv_phase = ADV_PHASE_OFF;
+        for (uint8_t i = 0; i < MAX_DEVICE_SLOTS; i++) {
+            if (slot_needs_background_reconnect(i)) {
+                adv_phase = ADV_PHASE_BACKGROUND;
+                break;
+            }
+        }
+    }
+    adv_apply_phase();
+}
+
+/* 再接続時間の計測開始 (起動時 / スロット切替時) */
+static void reconnect_timing_start(void) {
+    reconnect_timing = true;
+    reconnect_slot = device_slot_get_active();
+    reconnect_start_ms = btstack_run_loop_get_time_ms();
 }
 
 /* ============================================================
  * BLE イベントハンドラ
  * ============================================================ */
+
+static void handle_connection_complete(const uint8_t *packet) {
+    uint8_t status = hci_subevent_le_connection_complete_get_status(packet);
+    if (status == ERROR_CODE_ADVERTISING_TIMEOUT) {
+        /* 高デューティ Directed の1.28s 経過 → 次の段階 */
+        adv_advance_phase();
+        return;
+    }
+    if (status != ERROR_CODE_SUCCESS) return;
+
+    hci_con_handle_t handle = hci_subevent_le_connection_complete_get_connection_handle(packet);
+    ble_conn_t *conn = conn_alloc(handle);
+    if (!conn) {
+        gap_disconnect(handle);
+        return;
+    }
+    btstack_run_loop_remove_timer(&adv_timer);
+
+    /* 接続完了: ピアアドレスをキャッシュ (ペアリング保存用) */
+    /* 0x02/0x03 (コントローラで解決済みの ID アドレス) は public/random に正規化 */
+    conn->peer_addr_type = hci_subevent_le_connection_complete_get_peer_address_type(packet) & 0x01;
+    hci_subevent_le_connection_complete_get_peer_address(packet, conn->peer_addr);
+
+    /*
+     * スロット割当: 登録済みアドレスならそのスロット (同じホストの古い接続は置き換える)。
+     * それ以外はアドバタイズ中のスロットが空いているときだけ割り当てる。
+     * 使用中なら (RPA のホスト, バックグラウンド再接続中の未知のホスト) 割り当てずに
+     * ID 解決を待つ。未確認のアドレスのために使用中の接続を切ることはしない
+     */
+    uint8_t slot = slot_for_peer(conn->peer_addr, conn->peer_addr_type);
+    if (slot != SLOT_NONE) {
+        ble_conn_t *stale = conn_for_slot(slot);
+        if (stale) {
+            gap_disconnect(stale->handle);
+            conn_free(stale);
+        }
+    } else if (!conn_for_slot(adv_slot)) {
+        slot = adv_slot;
+    }
+    conn->slot = slot;
+    if (slot != SLOT_NONE && device_slot_get_info(slot)->paired) perf_count(PERF_CNT_RECONNECTS);
+
+    TRACE(BLE_CONNECTED, slot,
+          ((uint32_t)conn->peer_addr[0] << 16) | ((uint32_t)conn->peer_addr[1] << 8) |
+              conn->peer_addr[2],
+          ((uint32_t)conn->peer_addr[3] << 16) | ((uint32_t)conn->peer_addr[4] << 8) |
+              conn->peer_addr[5],
+          conn->peer_addr_type);
+
+    conn_link(conn)->reconnect_phase = (slot == adv_slot) ? adv_phase : ADV_PHASE_BACKGROUND;
+    conn_link(conn)->conn_interval =
+        hci_subevent_le_connection_complete_get_conn_interval(packet);
+    link_start_negotiation(conn);
+
+    /* 残りのスロット向けにアドバタイジングを再選択 */
+    start_advertising();
+}
+
+static void handle_hids_event(const uint8_t *packet) {
+    ble_conn_t *conn;
+
+    switch (hci_event_hids_meta_get_subevent_code(packet)) {
+        case HIDS_SUBEVENT_INPUT_REPORT_ENABLE:
+            conn = conn_for_handle(hids_subevent_input_report_enable_get_con_handle(packet));
+            if (!conn) break;
+            conn->reports_enabled = hids_subevent_input_report_enable_get_enable(packet) != 0;
+            link_check_mtu(conn);
+            TRACE(BLE_INPUT_REPORT, conn->reports_enabled, conn->slot);
+            if (!conn->reports_enabled) discard_if_no_active();
+            /* 再接続計測中: 全キー解放レポートを最初の入力レポートとして送る */
+            if (conn->reports_enabled && reconnect_timing && conn->slot == reconnect_slot) {
+                send_key_release_to(conn);
+            }
+            break;
+        case HIDS_SUBEVENT_BOOT_KEYBOARD_INPUT_REPORT_ENABLE:
+            conn = conn_for_handle(hids_subevent_boot_keyboard_input_report_enable_get_con_handle(packet));
+            if (!conn) break;
+            conn->reports_enabled = hids_subevent_boot_keyboard_input_report_enable_get_enable(packet) != 0;
+            TRACE(BLE_BOOT_REPORT, conn->reports_enabled, conn->slot);
+            if (!conn->reports_enabled) discard_if_no_active();
+            if (conn->reports_enabled && reconnect_timing && conn->slot == reconnect_slot) {
+                send_key_release_to(conn);
+            }
+            break;
+        case HIDS_SUBEVENT_PROTOCOL_MODE:
+            conn = conn_for_handle(hids_subevent_protocol_mode_get_con_handle(packet));
+            if (!conn) break;
+            conn->protocol_mode = hids_subevent_protocol_mode_get_protocol_mode(packet);
+            TRACE(BLE_PROTOCOL_MODE, conn->slot, conn->protocol_mode ? 1 : 0);
+            break;
+        case HIDS_SUBEVENT_CAN_SEND_NOW:
+            conn = conn_for_handle(hids_subevent_can_send_now_get_con_handle(packet));
+            if (!conn) break;
+            conn->can_send_now = true;
+            if (conn->can_send_requested) {
+                conn->can_send_requested = false;
+                perf_add_time(PERF_TIME_CAN_SEND_WAIT, time_us_32() - conn->can_send_request_us);
+            }
+            send_pending_reports(conn);
+            break;
+        default:
+            break;
+    }
+}
+
 static void packet_handler(uint8_t packet_type, uint16_t channel,
                            uint8_t *packet, uint16_t size) {
     UNUSED(channel);
-    UNUSED(size);
 
     if (packet_type != HCI_EVENT_PACKET) return;
 
     uint8_t event_type = hci_event_packet_get_type(packet);
+    ble_conn_t *conn;
 
     switch (event_type) {
         case BTSTACK_EVENT_STATE:
@@ -253,67 +831,144 @@ static void packet_handler(uint8_t packet_type, uint16_t channel,
             break;
 
         case HCI_EVENT_LE_META:
-            if (hci_event_le_meta_get_subevent_code(packet) ==
-                HCI_SUBEVENT_LE_CONNECTION_COMPLETE) {
-                /* 接続完了: ピアアドレスをキャッシュ (ペアリング保存用) */
-                peer_addr_type = hci_subevent_le_connection_complete_get_peer_address_type(packet);
-                hci_subevent_le_connection_complete_get_peer_address(packet, peer_addr);
-                DEBUG_PRINT("BLE connected (peer=%02X:%02X:%02X:%02X:%02X:%02X type=%d)",
-                            peer_addr[0], peer_addr[1], peer_addr[2],
-                            peer_addr[3], peer_addr[4], peer_addr[5],
-                            peer_addr_type);
+            switch (hci_event_le_meta_get_subevent_code(packet)) {
+                case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
+                    handle_connection_complete(packet);
+                    break;
+                case HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE:
+                    conn = conn_for_handle(
+                        hci_subevent_le_connection_update_complete_get_connection_handle(packet));
+                    if (!conn) break;
+                    conn_link(conn)->conn_interval =
+                        hci_subevent_le_connection_update_complete_get_conn_interval(packet);
+                    TRACE(BLE_CONN_INTERVAL, conn->slot, conn_link(conn)->conn_interval);
+                    break;
+                case HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE:
+                    conn = conn_for_handle(
+                        hci_subevent_le_phy_update_complete_get_connection_handle(packet));
+                    if (!conn) break;
+                    if (hci_subevent_le_phy_update_complete_get_status(packet) == ERROR_CODE_SUCCESS) {
+                        conn_link(conn)->tx_phy = hci_subevent_le_phy_update_complete_get_tx_phy(packet);
+                        conn_link(conn)->rx_phy = hci_subevent_le_phy_update_complete_get_rx_phy(packet);
+                    }
+                    TRACE(BLE_PHY, conn->slot, conn_link(conn)->tx_phy,
+                          conn_link(conn)->rx_phy);
+                    break;
+                case HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE:
+                    conn = conn_for_handle(
+                        hci_subevent_le_data_length_change_get_connection_handle(packet));
+                    if (!conn) break;
+                    conn_link(conn)->max_tx_octets =
+                        hci_subevent_le_data_length_change_get_max_tx_octets(packet);
+                    conn_link(conn)->max_rx_octets =
+                        hci_subevent_le_data_length_change_get_max_rx_octets(packet);
+                    TRACE(BLE_DATA_LENGTH, conn->slot, conn_link(conn)->max_tx_octets,
+                          conn_link(conn)->max_rx_octets);
+                    break;
+                default:
+                    break;
             }
             break;
 
+        case ATT_EVENT_MTU_EXCHANGE_COMPLETE:
+            conn = conn_for_handle(att_event_mtu_exchange_complete_get_handle(packet));
+            if (!conn) break;
+            conn_link(conn)->att_mtu = att_event_mtu_exchange_complete_get_MTU(packet);
+            TRACE(BLE_MTU, conn->slot, conn_link(conn)->att_mtu);
+            break;
+
+        case GATT_EVENT_MTU:
+            conn = conn_for_handle(gatt_event_mtu_get_handle(packet));
+            if (!conn) break;
+            conn_link(conn)->att_mtu = gatt_event_mtu_get_MTU(packet);
+            TRACE(BLE_MTU_PERIPHERAL, conn->slot, conn_link(conn)->att_mtu);
+            break;
+
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS: {
+            /* 送信完了 = その接続の接続イベントが直前にあった */
+            uint32_t now = time_us_32();
+            uint8_t num_handles = packet[2];
+            for (int i = 0; i < num_handles && (3 + 4 * i + 4) <= size; i++) {
+                hci_con_handle_t handle = little_endian_read_16(packet, 3 + 4 * i) & 0x0FFF;
+                conn = conn_for_handle(handle);
+                if (!conn) continue;
+                conn->anchor_us = now;
+                conn->anchor_valid = true;
+            }
+            break;
+        }
+
         case HCI_EVENT_DISCONNECTION_COMPLETE:
-            con_handle = HCI_CON_HANDLE_INVALID;
-            can_send_now = false;
-            kb_pending = false;
-            mouse_pending = false;
-            /* 切断後にアドバタイジング再開 */
+            conn = conn_for_handle(hci_event_disconnection_complete_get_connection_handle(packet));
+            if (!conn) break;
+            TRACE(BLE_DISCONNECTED, conn->slot);
+            if (throughput_running_on(conn)) {
+                throughput_active = false;
+                btstack_run_loop_remove_timer(&throughput_timer);
+            }
+            conn_free(conn);
+            discard_if_no_active();
+            /* 切断後にアドバタイジング再選択 */
             start_advertising();
-            DEBUG_PRINT("BLE disconnected, re-advertising");
             break;
 
         case HCI_EVENT_HIDS_META:
-            switch (hci_event_hids_meta_get_subevent_code(packet)) {
-                case HIDS_SUBEVENT_INPUT_REPORT_ENABLE:
-                    con_handle = hids_subevent_input_report_enable_get_con_handle(packet);
-                    DEBUG_PRINT("BLE HID input report enabled");
-                    break;
-                case HIDS_SUBEVENT_BOOT_KEYBOARD_INPUT_REPORT_ENABLE:
-                    con_handle = hids_subevent_boot_keyboard_input_report_enable_get_con_handle(packet);
-                    DEBUG_PRINT("BLE HID boot keyboard report enabled");
-                    break;
-                case HIDS_SUBEVENT_PROTOCOL_MODE:
-                    protocol_mode = hids_subevent_protocol_mode_get_protocol_mode(packet);
-                    DEBUG_PRINT("BLE protocol mode: %s",
-                                protocol_mode ? "Report (NKRO+Mouse)" : "Boot (6KRO)");
-                    break;
-                case HIDS_SUBEVENT_CAN_SEND_NOW:
-                    can_send_now = true;
-                    send_pending_reports();
-                    break;
-            }
+            handle_hids_event(packet);
             break;
 
         case SM_EVENT_JUST_WORKS_REQUEST:
             sm_just_works_confirm(sm_event_just_works_request_get_handle(packet));
-            DEBUG_PRINT("BLE pairing: Just Works confirmed");
+            TRACE(BLE_JUST_WORKS);
+            break;
+
+        case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED: {
+            /* RPA → IRK でボンド特定: ボンドに対応するスロットへ接続を付け替え */
+            conn = conn_for_handle(sm_event_identity_resolving_succeeded_get_handle(packet));
+            int8_t slot = device_slot_find_by_bond(
+                sm_event_identity_resolving_succeeded_get_index(packet));
+            if (!conn || slot < 0 || slot == conn->slot) break;
+
+            ble_conn_t *stale = conn_for_slot((uint8_t)slot);
+            if (stale && stale != conn) {
+                gap_disconnect(stale->handle);
+                conn_free(stale);
+            }
+            TRACE(BLE_IDENTITY, conn->slot, slot);
+            link_info[slot] = *conn_link(conn);
+            conn->slot = (uint8_t)slot;
+            start_advertising();
+            break;
+        }
+
+        case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+            /* ボンドの無いホストが使用中のスロットに割り込んだ: 新しい側を切る */
+            conn = conn_for_handle(sm_event_identity_resolving_failed_get_handle(packet));
+            if (!conn || conn->slot != SLOT_NONE) break;
+            TRACE(BLE_UNKNOWN_REJECTED);
+            gap_disconnect(conn->handle);
             break;
 
         case SM_EVENT_PAIRING_COMPLETE: {
             uint8_t status = sm_event_pairing_complete_get_status(packet);
-            if (status == ERROR_CODE_SUCCESS) {
-                /* ペアリング成功: キャッシュ済みピアアドレスをスロットに保存 */
-                device_slot_save_pairing(peer_addr, peer_addr_type);
-                DEBUG_PRINT("BLE pairing complete (success)");
+            hci_con_handle_t handle = sm_event_pairing_complete_get_handle(packet);
+            conn = conn_for_handle(handle);
+            if (status == ERROR_CODE_SUCCESS && conn && conn->slot == SLOT_NONE) {
+                /* 割当先のスロットが無い (使用中) ため保存しない */
+                TRACE(BLE_UNKNOWN_REJECTED);
+                gap_disconnect(handle);
+            } else if (status == ERROR_CODE_SUCCESS && conn) {
+                /* ペアリング成功: ボンドDBのエントリを接続先スロットに割当 */
+                device_slot_save_pairing(conn->slot, sm_le_device_index(handle));
+                TRACE(BLE_PAIRED, conn->slot);
             } else {
-                DEBUG_PRINT("BLE pairing failed (status=%d)", status);
+                TRACE(BLE_PAIR_FAILED, status);
             }
             break;
         }
     }
+
+    /* 保留中の DLE 要求 (コマンド送信枠が空いたら送信)。切断を処理した後に送る */
+    link_try_request_data_length();
 }
 
 /* ============================================================
@@ -321,12 +976,23 @@ static void packet_handler(uint8_t packet_type, uint16_t channel,
  * ============================================================ */
 
 void ble_hid_init(void) {
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS; i++) {
+        conn_free(&conns[i]);
+    }
+
     /* CYW43 初期化 (WiFi/BTチップ) */
     if (cyw43_arch_init()) {
         DEBUG_PRINT("ERROR: cyw43_arch_init failed");
         return;
     }
 
+    /* TLV を flash_log に差し替えてスロット表を読込 (ボンドDB + スロット情報, HCI 起動前) */
+    device_slot_storage_init();
+
+    /* BTstack が動作する async_context に送信ワーカーを登録 */
+    ble_context = cyw43_arch_async_context();
+    async_context_add_when_pending_worker(ble_context, &send_worker);
+
     /* L2CAP 初期化 */
     l2cap_init();
 
@@ -338,12 +1004,16 @@ void ble_hid_init(void) {
     /* ATT Server 初期化 (GATTデータベース登録) */
     att_server_init(profile_data, NULL, NULL);
 
+    /* GATT Client: MTU が不足するホストへの MTU 交換用 */
+    gatt_client_init();
+
     /* GATT サービス初期化 */
     battery_service_server_init(battery_level);
     device_information_service_server_init();
+    perf_service_init();
 
     /* HID Device サービス初期化 (コンポジット: キーボード + マウス) */
-    hids_device_init(0, hid_report_descriptor, sizeof(hid_report_descriptor));
+    hids_device_init(0, hid_report_descriptor, HID_REPORT_DESCRIPTOR_LEN);
 
     /* イベントハンドラ登録 */
     hci_event_callback_registration.callback = &packet_handler;
@@ -353,120 +1023,213 @@ void ble_hid_init(void) {
     sm_add_event_handler(&sm_event_callback_registration);
 
     hids_device_register_packet_handler(packet_handler);
+    att_server_register_packet_handler(packet_handler);
+
+    btstack_run_loop_set_timer_handler(&throughput_timer, &throughput_timeout_handler);
+    btstack_run_loop_set_timer_handler(&adv_timer, &adv_timeout_handler);
 
-    /* 接続パラメータ: 低レイテンシ (キーボード+ポインティング向け) */
-    gap_set_connection_parameters(6, 9, 25, 200);
+    /* 起動 → 最初の入力レポートまでを計測 */
+    reconnect_timing_start();
+
+    /* 接続パラメータ: 低レイテンシ (キーボード+ポインティング向け, config_store で変更可) */
+    gap_set_connection_parameters(config_get(CFG_CONN_INTERVAL_MIN),
+                                  config_get(CFG_CONN_INTERVAL_MAX),
+                                  config_get(CFG_CONN_LATENCY),
+                                  config_get(CFG_SUPERVISION_TIMEOUT));
 
     /* HCI 電源ON → BTstack起動 */
     hci_power_on();
 
-    DEBUG_PRINT("BLE HID initialized (composite: keyboard + mouse)");
+    DEBUG_PRINT("BLE HID initialized (composite: keyboard + mouse, %d connections, %s)",
+                MAX_NR_HCI_CONNECTIONS,
+                BLE_BACKGROUND_SERVICING ? "background" : "poll");
 }
 
-void ble_hid_send_report(const uint8_t *report, uint8_t len) {
-    if (con_handle == HCI_CON_HANDLE_INVALID) return;
+/* ============================================================
+ * hid_pipeline シンク
+ * ============================================================ */
 
-    if (protocol_mode == 0) {
-        /* Boot Protocol: Report IDなし、そのまま送信 */
-        if (!can_send_now) {
-            uint8_t copy_len = (len > BOOT_REPORT_SIZE) ? BOOT_REPORT_SIZE : len;
-            memcpy(pending_kb_report, report, copy_len);
-            pending_kb_len = copy_len;
-            kb_pending = true;
-            kb_is_boot = true;
-            hids_device_request_can_send_now_event(con_handle);
-            return;
-        }
-        can_send_now = false;
-        hids_device_send_boot_keyboard_input_report(con_handle, report, len);
-    } else {
-        /* Report Protocol: Report ID 1 を先頭に付与して送信 */
-        uint8_t buf[1 + NKRO_REPORT_SIZE];
-        buf[0] = HID_REPORT_ID_KEYBOARD;
-        uint8_t data_len = (len > NKRO_REPORT_SIZE) ? NKRO_REPORT_SIZE : len;
-        memcpy(buf + 1, report, data_len);
-        uint8_t total_len = 1 + data_len;
-
-        if (!can_send_now) {
-            memcpy(pending_kb_report, buf, total_len);
-            pending_kb_len = total_len;
-            kb_pending = true;
-            kb_is_boot = false;
-            hids_device_request_can_send_now_event(con_handle);
-            return;
-        }
-        can_send_now = false;
-        hids_device_send_input_report(con_handle, buf, total_len);
-    }
+static bool sink_is_ready(void *ctx) {
+    UNUSED(ctx);
+    return ble_hid_is_connected();
+}
 
-    /* マウスが保留中なら次のCAN_SEND_NOWを要求 */
-    if (mouse_pending) {
-        hids_device_request_can_send_now_event(con_handle);
-    }
+static bool sink_wants_boot(void *ctx) {
+    UNUSED(ctx);
+    return ble_hid_get_protocol_mode() == 0;
 }
 
-void ble_hid_send_mouse_report(uint8_t buttons, int8_t delta_x,
-                                int8_t delta_y, int8_t wheel) {
-    if (con_handle == HCI_CON_HANDLE_INVALID) return;
-    if (protocol_mode == 0) return;  /* Boot Protocolではマウス無効 */
+/* フレームが積まれた: 送信はワーカーに任せてすぐ戻る */
+static void sink_notify(void *ctx) {
+    UNUSED(ctx);
+    if (ble_context) async_context_set_work_pending(ble_context, &send_worker);
+}
 
-    /* Report ID 2 + マウスデータ */
-    uint8_t buf[1 + MOUSE_REPORT_SIZE];
-    buf[0] = HID_REPORT_ID_MOUSE;
-    buf[1] = buttons;
-    buf[2] = (uint8_t)delta_x;
-    buf[3] = (uint8_t)delta_y;
-    buf[4] = (uint8_t)wheel;
+static const hid_sink_t ble_sink_def = {
+    .name       = "BLE",
+    .is_ready   = sink_is_ready,
+    .wants_boot = sink_wants_boot,
+    .notify     = sink_notify,
+    .ctx        = NULL,
+};
 
-    if (!can_send_now) {
-        memcpy(pending_mouse_report, buf, sizeof(buf));
-        mouse_pending = true;
-        if (!kb_pending) {
-            hids_device_request_can_send_now_event(con_handle);
-        }
-        return;
+int ble_hid_attach_pipeline(void) {
+    ble_sink = hid_pipeline_add_sink(&ble_sink_def);
+    return ble_sink;
+}
+
+bool ble_hid_is_connected(void) {
+    if (!ble_context) return false;
+
+    BLE_LOCK();
+    bool connected = active_conn() != NULL;
+    BLE_UNLOCK();
+    return connected;
+}
+
+bool ble_hid_is_tx_idle(void) {
+    if (!ble_context) return true;
+
+    BLE_LOCK();
+    bool idle = !throughput_active;
+    for (int i = 0; i < MAX_NR_HCI_CONNECTIONS && idle; i++) {
+        if (conns[i].release_pending) idle = false;
     }
+    if (hid_pipeline_has_pending(ble_sink, HID_FRAME_MASK_ALL)) idle = false;
+    BLE_UNLOCK();
+    return idle;
+}
+
+bool ble_hid_get_next_anchor(uint32_t *anchor_us) {
+    if (!ble_context) return false;
 
-    can_send_now = false;
-    hids_device_send_input_report(con_handle, buf, sizeof(buf));
+    BLE_LOCK();
+    ble_conn_t *conn = active_conn();
+    bool valid = conn && conn_next_anchor(conn, time_us_32(), anchor_us);
+    BLE_UNLOCK();
+    return valid;
 }
 
-bool ble_hid_is_connected(void) {
-    return con_handle != HCI_CON_HANDLE_INVALID;
+uint32_t ble_hid_get_conn_interval_us(void) {
+    if (!ble_context) return 0;
+
+    BLE_LOCK();
+    ble_conn_t *conn = active_conn();
+    uint32_t interval = conn ? (uint32_t)conn_link(conn)->conn_interval * 1250 : 0;
+    BLE_UNLOCK();
+    return interval;
 }
 
 uint8_t ble_hid_get_protocol_mode(void) {
-    return protocol_mode;
+    if (!ble_context) return 1;
+
+    BLE_LOCK();
+    ble_conn_t *conn = active_conn();
+    uint8_t mode = conn ? conn->protocol_mode : 1;
+    BLE_UNLOCK();
+    return mode;
 }
 
 void ble_hid_poll(void) {
+#if !BLE_BACKGROUND_SERVICING
+    /* ポーリングビルドのみ: BTstack / 送信ワーカーをここで実行 */
     cyw43_arch_poll();
-}
-
-void ble_hid_send_key_release(void) {
-    if (protocol_mode == 0) {
-        uint8_t empty[BOOT_REPORT_SIZE] = {0};
-        ble_hid_send_report(empty, BOOT_REPORT_SIZE);
-    } else {
-        uint8_t empty[NKRO_REPORT_SIZE] = {0};
-        ble_hid_send_report(empty, NKRO_REPORT_SIZE);
-    }
+#endif
 }
 
 void ble_hid_update_battery(uint8_t level) {
+    if (!ble_context) return;
+
+    BLE_LOCK();
     battery_level = level;
     battery_service_server_set_battery_value(level);
+    BLE_UNLOCK();
 }
 
-void ble_hid_disconnect_and_readvertise(void) {
-    if (con_handle != HCI_CON_HANDLE_INVALID) {
-        /* 全キー解放を送信してから切断 */
-        ble_hid_send_key_release();
-        gap_disconnect(con_handle);
-        /* 切断完了はイベントハンドラで処理、そこで再アドバタイジング */
+void ble_hid_switch_slot(uint8_t prev_slot) {
+    if (!ble_context) return;
+
+    BLE_LOCK();
+
+    /* 旧スロット宛てに積まれていたフレームは新スロットへ送らない */
+    hid_pipeline_discard(ble_sink, HID_FRAME_MASK_ALL);
+
+    /* 旧スロットのホストに全キー解放を送る (押しっぱなし防止)。接続は維持 */
+    ble_conn_t *prev = conn_for_slot(prev_slot);
+    if (prev && prev->reports_enabled) {
+        send_key_release_to(prev);
+        prev->mouse_hold = false;
+        prev->mouse_released = false;
+    }
+
+    reconnect_timing_start();
+
+    ble_conn_t *next = active_conn();
+    if (next) {
+        /* 新スロット接続済み: 送信先を切り替えるだけ (次の接続イベントで到達) */
+        send_key_release_to(next);
+        TRACE(BLE_SLOT_SWITCHED, prev_slot, device_slot_get_active());
     } else {
-        /* 未接続なら即座に再アドバタイジング */
-        start_advertising();
+        TRACE(BLE_SLOT_WAITING, prev_slot, device_slot_get_active());
     }
-    DEBUG_PRINT("BLE disconnect requested for slot switch");
+    start_advertising();
+
+    BLE_UNLOCK();
+}
+
+const ble_hid_link_info_t *ble_hid_get_link_info(uint8_t slot) {
+    if (slot >= MAX_DEVICE_SLOTS) return NULL;
+    return &link_info[slot];
+}
+
+bool ble_hid_slot_is_connected(uint8_t slot) {
+    if (!ble_context) return false;
+
+    BLE_LOCK();
+    ble_conn_t *conn = conn_for_slot(slot);
+    bool connected = conn && conn->reports_enabled;
+    BLE_UNLOCK();
+    return connected;
+}
+
+bool ble_hid_throughput_test_start(uint32_t duration_ms) {
+    if (!ble_context) return false;
+
+    BLE_LOCK();
+    ble_conn_t *conn = active_conn();
+    if (!conn || throughput_active) {
+        BLE_UNLOCK();
+        return false;
+    }
+
+    throughput_active = true;
+    throughput_slot = conn->slot;
+    throughput_count = 0;
+    throughput_start_ms = btstack_run_loop_get_time_ms();
+
+    btstack_run_loop_set_timer(&throughput_timer, duration_ms);
+    btstack_run_loop_add_timer(&throughput_timer);
+
+    /* 最初の CAN_SEND_NOW を要求 → 以降は送信ごとに連鎖 */
+    request_can_send(conn);
+
+    TRACE(BLE_THROUGHPUT_START, conn->slot, duration_ms);
+    BLE_UNLOCK();
+    return true;
+}
+
+bool ble_hid_throughput_test_is_active(void) {
+    return throughput_active;
+}
+
+void ble_hid_get_latency_stats(ble_hid_latency_stats_t *stats, bool reset) {
+    if (!ble_context) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    BLE_LOCK();
+    *stats = latency_stats;
+    if (reset) memset(&latency_stats, 0, sizeof(latency_stats));
+    BLE_UNLOCK();
 }
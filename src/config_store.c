@@ -0,0 +1,176 @@
+/**
+ * @file config_store.c
+ * @brief 設定値ストア実装
+ *
+ * 保存レコードの検証 (バージョン, 長さ, CRC, 値の範囲) は解決時に1回だけ行い、
+ * 検証済みの値を RAM の配列へコピーする。以降の config_get() は配列を読むだけにする。
+ * flash_log のポインタは未コミットなら RAM の保留テーブルを指し、コミットで
+ * 保留テーブルが詰め直されると別のレコードを指すため、保持せずロック内でだけ使う。
+ * flash_log の世代が変わったときだけ再解決する。
+ */
+
+#include "config_store.h"
+#include "project_config.h"
+#include "keyboard_matrix.h"
+#include "flash_log.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+
+/* flash_log タグ 'JKCF' */
+#define CONFIG_TAG  (((uint32_t)'J' << 24) | ((uint32_t)'K' << 16) | \
+                     ((uint32_t)'C' << 8) | (uint32_t)'F')
+
+/* 保留テーブルは BTstack コールバックと共有 (device_slot と同じロック) */
+#define STORAGE_LOCK()    async_context_acquire_lock_blocking(cyw43_arch_async_context())
+#define STORAGE_UNLOCK()  async_context_release_lock(cyw43_arch_async_context())
+
+/* 保存形式 */
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint8_t  count;
+    uint8_t  reserved;
+    uint32_t values[];    /* values[count] の後に crc (2 bytes) */
+} config_blob_t;
+
+#define BLOB_SIZE(count)  (sizeof(config_blob_t) + (count) * sizeof(uint32_t) + sizeof(uint16_t))
+
+_Static_assert(BLOB_SIZE(CFG_KEY_COUNT) <= FLASH_LOG_MAX_VALUE, "config record too large");
+
+/* キー定義 */
+typedef struct {
+    const char *name;
+    uint32_t def;
+    uint32_t min;
+    uint32_t max;
+} config_def_t;
+
+static const config_def_t defs[CFG_KEY_COUNT] = {
+    [CFG_DEBOUNCE_MS]               = { "debounce_ms",       DEBOUNCE_MS,               1,    100 },
+    [CFG_TRACKBALL_SENSITIVITY]     = { "tb_sensitivity",    TRACKBALL_SENSITIVITY,     1,    8 },
+    [CFG_BATTERY_CHECK_INTERVAL_MS] = { "battery_interval_ms", BATTERY_CHECK_INTERVAL_MS, 1000, 3600000 },
+    [CFG_SLOT0_COLOR]               = { "slot0_color",       0x002000,                  0,    0xFFFFFF },
+    [CFG_SLOT1_COLOR]               = { "slot1_color",       0x000020,                  0,    0xFFFFFF },
+    [CFG_SLOT2_COLOR]               = { "slot2_color",       0x200000,                  0,    0xFFFFFF },
+    [CFG_CONN_INTERVAL_MIN]         = { "conn_interval_min", BLE_CONN_INTERVAL_MIN,     6,    3200 },
+    [CFG_CONN_INTERVAL_MAX]         = { "conn_interval_max", BLE_CONN_INTERVAL_MAX,     6,    3200 },
+    [CFG_CONN_LATENCY]              = { "conn_latency",      BLE_CONN_LATENCY,          0,    499 },
+    [CFG_SUPERVISION_TIMEOUT]       = { "supervision_timeout", BLE_SUPERVISION_TIMEOUT, 10,   3200 },
+    [CFG_DEBOUNCE_ADAPT]            = { "debounce_adapt",    DEBOUNCE_ADAPT_ENABLED,    0,    1 },
+};
+
+/* 解決済みの値 (保存値, なければ既定値) */
+static uint32_t values[CFG_KEY_COUNT];
+static uint16_t loaded_version = 0;
+static uint8_t  loaded_count = 0;      /* 0 = 保存レコードなし (全キー既定値) */
+static uint32_t values_generation = 0;
+static bool resolved = false;
+
+static uint16_t blob_crc(const uint8_t *data, uint32_t len) {
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* 保存レコードを検証して値をコピー (STORAGE_LOCK 内で呼ぶ) */
+static void resolve_locked(void) {
+    uint16_t len = 0;
+    const config_blob_t *b = (const config_blob_t *)flash_log_get_ptr(CONFIG_TAG, &len);
+    bool valid = (b != NULL);
+
+    if (valid && (len < sizeof(config_blob_t) || b->version > CONFIG_SCHEMA_VERSION ||
+                  b->count > CFG_KEY_COUNT || len != BLOB_SIZE(b->count))) {
+        valid = false;
+    }
+    if (valid) {
+        uint16_t crc;
+        memcpy(&crc, (const uint8_t *)b + len - sizeof(uint16_t), sizeof(crc));
+        if (blob_crc((const uint8_t *)b, len - sizeof(uint16_t)) != crc) valid = false;
+    }
+    for (uint8_t i = 0; valid && i < b->count; i++) {
+        if (b->values[i] < defs[i].min || b->values[i] > defs[i].max) valid = false;
+    }
+
+    loaded_version = valid ? b->version : 0;
+    loaded_count = valid ? b->count : 0;
+    for (int i = 0; i < CFG_KEY_COUNT; i++) {
+        values[i] = (i < loaded_count) ? b->values[i] : defs[i].def;
+    }
+    values_generation = flash_log_generation();
+    resolved = true;
+}
+
+static void resolve(void) {
+    STORAGE_LOCK();
+    resolve_locked();
+    STORAGE_UNLOCK();
+}
+
+void config_init(void) {
+    resolve();
+    if (loaded_count) {
+        DEBUG_PRINT("Config: loaded (schema %d, %d keys)", loaded_version, loaded_count);
+    } else {
+        DEBUG_PRINT("Config: using defaults");
+    }
+}
+
+uint32_t config_get(config_key_t key) {
+    if (key >= CFG_KEY_COUNT) return 0;
+    if (!resolved || values_generation != flash_log_generation()) resolve();
+    return values[key];
+}
+
+bool config_set(config_key_t key, uint32_t value) {
+    if (key >= CFG_KEY_COUNT || value < defs[key].min || value > defs[key].max) return false;
+    /* 接続間隔は min <= max を保つ */
+    if (key == CFG_CONN_INTERVAL_MIN && value > config_get(CFG_CONN_INTERVAL_MAX)) return false;
+    if (key == CFG_CONN_INTERVAL_MAX && value < config_get(CFG_CONN_INTERVAL_MIN)) return false;
+
+    static uint8_t buf[BLOB_SIZE(CFG_KEY_COUNT)] __attribute__((aligned(4)));
+    config_blob_t *b = (config_blob_t *)buf;
+    b->version = CONFIG_SCHEMA_VERSION;
+    b->count = CFG_KEY_COUNT;
+    b->reserved = 0;
+    for (int i = 0; i < CFG_KEY_COUNT; i++) {
+        b->values[i] = (i == (int)key) ? value : config_get((config_key_t)i);
+    }
+    uint16_t crc = blob_crc(buf, sizeof(buf) - sizeof(uint16_t));
+    memcpy(buf + sizeof(buf) - sizeof(uint16_t), &crc, sizeof(crc));
+
+    STORAGE_LOCK();
+    bool ok = flash_log_write(CONFIG_TAG, buf, sizeof(buf));
+    STORAGE_UNLOCK();
+    return ok;
+}
+
+void config_reset(void) {
+    STORAGE_LOCK();
+    flash_log_delete(CONFIG_TAG);
+    STORAGE_UNLOCK();
+}
+
+const char *config_key_name(config_key_t key) {
+    return (key < CFG_KEY_COUNT) ? defs[key].name : "?";
+}
+
+config_key_t config_find_key(const char *name) {
+    for (int i = 0; i < CFG_KEY_COUNT; i++) {
+        if (strcmp(defs[i].name, name) == 0) return (config_key_t)i;
+    }
+    return CFG_KEY_COUNT;
+}
+
+void config_get_slot_color(uint8_t slot, uint8_t *r, uint8_t *g, uint8_t *b) {
+    uint32_t rgb = (slot < 3) ? config_get((config_key_t)(CFG_SLOT0_COLOR + slot)) : 0;
+    *r = (uint8_t)(rgb >> 16);
+    *g = (uint8_t)(rgb >> 8);
+    *b = (uint8_t)rgb;
+}
@@ -0,0 +1,210 @@
+/**
+ * @file console.c
+ * @brief USB シリアルコンソール実装
+ *
+ * getchar_timeout_us(0) で1文字ずつ取り出し、改行で1行として実行する。
+ * 1回の呼出しで処理する文字数に上限を設け、メインループを止めない。
+ */
+
+#include "console.h"
+#include "config_store.h"
+#include "device_slot.h"
+#include "scheduler.h"
+#include "power_mgr.h"
+#include "perf.h"
+#include "keyboard_matrix.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#define CONSOLE_LINE_MAX      64
+#define CONSOLE_CHARS_PER_POLL 16
+
+static char line[CONSOLE_LINE_MAX];
+static uint8_t line_len = 0;
+
+static void cmd_cfg(char *args) {
+    char *name = strtok(args, " ");
+    char *value = strtok(NULL, " ");
+
+    if (!name) {
+        for (int i = 0; i < CFG_KEY_COUNT; i++) {
+            printf("%-20s %lu (0x%lx)\n", config_key_name((config_key_t)i),
+                   (unsigned long)config_get((config_key_t)i),
+                   (unsigned long)config_get((config_key_t)i));
+        }
+        return;
+    }
+
+    if (strcmp(name, "reset") == 0) {
+        config_reset();
+        printf("cfg: reset to defaults\n");
+        return;
+    }
+
+    config_key_t key = config_find_key(name);
+    if (key == CFG_KEY_COUNT) {
+        printf("cfg: unknown key '%s'\n", name);
+        return;
+    }
+    if (!value) {
+        printf("%s %lu\n", name, (unsigned long)config_get(key));
+        return;
+    }
+
+    char *end;
+    unsigned long v = strtoul(value, &end, 0);
+    if (*end != '\0' || !config_set(key, (uint32_t)v)) {
+        printf("cfg: invalid value '%s' for %s\n", value, name);
+        return;
+    }
+    printf("cfg: %s = %lu\n", name, v);
+    /* スロット色の変更をすぐ反映 */
+    device_slot_update_leds();
+}
+
+static void cmd_sched(void) {
+    printf("%-10s %8s %8s %6s %8s %8s %8s\n",
+           "task", "period", "runs", "miss", "avg_us", "max_us", "late_us");
+    for (int i = 0; i < sched_task_count(); i++) {
+        sched_task_stats_t st;
+        sched_get_stats(i, &st, true);
+        printf("%-10s %8lu %8lu %6lu %8lu %8lu %8lu\n", st.name,
+               (unsigned long)st.period_us, (unsigned long)st.runs,
+               (unsigned long)st.misses,
+               (unsigned long)(st.runs ? st.run_total_us / st.runs : 0),
+               (unsigned long)st.run_max_us, (unsigned long)st.late_max_us);
+    }
+}
+
+static void cmd_power(void) {
+    printf("state: %s\n", power_mgr_state_name(power_mgr_get_state()));
+    printf("%-12s %7s %10s %6s %9s %9s\n",
+           "tier", "entries", "time_ms", "wakes", "avg_us", "max_us");
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        power_state_stats_t st;
+        power_mgr_get_stats((power_state_t)i, &st, true);
+        printf("%-12s %7lu %10lu %6lu %9lu %9lu\n", power_mgr_state_name((power_state_t)i),
+               (unsigned long)st.entries, (unsigned long)st.residency_ms,
+               (unsigned long)st.wakes,
+               (unsigned long)(st.wakes ? st.wake_total_us / st.wakes : 0),
+               (unsigned long)st.wake_max_us);
+    }
+}
+
+static void cmd_perf(char *args) {
+    bool reset = strcmp(args, "reset") == 0;
+    perf_snapshot_t snap;
+    perf_snapshot(&snap, reset);
+
+    uint32_t ms = snap.elapsed_ms ? snap.elapsed_ms : 1;
+    printf("elapsed %lu ms%s\n", (unsigned long)snap.elapsed_ms, reset ? " (reset)" : "");
+    for (int i = 0; i < PERF_CNT_COUNT; i++) {
+        printf("%-18s %10lu  (%lu/s)\n", perf_counter_name((perf_counter_t)i),
+               (unsigned long)snap.counters[i],
+               (unsigned long)((uint64_t)snap.counters[i] * 1000 / ms));
+    }
+    for (int i = 0; i < PERF_TIME_COUNT; i++) {
+        const perf_time_stat_t *t = &snap.times[i];
+        printf("%-18s n=%lu avg=%lu max=%lu us\n", perf_timer_name((perf_timer_t)i),
+               (unsigned long)t->count,
+               (unsigned long)(t->count ? t->total_us / t->count : 0),
+               (unsigned long)t->max_us);
+    }
+}
+
+static void cmd_debounce(char *args) {
+    printf("mode: %s, base %lu ms\n", config_get(CFG_DEBOUNCE_ADAPT) ? "adaptive" : "fixed",
+           (unsigned long)config_get(CFG_DEBOUNCE_MS));
+
+    uint32_t wmin = UINT32_MAX, wmax = 0, wsum = 0, chatter = 0;
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            matrix_debounce_stats_t st;
+            matrix_get_debounce_stats(r, c, &st);
+            if (st.window_ms < wmin) wmin = st.window_ms;
+            if (st.window_ms > wmax) wmax = st.window_ms;
+            wsum += st.window_ms;
+            chatter += st.chatter;
+        }
+    }
+    printf("window min/avg/max %lu/%lu/%lu ms, chatter %lu\n", (unsigned long)wmin,
+           (unsigned long)(wsum / (MATRIX_ROWS * MATRIX_COLS)), (unsigned long)wmax,
+           (unsigned long)chatter);
+
+    /* ヒストグラムの見出し (各ビンの上限 ms) */
+    printf("%-5s %6s %6s %7s  bounce <", "key", "window", "n", "chatter");
+    for (int b = 0; b < DEBOUNCE_HIST_BINS; b++) {
+        uint8_t limit = matrix_debounce_bin_limit_ms((uint8_t)b);
+        if (limit) printf(" %5u", limit);
+        else       printf("   inf");
+    }
+    printf("\n");
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            matrix_debounce_stats_t st;
+            matrix_get_debounce_stats(r, c, &st);
+            if (st.samples == 0 && st.chatter == 0) continue;
+            printf("%u,%-3u %6u %6lu %7u          ", r, c, st.window_ms,
+                   (unsigned long)st.samples, st.chatter);
+            for (int b = 0; b < DEBOUNCE_HIST_BINS; b++) printf(" %5u", st.hist[b]);
+            printf("\n");
+        }
+    }
+
+    if (strcmp(args, "reset") == 0) {
+        matrix_reset_debounce_stats();
+        printf("debounce: stats reset\n");
+    }
+}
+
+static void cmd_trace(char *args) {
+    if (strcmp(args, "on") == 0) {
+        trace_set_streaming(true);
+    } else if (strcmp(args, "off") == 0) {
+        trace_set_streaming(false);
+    } else {
+        trace_dump(TRACE_BUF_RECORDS);
+    }
+}
+
+static void execute(char *cmd) {
+    char *args = strchr(cmd, ' ');
+    if (args) *args++ = '\0';
+    else args = cmd + strlen(cmd);
+
+    if (strcmp(cmd, "cfg") == 0) {
+        cmd_cfg(args);
+    } else if (strcmp(cmd, "sched") == 0) {
+        cmd_sched();
+    } else if (strcmp(cmd, "power") == 0) {
+        cmd_power();
+    } else if (strcmp(cmd, "perf") == 0) {
+        cmd_perf(args);
+    } else if (strcmp(cmd, "trace") == 0) {
+        cmd_trace(args);
+    } else if (strcmp(cmd, "debounce") == 0) {
+        cmd_debounce(args);
+    } else if (cmd[0] != '\0') {
+        printf("unknown command '%s' (cfg, sched, power, perf, trace, debounce)\n", cmd);
+    }
+}
+
+void console_poll(void) {
+    for (int n = 0; n < CONSOLE_CHARS_PER_POLL; n++) {
+        int c = getchar_timeout_us(0);
+        if (c == PICO_ERROR_TIMEOUT) return;
+
+        if (c == '\r' || c == '\n') {
+            line[line_len] = '\0';
+            line_len = 0;
+            execute(line);
+        } else if (line_len < CONSOLE_LINE_MAX - 1) {
+            line[line_len++] = (char)c;
+        }
+    }
+}
@@ -2,134 +2,283 @@
  * @file device_slot.c
  * @brief デバイススロット管理実装
  *
- * Flash最終4KBセクタにスロット情報を永続化。
- * 書込みはerase-write方式 (Flashセクタ単位)。
+ * スロット情報は BTstack の TLV ストア (flash_log バックエンド) に保存し、
+ * ボンディング鍵 (LTK/IRK) を持つ le_device_db と同じ Flash 領域を共有する。
+ * SDK 既定の pico_flash_bank TLV に保存された旧データは初回起動時に flash_log へ移行する。
+ * 各スロットは le_device_db のエントリ番号を保持し、1スロット = 1ボンドとして対応付ける。
+ * 起動時にスロット表とボンドDBを突き合わせ、食い違い (片方だけ存在) を解消する。
  *
  * スロットLED: WS2812B (NeoPixel) ×3 on GP22
- *   スロット0=緑, スロット1=青, スロット2=赤
+ *   スロット0=緑, スロット1=青, スロット2=赤 (既定値, config_store で変更可)
+ *   点滅などの表示は led_anim に登録するだけで、描画は led_anim_tick() が行う。
  *
- * Flash レイアウト (最終セクタ 4KB):
- *   offset 0x000: magic (4 bytes) "SLOT"
- *   offset 0x004: active_slot (1 byte)
- *   offset 0x005: reserved (3 bytes)
- *   offset 0x008: slot[0] (8 bytes: bd_addr[6] + addr_type + paired)
- *   offset 0x010: slot[1] (8 bytes)
- *   offset 0x018: slot[2] (8 bytes)
+ * TLV タグ:
+ *   'JKAS'       : アクティブスロット番号 (1 byte)
+ *   'JKS' + n    : スロットn (tlv_slot_record_t)
+ *   'JKP' + n    : スロットnのポインタ加速カーブ (1 byte, ペアリング解除後も保持)
+ *   'BTD' + n    : le_device_db エントリ (BTstack 管理)
  */
 
 #include "device_slot.h"
 #include "project_config.h"
 #include "ws2812_led.h"
+#include "led_anim.h"
+#include "pointer_accel.h"
+#include "flash_log.h"
+#include "config_store.h"
+#include "trace.h"
 
 #include <stdio.h>
 #include <string.h>
 
 #include "pico/stdlib.h"
-#include "hardware/flash.h"
-#include "hardware/sync.h"
+#include "pico/cyw43_arch.h"
+#include "btstack.h"
+#include "btstack_tlv.h"
+#include "ble/le_device_db.h"
+#include "ble/le_device_db_tlv.h"
 
 /* ============================================================
- * Flash ストレージ定数
+ * TLV ストレージ定数
  * ============================================================ */
-/* Pico 2W: 4MB flash, 最終セクタを使用 */
-#define FLASH_TOTAL_SIZE     (4 * 1024 * 1024)
-#define FLASH_SLOT_OFFSET    (FLASH_TOTAL_SIZE - FLASH_SECTOR_SIZE)
-#define FLASH_SLOT_MAGIC     0x534C4F54  /* "SLOT" in little-endian */
+#define TLV_TAG_ACTIVE_SLOT  (((uint32_t)'J' << 24) | ((uint32_t)'K' << 16) | \
+                              ((uint32_t)'A' << 8) | (uint32_t)'S')
+#define TLV_TAG_SLOT(n)      (((uint32_t)'J' << 24) | ((uint32_t)'K' << 16) | \
+                              ((uint32_t)'S' << 8) | (uint32_t)(n))
+#define TLV_TAG_POINTER(n)   (((uint32_t)'J' << 24) | ((uint32_t)'K' << 16) | \
+                              ((uint32_t)'P' << 8) | (uint32_t)(n))
+#define TLV_SLOT_VERSION     1
+
+/* le_device_db エントリ (BTstack le_device_db_tlv.c と同じ定義) */
+#define TLV_TAG_BOND(n)      (((uint32_t)'B' << 24) | ((uint32_t)'T' << 16) | \
+                              ((uint32_t)'D' << 8) | (uint32_t)(n))
+
+/*
+ * 保存するタグ (ボンド, スロット, カーブ, アクティブスロット, 設定 'JKCF') が全部
+ * 保留テーブルに載ること: 書込みは満杯だと拒否され、ペアリングや移行の途中で欠ける
+ */
+_Static_assert(NVM_NUM_DEVICE_DB_ENTRIES + 2 * MAX_DEVICE_SLOTS + 2 <= FLASH_LOG_PENDING_MAX,
+               "flash_log pending table cannot hold every stored tag");
 
-/* Flash上のスロットデータ構造 */
+/* TLV 上のスロットレコード */
 typedef struct __attribute__((packed)) {
-    uint32_t magic;
-    uint8_t  active_slot;
-    uint8_t  reserved[3];
-    struct __attribute__((packed)) {
-        uint8_t bd_addr[BD_ADDR_LEN];
-        uint8_t addr_type;
-        uint8_t paired;
-    } slots[MAX_DEVICE_SLOTS];
-} flash_slot_data_t;
+    uint8_t version;
+    uint8_t paired;
+    int8_t  db_index;                /* le_device_db エントリ番号 */
+    uint8_t addr_type;               /* ID アドレスタイプ */
+    uint8_t bd_addr[BD_ADDR_LEN];    /* ID アドレス (public / static random) */
+} tlv_slot_record_t;
 
 /* ============================================================
  * ランタイム状態
  * ============================================================ */
 static device_slot_info_t slots[MAX_DEVICE_SLOTS];
 static uint8_t active_slot = 0;
+static uint8_t pointer_curves[MAX_DEVICE_SLOTS];
+
+/* TLV の保留テーブルは BTstack コールバック (async_context) とメインループの
+ * 両方から触るため、async_context のロックで排他する (再帰ロック) */
+#define STORAGE_LOCK()    async_context_acquire_lock_blocking(cyw43_arch_async_context())
+#define STORAGE_UNLOCK()  async_context_release_lock(cyw43_arch_async_context())
+
+static const btstack_tlv_t *tlv_impl = NULL;
+static void *tlv_context = NULL;
+static bool slots_loaded = false;
 
-/* スロット別LED色 (R, G, B) - 輝度を抑えめに設定 */
-static const uint8_t slot_colors[MAX_DEVICE_SLOTS][3] = {
-    {  0, 32,  0 },   /* スロット0: 緑 */
-    {  0,  0, 32 },   /* スロット1: 青 */
-    { 32,  0,  0 },   /* スロット2: 赤 */
-};
 
 /* ============================================================
- * Flash 読み書き
+ * TLV 読み書き
  * ============================================================ */
 
-/* FlashからXIPアドレスへの変換 */
-static const flash_slot_data_t *flash_read_ptr(void) {
-    return (const flash_slot_data_t *)(XIP_BASE + FLASH_SLOT_OFFSET);
+static void clear_slot(uint8_t slot) {
+    memset(&slots[slot], 0, sizeof(device_slot_info_t));
+    slots[slot].db_index = DEVICE_SLOT_NO_BOND;
 }
 
-static void flash_save_slots(void) {
-    flash_slot_data_t data;
-    memset(&data, 0xFF, sizeof(data));  /* Flash消去値 */
-
-    data.magic = FLASH_SLOT_MAGIC;
-    data.active_slot = active_slot;
-
+static void reset_slots(void) {
     for (int i = 0; i < MAX_DEVICE_SLOTS; i++) {
-        memcpy(data.slots[i].bd_addr, slots[i].bd_addr, BD_ADDR_LEN);
-        data.slots[i].addr_type = slots[i].addr_type;
-        data.slots[i].paired = slots[i].paired ? 1 : 0;
+        clear_slot(i);
+        pointer_curves[i] = POINTER_CURVE_DEFAULT;
     }
+    active_slot = 0;
+}
+
+/* le_device_db はロック内で呼ぶ (BTstack 側の追加/削除と競合しないように) */
+static void bond_info(int index, int *addr_type, bd_addr_t addr) {
+    sm_key_t irk;
+    *addr_type = BD_ADDR_TYPE_UNKNOWN;
+    STORAGE_LOCK();
+    le_device_db_info(index, addr_type, addr, irk);
+    STORAGE_UNLOCK();
+}
 
-    /* Flash書込み: 割り込み無効化 → セクタ消去 → 書込み → 割り込み復帰 */
-    /* flash_range_program() は FLASH_PAGE_SIZE (256バイト) の倍数が必要 */
-    uint8_t page_buf[FLASH_PAGE_SIZE];
-    memset(page_buf, 0xFF, sizeof(page_buf));
-    memcpy(page_buf, &data, sizeof(flash_slot_data_t));
+static void bond_remove(int index) {
+    STORAGE_LOCK();
+    le_device_db_remove(index);
+    STORAGE_UNLOCK();
+}
 
-    uint32_t ints = save_and_disable_interrupts();
-    flash_range_erase(FLASH_SLOT_OFFSET, FLASH_SECTOR_SIZE);
-    flash_range_program(FLASH_SLOT_OFFSET, page_buf, FLASH_PAGE_SIZE);
-    restore_interrupts(ints);
+static void tlv_save_slot(uint8_t slot) {
+    if (!tlv_impl) return;
+
+    tlv_slot_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.version = TLV_SLOT_VERSION;
+    rec.paired = slots[slot].paired ? 1 : 0;
+    rec.db_index = slots[slot].db_index;
+    rec.addr_type = slots[slot].addr_type;
+    memcpy(rec.bd_addr, slots[slot].bd_addr, BD_ADDR_LEN);
+
+    STORAGE_LOCK();
+    tlv_impl->store_tag(tlv_context, TLV_TAG_SLOT(slot), (const uint8_t *)&rec, sizeof(rec));
+    STORAGE_UNLOCK();
+    TRACE(SLOT_SAVED, slot, slots[slot].db_index);
+}
 
-    DEBUG_PRINT("Flash: slots saved (active=%d)", active_slot);
+static void tlv_save_active(void) {
+    if (!tlv_impl) return;
+    STORAGE_LOCK();
+    tlv_impl->store_tag(tlv_context, TLV_TAG_ACTIVE_SLOT, &active_slot, 1);
+    STORAGE_UNLOCK();
+    TRACE(SLOT_ACTIVE_SAVED, active_slot);
 }
 
-static void flash_load_slots(void) {
-    const flash_slot_data_t *data = flash_read_ptr();
+/* スロットが参照するボンドが le_device_db に実在するか */
+static bool bond_matches_slot(const device_slot_info_t *info) {
+    if (info->db_index < 0 || info->db_index >= le_device_db_max_count()) return false;
 
-    if (data->magic != FLASH_SLOT_MAGIC) {
-        /* 初回起動: デフォルト値 */
-        DEBUG_PRINT("Flash: no slot data, initializing defaults");
-        memset(slots, 0, sizeof(slots));
-        active_slot = 0;
+    int addr_type;
+    bd_addr_t addr;
+    bond_info(info->db_index, &addr_type, addr);
+    if (addr_type == BD_ADDR_TYPE_UNKNOWN) return false;
+    return (addr_type == info->addr_type) &&
+           (memcmp(addr, info->bd_addr, BD_ADDR_LEN) == 0);
+}
+
+static void tlv_load_slots(void) {
+    reset_slots();
+    slots_loaded = true;
+
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (tlv_impl == NULL) {
+        DEBUG_PRINT("TLV: not available, slots are not persistent");
         return;
     }
 
-    active_slot = data->active_slot;
-    if (active_slot >= MAX_DEVICE_SLOTS) active_slot = 0;
+    uint8_t stored_active = 0;
+    if (tlv_impl->get_tag(tlv_context, TLV_TAG_ACTIVE_SLOT, &stored_active, 1) == 1 &&
+        stored_active < MAX_DEVICE_SLOTS) {
+        active_slot = stored_active;
+    }
 
     for (int i = 0; i < MAX_DEVICE_SLOTS; i++) {
-        memcpy(slots[i].bd_addr, data->slots[i].bd_addr, BD_ADDR_LEN);
-        slots[i].addr_type = data->slots[i].addr_type;
-        slots[i].paired = (data->slots[i].paired == 1);
+        uint8_t curve;
+        if (tlv_impl->get_tag(tlv_context, TLV_TAG_POINTER(i), &curve, 1) == 1 &&
+            curve < POINTER_CURVE_COUNT) {
+            pointer_curves[i] = curve;
+        }
+
+        tlv_slot_record_t rec;
+        int len = tlv_impl->get_tag(tlv_context, TLV_TAG_SLOT(i), (uint8_t *)&rec, sizeof(rec));
+        if (len != (int)sizeof(rec) || rec.version != TLV_SLOT_VERSION || rec.paired != 1) {
+            continue;
+        }
+
+        slots[i].paired = true;
+        slots[i].db_index = rec.db_index;
+        slots[i].addr_type = rec.addr_type;
+        memcpy(slots[i].bd_addr, rec.bd_addr, BD_ADDR_LEN);
+
+        /* ボンドが消えている (ホスト側再ペアリング等), または前のスロットと同じボンドを指す
+         * (1ボンド = 1スロット, 保存途中の電源断などで起こり得る) → スロットも未ペアリングに戻す */
+        if (!bond_matches_slot(&slots[i]) || device_slot_find_by_bond(rec.db_index) != i) {
+            DEBUG_PRINT("TLV: slot %d bond %d missing or shared, clearing", i, rec.db_index);
+            clear_slot(i);
+            STORAGE_LOCK();
+            tlv_impl->delete_tag(tlv_context, TLV_TAG_SLOT(i));
+            STORAGE_UNLOCK();
+        }
     }
 
-    DEBUG_PRINT("Flash: slots loaded (active=%d)", active_slot);
+    /* どのスロットからも参照されないボンドを削除 (DB溢れ防止) */
+    for (int index = 0; index < le_device_db_max_count(); index++) {
+        int addr_type;
+        bd_addr_t addr;
+        bond_info(index, &addr_type, addr);
+        if (addr_type == BD_ADDR_TYPE_UNKNOWN) continue;
+        if (device_slot_find_by_bond(index) >= 0) continue;
+
+        DEBUG_PRINT("TLV: removing orphan bond %d", index);
+        bond_remove(index);
+    }
+
+    DEBUG_PRINT("TLV: slots loaded (active=%d)", active_slot);
+}
+
+/* 旧 TLV (pico_flash_bank) のタグを flash_log へコピー */
+static void migrate_tag(const btstack_tlv_t *old_impl, void *old_context, uint32_t tag) {
+    uint8_t buf[FLASH_LOG_MAX_VALUE];
+    int len = old_impl->get_tag(old_context, tag, buf, sizeof(buf));
+    if (len <= 0 || len > (int)sizeof(buf)) return;
+    flash_log_write(tag, buf, (uint16_t)len);
+}
+
+static void migrate_from_flash_bank(const btstack_tlv_t *old_impl, void *old_context) {
+    for (int i = 0; i < NVM_NUM_DEVICE_DB_ENTRIES; i++) {
+        migrate_tag(old_impl, old_context, TLV_TAG_BOND(i));
+    }
+    migrate_tag(old_impl, old_context, TLV_TAG_ACTIVE_SLOT);
+    for (int i = 0; i < MAX_DEVICE_SLOTS; i++) {
+        migrate_tag(old_impl, old_context, TLV_TAG_SLOT(i));
+        migrate_tag(old_impl, old_context, TLV_TAG_POINTER(i));
+    }
+    DEBUG_PRINT("TLV: migrated from flash bank");
 }
 
 /* ============================================================
  * Public API
  * ============================================================ */
 
+bool device_slot_storage_init(void) {
+    if (!flash_log_init()) {
+        DEBUG_PRINT("TLV: flash log init failed, keeping flash bank TLV");
+        tlv_load_slots();
+        return false;
+    }
+
+    /* 初回: SDK が構成した pico_flash_bank TLV から移行 */
+    const btstack_tlv_t *old_impl = NULL;
+    void *old_context = NULL;
+    btstack_tlv_get_instance(&old_impl, &old_context);
+    if (flash_log_is_empty() && old_impl != NULL) {
+        migrate_from_flash_bank(old_impl, old_context);
+        flash_log_commit();
+    }
+
+    btstack_tlv_set_instance(flash_log_tlv_instance(), NULL);
+    le_device_db_tlv_configure(flash_log_tlv_instance(), NULL);
+
+    /* HCI 起動 (アドバタイジング開始) より前にスロット表をそろえる */
+    tlv_load_slots();
+    return true;
+}
+
+void device_slot_commit_storage(void) {
+    STORAGE_LOCK();
+    if (!flash_log_commit()) {
+        TRACE(SLOT_COMMIT_FAILED);
+    }
+    STORAGE_UNLOCK();
+}
+
 void device_slot_init(void) {
-    /* WS2812B LED 初期化 */
+    /* WS2812B LED + アニメーション初期化 */
     ws2812_init();
+    led_anim_init();
 
-    /* Flashからスロット情報読込 */
-    flash_load_slots();
+    /* スロット情報は device_slot_storage_init() で読込済み。
+     * BLE 初期化に失敗して読めていなければ既定値 (未ペアリング) で動く */
+    if (!slots_loaded) reset_slots();
 
     /* アクティブスロットのLEDを点灯 */
     device_slot_update_leds();
@@ -145,23 +294,44 @@ bool device_slot_switch(uint8_t slot) {
 
     active_slot = slot;
     device_slot_update_leds();
-    flash_save_slots();
+    tlv_save_active();
 
-    DEBUG_PRINT("Slot switched to %d (paired=%s)",
-                slot, slots[slot].paired ? "yes" : "no");
+    TRACE(SLOT_SWITCHED, slot, slots[slot].paired);
     return true;
 }
 
-void device_slot_save_pairing(const uint8_t *bd_addr, uint8_t addr_type) {
-    memcpy(slots[active_slot].bd_addr, bd_addr, BD_ADDR_LEN);
-    slots[active_slot].addr_type = addr_type;
-    slots[active_slot].paired = true;
-    flash_save_slots();
+void device_slot_save_pairing(uint8_t slot, int db_index) {
+    if (slot >= MAX_DEVICE_SLOTS) return;
+    if (db_index < 0 || db_index >= le_device_db_max_count()) return;
+
+    /* ボンドDBから ID アドレスを取得 (RPA ではなく IRK に対応する ID アドレス) */
+    int addr_type;
+    bd_addr_t addr;
+    bond_info(db_index, &addr_type, addr);
+    if (addr_type == BD_ADDR_TYPE_UNKNOWN) return;
+
+    /* このスロットが以前別のボンドを指していたら、そのボンドを削除 */
+    if (slots[slot].paired && slots[slot].db_index != db_index &&
+        slots[slot].db_index >= 0) {
+        bond_remove(slots[slot].db_index);
+    }
+
+    /* 同じホストが別スロットに登録済みなら、そちらは解除 (1ボンド = 1スロット) */
+    int8_t other = device_slot_find_by_bond(db_index);
+    if (other >= 0 && other != slot) {
+        clear_slot(other);
+        tlv_save_slot(other);
+    }
 
-    DEBUG_PRINT("Slot %d: pairing saved (addr=%02X:%02X:%02X:%02X:%02X:%02X)",
-                active_slot,
-                bd_addr[0], bd_addr[1], bd_addr[2],
-                bd_addr[3], bd_addr[4], bd_addr[5]);
+    memcpy(slots[slot].bd_addr, addr, BD_ADDR_LEN);
+    slots[slot].addr_type = (uint8_t)addr_type;
+    slots[slot].db_index = (int8_t)db_index;
+    slots[slot].paired = true;
+    tlv_save_slot(slot);
+
+    TRACE(SLOT_PAIRING_SAVED, slot, db_index,
+          ((uint32_t)addr[0] << 16) | ((uint32_t)addr[1] << 8) | addr[2],
+          ((uint32_t)addr[3] << 16) | ((uint32_t)addr[4] << 8) | addr[5]);
 }
 
 const device_slot_info_t *device_slot_get_info(uint8_t slot) {
@@ -169,40 +339,79 @@ const device_slot_info_t *device_slot_get_info(uint8_t slot) {
     return &slots[slot];
 }
 
+int8_t device_slot_find_by_bond(int db_index) {
+    if (db_index < 0) return -1;
+    for (int i = 0; i < MAX_DEVICE_SLOTS; i++) {
+        if (slots[i].paired && slots[i].db_index == db_index) return (int8_t)i;
+    }
+    return -1;
+}
+
+uint8_t device_slot_get_pointer_curve(uint8_t slot) {
+    if (slot >= MAX_DEVICE_SLOTS) return POINTER_CURVE_DEFAULT;
+    return pointer_curves[slot];
+}
+
+void device_slot_set_pointer_curve(uint8_t slot, uint8_t curve) {
+    if (slot >= MAX_DEVICE_SLOTS || curve >= POINTER_CURVE_COUNT) return;
+    if (pointer_curves[slot] == curve) return;
+
+    pointer_curves[slot] = curve;
+    if (tlv_impl) {
+        STORAGE_LOCK();
+        tlv_impl->store_tag(tlv_context, TLV_TAG_POINTER(slot), &curve, 1);
+        STORAGE_UNLOCK();
+    }
+    TRACE(SLOT_CURVE_SAVED, slot, curve);
+}
+
 void device_slot_clear_current(void) {
-    memset(&slots[active_slot], 0, sizeof(device_slot_info_t));
-    flash_save_slots();
-    DEBUG_PRINT("Slot %d: pairing cleared", active_slot);
+    /* ボンド (LTK/IRK) もスロットと一緒に削除 */
+    if (slots[active_slot].paired && slots[active_slot].db_index >= 0) {
+        bond_remove(slots[active_slot].db_index);
+    }
+    clear_slot(active_slot);
+    tlv_save_slot(active_slot);
+    TRACE(SLOT_CLEARED, active_slot);
 }
 
 void device_slot_update_leds(void) {
-    ws2812_clear();
-    /* アクティブスロットのLEDだけ点灯 */
-    ws2812_set_pixel(active_slot,
-                     slot_colors[active_slot][0],
-                     slot_colors[active_slot][1],
-                     slot_colors[active_slot][2]);
-    ws2812_show();
+    /* アクティブスロットのLEDだけ点灯 (ベース色) */
+    for (uint8_t i = 0; i < MAX_DEVICE_SLOTS; i++) {
+        if (i == active_slot) {
+            uint8_t r, g, b;
+            config_get_slot_color(i, &r, &g, &b);
+            led_anim_set_base(i, r, g, b);
+        } else {
+            led_anim_set_base(i, 0, 0, 0);
+            led_anim_stop(i);
+        }
+    }
 }
 
 void device_slot_blink_led(uint8_t slot, uint8_t blink_count) {
     if (slot >= MAX_DEVICE_SLOTS) return;
 
-    /* 指定LEDを blink_count 回点滅 */
-    for (uint8_t b = 0; b < blink_count; b++) {
-        ws2812_clear();
-        ws2812_set_pixel(slot,
-                         slot_colors[slot][0],
-                         slot_colors[slot][1],
-                         slot_colors[slot][2]);
-        ws2812_show();
-        sleep_ms(150);
+    /* 指定LEDを blink_count 回点滅 (終了後はベース色に戻る) */
+    uint8_t r, g, b;
+    config_get_slot_color(slot, &r, &g, &b);
+    led_anim_play(slot, &LED_SEQ_BLINK, r, g, b, blink_count);
+}
 
-        ws2812_clear();
-        ws2812_show();
-        sleep_ms(150);
+void device_slot_set_pairing_indicator(bool pairing) {
+    if (pairing) {
+        /* 切替時の点滅が終わってから開始 */
+        if (!led_anim_is_playing(active_slot, NULL)) {
+            uint8_t r, g, b;
+            config_get_slot_color(active_slot, &r, &g, &b);
+            led_anim_play(active_slot, &LED_SEQ_PAIRING, r, g, b, LED_ANIM_REPEAT_FOREVER);
+        }
+    } else if (led_anim_is_playing(active_slot, &LED_SEQ_PAIRING)) {
+        led_anim_stop(active_slot);
     }
+}
 
-    /* 最終状態: アクティブLED点灯 */
-    device_slot_update_leds();
+void device_slot_show_battery_warning(void) {
+    /* 赤の短い2回点滅を2周 */
+    led_anim_play(active_slot, &LED_SEQ_BATTERY_WARN, 32, 0, 0, 2);
 }
@@ -0,0 +1,617 @@
+/**
+ * @file flash_log.c
+ * @brief ログ構造 Flash ストア実装
+ *
+ * 領域: pico_flash_bank (BTstack 既定 TLV, 最終 8KB) の直前 FLASH_LOG_SECTORS セクタ
+ *
+ * セクタ構成:
+ *   [0..15]   セクタヘッダ: magic 'JKLG' + 世代番号 (+ 予約)
+ *   [16..]    レコード: ヘッダ (tag, len, crc, seq) + 値, 4バイト境界
+ *             レコードはページ (256B) をまたがない → 追記は1ページのプログラム
+ *
+ * レコード:
+ *   tag = 0xFFFFFFFF かつ len = 0xFFFF : 未書込み
+ *   len = LOG_LEN_DELETED               : 削除レコード (値なし)
+ *   crc = CRC16-CCITT (tag, len, seq, 値)
+ *
+ * セクタは世代番号順のリングとして使い、書込み先の次のセクタを常に消去済みの
+ * 予備に残す。書込み先が満杯になったら:
+ *   1. 予備セクタにヘッダを書いて新しい書込み先にする (世代番号 +1)
+ *   2. 最古セクタ (新しい書込み先の次) の有効レコードを書込み先へ退避
+ *   3. 最古セクタを消去して予備にする
+ * 2-3 の途中で電源断しても最古セクタは残っており、起動時に退避をやり直す。
+ * 退避済みレコードはシーケンス番号が大きいため重複しても新しい方が選ばれる。
+ *
+ * 遅延コミット:
+ *   write/delete は RAM の保留テーブルに積むだけで (同じタグは上書き = 合体)、
+ *   Flash へは flash_log_commit() でまとめて書く。読み出しは保留テーブルを優先する。
+ *   Flash 操作中は flash_safe_execute() が割り込み (と他コア) を止めるため、
+ *   その時間をコミットごとに計測して統計に残す。
+ */
+
+#include "flash_log.h"
+#include "project_config.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "pico/btstack_flash_bank.h"
+#include "hardware/flash.h"
+
+/* ============================================================
+ * レイアウト定数
+ * ============================================================ */
+#define LOG_REGION_OFFSET   (PICO_FLASH_BANK_STORAGE_OFFSET - FLASH_LOG_SECTORS * FLASH_SECTOR_SIZE)
+#define LOG_SECTOR_MAGIC    0x474C4B4Au   /* 'JKLG' */
+#define LOG_HEADER_SIZE     16
+#define LOG_ALIGN           4
+
+#define LOG_TAG_BLANK       0xFFFFFFFFu
+#define LOG_LEN_BLANK       0xFFFF
+#define LOG_LEN_DELETED     0xFFFE
+
+/* 索引に保持できるタグ数 (削除レコードを含む) */
+#define LOG_MAX_KEYS        48
+
+/* フラッシュ操作のタイムアウト (他コア/割り込みの停止待ち) */
+#define LOG_FLASH_TIMEOUT_MS  100
+
+_Static_assert(FLASH_LOG_SECTORS >= 3, "need head + spare + at least one more sector");
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t generation;
+    uint8_t  reserved[8];
+} log_sector_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t tag;
+    uint16_t len;
+    uint16_t crc;
+    uint32_t seq;
+} log_record_t;
+
+_Static_assert(sizeof(log_sector_header_t) == LOG_HEADER_SIZE, "sector header size");
+_Static_assert(sizeof(log_record_t) + FLASH_LOG_MAX_VALUE <= FLASH_PAGE_SIZE,
+               "record must fit in one page");
+
+/* 索引: タグ → 最新レコード (削除レコードも保持し、古い値の復活を防ぐ) */
+typedef struct {
+    uint32_t tag;
+    uint32_t offset;   /* 領域先頭からのレコード位置 */
+    uint32_t seq;
+    uint16_t len;      /* 値の長さ, LOG_LEN_DELETED = 削除済み */
+} log_index_t;
+
+static log_index_t index_table[LOG_MAX_KEYS];
+static uint8_t  index_count = 0;
+
+static bool     log_ready = false;
+static bool     compacting = false;
+static uint8_t  head_sector = 0;        /* 書込み先セクタ */
+static uint32_t head_generation = 0;
+static uint32_t head_offset = 0;        /* 書込み先セクタ内の次の書込み位置 */
+static uint32_t next_seq = 1;
+
+/* 保留中の書込み (len = LOG_LEN_DELETED は削除) */
+typedef struct {
+    uint32_t tag;
+    uint16_t len;
+    uint8_t  data[FLASH_LOG_MAX_VALUE] __attribute__((aligned(4)));  /* XIP 側と同じく4バイト境界 */
+} log_pending_t;
+
+static log_pending_t pending[FLASH_LOG_PENDING_MAX];
+static uint8_t  pending_count = 0;
+
+static uint32_t generation = 0;         /* ポインタ無効化の世代 */
+
+static flash_log_stats_t stats;
+static uint32_t blocked_us = 0;         /* 実行中コミットの割り込み停止時間 */
+
+/* ============================================================
+ * Flash アクセス
+ * ============================================================ */
+
+static inline const uint8_t *xip_ptr(uint32_t offset) {
+    return (const uint8_t *)(XIP_BASE + LOG_REGION_OFFSET + offset);
+}
+
+static inline uint32_t sector_base(uint8_t sector) {
+    return (uint32_t)sector * FLASH_SECTOR_SIZE;
+}
+
+static inline uint8_t sector_next(uint8_t sector, uint8_t n) {
+    return (uint8_t)((sector + n) % FLASH_LOG_SECTORS);
+}
+
+typedef struct {
+    uint32_t offset;        /* 領域先頭からのオフセット */
+    const uint8_t *data;    /* プログラム時のみ (1ページ) */
+} flash_op_t;
+
+static void do_erase(void *param) {
+    const flash_op_t *op = (const flash_op_t *)param;
+    flash_range_erase(LOG_REGION_OFFSET + op->offset, FLASH_SECTOR_SIZE);
+}
+
+static void do_program(void *param) {
+    const flash_op_t *op = (const flash_op_t *)param;
+    flash_range_program(LOG_REGION_OFFSET + op->offset, op->data, FLASH_PAGE_SIZE);
+}
+
+static bool erase_sector(uint8_t sector) {
+    flash_op_t op = { .offset = sector_base(sector), .data = NULL };
+    stats.sector_erases++;
+    uint32_t start = time_us_32();
+    int rc = flash_safe_execute(do_erase, &op, LOG_FLASH_TIMEOUT_MS);
+    blocked_us += time_us_32() - start;
+    return rc == PICO_OK;
+}
+
+/* offset から len バイトを書込み (同一ページ内, 残りは 0xFF = 変更なし) */
+static bool program_bytes(uint32_t offset, const uint8_t *data, uint32_t len) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t page_start = offset & ~(uint32_t)(FLASH_PAGE_SIZE - 1);
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page + (offset - page_start), data, len);
+
+    flash_op_t op = { .offset = page_start, .data = page };
+    stats.page_programs++;
+    uint32_t start = time_us_32();
+    int rc = flash_safe_execute(do_program, &op, LOG_FLASH_TIMEOUT_MS);
+    blocked_us += time_us_32() - start;
+    return rc == PICO_OK;
+}
+
+static bool sector_is_blank(uint8_t sector) {
+    const uint32_t *p = (const uint32_t *)xip_ptr(sector_base(sector));
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / 4; i++) {
+        if (p[i] != 0xFFFFFFFFu) return false;
+    }
+    return true;
+}
+
+static bool read_sector_header(uint8_t sector, uint32_t *generation) {
+    const log_sector_header_t *h = (const log_sector_header_t *)xip_ptr(sector_base(sector));
+    if (h->magic != LOG_SECTOR_MAGIC) return false;
+    if (generation) *generation = h->generation;
+    return true;
+}
+
+/* ============================================================
+ * レコード
+ * ============================================================ */
+
+static uint16_t crc16_update(uint16_t crc, const uint8_t *data, uint32_t len) {
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static inline uint16_t value_len(uint16_t len) {
+    return (len == LOG_LEN_DELETED) ? 0 : len;
+}
+
+static uint16_t record_crc(uint32_t tag, uint16_t len, uint32_t seq, const uint8_t *value) {
+    uint16_t crc = 0xFFFF;
+    crc = crc16_update(crc, (const uint8_t *)&tag, sizeof(tag));
+    crc = crc16_update(crc, (const uint8_t *)&len, sizeof(len));
+    crc = crc16_update(crc, (const uint8_t *)&seq, sizeof(seq));
+    return crc16_update(crc, value, value_len(len));
+}
+
+static inline uint32_t record_size(uint16_t len) {
+    uint32_t size = sizeof(log_record_t) + value_len(len);
+    return (size + LOG_ALIGN - 1) & ~(uint32_t)(LOG_ALIGN - 1);
+}
+
+static inline uint32_t page_end(uint32_t pos) {
+    return (pos & ~(uint32_t)(FLASH_PAGE_SIZE - 1)) + FLASH_PAGE_SIZE;
+}
+
+/* セクタ内位置 pos 以降で size バイトのレコードを置ける位置 (ページをまたがない) */
+static inline uint32_t place_in_page(uint32_t pos, uint32_t size) {
+    return (pos + size > page_end(pos)) ? page_end(pos) : pos;
+}
+
+/* ============================================================
+ * 索引
+ * ============================================================ */
+
+static log_index_t *index_find(uint32_t tag) {
+    for (uint8_t i = 0; i < index_count; i++) {
+        if (index_table[i].tag == tag) return &index_table[i];
+    }
+    return NULL;
+}
+
+static bool index_set(uint32_t tag, uint32_t offset, uint16_t len, uint32_t seq) {
+    log_index_t *e = index_find(tag);
+    if (!e) {
+        if (index_count >= LOG_MAX_KEYS) return false;
+        e = &index_table[index_count++];
+        e->tag = tag;
+    } else if (seq < e->seq) {
+        return true;   /* 既に新しいレコードがある */
+    }
+    e->offset = offset;
+    e->len = len;
+    e->seq = seq;
+    return true;
+}
+
+static const log_index_t *index_lookup(uint32_t tag) {
+    const log_index_t *e = index_find(tag);
+    return (e && e->len != LOG_LEN_DELETED) ? e : NULL;
+}
+
+/* ============================================================
+ * 起動時の走査
+ * ============================================================ */
+
+/* セクタ内のレコードを索引に反映。戻り値: データ終端 (次の書込み位置) */
+static uint32_t scan_sector(uint8_t sector) {
+    uint32_t base = sector_base(sector);
+    uint32_t pos = LOG_HEADER_SIZE;
+
+    while (pos + sizeof(log_record_t) <= FLASH_SECTOR_SIZE) {
+        log_record_t rec;
+        memcpy(&rec, xip_ptr(base + pos), sizeof(rec));
+
+        if (rec.tag == LOG_TAG_BLANK && rec.len == LOG_LEN_BLANK) {
+            /* ページ末尾の詰め物か、データ終端か: 次のページ先頭で判定 */
+            uint32_t next = page_end(pos);
+            if (next >= FLASH_SECTOR_SIZE) return FLASH_SECTOR_SIZE;
+            if (*(const uint32_t *)xip_ptr(base + next) == LOG_TAG_BLANK) return pos;
+            pos = next;
+            continue;
+        }
+
+        bool plausible = (rec.len == LOG_LEN_DELETED || rec.len <= FLASH_LOG_MAX_VALUE) &&
+                         place_in_page(pos, record_size(rec.len)) == pos;
+        if (!plausible) {
+            /* 長さが壊れている → このページの残りは読み飛ばす */
+            pos = page_end(pos);
+            continue;
+        }
+
+        const uint8_t *value = xip_ptr(base + pos + sizeof(log_record_t));
+        if (record_crc(rec.tag, rec.len, rec.seq, value) == rec.crc) {
+            if (rec.seq >= next_seq) next_seq = rec.seq + 1;
+            if (!index_set(rec.tag, base + pos, rec.len, rec.seq)) {
+                DEBUG_PRINT("FlashLog: index full, tag 0x%08lx dropped", (unsigned long)rec.tag);
+            }
+        }
+        pos += record_size(rec.len);
+    }
+    return pos;
+}
+
+/* ============================================================
+ * 書込み
+ * ============================================================ */
+
+static bool start_sector(uint8_t sector, uint32_t generation) {
+    log_sector_header_t h;
+    memset(&h, 0xFF, sizeof(h));
+    h.magic = LOG_SECTOR_MAGIC;
+    h.generation = generation;
+    if (!program_bytes(sector_base(sector), (const uint8_t *)&h, sizeof(h))) return false;
+
+    head_sector = sector;
+    head_generation = generation;
+    head_offset = LOG_HEADER_SIZE;
+    return true;
+}
+
+static bool append_record(uint32_t tag, uint16_t len, const uint8_t *value);
+
+/* sector の有効レコードを書込み先へ退避してから消去 */
+static bool evacuate(uint8_t sector) {
+    static uint8_t value[FLASH_LOG_MAX_VALUE];
+    uint32_t lo = sector_base(sector);
+    uint32_t hi = lo + FLASH_SECTOR_SIZE;
+
+    for (uint8_t i = 0; i < index_count;) {
+        log_index_t *e = &index_table[i];
+        if (e->offset < lo || e->offset >= hi) {
+            i++;
+            continue;
+        }
+        if (e->len == LOG_LEN_DELETED) {
+            /* 削除対象の古い値はこのセクタ以前にしか無い → 消去で消える */
+            *e = index_table[--index_count];
+            continue;
+        }
+        memcpy(value, xip_ptr(e->offset + sizeof(log_record_t)), e->len);
+        if (!append_record(e->tag, e->len, value)) return false;
+        i++;
+    }
+    return erase_sector(sector);
+}
+
+/* 書込み先を予備セクタへ進め、最古セクタを回収 */
+static bool compact(void) {
+    if (compacting) return false;   /* 有効データが1セクタに収まらない */
+    compacting = true;
+
+    uint8_t spare = sector_next(head_sector, 1);
+    bool ok = start_sector(spare, head_generation + 1);
+    if (ok) {
+        stats.compactions++;
+        uint8_t oldest = sector_next(head_sector, 1);
+        if (read_sector_header(oldest, NULL)) {
+            ok = evacuate(oldest);
+        }
+    }
+
+    compacting = false;
+    return ok;
+}
+
+static bool append_record(uint32_t tag, uint16_t len, const uint8_t *value) {
+    uint32_t size = record_size(len);
+    uint32_t pos = place_in_page(head_offset, size);
+
+    if (pos + size > FLASH_SECTOR_SIZE) {
+        if (!compact()) return false;
+        pos = place_in_page(head_offset, size);
+    }
+
+    uint8_t buf[sizeof(log_record_t) + FLASH_LOG_MAX_VALUE];
+    log_record_t rec = {
+        .tag = tag,
+        .len = len,
+        .crc = 0,
+        .seq = next_seq++,
+    };
+    rec.crc = record_crc(tag, len, rec.seq, value);
+    memcpy(buf, &rec, sizeof(rec));
+    if (value_len(len)) memcpy(buf + sizeof(rec), value, value_len(len));
+
+    uint32_t offset = sector_base(head_sector) + pos;
+    if (!program_bytes(offset, buf, sizeof(rec) + value_len(len))) return false;
+    head_offset = pos + size;
+
+    return index_set(tag, offset, len, rec.seq);
+}
+
+/* ============================================================
+ * Public API
+ * ============================================================ */
+
+bool flash_log_init(void) {
+    uint32_t gens[FLASH_LOG_SECTORS];
+    bool valid[FLASH_LOG_SECTORS];
+    uint8_t order[FLASH_LOG_SECTORS];
+    uint8_t valid_count = 0;
+
+    index_count = 0;
+    pending_count = 0;
+    next_seq = 1;
+    generation++;
+    memset(&stats, 0, sizeof(stats));
+
+    /* 有効なセクタを世代の古い順に並べる */
+    for (uint8_t s = 0; s < FLASH_LOG_SECTORS; s++) {
+        valid[s] = read_sector_header(s, &gens[s]);
+        if (!valid[s]) continue;
+        uint8_t i = valid_count++;
+        while (i > 0 && gens[order[i - 1]] > gens[s]) {
+            order[i] = order[i - 1];
+            i--;
+        }
+        order[i] = s;
+    }
+
+    /* ヘッダの無いセクタは消去して予備にする (消去途中の電源断を含む) */
+    for (uint8_t s = 0; s < FLASH_LOG_SECTORS; s++) {
+        if (!valid[s] && !sector_is_blank(s)) {
+            DEBUG_PRINT("FlashLog: sector %d has no header, erasing", s);
+            if (!erase_sector(s)) return false;
+        }
+    }
+
+    if (valid_count == 0) {
+        /* 初回: セクタ0から開始 */
+        if (!start_sector(0, 1)) return false;
+    } else {
+        /* 古い順に走査 (新しいレコードが後勝ち) */
+        uint32_t head_end = LOG_HEADER_SIZE;
+        for (uint8_t i = 0; i < valid_count; i++) {
+            head_end = scan_sector(order[i]);
+        }
+        head_sector = order[valid_count - 1];
+        head_generation = gens[head_sector];
+        head_offset = head_end;
+
+        /* 予備が残っていない = コンパクション途中の電源断 → 退避をやり直す */
+        uint8_t spare = sector_next(head_sector, 1);
+        if (valid[spare]) {
+            DEBUG_PRINT("FlashLog: resuming compaction of sector %d", spare);
+            compacting = true;
+            bool ok = evacuate(spare);
+            compacting = false;
+            if (!ok) return false;
+        }
+    }
+
+    log_ready = true;
+
+    flash_log_stats_t s;
+    flash_log_get_stats(&s);
+    DEBUG_PRINT("FlashLog: %lu keys, head sector %d (gen %lu, %lu bytes used)",
+                (unsigned long)s.records, head_sector,
+                (unsigned long)head_generation, (unsigned long)s.used_bytes);
+    return true;
+}
+
+bool flash_log_is_empty(void) {
+    if (pending_count > 0) return false;
+    for (uint8_t i = 0; i < index_count; i++) {
+        if (index_table[i].len != LOG_LEN_DELETED) return false;
+    }
+    return true;
+}
+
+static log_pending_t *pending_find(uint32_t tag) {
+    for (uint8_t i = 0; i < pending_count; i++) {
+        if (pending[i].tag == tag) return &pending[i];
+    }
+    return NULL;
+}
+
+const uint8_t *flash_log_get_ptr(uint32_t tag, uint16_t *len) {
+    if (!log_ready) return NULL;
+
+    const log_pending_t *p = pending_find(tag);
+    if (p) {
+        if (p->len == LOG_LEN_DELETED) return NULL;
+        if (len) *len = p->len;
+        return p->data;
+    }
+
+    const log_index_t *e = index_lookup(tag);
+    if (!e) return NULL;
+    if (len) *len = e->len;
+    return xip_ptr(e->offset + sizeof(log_record_t));
+}
+
+int flash_log_read(uint32_t tag, uint8_t *buffer, uint32_t buffer_size) {
+    uint16_t len;
+    const uint8_t *value = flash_log_get_ptr(tag, &len);
+    if (!value) return 0;
+    if (buffer) {
+        memcpy(buffer, value, (len < buffer_size) ? len : buffer_size);
+    }
+    return len;
+}
+
+/*
+ * 保留テーブルに積む (同じタグは上書き)
+ * 満杯なら拒否する。書込みは BTstack のコンテキストからも呼ばれるため、ここでは
+ * コミットせず (割り込みを止めない)、空きはアイドル時のコミットで作る。
+ */
+static bool stage(uint32_t tag, uint16_t len, const uint8_t *data) {
+    log_pending_t *p = pending_find(tag);
+    if (!p) {
+        if (pending_count >= FLASH_LOG_PENDING_MAX) {
+            stats.pending_full++;
+            TRACE(FLASHLOG_PENDING, tag);
+            return false;
+        }
+        p = &pending[pending_count++];
+        p->tag = tag;
+    }
+    p->len = len;
+    if (value_len(len)) memcpy(p->data, data, len);
+    generation++;
+    return true;
+}
+
+bool flash_log_write(uint32_t tag, const uint8_t *data, uint16_t len) {
+    if (!log_ready || len > FLASH_LOG_MAX_VALUE || tag == LOG_TAG_BLANK) return false;
+
+    /* 同じ内容なら書かない (消耗を避ける) */
+    uint16_t cur_len;
+    const uint8_t *cur = flash_log_get_ptr(tag, &cur_len);
+    if (cur && cur_len == len && memcmp(cur, data, len) == 0) return true;
+
+    if (!index_find(tag) && !pending_find(tag) &&
+        index_count + pending_count >= LOG_MAX_KEYS) {
+        TRACE(FLASHLOG_REJECTED, tag);
+        return false;
+    }
+    return stage(tag, len, data);
+}
+
+bool flash_log_delete(uint32_t tag) {
+    if (!log_ready) return false;
+    if (!flash_log_get_ptr(tag, NULL)) return true;
+    return stage(tag, LOG_LEN_DELETED, NULL);
+}
+
+bool flash_log_has_pending(void) {
+    return pending_count > 0;
+}
+
+bool flash_log_commit(void) {
+    if (!log_ready || pending_count == 0) return true;
+
+    blocked_us = 0;
+    bool ok = true;
+    uint8_t done = 0;
+    for (; done < pending_count; done++) {
+        const log_pending_t *p = &pending[done];
+        /* 削除は Flash 上に値があるときだけ記録する */
+        if (p->len == LOG_LEN_DELETED && !index_lookup(p->tag)) continue;
+        if (!append_record(p->tag, p->len, p->data)) {
+            ok = false;
+            break;
+        }
+    }
+
+    /* 失敗したら書けなかった分を残す (次回再試行) */
+    memmove(pending, &pending[done], (pending_count - done) * sizeof(log_pending_t));
+    pending_count -= done;
+    generation++;
+
+    stats.commits++;
+    stats.commit_last_us = blocked_us;
+    stats.commit_total_us += blocked_us;
+    if (blocked_us > stats.commit_max_us) stats.commit_max_us = blocked_us;
+    perf_add_time(PERF_TIME_FLASH_COMMIT, blocked_us);
+    return ok;
+}
+
+uint32_t flash_log_generation(void) {
+    return generation;
+}
+
+void flash_log_get_stats(flash_log_stats_t *out) {
+    *out = stats;
+    out->records = 0;
+    for (uint8_t i = 0; i < index_count; i++) {
+        if (index_table[i].len != LOG_LEN_DELETED) out->records++;
+    }
+    out->used_bytes = head_offset;
+    out->pending = pending_count;
+}
+
+/* ============================================================
+ * BTstack TLV アダプタ
+ * ============================================================ */
+
+static int tlv_get_tag(void *context, uint32_t tag, uint8_t *buffer, uint32_t buffer_size) {
+    (void)context;
+    return flash_log_read(tag, buffer, buffer_size);
+}
+
+static int tlv_store_tag(void *context, uint32_t tag, const uint8_t *data, uint32_t data_size) {
+    (void)context;
+    if (data_size > FLASH_LOG_MAX_VALUE) return 1;
+    return flash_log_write(tag, data, (uint16_t)data_size) ? 0 : 1;
+}
+
+static void tlv_delete_tag(void *context, uint32_t tag) {
+    (void)context;
+    flash_log_delete(tag);
+}
+
+static const btstack_tlv_t flash_log_tlv = {
+    .get_tag    = tlv_get_tag,
+    .store_tag  = tlv_store_tag,
+    .delete_tag = tlv_delete_tag,
+};
+
+const btstack_tlv_t *flash_log_tlv_instance(void) {
+    return &flash_log_tlv;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file hid_descriptor.c
+ * @brief HID Report Descriptor (BLE / USB 共通)
+ */
+
+#include "hid_descriptor.h"
+
+/* ============================================================
+ * HID Report Descriptor (コンポジット: キーボード + マウス)
+ *
+ * Report ID 1: キーボード
+ *   byte 0:     modifier keys (8 bits)
+ *   bytes 1-21: NKRO bitmap (168 bits, usage 0x00-0xA7)
+ *
+ * Report ID 2: マウス
+ *   byte 0:     buttons (3 bits + 5 padding)
+ *   byte 1:     X movement (int8)
+ *   byte 2:     Y movement (int8)
+ *   byte 3:     wheel (int8)
+ *   byte 4:     horizontal wheel (int8, AC Pan)
+ * ============================================================ */
+const uint8_t hid_report_descriptor[] = {
+    /* ===== Keyboard Collection (Report ID 1) ===== */
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x06,        /* Usage (Keyboard) */
+    0xA1, 0x01,        /* Collection (Application) */
+    0x85, 0x01,        /*   Report ID (1) */
+
+    /* --- Modifier byte (8 bits) --- */
+    0x05, 0x07,        /*   Usage Page (Keyboard/Keypad) */
+    0x19, 0xE0,        /*   Usage Minimum (Left Control) */
+    0x29, 0xE7,        /*   Usage Maximum (Right GUI) */
+    0x15, 0x00,        /*   Logical Minimum (0) */
+    0x25, 0x01,        /*   Logical Maximum (1) */
+    0x75, 0x01,        /*   Report Size (1 bit) */
+    0x95, 0x08,        /*   Report Count (8) */
+    0x81, 0x02,        /*   Input (Data, Variable, Absolute) */
+
+    /* --- NKRO bitmap (168 bits = 21 bytes) --- */
+    0x95, 0xA8,        /*   Report Count (168) */
+    0x75, 0x01,        /*   Report Size (1 bit) */
+    0x15, 0x00,        /*   Logical Minimum (0) */
+    0x25, 0x01,        /*   Logical Maximum (1) */
+    0x05, 0x07,        /*   Usage Page (Keyboard/Keypad) */
+    0x19, 0x00,        /*   Usage Minimum (0x00) */
+    0x29, 0xA7,        /*   Usage Maximum (0xA7) */
+    0x81, 0x02,        /*   Input (Data, Variable, Absolute) */
+
+    /* --- LED output report (5 bits + 3 padding) --- */
+    0x95, 0x05,        /*   Report Count (5) */
+    0x75, 0x01,        /*   Report Size (1 bit) */
+    0x05, 0x08,        /*   Usage Page (LEDs) */
+    0x19, 0x01,        /*   Usage Minimum (Num Lock) */
+    0x29, 0x05,        /*   Usage Maximum (Kana) */
+    0x91, 0x02,        /*   Output (Data, Variable, Absolute) */
+    0x95, 0x01,        /*   Report Count (1) */
+    0x75, 0x03,        /*   Report Size (3 bits) */
+    0x91, 0x01,        /*   Output (Constant) - padding */
+
+    0xC0,              /* End Collection (Keyboard) */
+
+    /* ===== Mouse Collection (Report ID 2) ===== */
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x02,        /* Usage (Mouse) */
+    0xA1, 0x01,        /* Collection (Application) */
+    0x85, 0x02,        /*   Report ID (2) */
+    0x09, 0x01,        /*   Usage (Pointer) */
+    0xA1, 0x00,        /*   Collection (Physical) */
+
+    /* --- Buttons (3 bits + 5 padding) --- */
+    0x05, 0x09,        /*     Usage Page (Button) */
+    0x19, 0x01,        /*     Usage Minimum (Button 1) */
+    0x29, 0x03,        /*     Usage Maximum (Button 3) */
+    0x15, 0x00,        /*     Logical Minimum (0) */
+    0x25, 0x01,        /*     Logical Maximum (1) */
+    0x75, 0x01,        /*     Report Size (1 bit) */
+    0x95, 0x03,        /*     Report Count (3) */
+    0x81, 0x02,        /*     Input (Data, Variable, Absolute) */
+    0x95, 0x01,        /*     Report Count (1) */
+    0x75, 0x05,        /*     Report Size (5 bits) */
+    0x81, 0x01,        /*     Input (Constant) - padding */
+
+    /* --- X, Y movement (2 bytes, signed) --- */
+    0x05, 0x01,        /*     Usage Page (Generic Desktop) */
+    0x09, 0x30,        /*     Usage (X) */
+    0x09, 0x31,        /*     Usage (Y) */
+    0x15, 0x81,        /*     Logical Minimum (-127) */
+    0x25, 0x7F,        /*     Logical Maximum (127) */
+    0x75, 0x08,        /*     Report Size (8 bits) */
+    0x95, 0x02,        /*     Report Count (2) */
+    0x81, 0x06,        /*     Input (Data, Variable, Relative) */
+
+    /* --- Wheel (1 byte, signed) --- */
+    0x09, 0x38,        /*     Usage (Wheel) */
+    0x15, 0x81,        /*     Logical Minimum (-127) */
+    0x25, 0x7F,        /*     Logical Maximum (127) */
+    0x75, 0x08,        /*     Report Size (8 bits) */
+    0x95, 0x01,        /*     Report Count (1) */
+    0x81, 0x06,        /*     Input (Data, Variable, Relative) */
+
+    /* --- Horizontal wheel (1 byte, signed) --- */
+    0x05, 0x0C,        /*     Usage Page (Consumer) */
+    0x0A, 0x38, 0x02,  /*     Usage (AC Pan) */
+    0x15, 0x81,        /*     Logical Minimum (-127) */
+    0x25, 0x7F,        /*     Logical Maximum (127) */
+    0x75, 0x08,        /*     Report Size (8 bits) */
+    0x95, 0x01,        /*     Report Count (1) */
+    0x81, 0x06,        /*     Input (Data, Variable, Relative) */
+
+    0xC0,              /*   End Collection (Physical) */
+    0xC0,              /* End Collection (Mouse) */
+};
+
+_Static_assert(sizeof(hid_report_descriptor) == HID_REPORT_DESCRIPTOR_LEN,
+               "HID_REPORT_DESCRIPTOR_LEN does not match hid_report_descriptor");
@@ -0,0 +1,363 @@
+/**
+ * @file hid_pipeline.c
+ * @brief HID レポートパイプライン実装
+ *
+ * シンクごとにキーボード・マウスそれぞれ HID_PIPELINE_DEPTH 件の送信待ちフレームを持つ。
+ * 生産側は port->lock() の区間で末尾のフレームを組み立て/上書き/加算し、
+ * 消費側は peek で得た先頭フレームの参照をそのまま送ってから consume する。
+ *
+ * 末尾への上書き/加算は未送信の変化を失わないときだけ行う:
+ *   キーボード: 末尾で変化したキー (1つ前の状態との差) が新しい状態で再び変化しない
+ *               (押して離したタップは2件になる)
+ *   マウス    : 同様に末尾で変化したボタンが再び変化しない (移動量は加算する)
+ * 送信待ちが一杯のときは末尾に上書きする (マウスの移動量は加算して残す)。
+ * ホストが受け取れない (is_ready == false) シンクには積まない
+ * (送信待ちが残り続けて Flash コミットなどを止めないように)。
+ */
+
+#include "hid_pipeline.h"
+
+#include <string.h>
+
+/* 送信待ちフレーム数 (種類ごと) */
+#define HID_PIPELINE_DEPTH  2
+
+typedef struct {
+    uint8_t  kb[1 + NKRO_REPORT_SIZE];       /* Report ID + NKRO */
+    uint8_t  boot[BOOT_REPORT_SIZE];
+    bool     is_boot;                        /* Boot 形式で送る */
+    uint32_t post_us;
+} kb_frame_t;
+
+typedef struct {
+    uint8_t  data[1 + MOUSE_REPORT_SIZE];    /* Report ID + マウス */
+    uint32_t post_us;
+} mouse_frame_t;
+
+typedef struct {
+    const hid_sink_t *sink;
+    kb_frame_t    kb[HID_PIPELINE_DEPTH];
+    mouse_frame_t mouse[HID_PIPELINE_DEPTH];
+    uint8_t  kb_head, kb_count;
+    uint8_t  mouse_head, mouse_count;
+    uint8_t  kb_sent[NKRO_REPORT_SIZE];      /* 最後に送ったキー状態 (上書き可否の判定用) */
+    uint8_t  mouse_sent;                     /* 最後に送ったボタン状態 */
+    hid_pipeline_stats_t stats;
+} sink_queue_t;
+
+static const hid_pipeline_port_t *port = NULL;
+static sink_queue_t queues[HID_PIPELINE_MAX_SINKS];
+static int sink_count = 0;
+static int active = HID_SINK_NONE;
+static uint8_t keys[NKRO_REPORT_SIZE];       /* 現在のキー状態 (modifier + ビットマップ) */
+
+/* ============================================================
+ * 内部関数
+ * ============================================================ */
+
+static inline uint32_t port_lock(void) {
+    return (port && port->lock) ? port->lock() : 0;
+}
+
+static inline void port_unlock(uint32_t state) {
+    if (port && port->unlock) port->unlock(state);
+}
+
+static inline uint32_t port_now(void) {
+    return (port && port->now_us) ? port->now_us() : 0;
+}
+
+static inline void port_queued(bool coalesced) {
+    if (port && port->on_queued) port->on_queued(coalesced);
+}
+
+static inline bool valid_sink(int sink) {
+    return sink >= 0 && sink < sink_count;
+}
+
+static bool sink_ready(const sink_queue_t *q) {
+    return !q->sink->is_ready || q->sink->is_ready(q->sink->ctx);
+}
+
+static void sink_notify(const sink_queue_t *q) {
+    if (q->sink->notify) q->sink->notify(q->sink->ctx);
+}
+
+static int8_t add_clamped(int8_t a, int8_t b) {
+    int16_t v = (int16_t)a + (int16_t)b;
+    if (v > 127)  v = 127;
+    if (v < -127) v = -127;
+    return (int8_t)v;
+}
+
+/* NKRO ビットマップから Boot レポート (6KRO) を作る。7キー目以降は使用番号順で捨てる */
+static void build_boot(uint8_t *boot, const uint8_t *nkro) {
+    memset(boot, 0, BOOT_REPORT_SIZE);
+    boot[0] = nkro[0];
+    int n = 2;
+    for (int byte = 0; byte < NKRO_BITMAP_BYTES && n < BOOT_REPORT_SIZE; byte++) {
+        uint8_t bits = nkro[1 + byte];
+        for (int bit = 0; bits && bit < 8 && n < BOOT_REPORT_SIZE; bit++) {
+            if (bits & (1u << bit)) {
+                boot[n++] = (uint8_t)(byte * 8 + bit);
+                bits &= (uint8_t)~(1u << bit);
+            }
+        }
+    }
+}
+
+static inline uint8_t ring_index(uint8_t head, uint8_t n) {
+    return (uint8_t)((head + n) % HID_PIPELINE_DEPTH);
+}
+
+/*
+ * 末尾のキーボードフレームを new の状態で上書きしてよいか:
+ * 末尾で変化したキー (前の状態との差) が new で再び変化しなければ、どの変化も失われない
+ */
+static bool kb_can_coalesce(const sink_queue_t *q, const uint8_t *nkro) {
+    const uint8_t *tail = q->kb[ring_index(q->kb_head, q->kb_count - 1)].kb + 1;
+    const uint8_t *prev = (q->kb_count > 1)
+        ? q->kb[ring_index(q->kb_head, q->kb_count - 2)].kb + 1 : q->kb_sent;
+    for (int i = 0; i < NKRO_REPORT_SIZE; i++) {
+        if ((tail[i] ^ prev[i]) & (nkro[i] ^ tail[i])) return false;
+    }
+    return true;
+}
+
+/* キーボードフレームを積む (Boot/NKRO はシンクの現在のプロトコルで決める) */
+static void queue_keyboard(sink_queue_t *q, const uint8_t *nkro) {
+    if (!sink_ready(q)) return;
+    bool boot = q->sink->wants_boot && q->sink->wants_boot(q->sink->ctx);
+    uint32_t now = port_now();
+
+    uint32_t state = port_lock();
+    bool coalesced = q->kb_count > 0 &&
+                     (q->kb_count == HID_PIPELINE_DEPTH || kb_can_coalesce(q, nkro));
+    if (!coalesced) {
+        q->kb[ring_index(q->kb_head, q->kb_count)].post_us = now;
+        q->kb_count++;
+    }
+    kb_frame_t *f = &q->kb[ring_index(q->kb_head, q->kb_count - 1)];
+    /* 上書き可否の判定に使うため NKRO 形式は Boot でも保持する */
+    f->kb[0] = HID_REPORT_ID_KEYBOARD;
+    memcpy(f->kb + 1, nkro, NKRO_REPORT_SIZE);
+    if (boot) build_boot(f->boot, nkro);
+    f->is_boot = boot;
+    q->stats.queued++;
+    if (coalesced) q->stats.coalesced++;
+    port_unlock(state);
+
+    port_queued(coalesced);
+    sink_notify(q);
+}
+
+/* ============================================================
+ * 公開 API
+ * ============================================================ */
+
+void hid_pipeline_init(const hid_pipeline_port_t *p) {
+    port = p;
+    memset(queues, 0, sizeof(queues));
+    memset(keys, 0, sizeof(keys));
+    sink_count = 0;
+    active = HID_SINK_NONE;
+}
+
+int hid_pipeline_add_sink(const hid_sink_t *sink) {
+    if (sink_count >= HID_PIPELINE_MAX_SINKS) return HID_SINK_NONE;
+    queues[sink_count].sink = sink;
+    return sink_count++;
+}
+
+void hid_pipeline_set_active(int sink) {
+    if (!valid_sink(sink)) sink = HID_SINK_NONE;
+    if (sink == active) return;
+
+    /* 旧シンク: 押しっぱなしにならないよう全キー解放 (マウスの送信待ちは捨てる) */
+    if (active != HID_SINK_NONE) {
+        static const uint8_t released[NKRO_REPORT_SIZE] = {0};
+        hid_pipeline_discard(active, HID_FRAME_MASK_MOUSE);
+        queue_keyboard(&queues[active], released);
+    }
+
+    active = sink;
+
+    /* 新シンク: 現在のキー状態から始める */
+    if (active != HID_SINK_NONE) queue_keyboard(&queues[active], keys);
+}
+
+int hid_pipeline_get_active(void) {
+    return active;
+}
+
+bool hid_pipeline_is_ready(void) {
+    return active != HID_SINK_NONE && sink_ready(&queues[active]);
+}
+
+/* keys は hid_pipeline_build_keys() が消費側から読むので、書き換えはロック内で行う */
+void hid_pipeline_set_keys(const uint8_t *nkro) {
+    uint32_t state = port_lock();
+    memcpy(keys, nkro, NKRO_REPORT_SIZE);
+    port_unlock(state);
+    if (active != HID_SINK_NONE) queue_keyboard(&queues[active], keys);
+}
+
+void hid_pipeline_release_keys(void) {
+    uint32_t state = port_lock();
+    memset(keys, 0, sizeof(keys));
+    port_unlock(state);
+    if (active != HID_SINK_NONE) queue_keyboard(&queues[active], keys);
+}
+
+uint8_t hid_pipeline_build_keys(bool boot, uint8_t *buf) {
+    uint8_t nkro[NKRO_REPORT_SIZE];
+    uint32_t state = port_lock();
+    memcpy(nkro, keys, sizeof(nkro));
+    port_unlock(state);
+
+    if (boot) {
+        build_boot(buf, nkro);
+        return BOOT_REPORT_SIZE;
+    }
+    buf[0] = HID_REPORT_ID_KEYBOARD;
+    memcpy(buf + 1, nkro, NKRO_REPORT_SIZE);
+    return 1 + NKRO_REPORT_SIZE;
+}
+
+void hid_pipeline_add_mouse(uint8_t buttons, int8_t dx, int8_t dy, int8_t wheel, int8_t pan) {
+    if (active == HID_SINK_NONE) return;
+    sink_queue_t *q = &queues[active];
+    if (!sink_ready(q)) return;
+    /* Boot Protocol ではマウス無効 */
+    if (q->sink->wants_boot && q->sink->wants_boot(q->sink->ctx)) return;
+    uint32_t now = port_now();
+
+    uint32_t state = port_lock();
+    uint8_t *tail = (q->mouse_count > 0)
+        ? q->mouse[ring_index(q->mouse_head, q->mouse_count - 1)].data : NULL;
+    uint8_t prev = (q->mouse_count > 1)
+        ? q->mouse[ring_index(q->mouse_head, q->mouse_count - 2)].data[1] : q->mouse_sent;
+    bool coalesced = tail && (((tail[1] ^ prev) & (buttons ^ tail[1])) == 0 ||
+                              q->mouse_count == HID_PIPELINE_DEPTH);
+    if (coalesced) {
+        /* 未送信フレームに移動量を加算 (保留中に届いたサンプルを失わない)。
+         * ボタンは末尾での変化を打ち消さない場合 (一杯のときは常に) 上書きする */
+        tail[1] = buttons;
+        tail[2] = (uint8_t)add_clamped((int8_t)tail[2], dx);
+        tail[3] = (uint8_t)add_clamped((int8_t)tail[3], dy);
+        tail[4] = (uint8_t)add_clamped((int8_t)tail[4], wheel);
+        tail[5] = (uint8_t)add_clamped((int8_t)tail[5], pan);
+    } else {
+        /* 末尾で押した/離したボタンが戻った: 前のフレーム (クリックと移動量) はそのまま送る */
+        mouse_frame_t *f = &q->mouse[ring_index(q->mouse_head, q->mouse_count)];
+        f->data[0] = HID_REPORT_ID_MOUSE;
+        f->data[1] = buttons;
+        f->data[2] = (uint8_t)dx;
+        f->data[3] = (uint8_t)dy;
+        f->data[4] = (uint8_t)wheel;
+        f->data[5] = (uint8_t)pan;
+        f->post_us = now;
+        q->mouse_count++;
+    }
+    q->stats.queued++;
+    if (coalesced) q->stats.coalesced++;
+    port_unlock(state);
+
+    port_queued(coalesced);
+    sink_notify(q);
+}
+
+bool hid_pipeline_peek(int sink, uint8_t mask, hid_frame_t *frame) {
+    if (!valid_sink(sink)) return false;
+    const sink_queue_t *q = &queues[sink];
+
+    if ((mask & HID_FRAME_MASK_KEYBOARD) && q->kb_count > 0) {
+        const kb_frame_t *f = &q->kb[q->kb_head];
+        if (f->is_boot) {
+            frame->kind = HID_FRAME_BOOT_KEYBOARD;
+            frame->data = f->boot;
+            frame->len = sizeof(f->boot);
+        } else {
+            frame->kind = HID_FRAME_KEYBOARD;
+            frame->data = f->kb;
+            frame->len = sizeof(f->kb);
+        }
+        frame->post_us = f->post_us;
+        return true;
+    }
+    if ((mask & HID_FRAME_MASK_MOUSE) && q->mouse_count > 0) {
+        const mouse_frame_t *f = &q->mouse[q->mouse_head];
+        frame->kind = HID_FRAME_MOUSE;
+        frame->data = f->data;
+        frame->len = sizeof(f->data);
+        frame->post_us = f->post_us;
+        return true;
+    }
+    return false;
+}
+
+void hid_pipeline_consume(int sink, hid_frame_kind_t kind) {
+    if (!valid_sink(sink)) return;
+    sink_queue_t *q = &queues[sink];
+
+    if (kind == HID_FRAME_MOUSE) {
+        if (q->mouse_count == 0) return;
+        q->mouse_sent = q->mouse[q->mouse_head].data[1];
+        q->mouse_head = ring_index(q->mouse_head, 1);
+        q->mouse_count--;
+    } else {
+        if (q->kb_count == 0) return;
+        memcpy(q->kb_sent, q->kb[q->kb_head].kb + 1, NKRO_REPORT_SIZE);
+        q->kb_head = ring_index(q->kb_head, 1);
+        q->kb_count--;
+    }
+    q->stats.sent++;
+}
+
+void hid_pipeline_discard(int sink, uint8_t mask) {
+    if (!valid_sink(sink)) return;
+    sink_queue_t *q = &queues[sink];
+
+    uint32_t state = port_lock();
+    if (mask & HID_FRAME_MASK_KEYBOARD) {
+        q->stats.dropped += q->kb_count;
+        q->kb_count = 0;
+        /* 捨てた後はホスト側の状態が分からないため、次の状態は上書きせず積む */
+        memset(q->kb_sent, 0, sizeof(q->kb_sent));
+    }
+    if (mask & HID_FRAME_MASK_MOUSE) {
+        q->stats.dropped += q->mouse_count;
+        q->mouse_count = 0;
+        q->mouse_sent = 0;
+    }
+    port_unlock(state);
+}
+
+bool hid_pipeline_has_pending(int sink, uint8_t mask) {
+    if (!valid_sink(sink)) return false;
+    const sink_queue_t *q = &queues[sink];
+    return ((mask & HID_FRAME_MASK_KEYBOARD) && q->kb_count > 0) ||
+           ((mask & HID_FRAME_MASK_MOUSE) && q->mouse_count > 0);
+}
+
+bool hid_pipeline_is_idle(void) {
+    for (int i = 0; i < sink_count; i++) {
+        if (queues[i].kb_count > 0 || queues[i].mouse_count > 0) return false;
+    }
+    return true;
+}
+
+void hid_pipeline_get_stats(int sink, hid_pipeline_stats_t *stats, bool reset) {
+    if (!valid_sink(sink)) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    uint32_t state = port_lock();
+    *stats = queues[sink].stats;
+    if (reset) memset(&queues[sink].stats, 0, sizeof(queues[sink].stats));
+    port_unlock(state);
+}
+
+const char *hid_pipeline_sink_name(int sink) {
+    return valid_sink(sink) ? queues[sink].sink->name : "?";
+}
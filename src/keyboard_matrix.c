@@ -7,11 +7,31 @@
  *   - 列ピン(内部プルアップ)を読み取り
  *   - LOWなら押下、HIGHなら開放
  *
- * デバウンス: キー単位のタイマー方式 (DEBOUNCE_MS 間安定で確定)
+ * デバウンス: キー単位のタイマー方式 (デバウンス時間の間安定で確定)
+ *   - 固定: 全キー CFG_DEBOUNCE_MS (既定 DEBOUNCE_MS)
+ *   - 適応 (CFG_DEBOUNCE_ADAPT): キーごとのデバウンス時間を CFG_DEBOUNCE_MS から始めて
+ *     [DEBOUNCE_ADAPT_MIN_MS, DEBOUNCE_ADAPT_MAX_MS] の範囲で調整する
+ *       延長: バウンス中のエッジが (デバウンス時間 - 余裕) を超えたらその場で延長。
+ *             前回の確定から DEBOUNCE_CHATTER_MS 未満で確定したら (チャタリング) 2倍にする
+ *       短縮: DEBOUNCE_ADAPT_EPOCH サンプルごとに、バウンス時間の 99% 点 + 余裕 へ半分ずつ近づける
+ *   - どちらのモードでもバウンス時間のヒストグラムは記録する (RAM のみ, 再起動で初期化)
+ *   - 確定の順序: 他のキーで先に始まった変化 (デバウンスタイマーの開始が早いもの) が
+ *     まだ確定できない間は、デバウンス時間を満たしたキーも確定を待つ。キーごとに
+ *     デバウンス時間が違っても、確定は変化の始まった順になる (Shift を離してから文字キーを
+ *     押したのに、文字の押下が先に届いて大文字になることがない)。固定モードでは
+ *     先に始まった変化が先に満了するので待つことはない
+ *
+ * 起床待ち (matrix_wake_arm):
+ *   - 全行を同時にLOWに駆動し、列ピンのLOWレベル割り込みを有効化
+ *   - どのキーを押しても列がLOWになり割り込みが入る (スキャン不要)
+ *   - 割り込みで全列の割り込みを無効化して行をHIGHに戻し、コールバックを呼ぶ
  */
 
 #include "keyboard_matrix.h"
+#include "config_store.h"
+#include "perf.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
 #include "pico/time.h"
 #include <string.h>
 
@@ -32,9 +52,151 @@ static bool debounced_matrix[MATRIX_ROWS][MATRIX_COLS];
 /* キー毎のデバウンスタイマー (変化検出時刻, 0=非アクティブ) */
 static uint32_t debounce_timer[MATRIX_ROWS][MATRIX_COLS];
 
+/* このスキャンでデバウンス時間を満たしたキー (確定の順序判定用) */
+static bool debounce_due[MATRIX_ROWS][MATRIX_COLS];
+
+/* キー毎の適応デバウンス状態と統計 */
+typedef struct {
+    uint32_t bounce_start;               /* バウンス最初のエッジ時刻 */
+    uint32_t last_edge;                  /* 最後のエッジ時刻 */
+    uint32_t last_commit;                /* 前回の確定時刻 (0=なし) */
+    uint32_t samples;
+    uint16_t hist[DEBOUNCE_HIST_BINS];
+    uint16_t chatter;
+    uint8_t  epoch;                      /* 前回の短縮判断からのサンプル数 */
+    uint8_t  window_ms;                  /* このキーのデバウンス時間 */
+    bool     bouncing;
+} key_adapt_t;
+
+static key_adapt_t key_adapt[MATRIX_ROWS][MATRIX_COLS];
+
+/* ビン b はバウンス時間 bin_limit_ms[b-1] 以上 bin_limit_ms[b] 未満 (最後のビンは上限なし) */
+static const uint8_t bin_limit_ms[DEBOUNCE_HIST_BINS - 1] = {1, 2, 3, 4, 6, 8, 12};
+
+/* key_adapt の window_ms を決めたときの設定値 (変わったら全キーを初期化) */
+static uint32_t adapt_base_ms;
+static bool adapt_enabled;
+static bool adapt_valid = false;
+
 /* 状態変化フラグ (matrix_scan()でセット、matrix_has_changed()でクリア) */
 static bool state_changed;
 
+/* 起床待ち (割り込みと共有) */
+static volatile bool wake_armed = false;
+static matrix_wake_cb_t wake_cb = NULL;
+static uint32_t row_mask = 0;
+static uint32_t col_mask = 0;
+
+static void wake_disable_irqs(void) {
+    for (int c = 0; c < MATRIX_COLS; c++) {
+        gpio_set_irq_enabled(col_pins[c], GPIO_IRQ_LEVEL_LOW, false);
+    }
+}
+
+static void matrix_wake_irq_handler(void) {
+    bool fired = false;
+    for (int c = 0; c < MATRIX_COLS; c++) {
+        if (gpio_get_irq_event_mask(col_pins[c]) & GPIO_IRQ_LEVEL_LOW) fired = true;
+    }
+    if (!fired || !wake_armed) return;
+
+    /* レベル割り込みは押下中ずっと入るため、最初の1回で無効化する */
+    wake_disable_irqs();
+    gpio_set_mask(row_mask);
+    wake_armed = false;
+    if (wake_cb) wake_cb();
+}
+
+/* ============================================================
+ * 適応デバウンス
+ * ============================================================ */
+
+static uint32_t adapt_max_ms(void) {
+    return adapt_base_ms > DEBOUNCE_ADAPT_MAX_MS ? adapt_base_ms : DEBOUNCE_ADAPT_MAX_MS;
+}
+
+static void adapt_set_window(key_adapt_t *k, uint32_t ms) {
+    if (!adapt_enabled) return;
+    if (ms < DEBOUNCE_ADAPT_MIN_MS) ms = DEBOUNCE_ADAPT_MIN_MS;
+    if (ms > adapt_max_ms()) ms = adapt_max_ms();
+    k->window_ms = (uint8_t)ms;
+}
+
+static void adapt_reset_windows(void) {
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            key_adapt[r][c].window_ms = (uint8_t)adapt_base_ms;
+            key_adapt[r][c].epoch = 0;
+            adapt_set_window(&key_adapt[r][c], adapt_base_ms);
+        }
+    }
+}
+
+/* 99% のバウンスが収まる時間 + 余裕 に向けて短縮 (延長はエッジとチャタリングで行う) */
+static void adapt_shorten(key_adapt_t *k) {
+    uint32_t total = 0;
+    for (int b = 0; b < DEBOUNCE_HIST_BINS; b++) total += k->hist[b];
+    uint32_t need = total - total / 100;
+
+    uint32_t cum = 0;
+    int bin = 0;
+    for (; bin < DEBOUNCE_HIST_BINS - 1; bin++) {
+        cum += k->hist[bin];
+        if (cum >= need) break;
+    }
+    uint32_t target = (bin < DEBOUNCE_HIST_BINS - 1)
+        ? (uint32_t)bin_limit_ms[bin] + DEBOUNCE_ADAPT_MARGIN_MS : adapt_max_ms();
+    if (target >= k->window_ms) return;
+
+    uint32_t step = (k->window_ms - target) / 2;
+    adapt_set_window(k, k->window_ms - (step ? step : 1));
+}
+
+static void adapt_record_bounce(key_adapt_t *k, uint32_t bounce_ms) {
+    int bin = 0;
+    while (bin < DEBOUNCE_HIST_BINS - 1 && bounce_ms >= bin_limit_ms[bin]) bin++;
+
+    uint32_t total = 0;
+    for (int b = 0; b < DEBOUNCE_HIST_BINS; b++) total += k->hist[b];
+    if (total >= DEBOUNCE_HIST_AGE) {
+        for (int b = 0; b < DEBOUNCE_HIST_BINS; b++) k->hist[b] /= 2;
+    }
+    k->hist[bin]++;
+    k->samples++;
+
+    if (++k->epoch >= DEBOUNCE_ADAPT_EPOCH) {
+        k->epoch = 0;
+        adapt_shorten(k);
+    }
+}
+
+/* 生値のエッジからバウンス時間を測る (確定判定の後に呼ぶ) */
+static void adapt_track(key_adapt_t *k, bool edge, uint32_t now) {
+    if (edge) {
+        if (!k->bouncing) {
+            k->bouncing = true;
+            k->bounce_start = now;
+        }
+        k->last_edge = now;
+        /* 長いバウンスは収まるのを待たずに延長 (誤確定の前に間に合わせる) */
+        uint32_t span = now - k->bounce_start + DEBOUNCE_ADAPT_MARGIN_MS;
+        if (span > k->window_ms) adapt_set_window(k, span);
+    } else if (k->bouncing && (now - k->last_edge) >= DEBOUNCE_QUIET_MS) {
+        k->bouncing = false;
+        adapt_record_bounce(k, k->last_edge - k->bounce_start);
+    }
+}
+
+static void adapt_on_commit(key_adapt_t *k, uint32_t now) {
+    if (k->last_commit != 0 && (now - k->last_commit) < DEBOUNCE_CHATTER_MS) {
+        if (k->chatter < UINT16_MAX) k->chatter++;
+        k->epoch = 0;   /* 直後の短縮を見送る */
+        perf_count(PERF_CNT_DEBOUNCE_CHATTER);
+        adapt_set_window(k, (uint32_t)k->window_ms * 2);
+    }
+    k->last_commit = now;
+}
+
 void matrix_init(void) {
     /* 行ピンを出力に設定、初期状態HIGH (非アクティブ) */
     for (int r = 0; r < MATRIX_ROWS; r++) {
@@ -50,14 +212,37 @@ void matrix_init(void) {
         gpio_pull_up(col_pins[c]);
     }
 
+    row_mask = 0;
+    col_mask = 0;
+    for (int r = 0; r < MATRIX_ROWS; r++) row_mask |= 1u << row_pins[r];
+    for (int c = 0; c < MATRIX_COLS; c++) col_mask |= 1u << col_pins[c];
+    gpio_add_raw_irq_handler_masked(col_mask, matrix_wake_irq_handler);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
     memset(raw_matrix, 0, sizeof(raw_matrix));
     memset(debounced_matrix, 0, sizeof(debounced_matrix));
     memset(debounce_timer, 0, sizeof(debounce_timer));
+    memset(debounce_due, 0, sizeof(debounce_due));
+    memset(key_adapt, 0, sizeof(key_adapt));
+    adapt_valid = false;   /* 最初のスキャンで設定値から初期化 */
     state_changed = false;
 }
 
 void matrix_scan(void) {
     uint32_t now = to_ms_since_boot(get_absolute_time());
+    uint32_t debounce_ms = config_get(CFG_DEBOUNCE_MS);
+    bool adaptive = config_get(CFG_DEBOUNCE_ADAPT) != 0;
+
+    /* 設定が変わったら学習したデバウンス時間を捨てる (統計は残す) */
+    if (!adapt_valid || debounce_ms != adapt_base_ms || adaptive != adapt_enabled) {
+        adapt_base_ms = debounce_ms;
+        adapt_enabled = adaptive;
+        adapt_valid = true;
+        adapt_reset_windows();
+    }
+
+    /* 起床待ちのまま呼ばれた場合は通常スキャンに戻す */
+    if (wake_armed) matrix_wake_disarm();
 
     for (int r = 0; r < MATRIX_ROWS; r++) {
         /* この行をLOWに駆動 */
@@ -69,27 +254,58 @@ void matrix_scan(void) {
         /* 全列を読み取り */
         for (int c = 0; c < MATRIX_COLS; c++) {
             bool pressed = !gpio_get(col_pins[c]);  /* LOW=押下 */
+            bool edge = pressed != raw_matrix[r][c];
             raw_matrix[r][c] = pressed;
 
+            key_adapt_t *k = &key_adapt[r][c];
+            uint32_t window = adapt_enabled ? k->window_ms : debounce_ms;
+
+            debounce_due[r][c] = false;
             if (raw_matrix[r][c] != debounced_matrix[r][c]) {
                 if (debounce_timer[r][c] == 0) {
                     /* デバウンスタイマー開始 */
                     debounce_timer[r][c] = now;
-                } else if ((now - debounce_timer[r][c]) >= DEBOUNCE_MS) {
-                    /* デバウンス期間経過 → 新状態を確定 */
-                    debounced_matrix[r][c] = raw_matrix[r][c];
-                    debounce_timer[r][c] = 0;
-                    state_changed = true;
+                } else if ((now - debounce_timer[r][c]) >= window) {
+                    /* デバウンス期間経過 → 確定候補 (確定は全キーを読んだ後) */
+                    debounce_due[r][c] = true;
                 }
             } else {
                 /* 生値とデバウンス値が一致 → タイマーリセット */
                 debounce_timer[r][c] = 0;
             }
+
+            adapt_track(k, edge, now);
         }
 
         /* 行をHIGHに復帰 (非アクティブ) */
         gpio_put(row_pins[r], 1);
     }
+
+    /* 満了していない変化のうち最も早く始まったもの。それより後に始まった変化は待たせる */
+    uint32_t oldest_age = 0;
+    bool waiting = false;
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (debounce_timer[r][c] == 0 || debounce_due[r][c]) continue;
+            uint32_t age = now - debounce_timer[r][c];
+            if (!waiting || age > oldest_age) oldest_age = age;
+            waiting = true;
+        }
+    }
+
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (!debounce_due[r][c]) continue;
+            if (waiting && (now - debounce_timer[r][c]) < oldest_age) continue;
+
+            /* デバウンス期間経過 → 新状態を確定 */
+            debounced_matrix[r][c] = raw_matrix[r][c];
+            debounce_timer[r][c] = 0;
+            state_changed = true;
+            perf_count(PERF_CNT_DEBOUNCE_COMMITS);
+            adapt_on_commit(&key_adapt[r][c], now);
+        }
+    }
 }
 
 bool matrix_has_changed(void) {
@@ -167,6 +383,15 @@ bool matrix_key_is_pressed(uint8_t row, uint8_t col) {
     return debounced_matrix[row][col];
 }
 
+bool matrix_any_key_pressed(void) {
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (debounced_matrix[r][c]) return true;
+        }
+    }
+    return false;
+}
+
 bool matrix_fn_is_pressed(void) {
     /* Fnキーの位置をマトリクス全体から検索 */
     for (int r = 0; r < MATRIX_ROWS; r++) {
@@ -194,3 +419,70 @@ int8_t matrix_get_fn_slot_action(void) {
     }
     return -1;
 }
+
+bool matrix_fn_combo_is_pressed(uint8_t keycode) {
+    if (!matrix_fn_is_pressed()) return false;
+
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (debounced_matrix[r][c] && keymap_get_keycode(r, c) == keycode) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool matrix_get_debounce_stats(uint8_t row, uint8_t col, matrix_debounce_stats_t *stats) {
+    if (row >= MATRIX_ROWS || col >= MATRIX_COLS) return false;
+    const key_adapt_t *k = &key_adapt[row][col];
+    stats->window_ms = k->window_ms;
+    memcpy(stats->hist, k->hist, sizeof(stats->hist));
+    stats->chatter = k->chatter;
+    stats->samples = k->samples;
+    return true;
+}
+
+void matrix_reset_debounce_stats(void) {
+    memset(key_adapt, 0, sizeof(key_adapt));
+    if (adapt_valid) adapt_reset_windows();
+}
+
+uint8_t matrix_debounce_bin_limit_ms(uint8_t bin) {
+    return (bin < DEBOUNCE_HIST_BINS - 1) ? bin_limit_ms[bin] : 0;
+}
+
+bool matrix_wake_arm(matrix_wake_cb_t cb) {
+    /* 全行LOW: 押されたキーの列がLOWになる */
+    gpio_clr_mask(row_mask);
+    busy_wait_us(10);
+
+    /* 既に押されている (デバウンス途中を含む) なら起床待ちにしない */
+    if ((gpio_get_all() & col_mask) != col_mask) {
+        gpio_set_mask(row_mask);
+        return false;
+    }
+
+    wake_cb = cb;
+    wake_armed = true;
+    for (int c = 0; c < MATRIX_COLS; c++) {
+        gpio_set_irq_enabled(col_pins[c], GPIO_IRQ_LEVEL_LOW, true);
+    }
+    return true;
+}
+
+void matrix_wake_disarm(void) {
+    wake_disable_irqs();
+    wake_armed = false;
+    gpio_set_mask(row_mask);
+}
+
+bool matrix_wake_is_armed(void) {
+    return wake_armed;
+}
+
+void matrix_wake_set_dormant(bool enable) {
+    for (int c = 0; c < MATRIX_COLS; c++) {
+        gpio_set_dormant_irq_enabled(col_pins[c], GPIO_IRQ_LEVEL_LOW, enable);
+    }
+}
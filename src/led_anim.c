@@ -0,0 +1,169 @@
+/**
+ * @file led_anim.c
+ * @brief LED アニメーション実装
+ *
+ * LEDごとに再生中シーケンスの開始時刻を持ち、tick 時点の経過時間から
+ * 現在のキーフレームを求める (途中の tick が遅れても位置がずれない)。
+ * 色は 8bit 固定小数点で計算し、前回送った色と比較して変化時のみ送信する。
+ */
+
+#include "led_anim.h"
+#include "ws2812_led.h"
+
+#include <string.h>
+
+/* ============================================================
+ * 定義済みシーケンス
+ * ============================================================ */
+static const led_keyframe_t blink_frames[] = {
+    { 255, 0, 150 },
+    {   0, 0, 150 },
+};
+const led_sequence_t LED_SEQ_BLINK = { blink_frames, 2 };
+
+static const led_keyframe_t pulse_frames[] = {
+    {  16, 1, 500 },
+    { 255, 1, 500 },
+};
+const led_sequence_t LED_SEQ_PULSE = { pulse_frames, 2 };
+
+static const led_keyframe_t battery_warn_frames[] = {
+    { 255, 0, 100 },
+    {   0, 0, 100 },
+    { 255, 0, 100 },
+    {   0, 0, 1700 },
+};
+const led_sequence_t LED_SEQ_BATTERY_WARN = { battery_warn_frames, 4 };
+
+static const led_keyframe_t pairing_frames[] = {
+    { 255, 0, 100 },
+    {   0, 0, 100 },
+};
+const led_sequence_t LED_SEQ_PAIRING = { pairing_frames, 2 };
+
+/* ============================================================
+ * 再生状態
+ * ============================================================ */
+typedef struct {
+    uint8_t  base[3];              /* ベース色 (R, G, B) */
+    const led_sequence_t *seq;     /* 再生中シーケンス (NULL=なし) */
+    uint8_t  color[3];             /* 再生色 */
+    uint8_t  repeat;               /* 繰り返し回数 (0=無限) */
+    bool     start_pending;        /* 次の tick を開始時刻にする */
+    uint32_t start_ms;             /* 再生開始時刻 */
+    uint32_t cycle_ms;             /* 1周の長さ */
+    uint8_t  shown[3];             /* 最後に送信した色 */
+} led_channel_t;
+
+static led_channel_t channels[WS2812_NUM_LEDS];
+static bool force_show = false;
+
+static uint8_t scale8(uint8_t c, uint8_t level) {
+    return (uint8_t)(((uint16_t)c * (level + 1)) >> 8);
+}
+
+/* 1周内の位置 t (ms) における明るさ */
+static uint8_t sequence_level(const led_sequence_t *seq, uint32_t t) {
+    for (uint8_t i = 0; i < seq->count; i++) {
+        const led_keyframe_t *kf = &seq->frames[i];
+        if (t < kf->duration_ms) {
+            if (!kf->fade) return kf->level;
+            const led_keyframe_t *next = &seq->frames[(i + 1) % seq->count];
+            int32_t delta = (int32_t)next->level - (int32_t)kf->level;
+            return (uint8_t)((int32_t)kf->level + delta * (int32_t)t / kf->duration_ms);
+        }
+        t -= kf->duration_ms;
+    }
+    return seq->frames[seq->count - 1].level;
+}
+
+void led_anim_init(void) {
+    memset(channels, 0, sizeof(channels));
+    force_show = true;
+}
+
+void led_anim_set_base(uint16_t led, uint8_t r, uint8_t g, uint8_t b) {
+    if (led >= WS2812_NUM_LEDS) return;
+    channels[led].base[0] = r;
+    channels[led].base[1] = g;
+    channels[led].base[2] = b;
+}
+
+void led_anim_play(uint16_t led, const led_sequence_t *seq,
+                   uint8_t r, uint8_t g, uint8_t b, uint8_t repeat) {
+    if (led >= WS2812_NUM_LEDS || !seq || seq->count == 0) return;
+
+    led_channel_t *ch = &channels[led];
+    uint32_t cycle = 0;
+    for (uint8_t i = 0; i < seq->count; i++) {
+        cycle += seq->frames[i].duration_ms;
+    }
+    if (cycle == 0) return;
+
+    ch->seq = seq;
+    ch->color[0] = r;
+    ch->color[1] = g;
+    ch->color[2] = b;
+    ch->repeat = repeat;
+    ch->cycle_ms = cycle;
+    ch->start_pending = true;
+}
+
+void led_anim_stop(uint16_t led) {
+    if (led >= WS2812_NUM_LEDS) return;
+    channels[led].seq = NULL;
+}
+
+bool led_anim_is_playing(uint16_t led, const led_sequence_t *seq) {
+    if (led >= WS2812_NUM_LEDS || channels[led].seq == NULL) return false;
+    return seq == NULL || channels[led].seq == seq;
+}
+
+bool led_anim_any_playing(void) {
+    for (uint16_t i = 0; i < WS2812_NUM_LEDS; i++) {
+        if (channels[i].seq != NULL) return true;
+    }
+    return false;
+}
+
+void led_anim_tick(uint32_t now_ms) {
+    bool changed = force_show;
+    force_show = false;
+
+    for (uint16_t i = 0; i < WS2812_NUM_LEDS; i++) {
+        led_channel_t *ch = &channels[i];
+        uint8_t rgb[3];
+
+        if (ch->seq && ch->start_pending) {
+            ch->start_ms = now_ms;
+            ch->start_pending = false;
+        }
+
+        if (ch->seq) {
+            uint32_t elapsed = now_ms - ch->start_ms;
+            if (ch->repeat != LED_ANIM_REPEAT_FOREVER &&
+                elapsed >= ch->cycle_ms * ch->repeat) {
+                /* 再生終了 → ベース色へ */
+                ch->seq = NULL;
+            } else {
+                uint8_t level = sequence_level(ch->seq, elapsed % ch->cycle_ms);
+                for (int c = 0; c < 3; c++) rgb[c] = scale8(ch->color[c], level);
+            }
+        }
+        if (!ch->seq) {
+            memcpy(rgb, ch->base, 3);
+        }
+
+        if (memcmp(rgb, ch->shown, 3) != 0) {
+            memcpy(ch->shown, rgb, 3);
+            changed = true;
+        }
+    }
+
+    if (!changed) return;
+
+    for (uint16_t i = 0; i < WS2812_NUM_LEDS; i++) {
+        ws2812_set_pixel(i, channels[i].shown[0], channels[i].shown[1], channels[i].shown[2]);
+    }
+    ws2812_show();
+}
@@ -2,14 +2,24 @@
  * @file main.c
  * @brief JP106 BLE キーボード+トラックボール - メインプログラム
  *
- * メインループ:
- *   1. BLEイベントポーリング
- *   2. マトリクススキャン
- *   3. Fnレイヤー処理 (デバイススロット切替: Fn+1/2/3)
- *   4. キーボードHIDレポート送信
- *   5. トラックボール読み取り + マウスレポート送信
- *   6. バッテリー監視
- *   7. LED更新
+ * メインループはデッドラインスケジューラ (scheduler.c) のタスクとして構成する:
+ *   ble       : BLEイベントポーリング (ポーリングビルドのみ)
+ *   matrix    : マトリクススキャン + Fnレイヤー処理 (スロット切替: Fn+1/2/3,
+ *               スループット計測: Fn+T, ポインタ加速カーブ切替: Fn+P) + キーボードレポート送信
+ *   trackball : トラックボール読み取り + ポインタ加速 (Fn押下中はスクロール) + マウスレポート送信
+ *               (読み取り完了の割り込みで起動, 周期実行は取りこぼし対策)
+ *   battery   : バッテリー監視 (CFG_BATTERY_CHECK_INTERVAL_MS 周期)
+ *   led       : LED更新 (オンボードLED + スロットLEDアニメーション)
+ *   service   : USB シリアルコンソール + VBUS 確認 + 保留中の Flash 書込み (入力と送信待ちが無いときのみ)
+ * 実行するタスクが無い間は次のリリース時刻まで WFE で待つ。
+ *
+ * HID トランスポート: USB ホストにエニュメレーションされている間 (usb_hid_is_active()) は
+ * 入力レポートを USB HID (1kHz) に送り、それ以外は BLE に送る。レポートは hid_pipeline に積み、
+ * 各トランスポートはそのシンクとして送信する。切替時は旧トランスポートに全キー解放を送り、
+ * 新トランスポートに現在のキー状態を送り直す (hid_pipeline_set_active)。
+ *
+ * 省電力 (power_mgr.c): 入力が途切れるとマトリクススキャンを止めてキー割り込み待ちにし、
+ * LED/サービスタスクの周期を延ばす。未接続のまま長時間入力がなければ DORMANT に入る。
  */
 
 #include <stdio.h>
@@ -17,13 +27,25 @@
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
 #include "hardware/adc.h"
+#include "hardware/sync.h"
 
 #include "project_config.h"
 #include "keyboard_matrix.h"
 #include "hid_keycodes.h"
+#include "hid_pipeline.h"
 #include "ble_hid.h"
+#include "usb_hid.h"
 #include "device_slot.h"
 #include "trackball.h"
+#include "pointer_accel.h"
+#include "led_anim.h"
+#include "flash_log.h"
+#include "config_store.h"
+#include "console.h"
+#include "scheduler.h"
+#include "power_mgr.h"
+#include "perf.h"
+#include "trace.h"
 
 /**
  * バッテリーレベル読み取り (GP28/ADC2, 分圧回路経由)
@@ -37,7 +59,324 @@ static uint8_t read_battery_level(void) {
     return (uint8_t)((vbat - 3.0f) / 1.2f * 100.0f);
 }
 
+/* ============================================================
+ * タスク間で共有する状態
+ * ============================================================ */
+static bool trackball_available = false;
+static pointer_accel_t accel;
+static uint32_t last_input_ms = 0;  /* 最後のキー/トラックボール操作 (Flash コミット判定) */
+static bool usb_transport = false;  /* 入力レポートを USB HID に送っている */
+static int ble_sink = HID_SINK_NONE;
+static int usb_sink = HID_SINK_NONE;
+
+static int task_matrix = -1;
+static int task_trackball = -1;
+static int task_battery = -1;
+static int task_led = -1;
+static int task_service = -1;
+
+/* 省電力中は LED/サービスタスクの周期を延ばす */
+static inline uint32_t low_rate_period(uint32_t active_period_us) {
+    return (power_mgr_get_state() == POWER_ACTIVE) ? active_period_us
+                                                   : POWER_LOW_TASK_PERIOD_US;
+}
+
+static inline uint32_t to_ms(uint64_t now_us) {
+    return (uint32_t)(now_us / 1000);
+}
+
+/* ============================================================
+ * HID パイプラインのプラットフォーム依存部
+ * (消費側は BTstack/TinyUSB の割り込み内で動くので割り込み禁止で排他する)
+ * ============================================================ */
+static void pipeline_on_queued(bool coalesced) {
+    perf_count(PERF_CNT_REPORTS_QUEUED);
+    if (coalesced) perf_count(PERF_CNT_REPORTS_COALESCED);
+}
+
+static const hid_pipeline_port_t pipeline_port = {
+    .lock      = save_and_disable_interrupts,
+    .unlock    = restore_interrupts,
+    .now_us    = time_us_32,
+    .on_queued = pipeline_on_queued,
+};
+
+/* ============================================================
+ * ble: BTstack ポーリング (ポーリングビルドのみ登録)
+ * ============================================================ */
+#if !BLE_BACKGROUND_SERVICING
+static void ble_task(uint64_t now_us) {
+    (void)now_us;
+    ble_hid_poll();
+}
+#endif
+
+/* ============================================================
+ * matrix: スキャン + Fn レイヤー + キーボードレポート
+ * ============================================================ */
+static void matrix_task(uint64_t now_us) {
+    static uint8_t hid_report[NKRO_REPORT_SIZE];
+    static int8_t prev_fn_slot = -1;    /* Fn+数字の重複実行防止 */
+    static bool prev_fn_test = false;   /* Fn+T の重複実行防止 */
+    static bool prev_fn_curve = false;  /* Fn+P の重複実行防止 */
+    static bool prev_test_active = false;
+
+    static uint64_t prev_scan_us = 0;
+
+    /* キー割り込みによる起床 / 入力なしでの省電力移行 */
+    power_mgr_update(now_us);
+    if (power_mgr_get_state() != POWER_ACTIVE) {
+        prev_scan_us = 0;
+        return;
+    }
+
+    /* スキャン間隔の周期からのずれ (省電力からの再開直後は除く) */
+    if (prev_scan_us != 0) {
+        int32_t diff = (int32_t)(now_us - prev_scan_us) - SCHED_MATRIX_PERIOD_US;
+        perf_add_time(PERF_TIME_SCAN_JITTER, (uint32_t)(diff < 0 ? -diff : diff));
+    }
+    prev_scan_us = now_us;
+
+    matrix_scan();
+    bool keys_changed = matrix_has_changed();
+    if (keys_changed) {
+        last_input_ms = to_ms(now_us);
+        power_mgr_note_input(now_us);
+    }
+
+    /* HID トランスポート切替 (USB 接続/切断・サスペンド) */
+    bool usb = usb_hid_is_active();
+    if (usb != usb_transport) {
+        TRACE(HID_TRANSPORT, usb_transport, usb);
+        usb_transport = usb;
+        hid_pipeline_set_active(usb ? usb_sink : ble_sink);
+    }
+
+    /* Fnレイヤー: デバイススロット切替 (Fn+1/2/3) */
+    int8_t fn_slot = matrix_get_fn_slot_action();
+    if (fn_slot >= 0 && fn_slot != prev_fn_slot) {
+        uint8_t current = device_slot_get_active();
+        if ((uint8_t)fn_slot != current) {
+            TRACE(SLOT_SWITCH, current, fn_slot);
+            device_slot_switch(fn_slot);
+            ble_hid_switch_slot(current);
+            pointer_accel_set_curve(&accel, device_slot_get_pointer_curve(fn_slot));
+            device_slot_blink_led(fn_slot, fn_slot + 1);
+        }
+    }
+    prev_fn_slot = fn_slot;
+
+    /* Fn+T: BLE スループット計測 (結果はシリアルログ + リンク情報) */
+    bool fn_test = matrix_fn_combo_is_pressed(KEY_T);
+    if (fn_test && !prev_fn_test) {
+        if (ble_hid_throughput_test_start(BLE_THROUGHPUT_TEST_MS) && trackball_available) {
+            /* 計測区間のサンプリング統計を取るためリセット */
+            trackball_sample_stats_t tb_stats;
+            trackball_get_sample_stats(&tb_stats, true);
+        }
+    }
+    prev_fn_test = fn_test;
+
+    /* 計測終了時: トラックボールのサンプリング統計も出力 */
+    bool test_active = ble_hid_throughput_test_is_active();
+    if (prev_test_active && !test_active && trackball_available) {
+        trackball_sample_stats_t tb_stats;
+        trackball_get_sample_stats(&tb_stats, true);
+        TRACE(TB_SAMPLE_STATS, tb_stats.interval_us, tb_stats.samples, tb_stats.skipped);
+        TRACE(TB_SAMPLE_JITTER,
+              tb_stats.samples ? tb_stats.jitter_total_us / tb_stats.samples : 0,
+              tb_stats.jitter_max_us);
+    }
+    prev_test_active = test_active;
+
+    /* Fn+P: ポインタ加速カーブ切替 (アクティブスロットごとに保存) */
+    bool fn_curve = matrix_fn_combo_is_pressed(KEY_P);
+    if (fn_curve && !prev_fn_curve) {
+        uint8_t slot = device_slot_get_active();
+        uint8_t curve = (device_slot_get_pointer_curve(slot) + 1) % POINTER_CURVE_COUNT;
+        device_slot_set_pointer_curve(slot, curve);
+        pointer_accel_set_curve(&accel, curve);
+        TRACE(POINTER_CURVE, slot, curve);
+    }
+    prev_fn_curve = fn_curve;
+
+    /* キーボードHIDレポート送信 (Fn押下中はキー入力を抑制) */
+    if (keys_changed && !matrix_fn_is_pressed()) {
+        /* Boot Protocol のホストにはパイプラインが 6KRO 形式に変換して送る */
+        matrix_build_nkro_report(hid_report);
+        hid_pipeline_set_keys(hid_report);
+        if (hid_pipeline_is_ready()) {
+            power_mgr_note_report(now_us);
+        } else {
+            /* 未接続時: デバッグ用にトレースへ記録 */
+            uint8_t debug_report[BOOT_REPORT_SIZE];
+            matrix_build_boot_report(debug_report);
+            if (debug_report[0] != 0 || debug_report[2] != 0) {
+                TRACE(KEY_DEBUG, debug_report[0],
+                      ((uint32_t)debug_report[2] << 24) | ((uint32_t)debug_report[3] << 16) |
+                      ((uint32_t)debug_report[4] << 8) | debug_report[5],
+                      ((uint32_t)debug_report[6] << 8) | debug_report[7]);
+            }
+        }
+    }
+}
+
+/* ============================================================
+ * trackball: デルタ取得 + 加速/スクロール + マウスレポート
+ *
+ * 読み取りは接続イベントの BLE_PRE_ANCHOR_SAMPLE_US 前に発行されるので、完了したら
+ * すぐにマウスレポートへ積まないと BLE_PRE_ANCHOR_SEND_US の送信に間に合わない。
+ * タスク自身の周期 (と位相) に任せず、完了割り込みから sched_trigger() で起こす。
+ * ============================================================ */
+static void on_trackball_sample(void) {
+    sched_trigger(task_trackball);
+}
+
+static void trackball_task(uint64_t now_us) {
+    static trackball_state_t tb_state;
+    static bool prev_tb_button = false;
+    static pointer_scroll_t scroll;
+    static bool prev_scroll_mode = false;
+
+    /* サンプリング周期を接続間隔に追従 (送信できる頻度以上に読まない, USB は 1ms) */
+    uint32_t conn_us = ble_hid_get_conn_interval_us();
+    uint32_t interval = usb_transport ? TRACKBALL_POLL_INTERVAL_US
+                      : conn_us       ? conn_us / TRACKBALL_SAMPLES_PER_CONN_EVENT
+                                      : TRACKBALL_IDLE_INTERVAL_US;
+    /* 省電力中は動き出しの検出だけできればよい */
+    if (power_mgr_get_state() != POWER_ACTIVE) interval = TRACKBALL_IDLE_INTERVAL_US;
+    if (interval < TRACKBALL_POLL_INTERVAL_US) interval = TRACKBALL_POLL_INTERVAL_US;
+    trackball_set_sample_interval(interval);
+
+    /* 読み取りの1回を接続イベント直前に合わせる */
+    uint32_t anchor_us;
+    if (!usb_transport && ble_hid_get_next_anchor(&anchor_us)) {
+        trackball_align_sample_phase(anchor_us - BLE_PRE_ANCHOR_SAMPLE_US);
+    }
+
+    trackball_read(&tb_state);
+
+    /* Fn押下中はスクロールモード (モード切替時に持ち越しを破棄) */
+    bool scroll_mode = matrix_fn_is_pressed();
+    if (scroll_mode != prev_scroll_mode) {
+        pointer_scroll_reset(&scroll);
+        pointer_accel_set_curve(&accel, accel.curve);
+        prev_scroll_mode = scroll_mode;
+    }
+
+    bool moved = (tb_state.delta_x != 0 || tb_state.delta_y != 0 ||
+                  (!scroll_mode && pointer_accel_pending(&accel)));
+    if (moved || tb_state.button != prev_tb_button) {
+        last_input_ms = to_ms(now_us);
+        power_mgr_note_input(now_us);
+    }
+    if ((moved || tb_state.button != prev_tb_button) && hid_pipeline_is_ready()) {
+        uint8_t buttons = tb_state.button ? MOUSE_BTN_LEFT : 0;
+        int8_t dx = 0, dy = 0, wheel = 0, pan = 0;
+        bool has_motion;
+        if (scroll_mode) {
+            /* 1ノッチ分たまったときだけホイール出力 */
+            has_motion = pointer_scroll_apply(&scroll, tb_state.delta_x,
+                                              tb_state.delta_y, &wheel, &pan);
+        } else {
+            /* 加速カーブ適用 (端数・超過分は次回へ持ち越し) */
+            pointer_accel_set_sensitivity(&accel, config_get(CFG_TRACKBALL_SENSITIVITY));
+            has_motion = pointer_accel_apply(&accel, tb_state.delta_x,
+                                             tb_state.delta_y, &dx, &dy);
+        }
+        if (has_motion || tb_state.button != prev_tb_button) {
+            hid_pipeline_add_mouse(buttons, dx, dy, wheel, pan);
+            power_mgr_note_report(now_us);
+        }
+        prev_tb_button = tb_state.button;
+    }
+}
+
+/* ============================================================
+ * battery: バッテリーレベル定期更新
+ * ============================================================ */
+static void battery_task(uint64_t now_us) {
+    (void)now_us;
+    uint8_t level = read_battery_level();
+    ble_hid_update_battery(level);
+    if (level <= BATTERY_WARN_LEVEL) {
+        device_slot_show_battery_warning();
+    }
+    /* 監視間隔は実行時に変更できる */
+    sched_set_period(task_battery, config_get(CFG_BATTERY_CHECK_INTERVAL_MS) * 1000);
+}
+
+/* ============================================================
+ * led: オンボードLED (BLE接続状態) + スロットLEDアニメーション
+ * ============================================================ */
+static void led_task(uint64_t now_us) {
+    static int onboard_led = -1;   /* 最後に出力した状態 (変化時のみ書込み) */
+    uint32_t now = to_ms(now_us);
+
+    /* ACTIVE: 接続中は点灯 / 未接続は 500ms 点滅
+     * IDLE: 消灯, ADVERTISING: POWER_ADV_BLINK_MS ごとに1周期だけ点灯 */
+    bool connected = hid_pipeline_is_ready();
+    int led_state;
+    switch (power_mgr_get_state()) {
+        case POWER_ACTIVE:
+            led_state = connected ? 1 : (((now / 500) % 2) == 0);
+            break;
+        case POWER_ADVERTISING:
+            led_state = (now % POWER_ADV_BLINK_MS) < (POWER_LOW_TASK_PERIOD_US / 1000);
+            break;
+        default:
+            led_state = 0;
+            break;
+    }
+    if (led_state != onboard_led) {
+        cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
+        onboard_led = led_state;
+    }
+
+    /* スロットLED: 未ペアリングスロットの接続待ちは速い点滅 */
+    uint8_t active = device_slot_get_active();
+    device_slot_set_pairing_indicator(!connected && !device_slot_get_info(active)->paired);
+    led_anim_tick(now);
+
+    /* アニメーション再生中は省電力中でも滑らかに */
+    sched_set_period(task_led, led_anim_any_playing() ? SCHED_LED_PERIOD_US
+                                                      : low_rate_period(SCHED_LED_PERIOD_US));
+}
+
+/* ============================================================
+ * service: シリアルコンソール + 保留中の Flash 書込み
+ * ============================================================ */
+static void service_task(uint64_t now_us) {
+    uint32_t now = to_ms(now_us);
+
+    /* 省電力ステート (割り込み待ち中の DORMANT 移行判定) */
+    power_mgr_update(now_us);
+    sched_set_period(task_service, low_rate_period(SCHED_SERVICE_PERIOD_US));
+
+    /* USB シリアルコンソール */
+    console_poll();
+
+    /* VBUS (USB 給電) の確認 */
+    usb_hid_update(now);
+
+    /* トレースの連続出力 (trace on のとき) */
+    trace_poll();
+
+    /* 保留中の Flash 書込み: 入力が途切れ、送信待ちも無いときだけ実行 */
+    if (flash_log_has_pending() &&
+        (now - last_input_ms) >= FLASH_COMMIT_IDLE_MS &&
+        !matrix_any_key_pressed() && hid_pipeline_is_idle() && ble_hid_is_tx_idle()) {
+        device_slot_commit_storage();
+        flash_log_stats_t fs;
+        flash_log_get_stats(&fs);
+        TRACE(FLASH_COMMIT, fs.commit_last_us, fs.commit_max_us, fs.commits,
+              now - last_input_ms);
+    }
+}
+
 int main(void) {
+    /* TinyUSB (CDC + HID) を先に初期化し、stdio はその CDC を使う */
+    usb_hid_init();
     stdio_init_all();
 
     /* ADC初期化 (バッテリー監視) */
@@ -47,116 +386,67 @@ int main(void) {
     /* マトリクスGPIO初期化 */
     matrix_init();
 
-    /* デバイススロット初期化 (Flash読込 + WS2812B LED初期化) */
-    device_slot_init();
-
     /* トラックボール初期化 (I2C, オプショナル) */
-    bool trackball_available = trackball_init();
+    trackball_available = trackball_init();
     if (trackball_available) {
         /* トラックボールLED: 控えめな白色点灯 */
         trackball_set_led(0, 0, 0, 16);
     }
 
-    /* BLE HID 初期化 (アドバタイジング開始) */
+    /* BLE HID 初期化 (Flash ストア初期化とスロット表読込を含む, HCI 起動後にアドバタイジング開始) */
     ble_hid_init();
 
-    /* 起動表示: オンボードLED + スロットLED */
-    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-    sleep_ms(200);
-    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
+    /* HID パイプライン: BLE/USB をシンクとして登録し、まず BLE へ送る */
+    hid_pipeline_init(&pipeline_port);
+    ble_sink = ble_hid_attach_pipeline();
+    usb_sink = usb_hid_attach_pipeline();
+    hid_pipeline_set_active(ble_sink);
+
+    /* 設定値ストア (flash_log 上) */
+    config_init();
+
+    /* デバイススロット LED 初期化 (スロット表は ble_hid_init() で読込済み) */
+    device_slot_init();
+
+    /* 起動表示: スロットLED点滅 (LED タスクで再生) */
     device_slot_blink_led(device_slot_get_active(),
                           device_slot_get_active() + 1);
 
+    pointer_accel_init(&accel, device_slot_get_pointer_curve(device_slot_get_active()));
+
     DEBUG_PRINT("JP106 BLE Keyboard started (slot %d, trackball=%s)",
                 device_slot_get_active(),
                 trackball_available ? "yes" : "no");
 
-    uint8_t hid_report[NKRO_REPORT_SIZE];
-    uint32_t last_battery_check = 0;
-    int8_t prev_fn_slot = -1;  /* Fn+数字の重複実行防止 */
-    trackball_state_t tb_state;
+    /* ============================================================
+     * タスク登録 (周期, 相対デッドライン)
+     * ============================================================ */
+#if !BLE_BACKGROUND_SERVICING
+    sched_add_task("ble", ble_task, SCHED_BLE_PERIOD_US, SCHED_BLE_PERIOD_US);
+#endif
+    task_matrix = sched_add_task("matrix", matrix_task, SCHED_MATRIX_PERIOD_US,
+                                 SCHED_MATRIX_DEADLINE_US);
+    if (trackball_available) {
+        /* 通常はサンプル完了で起動する。周期実行は間隔の追従と持ち越しの出し切り用 */
+        task_trackball = sched_add_task("trackball", trackball_task,
+                                        TRACKBALL_IDLE_INTERVAL_US, SCHED_TRACKBALL_DEADLINE_US);
+        trackball_set_sample_callback(on_trackball_sample);
+    }
+    task_battery = sched_add_task("battery", battery_task,
+                                  config_get(CFG_BATTERY_CHECK_INTERVAL_MS) * 1000,
+                                  SCHED_BATTERY_DEADLINE_US);
+    task_led = sched_add_task("led", led_task, SCHED_LED_PERIOD_US, SCHED_LED_PERIOD_US);
+    task_service = sched_add_task("service", service_task, SCHED_SERVICE_PERIOD_US,
+                                  SCHED_SERVICE_PERIOD_US);
+
+    /* 省電力ステート管理 (DORMANT からの起床ならレイテンシ計測を開始) */
+    power_mgr_init(task_matrix);
 
     /* ============================================================
      * メインループ
      * ============================================================ */
     while (true) {
-        /* 1. BLEイベント処理 (CYW43ポーリング) */
-        ble_hid_poll();
-
-        /* 2. マトリクススキャン */
-        matrix_scan();
-
-        /* 3. Fnレイヤー: デバイススロット切替 (Fn+1/2/3) */
-        int8_t fn_slot = matrix_get_fn_slot_action();
-        if (fn_slot >= 0 && fn_slot != prev_fn_slot) {
-            uint8_t current = device_slot_get_active();
-            if ((uint8_t)fn_slot != current) {
-                DEBUG_PRINT("Slot switch: %d -> %d", current, fn_slot);
-                ble_hid_disconnect_and_readvertise();
-                device_slot_switch(fn_slot);
-                device_slot_blink_led(fn_slot, fn_slot + 1);
-            }
-        }
-        prev_fn_slot = fn_slot;
-
-        /* 4. キーボードHIDレポート送信 (Fn押下中はキー入力を抑制) */
-        if (matrix_has_changed() && !matrix_fn_is_pressed()) {
-            if (ble_hid_is_connected()) {
-                if (ble_hid_get_protocol_mode() == 0) {
-                    uint8_t boot_report[BOOT_REPORT_SIZE];
-                    matrix_build_boot_report(boot_report);
-                    ble_hid_send_report(boot_report, BOOT_REPORT_SIZE);
-                } else {
-                    matrix_build_nkro_report(hid_report);
-                    ble_hid_send_report(hid_report, NKRO_REPORT_SIZE);
-                }
-            } else {
-                /* 未接続時: デバッグ出力 */
-                uint8_t debug_report[BOOT_REPORT_SIZE];
-                matrix_build_boot_report(debug_report);
-                if (debug_report[0] != 0 || debug_report[2] != 0) {
-                    DEBUG_PRINT("Key: mod=0x%02X keys=[0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X]",
-                                debug_report[0],
-                                debug_report[2], debug_report[3], debug_report[4],
-                                debug_report[5], debug_report[6], debug_report[7]);
-                }
-            }
-        }
-
-        /* 5. トラックボール読み取り + マウスレポート送信 */
-        if (trackball_available) {
-            trackball_read(&tb_state);
-            if (tb_state.changed && ble_hid_is_connected()) {
-                uint8_t buttons = tb_state.button ? MOUSE_BTN_LEFT : 0;
-                /* int16_tで計算してint8_t範囲にクランプ (オーバーフロー防止) */
-                int16_t dx_raw = (int16_t)tb_state.delta_x * TRACKBALL_SENSITIVITY;
-                int16_t dy_raw = (int16_t)tb_state.delta_y * TRACKBALL_SENSITIVITY;
-                if (dx_raw > 127) dx_raw = 127;
-                if (dx_raw < -127) dx_raw = -127;
-                if (dy_raw > 127) dy_raw = 127;
-                if (dy_raw < -127) dy_raw = -127;
-                ble_hid_send_mouse_report(buttons, (int8_t)dx_raw, (int8_t)dy_raw, 0);
-            }
-        }
-
-        /* 6. バッテリーレベル定期更新 */
-        uint32_t now = to_ms_since_boot(get_absolute_time());
-        if ((now - last_battery_check) >= BATTERY_CHECK_INTERVAL_MS) {
-            last_battery_check = now;
-            uint8_t level = read_battery_level();
-            ble_hid_update_battery(level);
-        }
-
-        /* 7. オンボードLED (BLE接続状態) */
-        if (ble_hid_is_connected()) {
-            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 1);
-        } else {
-            bool led_state = ((now / 500) % 2) == 0;
-            cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_state);
-        }
-
-        /* 8. スキャンレート制御 (~1kHz) */
-        sleep_us(500);
+        sched_run_tick();
     }
 
     return 0;
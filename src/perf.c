@@ -0,0 +1,69 @@
+/**
+ * @file perf.c
+ * @brief 実行時パフォーマンスカウンタ実装
+ */
+
+#include "perf.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+static perf_snapshot_t perf;
+static uint64_t reset_at_us = 0;
+
+static const char *const counter_names[PERF_CNT_COUNT] = {
+    [PERF_CNT_LOOP_TICKS]        = "loop_ticks",
+    [PERF_CNT_DEBOUNCE_COMMITS]  = "debounce_commits",
+    [PERF_CNT_REPORTS_QUEUED]    = "reports_queued",
+    [PERF_CNT_REPORTS_SENT]      = "reports_sent",
+    [PERF_CNT_REPORTS_COALESCED] = "reports_coalesced",
+    [PERF_CNT_I2C_ERRORS]        = "i2c_errors",
+    [PERF_CNT_RECONNECTS]        = "reconnects",
+    [PERF_CNT_USB_REPORTS_SENT]  = "usb_reports_sent",
+    [PERF_CNT_DEBOUNCE_CHATTER]  = "debounce_chatter",
+};
+
+static const char *const timer_names[PERF_TIME_COUNT] = {
+    [PERF_TIME_LOOP]          = "loop",
+    [PERF_TIME_SCAN_JITTER]   = "scan_jitter",
+    [PERF_TIME_CAN_SEND_WAIT] = "can_send_wait",
+    [PERF_TIME_FLASH_COMMIT]  = "flash_commit",
+};
+
+void perf_count(perf_counter_t counter) {
+    if (counter >= PERF_CNT_COUNT) return;
+    __atomic_fetch_add(&perf.counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+void perf_add_time(perf_timer_t timer, uint32_t us) {
+    if (timer >= PERF_TIME_COUNT) return;
+
+    uint32_t irq = save_and_disable_interrupts();
+    perf_time_stat_t *t = &perf.times[timer];
+    t->count++;
+    t->total_us += us;
+    if (us > t->max_us) t->max_us = us;
+    restore_interrupts(irq);
+}
+
+void perf_snapshot(perf_snapshot_t *snap, bool reset) {
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t now = time_us_64();
+    *snap = perf;
+    snap->elapsed_ms = (uint32_t)((now - reset_at_us) / 1000);
+    if (reset) {
+        memset(&perf, 0, sizeof(perf));
+        reset_at_us = now;
+    }
+    restore_interrupts(irq);
+}
+
+const char *perf_counter_name(perf_counter_t counter) {
+    return (counter < PERF_CNT_COUNT) ? counter_names[counter] : "?";
+}
+
+const char *perf_timer_name(perf_timer_t timer) {
+    return (timer < PERF_TIME_COUNT) ? timer_names[timer] : "?";
+}
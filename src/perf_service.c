@@ -0,0 +1,98 @@
+/**
+ * @file perf_service.c
+ * @brief 実行時カウンタ ベンダー GATT サービス実装
+ *
+ * BTstack の battery_service_server と同じく、GATT データベース (hog_keyboard.gatt) から
+ * UUID でハンドル範囲を引いて att_service_handler を登録する。
+ * 値は読み出しの先頭 (オフセット0) でスナップショットを取り、
+ * 続きの Read Blob には同じスナップショットを返す (途中でリセットされない)。
+ */
+
+#include "perf_service.h"
+#include "perf.h"
+#include "project_config.h"
+
+#include "btstack.h"
+
+/* UUID (ビッグエンディアン表記順) */
+static const uint8_t service_uuid[16] = {
+    0x4A, 0x50, 0x31, 0x30, 0x36, 0x50, 0x45, 0x52,
+    0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+};
+static const uint8_t value_uuid[16] = {
+    0x4A, 0x50, 0x31, 0x30, 0x36, 0x50, 0x45, 0x52,
+    0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+};
+
+#define IMAGE_SIZE  (4 + 4 + PERF_CNT_COUNT * 4 + PERF_TIME_COUNT * 16)
+
+static att_service_handler_t service;
+static uint16_t value_handle = 0;
+static bool reset_on_read = false;
+static uint8_t image[IMAGE_SIZE];
+
+static void build_image(void) {
+    perf_snapshot_t snap;
+    perf_snapshot(&snap, reset_on_read);
+
+    uint8_t *p = image;
+    *p++ = PERF_SERVICE_VERSION;
+    *p++ = PERF_CNT_COUNT;
+    *p++ = PERF_TIME_COUNT;
+    *p++ = reset_on_read ? 1 : 0;
+    little_endian_store_32(p, 0, snap.elapsed_ms);
+    p += 4;
+    for (int i = 0; i < PERF_CNT_COUNT; i++) {
+        little_endian_store_32(p, 0, snap.counters[i]);
+        p += 4;
+    }
+    for (int i = 0; i < PERF_TIME_COUNT; i++) {
+        const perf_time_stat_t *t = &snap.times[i];
+        little_endian_store_32(p, 0, t->count);
+        little_endian_store_32(p, 4, t->max_us);
+        little_endian_store_32(p, 8, (uint32_t)t->total_us);
+        little_endian_store_32(p, 12, (uint32_t)(t->total_us >> 32));
+        p += 16;
+    }
+}
+
+static uint16_t perf_read_callback(hci_con_handle_t con_handle, uint16_t attribute_handle,
+                                   uint16_t offset, uint8_t *buffer, uint16_t buffer_size) {
+    UNUSED(con_handle);
+    if (attribute_handle != value_handle) return 0;
+
+    /* buffer == NULL は長さの問い合わせ (スナップショットは取らない) */
+    if (buffer && offset == 0) build_image();
+    return att_read_callback_handle_blob(image, sizeof(image), offset, buffer, buffer_size);
+}
+
+static int perf_write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle,
+                               uint16_t transaction_mode, uint16_t offset,
+                               uint8_t *buffer, uint16_t buffer_size) {
+    UNUSED(con_handle);
+    UNUSED(offset);
+    if (attribute_handle != value_handle) return 0;
+    if (transaction_mode != ATT_TRANSACTION_MODE_NONE) return 0;
+    if (buffer_size != 1 || buffer[0] > 1) return ATT_ERROR_VALUE_NOT_ALLOWED;
+
+    reset_on_read = buffer[0] != 0;
+    return 0;
+}
+
+void perf_service_init(void) {
+    uint16_t start_handle = 0;
+    uint16_t end_handle = 0xFFFF;
+    if (!gatt_server_get_handle_range_for_service_with_uuid128(service_uuid,
+                                                               &start_handle, &end_handle)) {
+        DEBUG_PRINT("Perf service: not in GATT database");
+        return;
+    }
+    value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(
+        start_handle, end_handle, value_uuid);
+
+    service.start_handle = start_handle;
+    service.end_handle = end_handle;
+    service.read_callback = &perf_read_callback;
+    service.write_callback = &perf_write_callback;
+    att_server_register_service_handler(&service);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file pointer_accel.c
+ * @brief ポインタ加速実装
+ *
+ * 速度 = サンプルデルタの大きさの近似値 max(|dx|,|dy|) + min(|dx|,|dy|)/2
+ * (カウント/サンプル, ACCEL_LUT_SIZE-1 で飽和)。
+ * 速度でゲインテーブル (Q8) を引き、感度倍率 (既定 TRACKBALL_SENSITIVITY) を掛けて適用する。
+ *
+ *   out = (d * gain * SENSITIVITY + rem) >> 8
+ *   rem = 残り (Q8)
+ *
+ * 端数は下位8ビットとして次回へ持ち越し、向きが反転したら捨てる
+ * (逆方向に1カウント余計に動くのを防ぐ)。
+ * ±127 を超えた分も持ち越し、ACCEL_MAX_CARRY で頭打ちにする。
+ *
+ * スクロールモードは加速を通さず、カウントを TRACKBALL_SCROLL_DIVIDER で
+ * ノッチ単位に割る。端数は同様に持ち越す。
+ */
+
+#include "pointer_accel.h"
+#include "project_config.h"
+
+#define ACCEL_LUT_SIZE   16
+#define ACCEL_ONE        256                  /* Q8 の 1.0 */
+#define ACCEL_MAX_CARRY  (127 * ACCEL_ONE)    /* 持ち越し上限 (1レポート分) */
+
+/* 速度 (カウント/サンプル) → ゲイン (Q8) */
+static const uint16_t accel_lut[POINTER_CURVE_COUNT][ACCEL_LUT_SIZE] = {
+    [POINTER_CURVE_LINEAR] = {
+        256, 256, 256, 256, 256, 256, 256, 256,
+        256, 256, 256, 256, 256, 256, 256, 256,
+    },
+    [POINTER_CURVE_MILD] = {
+        256, 256, 256, 272, 296, 320, 352, 384,
+        416, 448, 480, 512, 544, 576, 608, 640,
+    },
+    [POINTER_CURVE_STRONG] = {
+        128, 128, 160, 208, 256, 320, 400, 480,
+        560, 640, 720, 800, 880, 960, 1024, 1088,
+    },
+};
+
+static const char *const curve_names[POINTER_CURVE_COUNT] = {
+    "linear", "mild", "strong",
+};
+
+static inline int32_t abs32(int32_t v) {
+    return (v < 0) ? -v : v;
+}
+
+/**
+ * 1軸分の変換 (端数・超過分は *rem に持ち越し)
+ */
+static int8_t apply_axis(int32_t d, int32_t gain, int32_t *rem) {
+    /* 向きが反転したら持ち越しを捨てる */
+    if ((d > 0 && *rem < 0) || (d < 0 && *rem > 0)) {
+        *rem = 0;
+    }
+
+    int32_t v = d * gain + *rem;
+    /* 0方向への切り捨て: 端数は同じ符号のまま残る */
+    int32_t out = (v >= 0) ? (v >> 8) : -((-v) >> 8);
+    if (out > 127)  out = 127;
+    if (out < -127) out = -127;
+
+    int32_t carry = v - out * ACCEL_ONE;
+    if (carry > ACCEL_MAX_CARRY)  carry = ACCEL_MAX_CARRY;
+    if (carry < -ACCEL_MAX_CARRY) carry = -ACCEL_MAX_CARRY;
+    *rem = carry;
+
+    return (int8_t)out;
+}
+
+void pointer_accel_init(pointer_accel_t *accel, uint8_t curve) {
+    accel->rem_x = 0;
+    accel->rem_y = 0;
+    accel->curve = (curve < POINTER_CURVE_COUNT) ? curve : POINTER_CURVE_DEFAULT;
+    accel->sensitivity = TRACKBALL_SENSITIVITY;
+}
+
+void pointer_accel_set_curve(pointer_accel_t *accel, uint8_t curve) {
+    uint8_t sensitivity = accel->sensitivity;
+    pointer_accel_init(accel, curve);
+    accel->sensitivity = sensitivity;
+}
+
+void pointer_accel_set_sensitivity(pointer_accel_t *accel, uint8_t sensitivity) {
+    accel->sensitivity = sensitivity ? sensitivity : 1;
+}
+
+bool pointer_accel_apply(pointer_accel_t *accel, int16_t dx, int16_t dy,
+                         int8_t *out_x, int8_t *out_y) {
+    int32_t ax = abs32(dx);
+    int32_t ay = abs32(dy);
+    int32_t speed = (ax > ay) ? (ax + ay / 2) : (ay + ax / 2);
+    if (speed >= ACCEL_LUT_SIZE) speed = ACCEL_LUT_SIZE - 1;
+
+    int32_t gain = accel_lut[accel->curve][speed] * accel->sensitivity;
+
+    *out_x = apply_axis(dx, gain, &accel->rem_x);
+    *out_y = apply_axis(dy, gain, &accel->rem_y);
+    return (*out_x != 0 || *out_y != 0);
+}
+
+bool pointer_accel_pending(const pointer_accel_t *accel) {
+    return abs32(accel->rem_x) >= ACCEL_ONE || abs32(accel->rem_y) >= ACCEL_ONE;
+}
+
+void pointer_scroll_reset(pointer_scroll_t *scroll) {
+    scroll->acc_v = 0;
+    scroll->acc_h = 0;
+}
+
+/* 累積値からノッチ単位を取り出す (0方向へ切り捨て, 端数は残す) */
+static int8_t take_detents(int32_t *acc) {
+    int32_t n = *acc / TRACKBALL_SCROLL_DIVIDER;
+    if (n > 127)  n = 127;
+    if (n < -127) n = -127;
+    *acc -= n * TRACKBALL_SCROLL_DIVIDER;
+    return (int8_t)n;
+}
+
+bool pointer_scroll_apply(pointer_scroll_t *scroll, int16_t dx, int16_t dy,
+                          int8_t *wheel, int8_t *pan) {
+    if (abs32(dy) >= abs32(dx)) {
+        /* 向きが反転したら端数を捨てる */
+        if ((dy < 0 && scroll->acc_v < 0) || (dy > 0 && scroll->acc_v > 0)) {
+            scroll->acc_v = 0;
+        }
+        scroll->acc_v -= dy;   /* ボールを上へ (dy<0) → ホイール正 */
+    } else {
+        if ((dx > 0 && scroll->acc_h < 0) || (dx < 0 && scroll->acc_h > 0)) {
+            scroll->acc_h = 0;
+        }
+        scroll->acc_h += dx;
+    }
+
+    *wheel = take_detents(&scroll->acc_v);
+    *pan = take_detents(&scroll->acc_h);
+    return (*wheel != 0 || *pan != 0);
+}
+
+const char *pointer_accel_curve_name(uint8_t curve) {
+    return (curve < POINTER_CURVE_COUNT) ? curve_names[curve] : "?";
+}
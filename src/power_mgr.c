@@ -0,0 +1,269 @@
+/**
+ * @file power_mgr.c
+ * @brief 省電力ステート管理実装
+ *
+ * ACTIVE 以外のステートではマトリクスタスクを周期実行から外し
+ * (matrix_wake_arm() で全行LOW + 列のLOWレベル割り込み)、
+ * 割り込みでタスクを即時実行させてから ACTIVE に戻す。
+ * 起床時刻は割り込み内で記録し、レイテンシの始点にする。
+ *
+ * DORMANT は clk_ref/clk_sys を XOSC に切り替えて PLL を止めてから
+ * XOSC を DORMANT にする。起床後は CYW43 と BTstack を初期化し直す必要があるため
+ * ウォッチドッグで再起動し、watchdog scratch に残した印で DORMANT 起床を判別する。
+ */
+
+#include "power_mgr.h"
+#include "project_config.h"
+#include "keyboard_matrix.h"
+#include "scheduler.h"
+#include "ble_hid.h"
+#include "usb_hid.h"
+#include "device_slot.h"
+#include "flash_log.h"
+#include "trackball.h"
+#include "ws2812_led.h"
+#include "trace.h"
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/xosc.h"
+#include "hardware/watchdog.h"
+#include "hardware/gpio.h"
+
+/* watchdog scratch[0]: DORMANT からの再起動の印 ('DORM') */
+#define DORMANT_SCRATCH  0
+#define DORMANT_MAGIC    0x444F524Du
+
+static power_state_t state = POWER_ACTIVE;
+static int matrix_task = -1;
+static uint64_t state_since_us = 0;
+static uint64_t last_input_us = 0;
+static uint64_t last_connected_us = 0;
+
+/* 起床割り込み (割り込みと共有) */
+static volatile bool wake_irq = false;
+static volatile uint64_t wake_irq_us = 0;
+
+/* 起床レイテンシ計測 */
+static bool wake_measuring = false;
+static power_state_t wake_from = POWER_ACTIVE;
+static uint64_t wake_at_us = 0;
+
+static power_state_stats_t stats[POWER_STATE_COUNT];
+
+static void on_matrix_wake(void) {
+    wake_irq_us = time_us_64();
+    wake_irq = true;
+    sched_trigger(matrix_task);
+}
+
+static void finish_wake_measure(uint64_t now_us) {
+    if (!wake_measuring) return;
+    wake_measuring = false;
+
+    power_state_stats_t *st = &stats[wake_from];
+    uint32_t us = (uint32_t)(now_us - wake_at_us);
+    st->wakes++;
+    st->wake_last_us = us;
+    st->wake_total_us += us;
+    if (us > st->wake_max_us) st->wake_max_us = us;
+    TRACE(POWER_WAKE, wake_from, us);
+}
+
+static void set_state(power_state_t next, uint64_t now_us) {
+    if (next == state) return;
+
+    stats[state].residency_ms += (uint32_t)((now_us - state_since_us) / 1000);
+    stats[next].entries++;
+    TRACE(POWER_STATE, state, next);
+
+    if (next == POWER_ACTIVE) {
+        matrix_wake_disarm();
+        sched_set_period(matrix_task, SCHED_MATRIX_PERIOD_US);
+    } else if (state == POWER_ACTIVE) {
+        /* 起床待ちは呼出し側で開始済み。スキャンは割り込みまで止める */
+        sched_set_period(matrix_task, 0);
+        /* IDLE からの起床で何も送らずに戻ってきた計測は捨てる
+         * (未接続ステートからの計測は接続確立まで続ける) */
+        if (wake_from == POWER_IDLE) wake_measuring = false;
+    }
+    state = next;
+    state_since_us = now_us;
+}
+
+/*
+ * DORMANT に入る (戻らない)。保留中の Flash 書込みを済ませ、LED・無線・PLL を止めて
+ * XOSC を停止する。キー (または INT) の LOW で起床したら再起動し、power_mgr_init() が
+ * watchdog の scratch から DORMANT 明けと判断する。
+ */
+static void __attribute__((noreturn)) enter_dormant(void) {
+    TRACE(POWER_STATE, state, POWER_DORMANT);
+
+    /* 保留中の設定/ボンド情報を書いておく */
+    if (flash_log_has_pending()) device_slot_commit_storage();
+
+    /* LED 消灯 */
+    ws2812_clear();
+    ws2812_show();
+    while (ws2812_is_busy()) tight_loop_contents();
+    if (trackball_is_connected()) {
+        trackball_set_led(0, 0, 0, 0);
+        busy_wait_ms(2);   /* 非同期 I2C 書込みの完了待ち */
+    }
+    cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, 0);
+
+    /* 無線停止 (WL_REG_ON を落とす) */
+    cyw43_arch_deinit();
+
+    /* 起床要因: 任意のキー (+ トラックボール INT) */
+    if (!matrix_wake_arm(NULL)) watchdog_reboot(0, 0, 0);
+    matrix_wake_set_dormant(true);
+#if TRACKBALL_INT_PIN >= 0
+    gpio_set_dormant_irq_enabled(TRACKBALL_INT_PIN, GPIO_IRQ_LEVEL_LOW, true);
+#endif
+
+    watchdog_hw->scratch[DORMANT_SCRATCH] = DORMANT_MAGIC;
+    stdio_flush();
+
+    /* クロックを XOSC 直結にして PLL を止める */
+    clock_configure(clk_ref, CLOCKS_CLK_REF_CTRL_SRC_VALUE_XOSC_CLKSRC, 0,
+                    XOSC_HZ, XOSC_HZ);
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0,
+                    XOSC_HZ, XOSC_HZ);
+    clock_stop(clk_usb);
+    clock_stop(clk_adc);
+    pll_deinit(pll_sys);
+    pll_deinit(pll_usb);
+
+    /* GPIO の LOW レベルで XOSC が再開するまで停止 */
+    xosc_dormant();
+
+    /* 起床: 全体を初期化し直す */
+    watchdog_reboot(0, 0, 0);
+    while (true) tight_loop_contents();
+}
+
+void power_mgr_init(int task) {
+    uint64_t now = time_us_64();
+    matrix_task = task;
+    state = POWER_ACTIVE;
+    state_since_us = now;
+    last_input_us = now;
+    last_connected_us = now;
+    stats[POWER_ACTIVE].entries++;
+
+    if (watchdog_hw->scratch[DORMANT_SCRATCH] == DORMANT_MAGIC) {
+        watchdog_hw->scratch[DORMANT_SCRATCH] = 0;
+        /* 起床 = 再起動。起動からの時間をレイテンシとする */
+        stats[POWER_DORMANT].entries++;
+        wake_measuring = true;
+        wake_from = POWER_DORMANT;
+        wake_at_us = 0;
+        DEBUG_PRINT("Power: resumed from dormant");
+    }
+}
+
+void power_mgr_update(uint64_t now_us) {
+    /* USB HID で送信中も「接続中」として扱う (DORMANT に入らない) */
+    bool connected = ble_hid_is_connected() || usb_hid_is_active();
+    if (connected) last_connected_us = now_us;
+
+    /* キー押下による起床 */
+    if (wake_irq) {
+        wake_irq = false;
+        wake_measuring = true;
+        wake_from = state;
+        wake_at_us = wake_irq_us;
+        last_input_us = now_us;
+        set_state(POWER_ACTIVE, now_us);
+        return;
+    }
+
+    /* 未接続ステートからの起床は接続確立 (送信可能) で計測終了 */
+    if (wake_measuring && wake_from != POWER_IDLE && connected) {
+        finish_wake_measure(now_us);
+    }
+
+    switch (state) {
+        case POWER_ACTIVE:
+            if ((now_us - last_input_us) >= (uint64_t)POWER_IDLE_TIMEOUT_MS * 1000 &&
+                !matrix_any_key_pressed() &&
+                matrix_wake_arm(on_matrix_wake)) {
+                set_state(connected ? POWER_IDLE : POWER_ADVERTISING, now_us);
+            }
+            break;
+
+        case POWER_IDLE:
+            if (!connected) set_state(POWER_ADVERTISING, now_us);
+            break;
+
+        case POWER_ADVERTISING: {
+            if (connected) {
+                set_state(POWER_IDLE, now_us);
+                break;
+            }
+            uint64_t since = (last_input_us > last_connected_us) ? last_input_us
+                                                                 : last_connected_us;
+            /* USB 給電中は入らない (DORMANT にすると USB シリアルも止まるため) */
+            if ((now_us - since) >= (uint64_t)POWER_DORMANT_TIMEOUT_MS * 1000 &&
+                !usb_hid_vbus_present()) {
+                matrix_wake_disarm();
+                enter_dormant();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void power_mgr_note_input(uint64_t now_us) {
+    last_input_us = now_us;
+    /* トラックボールなど割り込み以外の起床 */
+    if (state != POWER_ACTIVE) {
+        wake_measuring = true;
+        wake_from = state;
+        wake_at_us = now_us;
+        set_state(POWER_ACTIVE, now_us);
+    }
+}
+
+void power_mgr_note_report(uint64_t now_us) {
+    if (wake_measuring && wake_from == POWER_IDLE) finish_wake_measure(now_us);
+}
+
+power_state_t power_mgr_get_state(void) {
+    return state;
+}
+
+const char *power_mgr_state_name(power_state_t s) {
+    switch (s) {
+        case POWER_ACTIVE:      return "active";
+        case POWER_IDLE:        return "idle";
+        case POWER_ADVERTISING: return "advertising";
+        case POWER_DORMANT:     return "dormant";
+        default:                return "?";
+    }
+}
+
+void power_mgr_get_stats(power_state_t s, power_state_stats_t *out, bool reset) {
+    if (s >= POWER_STATE_COUNT) return;
+    uint64_t now = time_us_64();
+
+    *out = stats[s];
+    if (s == state) out->residency_ms += (uint32_t)((now - state_since_us) / 1000);
+
+    if (reset) {
+        power_state_stats_t *st = &stats[s];
+        st->entries = 0;
+        st->residency_ms = 0;
+        st->wakes = 0;
+        st->wake_last_us = 0;
+        st->wake_max_us = 0;
+        st->wake_total_us = 0;
+        if (s == state) state_since_us = now;
+    }
+}
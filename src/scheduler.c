@@ -0,0 +1,157 @@
+/**
+ * @file scheduler.c
+ * @brief 協調型デッドラインスケジューラ実装
+ *
+ * 各タスクは次のリリース時刻を持ち、実行後は「リリース時刻 + 周期」へ進める
+ * (実行時刻のずれが蓄積しない)。1周期以上遅れた場合は取りこぼした周期を
+ * まとめてミスとして数え、現在時刻から次の周期を始める。
+ */
+
+#include "scheduler.h"
+#include "perf.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/time.h"
+
+typedef struct {
+    sched_task_fn_t fn;
+    uint32_t deadline_us;
+    uint64_t release_us;     /* 次のリリース時刻 */
+    volatile bool triggered; /* sched_trigger() による即時実行要求 (割り込みから可) */
+    sched_task_stats_t stats;
+} sched_task_t;
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static int task_count = 0;
+
+int sched_add_task(const char *name, sched_task_fn_t fn,
+                   uint32_t period_us, uint32_t deadline_us) {
+    if (task_count >= SCHED_MAX_TASKS || !fn) return -1;
+
+    sched_task_t *t = &tasks[task_count];
+    memset(t, 0, sizeof(*t));
+    t->fn = fn;
+    t->deadline_us = deadline_us;
+    t->release_us = time_us_64();
+    t->stats.name = name;
+    t->stats.period_us = period_us;
+    return task_count++;
+}
+
+void sched_set_period(int task, uint32_t period_us) {
+    if (task < 0 || task >= task_count) return;
+    sched_task_t *t = &tasks[task];
+    if (t->stats.period_us == period_us) return;
+
+    /* 周期なし → 周期あり: 今から始める */
+    if (t->stats.period_us == 0) t->release_us = time_us_64();
+    t->stats.period_us = period_us;
+}
+
+void sched_trigger(int task) {
+    if (task < 0 || task >= task_count) return;
+    tasks[task].triggered = true;
+}
+
+static inline bool task_is_due(const sched_task_t *t, uint64_t now) {
+    return t->triggered || (t->stats.period_us != 0 && t->release_us <= now);
+}
+
+/* 実行可能なタスクのうち絶対デッドラインが最も早いもの */
+static sched_task_t *pick_next(uint64_t now) {
+    sched_task_t *best = NULL;
+    uint64_t best_deadline = UINT64_MAX;
+    for (int i = 0; i < task_count; i++) {
+        sched_task_t *t = &tasks[i];
+        if (!task_is_due(t, now)) continue;
+        uint64_t release = t->triggered ? now : t->release_us;
+        uint64_t deadline = release + t->deadline_us;
+        if (deadline < best_deadline) {
+            best = t;
+            best_deadline = deadline;
+        }
+    }
+    return best;
+}
+
+static void run_task(sched_task_t *t, uint64_t now) {
+    uint32_t period = t->stats.period_us;
+    bool periodic = period != 0 && t->release_us <= now;
+
+    /* 開始遅れとデッドライン判定 (周期リリースのみ) */
+    if (periodic) {
+        uint32_t late = (uint32_t)(now - t->release_us);
+        if (late > t->stats.late_max_us) t->stats.late_max_us = late;
+        if (late > t->deadline_us) t->stats.misses++;
+    }
+
+    /* 実行中に割り込みから再要求された場合に備えて先にクリア */
+    t->triggered = false;
+
+    uint32_t start = time_us_32();
+    t->fn(now);
+    uint32_t elapsed = time_us_32() - start;
+
+    t->stats.runs++;
+    t->stats.run_total_us += elapsed;
+    if (elapsed > t->stats.run_max_us) t->stats.run_max_us = elapsed;
+
+    /* 次のリリース (タスク内で周期が変わった場合は新しい周期) */
+    period = t->stats.period_us;
+    if (periodic && period != 0) {
+        t->release_us += period;
+        if (t->release_us <= now) {
+            /* 1周期以上遅れた: 取りこぼした分をミスとして数えて追従 */
+            uint64_t behind = (now - t->release_us) / period + 1;
+            t->stats.misses += (uint32_t)behind;
+            t->release_us += behind * period;
+        }
+    }
+}
+
+void sched_run_tick(void) {
+    /* ティック開始時刻 (全タスク共通) */
+    uint64_t now = time_us_64();
+
+    /* 実行可能なタスクを EDF 順に全て実行 */
+    sched_task_t *t;
+    bool ran = false;
+    while ((t = pick_next(now)) != NULL) {
+        run_task(t, now);
+        ran = true;
+    }
+    perf_count(PERF_CNT_LOOP_TICKS);
+    if (ran) perf_add_time(PERF_TIME_LOOP, (uint32_t)(time_us_64() - now));
+
+    /* 次のリリースまで待つ (割り込み/イベントで早めに起きることがある) */
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].triggered) return;
+        if (tasks[i].stats.period_us != 0 && tasks[i].release_us < next) {
+            next = tasks[i].release_us;
+        }
+    }
+    if (next != UINT64_MAX && next > time_us_64()) {
+        best_effort_wfe_or_timeout(from_us_since_boot(next));
+    }
+}
+
+bool sched_get_stats(int task, sched_task_stats_t *stats, bool reset) {
+    if (task < 0 || task >= task_count) return false;
+    sched_task_t *t = &tasks[task];
+    *stats = t->stats;
+    if (reset) {
+        t->stats.runs = 0;
+        t->stats.misses = 0;
+        t->stats.run_max_us = 0;
+        t->stats.run_total_us = 0;
+        t->stats.late_max_us = 0;
+    }
+    return true;
+}
+
+int sched_task_count(void) {
+    return task_count;
+}
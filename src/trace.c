@@ -0,0 +1,81 @@
+/**
+ * @file trace.c
+ * @brief バイナリトレース実装
+ *
+ * 書込み側は通し番号を排他アクセス命令で1つ確保し、レコードを埋めてから
+ * seq に「通し番号 + 1」を書く。読み出し側 (メインループのみ) は
+ * seq が期待値と一致するレコードだけをコピーし、コピー後にも seq を確かめる
+ * (コピー中に割り込みで上書きされたものは欠落として数える)。
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+trace_record_t trace_buf[TRACE_BUF_RECORDS];
+uint32_t trace_head = 0;
+
+static uint32_t tail = 0;        /* 次に読む通し番号 */
+static uint32_t dropped = 0;
+static bool streaming = false;
+
+bool trace_read(trace_record_t *rec) {
+    while (true) {
+        uint32_t head = __atomic_load_n(&trace_head, __ATOMIC_ACQUIRE);
+        if (head - tail > TRACE_BUF_RECORDS) {
+            /* 読む前に上書きされた */
+            dropped += head - tail - TRACE_BUF_RECORDS;
+            tail = head - TRACE_BUF_RECORDS;
+        }
+        if (tail == head) return false;
+
+        const trace_record_t *r = &trace_buf[tail & (TRACE_BUF_RECORDS - 1)];
+        uint32_t expect = tail + 1;
+        tail++;
+        if (r->seq != expect) {
+            dropped++;
+            continue;
+        }
+        *rec = *r;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (r->seq != expect) {
+            dropped++;
+            continue;
+        }
+        return true;
+    }
+}
+
+uint32_t trace_take_dropped(void) {
+    uint32_t n = dropped;
+    dropped = 0;
+    return n;
+}
+
+uint32_t trace_dump(uint32_t max_records) {
+    trace_record_t rec;
+    uint32_t n = 0;
+
+    while (n < max_records && trace_read(&rec)) {
+        printf("#T %08lx %u", (unsigned long)rec.ts_us, rec.id);
+        for (uint8_t i = 0; i < rec.nargs && i < TRACE_ARGS_MAX; i++) {
+            printf(" %lx", (unsigned long)rec.args[i]);
+        }
+        printf("\n");
+        n++;
+    }
+
+    uint32_t lost = trace_take_dropped();
+    if (lost) printf("#T! dropped %lu\n", (unsigned long)lost);
+    return n;
+}
+
+void trace_set_streaming(bool enable) {
+    streaming = enable;
+}
+
+void trace_poll(void) {
+    if (streaming) trace_dump(TRACE_DRAIN_PER_POLL);
+}
@@ -14,16 +14,248 @@
  * デルタ算出:
  *   delta_x = right - left
  *   delta_y = down - up
+ *
+ * 非同期転送:
+ *   1トランザクション (レジスタ読み取り: 1+5コマンド, LED書き込み: 5コマンド) は
+ *   I2C TX FIFO (16段) に収まるため、コマンドを一括投入して STOP_DET 割り込みで
+ *   完了を検出する。読み取り結果は割り込み内でデルタを累積し、
+ *   trackball_read() が取り出す。読み取りが完了するたびに
+ *   trackball_set_sample_callback() のコールバックで消費側のタスクを起こす。
+ *   転送中の要求はフラグで保留し、完了割り込みから続けて発行する (LED書き込みを優先)。
+ *
+ * INTピン (TRACKBALL_INT_PIN >= 0):
+ *   ブレークアウトの INT 出力 (移動/ボタン変化でLOW) の立下りで読み取りを要求し、
+ *   静止中はバスを使わない。取りこぼし対策として TRACKBALL_INT_FALLBACK_MS
+ *   周期でも読み取る。読み取り完了時に INT が LOW のままなら続けて読み取る。
+ *   GPIO/タイマー割り込みからは I2C 割り込みを保留状態にして転送を開始させ、
+ *   転送状態の更新を I2C 割り込みとその禁止区間に限定する。
+ *
+ * サンプリングタイマー (INTピン未使用時):
+ *   読み取りはメインループではなく固定周期のアラームで発行する。
+ *   周期は trackball_set_sample_interval() で BLE 接続間隔に合わせて変更し、
+ *   trackball_align_sample_phase() で接続イベント直前に位相を合わせる。
+ *   発火時刻と予定時刻の差 (ジッタ) を記録する。
  */
 
 #include "trackball.h"
 #include "project_config.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <string.h>
 
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "pico/time.h"
+#include "hardware/sync.h"
+
+#define READ_LEN  5   /* left, right, up, down, switch */
+
+typedef enum {
+    XFER_IDLE = 0,
+    XFER_READ,
+    XFER_LED,
+} xfer_t;
 
 static bool connected = false;
 
+/* 転送状態 (割り込みと共有) */
+static volatile xfer_t xfer = XFER_IDLE;
+static volatile bool read_requested = false;
+static volatile bool led_pending = false;
+static uint8_t led_value[4];
+
+/* 完了済みサンプル (割り込みで累積, trackball_read() で取り出し) */
+static int16_t acc_dx = 0;
+static int16_t acc_dy = 0;
+static bool    last_button = false;
+static volatile trackball_sample_cb_t sample_cb = NULL;
+
+#if TRACKBALL_INT_PIN >= 0
+static repeating_timer_t fallback_timer;
+#else
+static alarm_id_t sample_alarm = 0;
+static volatile uint32_t next_tick_us = 0;   /* 次の発火予定時刻 */
+#endif
+static trackball_sample_stats_t sample_stats;
+
+static inline void irq_lock(void)   { irq_set_enabled(TRACKBALL_I2C_IRQ, false); }
+static inline void irq_unlock(void) { irq_set_enabled(TRACKBALL_I2C_IRQ, true); }
+
+/**
+ * 保留中の転送を開始 (割り込み禁止中 or 割り込みハンドラから呼ぶ)
+ */
+static void start_next_xfer(void) {
+    i2c_hw_t *hw = i2c_get_hw(TRACKBALL_I2C);
+
+    if (xfer != XFER_IDLE) return;
+    /* 中断後の STOP 送出中などは次の割り込み/要求で再試行 */
+    if (hw->status & I2C_IC_STATUS_ACTIVITY_BITS) return;
+
+    (void)hw->clr_tx_abrt;
+    (void)hw->clr_stop_det;
+
+    if (led_pending) {
+        led_pending = false;
+        xfer = XFER_LED;
+        hw->data_cmd = TRACKBALL_REG_LED_RED;
+        for (int i = 0; i < 4; i++) {
+            hw->data_cmd = led_value[i] |
+                           (i == 3 ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+        }
+    } else if (read_requested) {
+        read_requested = false;
+        xfer = XFER_READ;
+        hw->data_cmd = TRACKBALL_REG_LEFT;
+        for (int i = 0; i < READ_LEN; i++) {
+            hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS |
+                           (i == 0 ? I2C_IC_DATA_CMD_RESTART_BITS : 0) |
+                           (i == READ_LEN - 1 ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+        }
+    }
+}
+
+/* 取り出されないまま累積し続けた場合の上限 */
+static inline int16_t clamp_acc(int32_t v) {
+    if (v > 1024)  return 1024;
+    if (v < -1024) return -1024;
+    return (int16_t)v;
+}
+
+static bool complete_read(i2c_hw_t *hw) {
+    uint8_t buf[READ_LEN];
+
+    if (hw->rxflr < READ_LEN) {
+        perf_count(PERF_CNT_I2C_ERRORS);
+        while (hw->rxflr) (void)hw->data_cmd;
+        return false;
+    }
+    for (int i = 0; i < READ_LEN; i++) {
+        buf[i] = (uint8_t)hw->data_cmd;
+    }
+
+    uint8_t left  = buf[0];
+    uint8_t right = buf[1];
+    uint8_t up    = buf[2];
+    uint8_t down  = buf[3];
+    uint8_t sw    = buf[4];
+
+    acc_dx = clamp_acc(acc_dx + (int16_t)right - (int16_t)left);
+    acc_dy = clamp_acc(acc_dy + (int16_t)down - (int16_t)up);
+    last_button = (sw >= 128);
+    return true;
+}
+
+static void trackball_i2c_irq_handler(void) {
+    i2c_hw_t *hw = i2c_get_hw(TRACKBALL_I2C);
+    uint32_t stat = hw->raw_intr_stat;
+    bool sampled = false;
+
+    if (stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        /* NACK 等: 転送を破棄 (FIFOはハードウェアでフラッシュ済み) */
+        (void)hw->clr_tx_abrt;
+        while (hw->rxflr) (void)hw->data_cmd;
+        xfer = XFER_IDLE;
+        perf_count(PERF_CNT_I2C_ERRORS);
+    }
+
+    if (stat & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS) {
+        (void)hw->clr_stop_det;
+        if (xfer == XFER_READ) {
+            sampled = complete_read(hw);
+#if TRACKBALL_INT_PIN >= 0
+            /* 未読の移動が残っている */
+            if (!gpio_get(TRACKBALL_INT_PIN)) read_requested = true;
+#endif
+        }
+        xfer = XFER_IDLE;
+    }
+
+    start_next_xfer();
+
+    /* 次の転送を始めてから消費側へ通知 */
+    if (sampled && sample_cb) sample_cb();
+}
+
+/**
+ * 読み取り要求を I2C 割り込みコンテキストへ委譲
+ */
+static void request_from_irq(void) {
+    read_requested = true;
+    irq_set_pending(TRACKBALL_I2C_IRQ);
+}
+
+#if TRACKBALL_INT_PIN < 0
+static int64_t sample_alarm_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+
+    /* 予定時刻からの遅れ */
+    uint32_t jitter = time_us_32() - next_tick_us;
+    sample_stats.jitter_total_us += jitter;
+    if (jitter > sample_stats.jitter_max_us) sample_stats.jitter_max_us = jitter;
+    sample_stats.samples++;
+
+    /* バスが前周期の読み取りをまだ終えていない */
+    if (xfer == XFER_READ || read_requested) sample_stats.skipped++;
+
+    request_from_irq();
+
+    /* 負値: 前回の予定時刻から一定周期で再スケジュール (発火遅れが累積しない) */
+    next_tick_us += sample_stats.interval_us;
+    return -(int64_t)sample_stats.interval_us;
+}
+
+/* 次の発火を絶対時刻 at_us に設定 (以降 interval_us 周期) */
+static void schedule_sample_alarm(uint32_t at_us) {
+    if (sample_alarm > 0) {
+        cancel_alarm(sample_alarm);
+    }
+    int32_t delay = (int32_t)(at_us - time_us_32());
+    if (delay < 1) delay = 1;
+    next_tick_us = time_us_32() + (uint32_t)delay;
+    sample_alarm = add_alarm_in_us(delay, sample_alarm_cb, NULL, true);
+}
+#endif
+
+#if TRACKBALL_INT_PIN >= 0
+static void trackball_int_irq_handler(void) {
+    if (gpio_get_irq_event_mask(TRACKBALL_INT_PIN) & GPIO_IRQ_EDGE_FALL) {
+        gpio_acknowledge_irq(TRACKBALL_INT_PIN, GPIO_IRQ_EDGE_FALL);
+        request_from_irq();
+    }
+}
+
+static bool fallback_poll_cb(repeating_timer_t *rt) {
+    (void)rt;
+    request_from_irq();
+    return true;
+}
+
+/**
+ * INTピン設定 (ブレークアウト側の INT 出力を有効化 + GPIO割り込み)
+ */
+static bool int_pin_init(void) {
+    uint8_t buf[2] = { TRACKBALL_REG_INT, TRACKBALL_INT_OUT_EN };
+    if (i2c_write_blocking(TRACKBALL_I2C, TRACKBALL_I2C_ADDR,
+                           buf, 2, false) < 0) {
+        return false;
+    }
+
+    gpio_init(TRACKBALL_INT_PIN);
+    gpio_set_dir(TRACKBALL_INT_PIN, GPIO_IN);
+    gpio_pull_up(TRACKBALL_INT_PIN);  /* INT はオープンドレイン */
+    gpio_add_raw_irq_handler(TRACKBALL_INT_PIN, trackball_int_irq_handler);
+    gpio_set_irq_enabled(TRACKBALL_INT_PIN, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    add_repeating_timer_ms(TRACKBALL_INT_FALLBACK_MS, fallback_poll_cb,
+                           NULL, &fallback_timer);
+    return true;
+}
+#endif
+
 bool trackball_init(void) {
     /* I2C1 初期化 */
     i2c_init(TRACKBALL_I2C, TRACKBALL_I2C_FREQ);
@@ -34,7 +266,7 @@ bool trackball_init(void) {
     gpio_pull_up(TRACKBALL_SDA_PIN);
     gpio_pull_up(TRACKBALL_SCL_PIN);
 
-    /* デバイス検出: レジスタ0x00を読み取れるか */
+    /* デバイス検出: レジスタ0x00を読み取れるか (起動時のみブロッキング) */
     uint8_t reg = TRACKBALL_REG_LED_RED;
     uint8_t dummy;
     int ret = i2c_write_blocking(TRACKBALL_I2C, TRACKBALL_I2C_ADDR,
@@ -52,15 +284,50 @@ bool trackball_init(void) {
         return false;
     }
 
+#if TRACKBALL_INT_PIN >= 0
+    if (!int_pin_init()) {
+        connected = false;
+        return false;
+    }
+#endif
+
+    /* 以降は割り込み駆動: ターゲットアドレス固定 + STOP/ABORT 割り込み */
+    i2c_hw_t *hw = i2c_get_hw(TRACKBALL_I2C);
+    hw->enable = 0;
+    hw->tar = TRACKBALL_I2C_ADDR;
+    hw->enable = 1;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS |
+                    I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+    irq_set_exclusive_handler(TRACKBALL_I2C_IRQ, trackball_i2c_irq_handler);
+    irq_set_enabled(TRACKBALL_I2C_IRQ, true);
+
     connected = true;
-    DEBUG_PRINT("Trackball: detected on I2C (addr=0x%02X)", TRACKBALL_I2C_ADDR);
+    DEBUG_PRINT("Trackball: detected on I2C (addr=0x%02X, %dkHz, INT=%d)",
+                TRACKBALL_I2C_ADDR, TRACKBALL_I2C_FREQ / 1000, TRACKBALL_INT_PIN);
 
     /* 初期LED設定 (消灯) */
     trackball_set_led(0, 0, 0, 0);
 
+#if TRACKBALL_INT_PIN >= 0
+    /* 起動時点の状態を読み取り、INT を解除 */
+    trackball_request_sample();
+#else
+    /* 未接続時の周期でサンプリング開始 (接続後に接続間隔へ追従) */
+    trackball_set_sample_interval(TRACKBALL_IDLE_INTERVAL_US);
+#endif
+
     return true;
 }
 
+void trackball_request_sample(void) {
+    if (!connected) return;
+
+    irq_lock();
+    read_requested = true;
+    start_next_xfer();
+    irq_unlock();
+}
+
 void trackball_read(trackball_state_t *state) {
     state->delta_x = 0;
     state->delta_y = 0;
@@ -69,44 +336,96 @@ void trackball_read(trackball_state_t *state) {
 
     if (!connected) return;
 
-    /* レジスタ0x04から5バイト連続読み取り */
-    uint8_t reg = TRACKBALL_REG_LEFT;
-    int ret = i2c_write_blocking(TRACKBALL_I2C, TRACKBALL_I2C_ADDR,
-                                  &reg, 1, true);
-    if (ret < 0) return;
-
-    uint8_t buf[5];
-    ret = i2c_read_blocking(TRACKBALL_I2C, TRACKBALL_I2C_ADDR,
-                             buf, 5, false);
-    if (ret < 0) return;
-
-    uint8_t left  = buf[0];
-    uint8_t right = buf[1];
-    uint8_t up    = buf[2];
-    uint8_t down  = buf[3];
-    uint8_t sw    = buf[4];
-
-    /* デルタ算出 (int16_tで計算してint8_tにクランプ) */
-    int16_t dx = (int16_t)right - (int16_t)left;
-    int16_t dy = (int16_t)down - (int16_t)up;
-
+    /* 完了済みサンプルを取り出す (読み取りの発行はタイマー/INT が行う) */
+    irq_lock();
+    int16_t dx = acc_dx;
+    int16_t dy = acc_dy;
+    /* int8_tにクランプ (超過分は次回へ持ち越し) */
     if (dx > 127)  dx = 127;
     if (dx < -127) dx = -127;
     if (dy > 127)  dy = 127;
     if (dy < -127) dy = -127;
+    acc_dx -= dx;
+    acc_dy -= dy;
+    bool button = last_button;
+    irq_unlock();
 
     state->delta_x = (int8_t)dx;
     state->delta_y = (int8_t)dy;
-    state->button = (sw >= 128);
+    state->button = button;
     state->changed = (dx != 0 || dy != 0 || state->button);
 }
 
 void trackball_set_led(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
     if (!connected) return;
 
-    uint8_t buf[5] = { TRACKBALL_REG_LED_RED, r, g, b, w };
-    i2c_write_blocking(TRACKBALL_I2C, TRACKBALL_I2C_ADDR,
-                        buf, 5, false);
+    irq_lock();
+    led_value[0] = r;
+    led_value[1] = g;
+    led_value[2] = b;
+    led_value[3] = w;
+    led_pending = true;
+    start_next_xfer();
+    irq_unlock();
+}
+
+void trackball_set_sample_callback(trackball_sample_cb_t cb) {
+    sample_cb = cb;
+}
+
+void trackball_set_sample_interval(uint32_t interval_us) {
+#if TRACKBALL_INT_PIN < 0
+    if (!connected) return;
+    if (interval_us < TRACKBALL_POLL_INTERVAL_US) interval_us = TRACKBALL_POLL_INTERVAL_US;
+    if (sample_alarm > 0 && interval_us == sample_stats.interval_us) return;
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    sample_stats.interval_us = interval_us;
+    restore_interrupts(irq_state);
+
+    schedule_sample_alarm(time_us_32() + interval_us);
+    TRACE(TB_SAMPLE_INTERVAL, interval_us);
+#else
+    (void)interval_us;
+#endif
+}
+
+void trackball_align_sample_phase(uint32_t at_us) {
+#if TRACKBALL_INT_PIN < 0
+    if (!connected || sample_alarm <= 0) return;
+
+    uint32_t period = sample_stats.interval_us;
+    /* 次の発火予定と目標位相のずれ (-period/2 .. +period/2)。
+     * at_us が発火予定より前のとき差は負になるので、符号付きで剰余を取る
+     * (符号なしのまま取ると 2^32 を period で割った余りだけ位相がずれる) */
+    int32_t diff = (int32_t)(at_us - next_tick_us);
+    int32_t offset = diff % (int32_t)period;
+    if (offset < 0) offset += (int32_t)period;
+    if (offset > (int32_t)(period / 2)) offset -= (int32_t)period;
+    if (offset <= TRACKBALL_PHASE_TOLERANCE_US && offset >= -TRACKBALL_PHASE_TOLERANCE_US) {
+        return;
+    }
+
+    /* 目標位相で最も近い未来の時刻へ付け替え */
+    uint32_t now = time_us_32();
+    uint32_t next = at_us;
+    while ((int32_t)(next - now) <= 0) next += period;
+    while ((int32_t)(next - now) > (int32_t)period) next -= period;
+    schedule_sample_alarm(next);
+#else
+    (void)at_us;
+#endif
+}
+
+void trackball_get_sample_stats(trackball_sample_stats_t *stats, bool reset) {
+    uint32_t irq_state = save_and_disable_interrupts();
+    *stats = sample_stats;
+    if (reset) {
+        uint32_t interval = sample_stats.interval_us;
+        memset(&sample_stats, 0, sizeof(sample_stats));
+        sample_stats.interval_us = interval;
+    }
+    restore_interrupts(irq_state);
 }
 
 bool trackball_is_connected(void) {
@@ -0,0 +1,126 @@
+/**
+ * @file usb_descriptors.c
+ * @brief USB ディスクリプタ (コンポジット: CDC シリアル + HID)
+ *
+ * インターフェース 0/1: CDC (pico_stdio_usb のシリアルコンソール)
+ * インターフェース 2  : HID (BLE と同じレポートディスクリプタ, 1ms ポーリング)
+ *
+ * Report ID 付きのため HID はブートインターフェースにしない (BIOS では BLE の Boot Protocol を使う)。
+ * SDK 既定のリセットインターフェースは含めないので、書込みは BOOTSEL ボタンで行う。
+ */
+
+#include "tusb.h"
+#include "pico/unique_id.h"
+
+#include "project_config.h"
+#include "hid_descriptor.h"
+
+#include <string.h>
+
+enum {
+    ITF_NUM_CDC = 0,
+    ITF_NUM_CDC_DATA,
+    ITF_NUM_HID,
+    ITF_NUM_TOTAL
+};
+
+#define EPNUM_CDC_NOTIF  0x81
+#define EPNUM_CDC_OUT    0x02
+#define EPNUM_CDC_IN     0x82
+#define EPNUM_HID        0x83
+
+enum {
+    STRID_LANGID = 0,
+    STRID_MANUFACTURER,
+    STRID_PRODUCT,
+    STRID_SERIAL,
+    STRID_CDC,
+    STRID_HID,
+};
+
+/* ============================================================
+ * デバイスディスクリプタ (CDC を含むため IAD 付きコンポジット)
+ * ============================================================ */
+static const tusb_desc_device_t desc_device = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0200,
+    .bDeviceClass       = TUSB_CLASS_MISC,
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_VID,
+    .idProduct          = USB_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = STRID_MANUFACTURER,
+    .iProduct           = STRID_PRODUCT,
+    .iSerialNumber      = STRID_SERIAL,
+    .bNumConfigurations = 1,
+};
+
+const uint8_t *tud_descriptor_device_cb(void) {
+    return (const uint8_t *)&desc_device;
+}
+
+/* ============================================================
+ * コンフィグレーションディスクリプタ
+ * ============================================================ */
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN)
+
+static const uint8_t desc_configuration[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8,
+                       EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+    TUD_HID_DESCRIPTOR(ITF_NUM_HID, STRID_HID, HID_ITF_PROTOCOL_NONE,
+                       HID_REPORT_DESCRIPTOR_LEN, EPNUM_HID,
+                       CFG_TUD_HID_EP_BUFSIZE, USB_HID_POLL_INTERVAL_MS),
+};
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    (void)index;
+    return desc_configuration;
+}
+
+const uint8_t *tud_hid_descriptor_report_cb(uint8_t instance) {
+    (void)instance;
+    return hid_report_descriptor;
+}
+
+/* ============================================================
+ * 文字列ディスクリプタ (UTF-16LE)
+ * ============================================================ */
+static const char *const string_table[] = {
+    [STRID_MANUFACTURER] = USB_MANUFACTURER,
+    [STRID_PRODUCT]      = USB_PRODUCT,
+    [STRID_CDC]          = USB_PRODUCT " Console",
+    [STRID_HID]          = USB_PRODUCT,
+};
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    (void)langid;
+    static uint16_t desc_str[33];
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    const char *str;
+    uint8_t len;
+
+    if (index == STRID_LANGID) {
+        desc_str[1] = 0x0409;   /* English (US) */
+        len = 1;
+    } else {
+        if (index == STRID_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            str = serial;
+        } else if (index < sizeof(string_table) / sizeof(string_table[0]) &&
+                   string_table[index]) {
+            str = string_table[index];
+        } else {
+            return NULL;
+        }
+        len = (uint8_t)strlen(str);
+        if (len > 32) len = 32;
+        for (uint8_t i = 0; i < len; i++) desc_str[1 + i] = (uint8_t)str[i];
+    }
+
+    desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * len + 2));
+    return desc_str;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file usb_hid.c
+ * @brief USB HID トランスポート実装
+ *
+ * USB HID シンク。送信フレームは hid_pipeline が持ち、ここではコピーせずに送る。
+ * 生産側の notify (割り込み禁止区間) でエンドポイントが空いていればその場で送り、
+ * 使用中なら tud_hid_report_complete_cb (tud_task 内) が続きを送る。
+ */
+
+#include "usb_hid.h"
+#include "hid_keycodes.h"
+#include "hid_pipeline.h"
+#include "project_config.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/sync.h"
+
+#include "tusb.h"
+
+static int usb_sink = HID_SINK_NONE;
+static uint8_t kb_state[NKRO_REPORT_SIZE];   /* 最後に送ったキーボードレポート (GET_REPORT 用) */
+
+static bool vbus = false;
+static bool vbus_checked = false;
+static uint32_t last_vbus_check_ms = 0;
+
+/* 割り込み禁止中または tud_task 内から呼ぶ */
+static void send_pending(void) {
+    if (!tud_hid_ready()) return;
+
+    hid_frame_t frame;
+    if (!hid_pipeline_peek(usb_sink, HID_FRAME_MASK_ALL, &frame)) return;
+
+    /* data[0] は Report ID (USB シンクは Boot 形式を使わない) */
+    if (tud_hid_report(frame.data[0], frame.data + 1, (uint16_t)(frame.len - 1))) {
+        if (frame.kind == HID_FRAME_KEYBOARD) memcpy(kb_state, frame.data + 1, sizeof(kb_state));
+        hid_pipeline_consume(usb_sink, frame.kind);
+        perf_count(PERF_CNT_USB_REPORTS_SENT);
+    }
+}
+
+/* ============================================================
+ * パイプラインのシンク
+ * ============================================================ */
+
+static bool sink_is_ready(void *ctx) {
+    (void)ctx;
+    return usb_hid_is_active();
+}
+
+static void sink_notify(void *ctx) {
+    (void)ctx;
+    uint32_t irq = save_and_disable_interrupts();
+    send_pending();
+    restore_interrupts(irq);
+}
+
+static const hid_sink_t usb_hid_sink = {
+    .name       = "USB",
+    .is_ready   = sink_is_ready,
+    .wants_boot = NULL,
+    .notify     = sink_notify,
+    .ctx        = NULL,
+};
+
+/* ============================================================
+ * TinyUSB コールバック (tud_task 内)
+ * ============================================================ */
+
+void tud_mount_cb(void) {
+    TRACE(USB_MOUNTED);
+}
+
+void tud_umount_cb(void) {
+    hid_pipeline_discard(usb_sink, HID_FRAME_MASK_ALL);
+    TRACE(USB_UNMOUNTED);
+}
+
+void tud_suspend_cb(bool remote_wakeup_en) {
+    (void)remote_wakeup_en;
+    TRACE(USB_SUSPENDED);
+}
+
+void tud_resume_cb(void) {
+    TRACE(USB_RESUMED);
+}
+
+void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report, uint16_t len) {
+    (void)instance;
+    (void)report;
+    (void)len;
+    send_pending();
+}
+
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id,
+                               hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen) {
+    (void)instance;
+    (void)report_type;
+    /* GET_REPORT はほぼ使われないが、キーボードは現在の状態を返す */
+    if (report_id == HID_REPORT_ID_KEYBOARD && reqlen >= sizeof(kb_state)) {
+        memcpy(buffer, kb_state, sizeof(kb_state));
+        return sizeof(kb_state);
+    }
+    return 0;
+}
+
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
+                           hid_report_type_t report_type,
+                           const uint8_t *buffer, uint16_t bufsize) {
+    /* LED 出力レポートは BLE と同じく使わない */
+    (void)instance;
+    (void)report_id;
+    (void)report_type;
+    (void)buffer;
+    (void)bufsize;
+}
+
+/* ============================================================
+ * 公開 API
+ * ============================================================ */
+
+void usb_hid_init(void) {
+    tusb_init();
+}
+
+void usb_hid_update(uint32_t now_ms) {
+    if (vbus_checked && (now_ms - last_vbus_check_ms) < USB_VBUS_POLL_MS) return;
+    vbus_checked = true;
+    last_vbus_check_ms = now_ms;
+
+    bool present = cyw43_arch_gpio_get(CYW43_WL_GPIO_VBUS_PIN);
+    if (present != vbus) {
+        vbus = present;
+        TRACE(USB_VBUS, present);
+    }
+}
+
+bool usb_hid_vbus_present(void) {
+    return vbus;
+}
+
+bool usb_hid_is_active(void) {
+    return vbus && tud_mounted() && !tud_suspended();
+}
+
+int usb_hid_attach_pipeline(void) {
+    usb_sink = hid_pipeline_add_sink(&usb_hid_sink);
+    return usb_sink;
+}
+
+bool usb_hid_is_tx_idle(void) {
+    return !hid_pipeline_has_pending(usb_sink, HID_FRAME_MASK_ALL);
+}
@@ -4,26 +4,92 @@
  *
  * PIO ステートマシンを使って WS2812B の 800kHz プロトコルを生成。
  * 3個のLEDをデイジーチェーン接続 (GP22 → LED0 → LED1 → LED2)。
+ *
+ * バッファ構成:
+ *   draw_buf    : set_pixel()/clear() が書き込む描画バッファ
+ *   tx_buf[2]   : DMA 送信用のダブルバッファ (front=送信中, back=次フレーム)
+ *
+ * 送信フロー:
+ *   show() → draw_buf を back にコピー → アイドルなら front/back を入れ替えて DMA 開始
+ *   DMA 完了割り込み → FIFO 排出 + ラッチ期間のアラーム
+ *   アラーム → 次フレームがあれば送信開始、なければアイドル + 完了コールバック
+ *   (アラームを登録できなければ DMA 完了割り込みの中でラッチ期間を待って同じ処理)
  */
 
 #include "ws2812_led.h"
 
 #include <string.h>
 #include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
 #include "ws2812.pio.h"  /* ビルド時に ws2812.pio から自動生成 */
 
+/* DMA 完了割り込み (共有ハンドラで他の DMA 利用者と共存) */
+#define WS2812_DMA_IRQ   DMA_IRQ_1
+
+/* PIO TX FIFO 段数 (TX 結合で 8) と 1ワード (24bit) の送信時間 */
+#define WS2812_FIFO_DEPTH    8
+#define WS2812_WORD_US       30
+
 /* PIOインスタンスとステートマシン */
 static PIO pio_instance;
 static uint pio_sm;
+static int dma_chan = -1;
 
 /* ピクセルバッファ (GRB順) */
-static uint32_t pixel_buf[WS2812_NUM_LEDS];
+static uint32_t draw_buf[WS2812_NUM_LEDS];
+static uint32_t tx_buf[2][WS2812_NUM_LEDS];
+static uint8_t  front = 0;                 /* 送信中の tx_buf */
+static volatile bool busy = false;         /* DMA 送信 or ラッチ期間中 */
+static volatile bool back_ready = false;   /* back に未送信フレームあり */
+static ws2812_done_cb_t done_cb = NULL;
 
 static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
     /* WS2812B: GRB順、MSBファースト → 左シフトで上位ビットに配置 */
     return ((uint32_t)g << 24) | ((uint32_t)r << 16) | ((uint32_t)b << 8);
 }
 
+/* back を front にして DMA 送信開始 (割り込み禁止中に呼ぶ) */
+static void start_frame(void) {
+    front ^= 1;
+    back_ready = false;
+    busy = true;
+    dma_channel_transfer_from_buffer_now(dma_chan, tx_buf[front], WS2812_NUM_LEDS);
+}
+
+static int64_t latch_done_cb(alarm_id_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+
+    uint32_t irq_state = save_and_disable_interrupts();
+    if (back_ready) {
+        start_frame();
+        restore_interrupts(irq_state);
+        return 0;
+    }
+    busy = false;
+    restore_interrupts(irq_state);
+
+    if (done_cb) done_cb();
+    return 0;
+}
+
+static void ws2812_dma_irq_handler(void) {
+    if (!dma_channel_get_irq1_status(dma_chan)) return;
+    dma_channel_acknowledge_irq1(dma_chan);
+
+    /* DMA 完了時点で FIFO に残っている分の送出 + ラッチ期間を待つ */
+    uint32_t words = (WS2812_NUM_LEDS < WS2812_FIFO_DEPTH) ? WS2812_NUM_LEDS : WS2812_FIFO_DEPTH;
+    uint32_t latch_us = words * WS2812_WORD_US + WS2812_RESET_US;
+    if (add_alarm_in_us(latch_us, latch_done_cb, NULL, true) < 0) {
+        /* アラームが取れない: busy のまま残さないよう、ここでラッチ期間を待って完了させる */
+        busy_wait_us_32(latch_us);
+        latch_done_cb(0, NULL);
+    }
+}
+
 void ws2812_init(void) {
     pio_instance = pio0;
     pio_sm = pio_claim_unused_sm(pio_instance, true);
@@ -32,21 +98,52 @@ void ws2812_init(void) {
     ws2812_program_init(pio_instance, pio_sm, offset,
                         WS2812_PIN, WS2812_FREQ);
 
-    memset(pixel_buf, 0, sizeof(pixel_buf));
+    /* DMA: tx_buf → PIO TX FIFO (32bit, DREQ でペーシング) */
+    dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio_instance, pio_sm, true));
+    dma_channel_configure(dma_chan, &c, &pio_instance->txf[pio_sm],
+                          NULL, WS2812_NUM_LEDS, false);
+
+    dma_channel_set_irq1_enabled(dma_chan, true);
+    irq_add_shared_handler(WS2812_DMA_IRQ, ws2812_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(WS2812_DMA_IRQ, true);
+
+    memset(draw_buf, 0, sizeof(draw_buf));
+    memset(tx_buf, 0, sizeof(tx_buf));
     ws2812_show();
 }
 
-void ws2812_set_pixel(uint8_t index, uint8_t r, uint8_t g, uint8_t b) {
+void ws2812_set_pixel(uint16_t index, uint8_t r, uint8_t g, uint8_t b) {
     if (index >= WS2812_NUM_LEDS) return;
-    pixel_buf[index] = urgb_u32(r, g, b);
+    draw_buf[index] = urgb_u32(r, g, b);
 }
 
 void ws2812_clear(void) {
-    memset(pixel_buf, 0, sizeof(pixel_buf));
+    memset(draw_buf, 0, sizeof(draw_buf));
 }
 
 void ws2812_show(void) {
-    for (int i = 0; i < WS2812_NUM_LEDS; i++) {
-        pio_sm_put_blocking(pio_instance, pio_sm, pixel_buf[i]);
+    if (dma_chan < 0) return;
+
+    /* back は送信に使われていないため、送信中でも書き換えてよい */
+    uint32_t irq_state = save_and_disable_interrupts();
+    memcpy(tx_buf[front ^ 1], draw_buf, sizeof(draw_buf));
+    back_ready = true;
+    if (!busy) {
+        start_frame();
     }
+    restore_interrupts(irq_state);
+}
+
+bool ws2812_is_busy(void) {
+    return busy;
+}
+
+void ws2812_set_done_callback(ws2812_done_cb_t cb) {
+    done_cb = cb;
 }
@@ -0,0 +1,57 @@
+/**
+ * @file fuzz_common.h
+ * @brief ファズターゲット共通: 不変条件チェックと入力の読み出し
+ *
+ * 入力はバイト列を先頭から順に読む小さな命令列として解釈する。
+ * 読み切ったら 0 を返すので、どんな長さの入力でも最後まで実行できる。
+ */
+
+#ifndef FUZZ_COMMON_H
+#define FUZZ_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* 不変条件違反: libFuzzer にクラッシュとして検出させる (入力は crash-* に保存される) */
+#define FUZZ_CHECK(cond, ...) do {                                        \
+        if (!(cond)) {                                                    \
+            fprintf(stderr, "%s:%d: invariant failed: %s: ",              \
+                    __FILE__, __LINE__, #cond);                           \
+            fprintf(stderr, __VA_ARGS__);                                 \
+            fprintf(stderr, "\n");                                        \
+            abort();                                                      \
+        }                                                                 \
+    } while (0)
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;
+} fuzz_input_t;
+
+static inline bool fuzz_more(const fuzz_input_t *in) {
+    return in->pos < in->size;
+}
+
+static inline uint8_t fuzz_u8(fuzz_input_t *in) {
+    return (in->pos < in->size) ? in->data[in->pos++] : 0;
+}
+
+static inline uint16_t fuzz_u16(fuzz_input_t *in) {
+    uint16_t lo = fuzz_u8(in);
+    return (uint16_t)(lo | ((uint16_t)fuzz_u8(in) << 8));
+}
+
+/* n バイトを取り出す (足りない分は 0) */
+static inline void fuzz_bytes(fuzz_input_t *in, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fuzz_u8(in);
+}
+
+/* libFuzzer のエントリポイント (fuzz_driver.c からも呼ぶ) */
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#endif /* FUZZ_COMMON_H */
@@ -0,0 +1,145 @@
+/**
+ * @file fuzz_driver.c
+ * @brief libFuzzer を使わないときのファズターゲット実行ドライバ
+ *
+ * clang (-fsanitize=fuzzer) が無い環境や, ベンチマークとして決まった回数だけ回すときに
+ * ターゲットへリンクする。カバレッジによる誘導はせず, シードから作る乱数入力を与える。
+ *
+ *   fuzz_xxx [-runs=N] [-seed=S] [-max_len=L] [ファイル...]
+ *
+ * ファイルを指定するとその入力を1回ずつ実行する (crash-* の再現, コーパスの回帰確認)。
+ * 指定しなければ乱数入力を N 回 (既定 10000) 実行し, 実行回数と exec/s を表示する。
+ * オプションの書式は libFuzzer と同じ。不変条件違反 (abort) の入力は libFuzzer と同じく
+ * カレントディレクトリの crash-<実行番号> に保存する。
+ *
+ * ビルド例 (gcc, リポジトリのルートで):
+ *   mkdir -p build && cc -std=gnu11 -g -O1 -fsanitize=address,undefined \
+ *      -Itools/fuzz -Itools/fuzz/hal -Itools/replay -Itools/replay/hal -Iinclude \
+ *      -o build/fuzz_matrix tools/fuzz/fuzz_driver.c tools/fuzz/fuzz_matrix.c \
+ *      tools/replay/sim_hal.c src/keyboard_matrix.c src/keymap.c src/hid_pipeline.c src/perf.c
+ *   build/fuzz_matrix -runs=2000
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "fuzz_common.h"
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+/* 実行中の入力 (abort 時に保存する) */
+static const uint8_t *cur_data = NULL;
+static size_t cur_size = 0;
+static unsigned long cur_run = 0;
+
+static void on_abort(int sig) {
+    char path[32];
+    snprintf(path, sizeof(path), "crash-%lu", cur_run);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write(fd, cur_data, cur_size) == (ssize_t)cur_size) {
+            fprintf(stderr, "Test unit written to %s\n", path);
+        }
+        close(fd);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int run_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    size_t cap = 4096, size = 0;
+    uint8_t *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + size, 1, cap - size, f)) > 0) {
+        size += n;
+        if (size == cap) buf = realloc(buf, cap *= 2);
+    }
+    fclose(f);
+    if (!buf) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    fprintf(stderr, "Running: %s (%zu bytes)\n", path, size);
+    cur_data = buf;
+    cur_size = size;
+    LLVMFuzzerTestOneInput(buf, size);
+    free(buf);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned long runs = 10000;
+    unsigned long max_len = 4096;
+    int files = 0;
+
+    LLVMFuzzerInitialize(&argc, &argv);
+    signal(SIGABRT, on_abort);
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        if      (!strncmp(a, "-runs=", 6))    runs = strtoul(a + 6, NULL, 0);
+        else if (!strncmp(a, "-seed=", 6))    rng_state = (uint32_t)strtoul(a + 6, NULL, 0);
+        else if (!strncmp(a, "-max_len=", 9)) max_len = strtoul(a + 9, NULL, 0);
+        else if (a[0] == '-') {
+            fprintf(stderr, "usage: %s [-runs=N] [-seed=S] [-max_len=L] [file...]\n", argv[0]);
+            return 2;
+        }
+        else {
+            if (run_file(a)) return 1;
+            files++;
+        }
+    }
+    if (files > 0) return 0;
+    if (rng_state == 0) rng_state = 1;
+    if (max_len == 0) max_len = 1;
+
+    uint8_t *buf = malloc(max_len);
+    if (!buf) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    double start = now_ms();
+    for (unsigned long r = 0; r < runs; r++) {
+        size_t len = rng() % (max_len + 1);
+        for (size_t i = 0; i < len; i++) buf[i] = (uint8_t)rng();
+        cur_data = buf;
+        cur_size = len;
+        cur_run = r;
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+    double elapsed = now_ms() - start;
+    free(buf);
+
+    fprintf(stderr, "Done %lu runs in %.0f ms (%.0f exec/s)\n",
+            runs, elapsed, elapsed > 0 ? runs * 1000.0 / elapsed : 0.0);
+    return 0;
+}
@@ -0,0 +1,497 @@
+/**
+ * @file fuzz_flash_slots.c
+ * @brief ファズターゲット: ログ構造 Flash ストアとデバイススロットの読込み
+ *
+ * RAM 上の NOR Flash (sim_flash.c) に対して flash_log.c / device_slot.c の実コードを動かす。
+ * 入力は命令列で、タグの書込み/削除/コミット (保留テーブルを満杯にする連続書込みを含む),
+ * Flash イメージの破壊 (ビット反転, 上書き, セクタ消去), コミット途中の電源断,
+ * 再起動 (索引の再構築とスロット表の読込み) を並べる。
+ *
+ * 不変条件:
+ *   - Flash 操作は消去/プログラムの単位に揃い, flash_log の領域外 (pico_flash_bank) に触れない
+ *   - 値の長さ <= FLASH_LOG_MAX_VALUE, XIP 上の値は領域内を指す
+ *   - 破壊していなければ, 読み出しは書いた値 (再起動後はコミット済みの値) と一致する
+ *   - コミット途中で電源断しても, 各タグは「コミット前の値」か「書こうとした値」のどちらか
+ *   - 書込み/削除の呼出しの中ではコミットせず, 拒否するのは保留テーブルが満杯のときだけ
+ *   - スロット: アクティブ < MAX_DEVICE_SLOTS, ペアリング済みスロットのボンド番号は
+ *     le_device_db の範囲内で, 同じボンドを2スロットが指さない。読込み直後は
+ *     スロットのアドレスがボンドと一致し, どのスロットからも参照されないボンドは残らない
+ *
+ * ビルド (リポジトリのルートで, libFuzzer):
+ *   mkdir -p build && clang -g -O1 -fsanitize=fuzzer,address,undefined \
+ *      -Itools/fuzz -Itools/fuzz/hal -Itools/replay -Itools/replay/hal -Iinclude \
+ *      -o build/fuzz_flash_slots \
+ *      tools/fuzz/fuzz_flash_slots.c tools/fuzz/sim_flash.c tools/fuzz/sim_btstack.c \
+ *      tools/replay/sim_hal.c src/flash_log.c src/device_slot.c src/led_anim.c \
+ *      src/perf.c src/trace.c
+ *   build/fuzz_flash_slots -max_total_time=60 corpus/flash_slots
+ *
+ * clang が無い場合は -fsanitize=fuzzer の代わりに tools/fuzz/fuzz_driver.c をリンクする
+ * (docs/DEVELOPMENT_GUIDE.md「ファズテスト (ホスト)」)。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fuzz_common.h"
+#include "sim_flash.h"
+#include "sim_btstack.h"
+#include "sim_hal.h"
+#include "project_config.h"
+#include "flash_log.h"
+#include "device_slot.h"
+#include "pointer_accel.h"
+#include "ws2812_led.h"
+#include "config_store.h"
+#include "pico/btstack_flash_bank.h"
+#include "ble/le_device_db.h"
+
+/* flash_log.c のレイアウトと同じ */
+#define LOG_REGION_OFFSET  (PICO_FLASH_BANK_STORAGE_OFFSET - FLASH_LOG_SECTORS * FLASH_SECTOR_SIZE)
+#define LOG_REGION_SIZE    (FLASH_LOG_SECTORS * FLASH_SECTOR_SIZE)
+#define LOG_MAX_KEYS       48
+
+/* device_slot.c / le_device_db_tlv と同じタグ */
+#define TAG4(a, b, c, d)   (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | \
+                            ((uint32_t)(c) << 8) | (uint32_t)(d))
+#define TAG_ACTIVE_SLOT    TAG4('J', 'K', 'A', 'S')
+#define TAG_SLOT(n)        TAG4('J', 'K', 'S', (n))
+#define TAG_POINTER(n)     TAG4('J', 'K', 'P', (n))
+#define TAG_BOND(n)        TAG4('B', 'T', 'D', (n))
+
+/*
+ * 入力で選べるタグ (範囲外スロット・無関係なタグ・書けないタグを含む)
+ * 書けるタグは FLASH_LOG_PENDING_MAX より多くし, 保留テーブル満杯の経路も通す
+ */
+static const uint32_t tags[] = {
+    TAG_ACTIVE_SLOT,
+    TAG_SLOT(0), TAG_SLOT(1), TAG_SLOT(2), TAG_SLOT(3),
+    TAG_POINTER(0), TAG_POINTER(1), TAG_POINTER(2),
+    TAG_BOND(0), TAG_BOND(1), TAG_BOND(2),
+    0x12345678u,
+    TAG4('X', 'F', 'Z', 0), TAG4('X', 'F', 'Z', 1), TAG4('X', 'F', 'Z', 2),
+    TAG4('X', 'F', 'Z', 3), TAG4('X', 'F', 'Z', 4), TAG4('X', 'F', 'Z', 5),
+    0xFFFFFFFFu,
+};
+#define TAG_COUNT  (sizeof(tags) / sizeof(tags[0]))
+
+/* device_slot.c の tlv_slot_record_t と同じ形式 */
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t paired;
+    int8_t  db_index;
+    uint8_t addr_type;
+    uint8_t bd_addr[BD_ADDR_LEN];
+} slot_record_t;
+
+/* ============================================================
+ * 期待値モデル
+ * ============================================================ */
+typedef struct {
+    bool     present;
+    uint16_t len;
+    uint8_t  data[FLASH_LOG_MAX_VALUE];
+} value_t;
+
+static value_t committed[TAG_COUNT];   /* 再起動後に読めるはずの値 */
+static value_t visible[TAG_COUNT];     /* 今読めるはずの値 (保留を含む) */
+static bool model_valid;               /* Flash を直接壊したら以降は構造の検査だけ */
+static bool slots_loaded;
+
+static bool value_equal(const value_t *a, const value_t *b) {
+    if (a->present != b->present) return false;
+    if (!a->present) return true;
+    return a->len == b->len && memcmp(a->data, b->data, a->len) == 0;
+}
+
+static void read_actual(uint32_t tag, value_t *v) {
+    int len = flash_log_read(tag, v->data, sizeof(v->data));
+    v->present = len > 0 || flash_log_get_ptr(tag, NULL) != NULL;
+    v->len = (uint16_t)len;
+}
+
+/* ストアの実際の値をモデルに取り込む (device_slot が書き換えた後など) */
+static void resync_visible(void) {
+    for (size_t i = 0; i < TAG_COUNT; i++) read_actual(tags[i], &visible[i]);
+}
+
+static void model_commit(void) {
+    memcpy(committed, visible, sizeof(committed));
+}
+
+/* ============================================================
+ * 不変条件
+ * ============================================================ */
+
+static void check_store(void) {
+    flash_log_stats_t st;
+    flash_log_get_stats(&st);
+    FUZZ_CHECK(st.used_bytes <= FLASH_SECTOR_SIZE, "used_bytes %lu", (unsigned long)st.used_bytes);
+    FUZZ_CHECK(st.records <= LOG_MAX_KEYS, "records %lu", (unsigned long)st.records);
+    FUZZ_CHECK(st.pending <= FLASH_LOG_PENDING_MAX, "pending %lu", (unsigned long)st.pending);
+
+    const uint8_t *region = sim_flash_mem + LOG_REGION_OFFSET;
+    for (size_t i = 0; i < TAG_COUNT; i++) {
+        uint16_t len = 0;
+        const uint8_t *p = flash_log_get_ptr(tags[i], &len);
+        if (!p) {
+            FUZZ_CHECK(!model_valid || !visible[i].present, "tag 0x%08lx lost",
+                       (unsigned long)tags[i]);
+            continue;
+        }
+        FUZZ_CHECK(len <= FLASH_LOG_MAX_VALUE, "tag 0x%08lx len %u", (unsigned long)tags[i], len);
+        if (p >= sim_flash_mem && p < sim_flash_mem + SIM_FLASH_SIZE) {
+            FUZZ_CHECK(p >= region && p + len <= region + LOG_REGION_SIZE,
+                       "tag 0x%08lx points outside the log region", (unsigned long)tags[i]);
+        }
+        if (model_valid) {
+            value_t v;
+            read_actual(tags[i], &v);
+            FUZZ_CHECK(value_equal(&v, &visible[i]), "tag 0x%08lx value mismatch",
+                       (unsigned long)tags[i]);
+        }
+    }
+}
+
+/* pico_flash_bank (BTstack 既定 TLV) の領域は一度も書かれない */
+static void check_bank_untouched(void) {
+    for (uint32_t i = PICO_FLASH_BANK_STORAGE_OFFSET; i < SIM_FLASH_SIZE; i++) {
+        FUZZ_CHECK(sim_flash_mem[i] == 0xFF, "flash bank byte 0x%lx written", (unsigned long)i);
+    }
+}
+
+static bool bond_info(int index, int *addr_type, bd_addr_t addr) {
+    sm_key_t irk;
+    le_device_db_info(index, addr_type, addr, irk);
+    return *addr_type != BD_ADDR_TYPE_UNKNOWN;
+}
+
+static void check_slots(bool just_loaded) {
+    FUZZ_CHECK(device_slot_get_active() < MAX_DEVICE_SLOTS, "active slot %u",
+               device_slot_get_active());
+    FUZZ_CHECK(device_slot_get_info(MAX_DEVICE_SLOTS) == NULL, "slot index not bounded");
+
+    for (uint8_t i = 0; i < MAX_DEVICE_SLOTS; i++) {
+        const device_slot_info_t *info = device_slot_get_info(i);
+        FUZZ_CHECK(info != NULL, "slot %u info", i);
+        FUZZ_CHECK(device_slot_get_pointer_curve(i) < POINTER_CURVE_COUNT, "slot %u curve %u",
+                   i, device_slot_get_pointer_curve(i));
+        if (!info->paired) {
+            FUZZ_CHECK(info->db_index == DEVICE_SLOT_NO_BOND, "unpaired slot %u db_index %d",
+                       i, info->db_index);
+            continue;
+        }
+        FUZZ_CHECK(info->db_index >= 0 && info->db_index < le_device_db_max_count(),
+                   "slot %u db_index %d out of range", i, info->db_index);
+        FUZZ_CHECK(device_slot_find_by_bond(info->db_index) == (int8_t)i,
+                   "bond %d shared by several slots", info->db_index);
+
+        /* 読込み後にボンドDBが直接書き換えられた場合の突き合わせは次の起動で行う */
+        if (!just_loaded) continue;
+        int addr_type;
+        bd_addr_t addr;
+        FUZZ_CHECK(bond_info(info->db_index, &addr_type, addr), "slot %u bond %d missing",
+                   i, info->db_index);
+        FUZZ_CHECK(addr_type == info->addr_type && memcmp(addr, info->bd_addr, BD_ADDR_LEN) == 0,
+                   "slot %u address differs from bond %d", i, info->db_index);
+    }
+
+    /* どのスロットからも参照されないボンドは残らない */
+    if (just_loaded) {
+        for (int index = 0; index < le_device_db_max_count(); index++) {
+            int addr_type;
+            bd_addr_t addr;
+            if (!bond_info(index, &addr_type, addr)) continue;
+            FUZZ_CHECK(device_slot_find_by_bond(index) >= 0, "orphan bond %d kept", index);
+        }
+    }
+}
+
+/* ============================================================
+ * 操作
+ * ============================================================ */
+
+static void do_write(uint32_t tag_index, const uint8_t *data, uint16_t len) {
+    uint32_t tag = tags[tag_index];
+    flash_log_stats_t before, after;
+    flash_log_get_stats(&before);
+    bool ok = flash_log_write(tag, data, len);
+    flash_log_get_stats(&after);
+
+    /* 保留テーブルが満杯なら拒否される (コミットはしない) */
+    bool full = after.pending_full != before.pending_full;
+    FUZZ_CHECK(!full || (!ok && before.pending == FLASH_LOG_PENDING_MAX),
+               "write tag 0x%08lx rejected with %lu pending", (unsigned long)tag,
+               (unsigned long)before.pending);
+    FUZZ_CHECK(after.commits == before.commits, "write tag 0x%08lx committed",
+               (unsigned long)tag);
+
+    /* 壊れたイメージでは索引が無関係なタグで埋まり, 書けないことがある */
+    bool expect_ok = len <= FLASH_LOG_MAX_VALUE && tag != 0xFFFFFFFFu && !full;
+    FUZZ_CHECK(ok == expect_ok || (!model_valid && !ok), "write tag 0x%08lx len %u returned %d",
+               (unsigned long)tag, len, ok);
+    if (ok) {
+        visible[tag_index].present = true;
+        visible[tag_index].len = len;
+        memcpy(visible[tag_index].data, data, len);
+    }
+}
+
+static void do_delete(uint32_t tag_index) {
+    flash_log_stats_t before, after;
+    flash_log_get_stats(&before);
+    bool ok = flash_log_delete(tags[tag_index]);
+    flash_log_get_stats(&after);
+
+    /* 削除も保留テーブルに積むので, 満杯なら拒否される */
+    bool full = after.pending_full != before.pending_full;
+    FUZZ_CHECK(ok != full && (!full || before.pending == FLASH_LOG_PENDING_MAX),
+               "delete tag 0x%08lx returned %d with %lu pending",
+               (unsigned long)tags[tag_index], ok, (unsigned long)before.pending);
+    if (ok) {
+        visible[tag_index].present = false;
+        visible[tag_index].len = 0;
+    }
+}
+
+static void do_commit(void) {
+    bool ok = flash_log_commit();
+    FUZZ_CHECK(ok || !model_valid, "commit failed");
+    FUZZ_CHECK(!ok || !flash_log_has_pending(), "pending left after commit");
+    model_commit();
+}
+
+/* device_slot 経由の書込みを取り込む (保存呼出しの中ではコミットされない) */
+static void absorb_slot_writes(uint32_t commits_before) {
+    flash_log_stats_t st;
+    flash_log_get_stats(&st);
+    FUZZ_CHECK(st.commits == commits_before, "slot action committed");
+    resync_visible();
+}
+
+static uint32_t commit_count(void) {
+    flash_log_stats_t st;
+    flash_log_get_stats(&st);
+    return st.commits;
+}
+
+/* 電源を入れ直して索引を作り直す (保留中の書込みは失われる) */
+static void reboot(void) {
+    sim_flash_power_cycle();
+    sim_btstack_reset();
+    slots_loaded = false;
+    FUZZ_CHECK(flash_log_init(), "flash_log_init failed");
+    memcpy(visible, committed, sizeof(visible));
+}
+
+/* コミット途中で電源断 → 各タグはコミット前か書こうとした値のどちらか */
+static void do_power_loss(uint32_t ops, uint32_t torn_bytes) {
+    static value_t old_values[TAG_COUNT], new_values[TAG_COUNT];
+    memcpy(old_values, committed, sizeof(old_values));
+    memcpy(new_values, visible, sizeof(new_values));
+
+    sim_flash_fail_after(ops, torn_bytes);
+    if (flash_log_commit()) model_commit();
+    reboot();
+
+    for (size_t i = 0; i < TAG_COUNT; i++) {
+        value_t v;
+        read_actual(tags[i], &v);
+        FUZZ_CHECK(!model_valid || value_equal(&v, &old_values[i]) ||
+                   value_equal(&v, &new_values[i]),
+                   "tag 0x%08lx neither old nor new after power loss", (unsigned long)tags[i]);
+        committed[i] = v;
+    }
+    memcpy(visible, committed, sizeof(visible));
+}
+
+/* ファームウェアの起動時と同じ順でストアとスロット表を読み込む */
+static void boot_firmware(void) {
+    value_t before[TAG_COUNT];
+
+    sim_flash_power_cycle();
+    sim_btstack_reset();
+    memcpy(visible, committed, sizeof(visible));
+    memcpy(before, visible, sizeof(before));
+
+    /* スロット表の読込みはストア初期化の中で行われる (移行時のコミットも含む) */
+    FUZZ_CHECK(device_slot_storage_init(), "device_slot_storage_init failed");
+    uint32_t commits = commit_count();
+    device_slot_init();
+    slots_loaded = true;
+    check_slots(true);
+
+    /* 読込みで消してよいのは食い違ったスロットと孤立したボンドだけ */
+    absorb_slot_writes(commits);
+    for (size_t i = 0; i < TAG_COUNT; i++) {
+        if (!model_valid || value_equal(&visible[i], &before[i])) continue;
+        bool deletable = tags[i] == TAG_SLOT(0) || tags[i] == TAG_SLOT(1) ||
+                         tags[i] == TAG_SLOT(2) || tags[i] == TAG_BOND(0) ||
+                         tags[i] == TAG_BOND(1) || tags[i] == TAG_BOND(2);
+        FUZZ_CHECK(deletable && !visible[i].present, "slot load changed tag 0x%08lx",
+                   (unsigned long)tags[i]);
+    }
+}
+
+static void do_slot_action(fuzz_input_t *in) {
+    if (!slots_loaded) return;
+    uint32_t commits = commit_count();
+    switch (fuzz_u8(in) % 4) {
+    case 0:
+        device_slot_switch(fuzz_u8(in) % (MAX_DEVICE_SLOTS + 1));
+        break;
+    case 1: {
+        uint8_t slot = fuzz_u8(in) % (MAX_DEVICE_SLOTS + 1);
+        device_slot_set_pointer_curve(slot, fuzz_u8(in) % (POINTER_CURVE_COUNT + 1));
+        break;
+    }
+    case 2:
+        device_slot_clear_current();
+        break;
+    default: {
+        uint8_t slot = fuzz_u8(in) % (MAX_DEVICE_SLOTS + 1);
+        device_slot_save_pairing(slot, (int)(fuzz_u8(in) % (NVM_NUM_DEVICE_DB_ENTRIES + 2)) - 1);
+        break;
+    }
+    }
+    check_slots(false);
+    absorb_slot_writes(commits);
+}
+
+/* ============================================================
+ * エントリポイント
+ * ============================================================ */
+
+/* ws2812_led.c の代替 (LED は見ない) */
+void ws2812_init(void) {}
+void ws2812_set_pixel(uint16_t index, uint8_t r, uint8_t g, uint8_t b) {
+    (void)r; (void)g; (void)b;
+    FUZZ_CHECK(index < WS2812_NUM_LEDS, "LED index %u", index);
+}
+void ws2812_clear(void) {}
+void ws2812_show(void) {}
+bool ws2812_is_busy(void) { return false; }
+void ws2812_set_done_callback(ws2812_done_cb_t cb) { (void)cb; }
+
+/* config_store.c の代替 */
+void config_get_slot_color(uint8_t slot, uint8_t *r, uint8_t *g, uint8_t *b) {
+    FUZZ_CHECK(slot < MAX_DEVICE_SLOTS, "slot color index %u", slot);
+    *r = 0;
+    *g = 32;
+    *b = 0;
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    /* DEBUG_PRINT は毎回出るので捨てる (違反の報告は stderr) */
+    if (freopen("/dev/null", "w", stdout) == NULL) perror("freopen");
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    fuzz_input_t in = { data, size, 0 };
+
+    sim_hal_reset();
+    sim_flash_reset();
+    memset(committed, 0, sizeof(committed));
+    memset(visible, 0, sizeof(visible));
+    model_valid = true;
+    reboot();
+    check_store();
+
+    while (fuzz_more(&in)) {
+        uint8_t op = fuzz_u8(&in);
+        switch (op % 13) {
+        case 0: {   /* 任意の値を書く (長すぎる値も試す) */
+            uint8_t buf[FLASH_LOG_MAX_VALUE + 8];
+            uint32_t t = fuzz_u8(&in) % TAG_COUNT;
+            uint16_t len = fuzz_u8(&in) % (sizeof(buf) + 1);
+            fuzz_bytes(&in, buf, len);
+            do_write(t, buf, len);
+            break;
+        }
+        case 1:
+            do_delete(fuzz_u8(&in) % TAG_COUNT);
+            break;
+        case 2:
+            do_commit();
+            break;
+        case 3: {   /* ビット反転 */
+            uint32_t pos = fuzz_u16(&in) % LOG_REGION_SIZE;
+            uint8_t mask = fuzz_u8(&in);
+            sim_flash_mem[LOG_REGION_OFFSET + pos] ^= mask ? mask : 1;
+            model_valid = false;
+            break;
+        }
+        case 4: {   /* 任意のバイト列で上書き (偽のヘッダ/レコード) */
+            uint32_t pos = fuzz_u16(&in) % LOG_REGION_SIZE;
+            uint32_t n = fuzz_u8(&in) % 32;
+            for (uint32_t i = 0; i < n && pos + i < LOG_REGION_SIZE; i++) {
+                sim_flash_mem[LOG_REGION_OFFSET + pos + i] = fuzz_u8(&in);
+            }
+            model_valid = false;
+            break;
+        }
+        case 5: {   /* セクタ消去 */
+            uint32_t sector = fuzz_u8(&in) % FLASH_LOG_SECTORS;
+            memset(sim_flash_mem + LOG_REGION_OFFSET + sector * FLASH_SECTOR_SIZE, 0xFF,
+                   FLASH_SECTOR_SIZE);
+            model_valid = false;
+            break;
+        }
+        case 6: {
+            uint32_t ops = fuzz_u8(&in) % 16;
+            do_power_loss(ops, fuzz_u16(&in) % (FLASH_SECTOR_SIZE + 1));
+            break;
+        }
+        case 7:
+            reboot();
+            break;
+        case 8: {   /* スロットレコード (有効な形に寄せる) */
+            slot_record_t rec;
+            uint8_t slot = fuzz_u8(&in) % (MAX_DEVICE_SLOTS + 1);
+            uint8_t b = fuzz_u8(&in);
+            rec.version = (b & 0x80) ? (uint8_t)(b & 0x7F) : 1;
+            rec.paired = (b & 0x40) ? (uint8_t)(b & 0x3F) : 1;
+            rec.db_index = (int8_t)(fuzz_u8(&in) % (NVM_NUM_DEVICE_DB_ENTRIES + 3)) - 1;
+            rec.addr_type = fuzz_u8(&in) % 3;
+            memset(rec.bd_addr, fuzz_u8(&in) % 4, BD_ADDR_LEN);
+            do_write(1 + slot, (const uint8_t *)&rec, sizeof(rec));
+            break;
+        }
+        case 9: {   /* ボンドエントリ (sim_btstack.c の形式) */
+            uint8_t entry[1 + BD_ADDR_LEN];
+            uint8_t index = fuzz_u8(&in) % NVM_NUM_DEVICE_DB_ENTRIES;
+            entry[0] = fuzz_u8(&in) % 2;
+            memset(entry + 1, fuzz_u8(&in) % 4, BD_ADDR_LEN);
+            do_write(8 + index, entry, sizeof(entry));
+            break;
+        }
+        case 10:
+            boot_firmware();
+            break;
+        case 11: {  /* 書けるタグを順に1バイト書く (保留テーブルを満杯にする) */
+            uint8_t v = fuzz_u8(&in);
+            for (uint32_t i = 0; i < TAG_COUNT; i++) {
+                if (tags[i] != 0xFFFFFFFFu) do_write(i, &v, 1);
+            }
+            break;
+        }
+        default:
+            do_slot_action(&in);
+            break;
+        }
+        check_store();
+    }
+
+    /* 最後に全件コミットして起動し直す */
+    sim_flash_power_cycle();
+    do_commit();
+    boot_firmware();
+    check_store();
+    check_bank_untouched();
+    return 0;
+}
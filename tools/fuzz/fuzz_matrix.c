@@ -0,0 +1,514 @@
+/**
+ * @file fuzz_matrix.c
+ * @brief ファズターゲット: マトリクススキャン/デバウンスとレポート組立て・パイプライン
+ *
+ * 仮想 GPIO (tools/replay/sim_hal.c) 上のキースイッチを入力どおりに開閉し,
+ * keyboard_matrix.c のスキャン+デバウンス, Boot/NKRO レポートの組立て,
+ * hid_pipeline.c の送信待ちフレーム (2シンク, Boot/NKRO 切替, 未接続) を実コードで動かす。
+ * デバウンス時間 (0-30ms) と固定/適応デバウンスも入力から選ぶ。
+ *
+ * 命令 (1バイト + 引数):
+ *   スイッチ反転 / 時刻を進める / スキャン+レポート送信 / シンクから取り出す /
+ *   マウス入力 / 送信先切替・Boot 切替・接続状態切替・全キー解放
+ *
+ * 不変条件:
+ *   - デバウンス: 確定した状態は接点の状態と一致し, 連続2スキャン以上かつデバウンス時間
+ *     (固定なら設定値, 適応ならスキャン直前のキーごとの値) 以上変化が続いたときだけ確定する。
+ *     条件を満たしたのに確定しないのは、先に始まった他のキーの変化がまだ条件を満たして
+ *     いないとき (確定は変化の始まった順) だけ。適応時のキーごとの値は上下限の範囲内
+ *   - Boot レポート: 8 バイト, 予約バイト 0, キーは最大6個で重複なし, 押されているキーだけ
+ *   - NKRO レポート: modifier とビットマップが押下中のキー (Fn と Fn+1/2/3 を除く) と一致
+ *   - パイプライン: フレームの長さ・Report ID, シンクごとの送信待ちの順序と内容
+ *     (タップ・クリックが上書きで消えないこと), Boot のシンクにマウスフレームが積まれないこと
+ *
+ * ビルド (リポジトリのルートで, libFuzzer):
+ *   mkdir -p build && clang -g -O1 -fsanitize=fuzzer,address,undefined \
+ *      -Itools/fuzz -Itools/fuzz/hal -Itools/replay -Itools/replay/hal -Iinclude \
+ *      -o build/fuzz_matrix \
+ *      tools/fuzz/fuzz_matrix.c tools/replay/sim_hal.c \
+ *      src/keyboard_matrix.c src/keymap.c src/hid_pipeline.c src/perf.c
+ *   build/fuzz_matrix -max_total_time=60 corpus/matrix
+ *
+ * clang が無い場合は -fsanitize=fuzzer の代わりに tools/fuzz/fuzz_driver.c をリンクする
+ * (docs/DEVELOPMENT_GUIDE.md「ファズテスト (ホスト)」)。
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "fuzz_common.h"
+#include "sim_hal.h"
+#include "pico/time.h"
+#include "project_config.h"
+#include "keyboard_matrix.h"
+#include "keymap.h"
+#include "hid_keycodes.h"
+#include "hid_pipeline.h"
+#include "config_store.h"
+
+/* keyboard_matrix.c と同じ配線 (行 GP0-7, 列 GP8-21) */
+#define ROW_GPIO(r)    (r)
+#define COL_GPIO(c)    (8 + (c))
+
+#define SINK_COUNT     2
+#define START_US       1000000   /* 時刻 0ms はデバウンスタイマーの「停止中」と区別できない */
+#define MAX_DEBOUNCE   30
+#define MODEL_DEPTH    2         /* hid_pipeline.c の送信待ち数 */
+
+/* ============================================================
+ * 状態と期待値モデル
+ * ============================================================ */
+typedef struct {
+    /* 環境 (シンクのコールバックが返す値) */
+    bool ready;
+    bool boot;
+    /* 期待値 (送信待ちは古い順, 種類ごとに MODEL_DEPTH 件まで) */
+    int kb_count;
+    bool kb_boot[MODEL_DEPTH];
+    uint8_t kb[MODEL_DEPTH][NKRO_REPORT_SIZE];
+    uint8_t kb_sent[NKRO_REPORT_SIZE];    /* 最後に取り出したキー状態 */
+    int mouse_count;
+    uint8_t mouse_buttons[MODEL_DEPTH];
+    uint8_t mouse_sent;                   /* 最後に取り出したボタン状態 */
+} sink_model_t;
+
+static uint32_t debounce_ms;
+static bool adaptive;
+static bool contact[MATRIX_ROWS][MATRIX_COLS];      /* 接点 (生の状態) */
+static bool debounced[MATRIX_ROWS][MATRIX_COLS];    /* 前回スキャン後の確定状態 */
+static uint32_t run_start_ms[MATRIX_ROWS][MATRIX_COLS];  /* 接点≠確定 が続いている最初のスキャン */
+static uint32_t run_scans[MATRIX_ROWS][MATRIX_COLS];
+
+static sink_model_t sinks[SINK_COUNT];
+static int sink_ids[SINK_COUNT];
+static int active;
+static uint8_t keys[NKRO_REPORT_SIZE];
+
+uint32_t config_get(config_key_t key) {
+    if (key == CFG_DEBOUNCE_MS) return debounce_ms;
+    if (key == CFG_DEBOUNCE_ADAPT) return adaptive;
+    return 0;
+}
+
+/* 適応デバウンスでキーが取りうるデバウンス時間の上限 */
+static uint32_t max_window_ms(void) {
+    if (!adaptive) return debounce_ms;
+    return debounce_ms > DEBOUNCE_ADAPT_MAX_MS ? debounce_ms : DEBOUNCE_ADAPT_MAX_MS;
+}
+
+static bool sink_is_ready(void *ctx) {
+    return ((const sink_model_t *)ctx)->ready;
+}
+
+static bool sink_wants_boot(void *ctx) {
+    return ((const sink_model_t *)ctx)->boot;
+}
+
+static const hid_sink_t sink_defs[SINK_COUNT] = {
+    { .name = "A", .is_ready = sink_is_ready, .wants_boot = sink_wants_boot, .ctx = &sinks[0] },
+    { .name = "B", .is_ready = sink_is_ready, .wants_boot = sink_wants_boot, .ctx = &sinks[1] },
+};
+
+static const hid_pipeline_port_t pipeline_port = {
+    .now_us = time_us_32,
+};
+
+/*
+ * hid_pipeline.c の queue_keyboard と同じ条件で期待値を更新:
+ * 末尾で変化したキーが再び変化しないなら末尾に上書き, 一杯なら末尾に上書き, それ以外は追加
+ */
+static void model_queue_keyboard(int s, const uint8_t *nkro) {
+    sink_model_t *m = &sinks[s];
+    if (!m->ready) return;
+
+    bool overwrite = m->kb_count == MODEL_DEPTH;
+    if (m->kb_count > 0 && !overwrite) {
+        const uint8_t *tail = m->kb[m->kb_count - 1];
+        const uint8_t *prev = (m->kb_count > 1) ? m->kb[m->kb_count - 2] : m->kb_sent;
+        overwrite = true;
+        for (int i = 0; i < NKRO_REPORT_SIZE; i++) {
+            if ((tail[i] ^ prev[i]) & (nkro[i] ^ tail[i])) overwrite = false;
+        }
+    }
+    if (!overwrite) m->kb_count++;
+    m->kb_boot[m->kb_count - 1] = m->boot;
+    memcpy(m->kb[m->kb_count - 1], nkro, NKRO_REPORT_SIZE);
+}
+
+static void model_pop_keyboard(sink_model_t *m) {
+    memcpy(m->kb_sent, m->kb[0], NKRO_REPORT_SIZE);
+    memmove(m->kb[0], m->kb[1], sizeof(m->kb[0]) * (MODEL_DEPTH - 1));
+    memmove(m->kb_boot, m->kb_boot + 1, sizeof(m->kb_boot[0]) * (MODEL_DEPTH - 1));
+    m->kb_count--;
+}
+
+static void model_pop_mouse(sink_model_t *m) {
+    m->mouse_sent = m->mouse_buttons[0];
+    memmove(m->mouse_buttons, m->mouse_buttons + 1, MODEL_DEPTH - 1);
+    m->mouse_count--;
+}
+
+static void set_active(int s) {
+    static const uint8_t released[NKRO_REPORT_SIZE] = {0};
+    hid_pipeline_set_active(s < 0 ? HID_SINK_NONE : sink_ids[s]);
+    if (s == active) return;
+    if (active >= 0) {
+        sinks[active].mouse_count = 0;
+        sinks[active].mouse_sent = 0;
+        model_queue_keyboard(active, released);
+    }
+    active = s;
+    if (active >= 0) model_queue_keyboard(active, keys);
+}
+
+/* ============================================================
+ * 不変条件
+ * ============================================================ */
+
+/* 確定状態から期待される modifier と Usage 集合 */
+static uint8_t expected_keys(bool usage[256], int *positions) {
+    bool fn = false;
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (debounced[r][c] && keymap_get_keycode(r, c) == KEY_FN) fn = true;
+        }
+    }
+
+    uint8_t mods = 0;
+    memset(usage, 0, 256 * sizeof(bool));
+    *positions = 0;
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            if (!debounced[r][c]) continue;
+            uint8_t kc = keymap_get_keycode(r, c);
+            if (kc == KEY_NONE || kc == KEY_FN) continue;
+            if (fn && (kc == KEY_1 || kc == KEY_2 || kc == KEY_3)) continue;
+            if (IS_MODIFIER(kc)) {
+                mods |= (uint8_t)MODIFIER_BIT(kc);
+            } else {
+                usage[kc] = true;
+                (*positions)++;
+            }
+        }
+    }
+    return mods;
+}
+
+/* Boot 形式として正しいか (8 バイト, 予約 0, キーは先頭詰めで最大6個, 重複なし) */
+static int check_boot_shape(const uint8_t *report) {
+    int n = 0;
+    FUZZ_CHECK(report[1] == 0, "boot reserved byte 0x%02x", report[1]);
+    for (int i = 2; i < BOOT_REPORT_SIZE; i++) {
+        if (report[i] == KEY_NONE) continue;
+        FUZZ_CHECK(i == 2 + n, "boot keycodes not packed");
+        FUZZ_CHECK(report[i] != KEY_FN && !IS_MODIFIER(report[i]), "boot keycode 0x%02x",
+                   report[i]);
+        for (int j = 2; j < i; j++) {
+            FUZZ_CHECK(report[j] != report[i], "boot keycode 0x%02x duplicated", report[i]);
+        }
+        n++;
+    }
+    FUZZ_CHECK(n <= 6, "boot report has %d keys", n);
+    return n;
+}
+
+static void check_reports(const uint8_t *nkro, const uint8_t *boot) {
+    bool usage[256];
+    int positions;
+    uint8_t mods = expected_keys(usage, &positions);
+
+    FUZZ_CHECK(nkro[0] == mods, "nkro modifier 0x%02x != 0x%02x", nkro[0], mods);
+    for (int u = 0; u < NKRO_BITMAP_BYTES * 8; u++) {
+        bool bit = (nkro[1 + u / 8] >> (u % 8)) & 1;
+        FUZZ_CHECK(bit == usage[u], "nkro usage 0x%02x bit %d", u, bit);
+    }
+
+    FUZZ_CHECK(boot[0] == mods, "boot modifier 0x%02x != 0x%02x", boot[0], mods);
+    int n = check_boot_shape(boot);
+    for (int i = 0; i < n; i++) {
+        FUZZ_CHECK(usage[boot[2 + i]], "boot keycode 0x%02x not pressed", boot[2 + i]);
+    }
+    FUZZ_CHECK(n == (positions < 6 ? positions : 6), "boot report has %d of %d keys",
+               n, positions);
+}
+
+/* パイプラインのフレームを期待値と照合 */
+static void check_frame(int s, const hid_frame_t *f) {
+    const sink_model_t *m = &sinks[s];
+    FUZZ_CHECK(f->post_us <= time_us_32(), "frame posted in the future");
+
+    if (f->kind == HID_FRAME_MOUSE) {
+        FUZZ_CHECK(m->mouse_count > 0, "unexpected mouse frame on sink %d", s);
+        FUZZ_CHECK(f->len == 1 + MOUSE_REPORT_SIZE, "mouse frame len %u", f->len);
+        FUZZ_CHECK(f->data[0] == HID_REPORT_ID_MOUSE, "mouse report id %u", f->data[0]);
+        FUZZ_CHECK(f->data[1] == m->mouse_buttons[0], "mouse buttons 0x%02x != 0x%02x",
+                   f->data[1], m->mouse_buttons[0]);
+        return;
+    }
+
+    FUZZ_CHECK(m->kb_count > 0, "unexpected keyboard frame on sink %d", s);
+    const uint8_t *kb = m->kb[0];
+    if (f->kind == HID_FRAME_KEYBOARD) {
+        FUZZ_CHECK(!m->kb_boot[0], "NKRO frame queued for a boot protocol host");
+        FUZZ_CHECK(f->len == 1 + NKRO_REPORT_SIZE, "nkro frame len %u", f->len);
+        FUZZ_CHECK(f->data[0] == HID_REPORT_ID_KEYBOARD, "keyboard report id %u", f->data[0]);
+        FUZZ_CHECK(memcmp(f->data + 1, kb, NKRO_REPORT_SIZE) == 0, "stale nkro frame");
+        return;
+    }
+
+    FUZZ_CHECK(f->kind == HID_FRAME_BOOT_KEYBOARD, "frame kind %d", f->kind);
+    FUZZ_CHECK(m->kb_boot[0], "boot frame queued for a report protocol host");
+    FUZZ_CHECK(f->len == BOOT_REPORT_SIZE, "boot frame len %u", f->len);
+    FUZZ_CHECK(f->data[0] == kb[0], "boot frame modifier");
+    int n = check_boot_shape(f->data);
+
+    /* 使用番号の小さい順に最大6キー */
+    int expect = 0;
+    for (int u = 0; u < NKRO_BITMAP_BYTES * 8 && expect < 6; u++) {
+        if (!((kb[1 + u / 8] >> (u % 8)) & 1)) continue;
+        FUZZ_CHECK(f->data[2 + expect] == u, "boot frame key %d is 0x%02x, want 0x%02x",
+                   expect, f->data[2 + expect], u);
+        expect++;
+    }
+    FUZZ_CHECK(n == expect, "boot frame has %d keys, want %d", n, expect);
+}
+
+static void check_pending(void) {
+    bool idle = true;
+    for (int s = 0; s < SINK_COUNT; s++) {
+        bool kb = hid_pipeline_has_pending(sink_ids[s], HID_FRAME_MASK_KEYBOARD);
+        bool mouse = hid_pipeline_has_pending(sink_ids[s], HID_FRAME_MASK_MOUSE);
+        FUZZ_CHECK(kb == (sinks[s].kb_count > 0), "sink %d keyboard pending %d", s, kb);
+        FUZZ_CHECK(mouse == (sinks[s].mouse_count > 0), "sink %d mouse pending %d", s, mouse);
+        if (kb || mouse) idle = false;
+    }
+    FUZZ_CHECK(hid_pipeline_is_idle() == idle, "is_idle %d", !idle);
+}
+
+/* ============================================================
+ * 操作
+ * ============================================================ */
+
+/* 1回のスキャンとデバウンスの検査, 変化があればレポートを組み立てて送る */
+static void matrix_task(void) {
+    static uint8_t window[MATRIX_ROWS][MATRIX_COLS];
+    uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+    /* 確定判定はスキャン直前のデバウンス時間で行われる (調整は判定の後)。
+     * 初回スキャンの前は未設定だが, 初回は確定し得ないので影響しない */
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            matrix_debounce_stats_t st;
+            matrix_get_debounce_stats(r, c, &st);
+            window[r][c] = st.window_ms;
+        }
+    }
+    matrix_scan();
+
+    /* 確定条件 (連続2スキャン以上 + デバウンス時間) を満たしたか */
+    static bool due[MATRIX_ROWS][MATRIX_COLS];
+    bool waiting = false;
+    uint32_t oldest_waiting = 0;   /* 条件を満たしていない変化のうち最も早い開始 */
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            uint32_t window_ms = adaptive ? window[r][c] : debounce_ms;
+            bool differ = contact[r][c] != debounced[r][c];
+            if (differ) {
+                if (run_scans[r][c] == 0) run_start_ms[r][c] = now_ms;
+                run_scans[r][c]++;
+            } else {
+                run_scans[r][c] = 0;
+            }
+            due[r][c] = run_scans[r][c] >= 2 && now_ms - run_start_ms[r][c] >= window_ms;
+            if (differ && !due[r][c] && (!waiting || run_start_ms[r][c] < oldest_waiting)) {
+                oldest_waiting = run_start_ms[r][c];
+                waiting = true;
+            }
+        }
+    }
+
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            matrix_debounce_stats_t st;
+            matrix_get_debounce_stats(r, c, &st);
+            if (adaptive) {
+                FUZZ_CHECK(st.window_ms >= DEBOUNCE_ADAPT_MIN_MS && st.window_ms <= max_window_ms(),
+                           "key %d,%d window %u ms out of range", r, c, st.window_ms);
+            } else {
+                FUZZ_CHECK(st.window_ms == debounce_ms, "key %d,%d window %u ms in fixed mode",
+                           r, c, st.window_ms);
+            }
+            bool now = matrix_key_is_pressed(r, c);
+            bool differ = contact[r][c] != debounced[r][c];
+            /* 先に始まった変化が条件を満たしていなければ待つ */
+            bool held = waiting && run_start_ms[r][c] > oldest_waiting;
+
+            if (now != debounced[r][c]) {
+                FUZZ_CHECK(now == contact[r][c], "key %d,%d committed against the contact", r, c);
+                FUZZ_CHECK(due[r][c], "key %d,%d committed early (%lu scans, %lu ms)", r, c,
+                           (unsigned long)run_scans[r][c],
+                           (unsigned long)(now_ms - run_start_ms[r][c]));
+                FUZZ_CHECK(!held, "key %d,%d committed before a change started %lu ms earlier",
+                           r, c, (unsigned long)(run_start_ms[r][c] - oldest_waiting));
+                debounced[r][c] = now;
+                run_scans[r][c] = 0;
+            } else {
+                FUZZ_CHECK(!differ || !due[r][c] || held, "key %d,%d not committed after %lu ms",
+                           r, c, (unsigned long)(now_ms - run_start_ms[r][c]));
+            }
+        }
+    }
+
+    if (!matrix_has_changed()) return;
+
+    uint8_t nkro[NKRO_REPORT_SIZE];
+    uint8_t boot[BOOT_REPORT_SIZE];
+    matrix_build_nkro_report(nkro);
+    matrix_build_boot_report(boot);
+    check_reports(nkro, boot);
+
+    memcpy(keys, nkro, sizeof(keys));
+    hid_pipeline_set_keys(nkro);
+    if (active >= 0) model_queue_keyboard(active, keys);
+}
+
+static void drain(int s, uint8_t mask) {
+    hid_frame_t frame;
+    while (hid_pipeline_peek(sink_ids[s], mask, &frame)) {
+        check_frame(s, &frame);
+        hid_pipeline_consume(sink_ids[s], frame.kind);
+        if (frame.kind == HID_FRAME_MOUSE) {
+            model_pop_mouse(&sinks[s]);
+        } else {
+            model_pop_keyboard(&sinks[s]);
+        }
+    }
+}
+
+static void add_mouse(uint8_t buttons, int8_t dx, int8_t dy, int8_t wheel, int8_t pan) {
+    hid_pipeline_add_mouse(buttons, dx, dy, wheel, pan);
+    if (active < 0 || !sinks[active].ready || sinks[active].boot) return;
+    /* 末尾で変化したボタンが戻らない (加算) か一杯 (上書き) なら末尾, それ以外は追加 */
+    sink_model_t *m = &sinks[active];
+    bool append = m->mouse_count == 0;
+    if (!append && m->mouse_count < MODEL_DEPTH) {
+        uint8_t tail = m->mouse_buttons[m->mouse_count - 1];
+        uint8_t prev = (m->mouse_count > 1) ? m->mouse_buttons[m->mouse_count - 2] : m->mouse_sent;
+        append = ((tail ^ prev) & (buttons ^ tail)) != 0;
+    }
+    if (append) m->mouse_count++;
+    m->mouse_buttons[m->mouse_count - 1] = buttons;
+}
+
+static void advance_us(uint32_t us) {
+    sim_set_time_us(sim_now_us() + us);
+}
+
+/* ============================================================
+ * エントリポイント
+ * ============================================================ */
+
+int LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void)argc;
+    (void)argv;
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    fuzz_input_t in = { data, size, 0 };
+
+    sim_hal_reset();
+    sim_set_time_us(START_US);
+    uint8_t mode = fuzz_u8(&in);
+    debounce_ms = mode % (MAX_DEBOUNCE + 1);
+    adaptive = mode & 0x80;
+    memset(contact, 0, sizeof(contact));
+    memset(debounced, 0, sizeof(debounced));
+    memset(run_scans, 0, sizeof(run_scans));
+    memset(sinks, 0, sizeof(sinks));
+    memset(keys, 0, sizeof(keys));
+    sinks[0].ready = true;
+    sinks[1].ready = true;
+
+    matrix_init();
+    hid_pipeline_init(&pipeline_port);
+    for (int s = 0; s < SINK_COUNT; s++) {
+        sink_ids[s] = hid_pipeline_add_sink(&sink_defs[s]);
+        FUZZ_CHECK(sink_ids[s] != HID_SINK_NONE, "add_sink %d", s);
+    }
+    active = -1;
+    set_active(0);
+
+    while (fuzz_more(&in)) {
+        uint8_t op = fuzz_u8(&in);
+        switch (op % 8) {
+        case 0:
+        case 1:
+        case 2: {   /* スイッチ反転 */
+            uint8_t key = fuzz_u8(&in) % (MATRIX_ROWS * MATRIX_COLS);
+            uint8_t r = key / MATRIX_COLS;
+            uint8_t c = key % MATRIX_COLS;
+            contact[r][c] = !contact[r][c];
+            sim_set_switch(ROW_GPIO(r), COL_GPIO(c), contact[r][c]);
+            break;
+        }
+        case 3:
+            advance_us(((uint32_t)fuzz_u8(&in) + 1) * 100);
+            break;
+        case 4:
+            matrix_task();
+            break;
+        case 5: {
+            uint8_t b = fuzz_u8(&in);
+            drain(b & 1, (uint8_t)(1 + (b >> 1) % 3));
+            break;
+        }
+        case 6: {
+            uint8_t buttons = fuzz_u8(&in) & 0x1F;
+            int8_t dx = (int8_t)fuzz_u8(&in);
+            int8_t dy = (int8_t)fuzz_u8(&in);
+            int8_t wheel = (int8_t)fuzz_u8(&in);
+            int8_t pan = (int8_t)fuzz_u8(&in);
+            add_mouse(buttons, dx, dy, wheel, pan);
+            break;
+        }
+        default: {
+            uint8_t b = fuzz_u8(&in);
+            int s = (b >> 2) & 1;
+            switch (b % 4) {
+            case 0:
+                set_active((int)((b >> 2) % 3) - 1);
+                break;
+            case 1:
+                sinks[s].boot = !sinks[s].boot;
+                break;
+            case 2:
+                sinks[s].ready = !sinks[s].ready;
+                break;
+            default:
+                memset(keys, 0, sizeof(keys));
+                hid_pipeline_release_keys();
+                if (active >= 0) model_queue_keyboard(active, keys);
+                break;
+            }
+            break;
+        }
+        }
+        check_pending();
+    }
+
+    /* 接点を固定してデバウンス時間より長くスキャンすれば全キーが確定する */
+    for (uint32_t i = 0; i < max_window_ms() + 3; i++) {
+        advance_us(1000);
+        matrix_task();
+    }
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            FUZZ_CHECK(matrix_key_is_pressed(r, c) == contact[r][c], "key %d,%d never settled",
+                       r, c);
+        }
+    }
+    for (int s = 0; s < SINK_COUNT; s++) drain(s, HID_FRAME_MASK_ALL);
+    check_pending();
+    return 0;
+}
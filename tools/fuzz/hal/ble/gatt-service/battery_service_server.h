@@ -0,0 +1,14 @@
+/**
+ * @file battery_service_server.h
+ * @brief BTstack battery_service_server.h の代替 (sim_ble.c)
+ */
+
+#ifndef SIM_BATTERY_SERVICE_SERVER_H
+#define SIM_BATTERY_SERVICE_SERVER_H
+
+#include <stdint.h>
+
+void battery_service_server_init(uint8_t battery_value);
+void battery_service_server_set_battery_value(uint8_t battery_value);
+
+#endif /* SIM_BATTERY_SERVICE_SERVER_H */
@@ -0,0 +1,11 @@
+/**
+ * @file device_information_service_server.h
+ * @brief BTstack device_information_service_server.h の代替 (sim_ble.c)
+ */
+
+#ifndef SIM_DEVICE_INFORMATION_SERVICE_SERVER_H
+#define SIM_DEVICE_INFORMATION_SERVICE_SERVER_H
+
+void device_information_service_server_init(void);
+
+#endif /* SIM_DEVICE_INFORMATION_SERVICE_SERVER_H */
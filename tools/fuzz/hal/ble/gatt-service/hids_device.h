@@ -0,0 +1,22 @@
+/**
+ * @file hids_device.h
+ * @brief BTstack hids_device.h の代替 (sim_ble.c)
+ */
+
+#ifndef SIM_HIDS_DEVICE_H
+#define SIM_HIDS_DEVICE_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+
+void hids_device_init(uint8_t hid_country_code, const uint8_t *hid_descriptor,
+                      uint16_t hid_descriptor_size);
+void hids_device_register_packet_handler(btstack_packet_handler_t callback);
+void hids_device_request_can_send_now_event(hci_con_handle_t con_handle);
+void hids_device_send_input_report(hci_con_handle_t con_handle, const uint8_t *report,
+                                   uint16_t report_len);
+void hids_device_send_boot_keyboard_input_report(hci_con_handle_t con_handle,
+                                                 const uint8_t *report, uint16_t report_len);
+
+#endif /* SIM_HIDS_DEVICE_H */
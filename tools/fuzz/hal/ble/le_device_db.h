@@ -0,0 +1,15 @@
+/**
+ * @file le_device_db.h
+ * @brief BTstack ble/le_device_db.h の代替 (sim_btstack.c)
+ */
+
+#ifndef SIM_BLE_LE_DEVICE_DB_H
+#define SIM_BLE_LE_DEVICE_DB_H
+
+#include "btstack.h"
+
+int  le_device_db_max_count(void);
+void le_device_db_info(int index, int *addr_type, bd_addr_t addr, sm_key_t irk);
+void le_device_db_remove(int index);
+
+#endif /* SIM_BLE_LE_DEVICE_DB_H */
@@ -0,0 +1,13 @@
+/**
+ * @file le_device_db_tlv.h
+ * @brief BTstack ble/le_device_db_tlv.h の代替 (sim_btstack.c)
+ */
+
+#ifndef SIM_BLE_LE_DEVICE_DB_TLV_H
+#define SIM_BLE_LE_DEVICE_DB_TLV_H
+
+#include "btstack_tlv.h"
+
+void le_device_db_tlv_configure(const btstack_tlv_t *tlv_impl, void *tlv_context);
+
+#endif /* SIM_BLE_LE_DEVICE_DB_TLV_H */
@@ -0,0 +1,285 @@
+/**
+ * @file btstack.h
+ * @brief BTstack btstack.h の代替 (device_slot.c / ble_hid.c が使う型・定数・関数のみ)
+ *
+ * イベントのバイト配置と取り出し関数は BTstack (btstack_event.h) と同じ。
+ * 関数の実体は tools/fuzz/sim_ble.c (HCI/GAP/SM/ATT/HIDS, run loop)。
+ */
+
+#ifndef SIM_BTSTACK_MAIN_H
+#define SIM_BTSTACK_MAIN_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "btstack_config.h"
+#include "btstack_tlv.h"
+
+#ifndef BD_ADDR_LEN
+#define BD_ADDR_LEN  6
+#endif
+
+#define UNUSED(x)  (void)(x)
+
+typedef uint8_t bd_addr_t[BD_ADDR_LEN];
+typedef uint8_t sm_key_t[16];
+typedef uint16_t hci_con_handle_t;
+
+typedef enum {
+    BD_ADDR_TYPE_LE_PUBLIC = 0,
+    BD_ADDR_TYPE_LE_RANDOM = 1,
+    BD_ADDR_TYPE_UNKNOWN   = 0xfe,
+} bd_addr_type_t;
+
+#define HCI_CON_HANDLE_INVALID  0xffff
+
+/* ============================================================
+ * パケット種別・イベントコード (BTstack と同じ値)
+ * ============================================================ */
+#define HCI_EVENT_PACKET                            0x04
+
+#define HCI_EVENT_DISCONNECTION_COMPLETE            0x05
+#define HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS       0x13
+#define HCI_EVENT_LE_META                           0x3e
+#define BTSTACK_EVENT_STATE                         0x60
+#define GATT_EVENT_MTU                              0xab
+#define ATT_EVENT_MTU_EXCHANGE_COMPLETE             0xb5
+#define SM_EVENT_JUST_WORKS_REQUEST                 0xc8
+#define SM_EVENT_IDENTITY_RESOLVING_FAILED          0xcf
+#define SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED       0xd0
+#define SM_EVENT_PAIRING_COMPLETE                   0xd4
+#define HCI_EVENT_HIDS_META                         0xef
+
+#define HCI_SUBEVENT_LE_CONNECTION_COMPLETE         0x01
+#define HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE  0x03
+#define HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE          0x07
+#define HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE         0x0c
+
+#define HIDS_SUBEVENT_CAN_SEND_NOW                       0x01
+#define HIDS_SUBEVENT_PROTOCOL_MODE                      0x02
+#define HIDS_SUBEVENT_BOOT_MOUSE_INPUT_REPORT_ENABLE     0x03
+#define HIDS_SUBEVENT_BOOT_KEYBOARD_INPUT_REPORT_ENABLE  0x04
+#define HIDS_SUBEVENT_INPUT_REPORT_ENABLE                0x05
+
+#define HCI_STATE_OFF      0
+#define HCI_STATE_WORKING  2
+
+#define ERROR_CODE_SUCCESS              0x00
+#define ERROR_CODE_ADVERTISING_TIMEOUT  0x3c
+
+#define ATT_DEFAULT_MTU  23
+
+#define IO_CAPABILITY_NO_INPUT_NO_OUTPUT  3
+#define SM_AUTHREQ_BONDING                0x01
+#define SM_AUTHREQ_SECURE_CONNECTION      0x08
+
+#define BLUETOOTH_DATA_TYPE_FLAGS                                      0x01
+#define BLUETOOTH_DATA_TYPE_INCOMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS 0x02
+#define BLUETOOTH_DATA_TYPE_COMPLETE_LOCAL_NAME                        0x09
+#define BLUETOOTH_DATA_TYPE_APPEARANCE                                 0x19
+
+/* ============================================================
+ * イベントの取り出し (btstack_event.h と同じ配置)
+ * ============================================================ */
+static inline uint16_t little_endian_read_16(const uint8_t *buffer, int position) {
+    return (uint16_t)(buffer[position] | ((uint16_t)buffer[position + 1] << 8));
+}
+
+/* BTstack はアドレスを逆順で格納する */
+static inline void reverse_bd_addr(const uint8_t *src, uint8_t *dest) {
+    for (int i = 0; i < BD_ADDR_LEN; i++) dest[i] = src[BD_ADDR_LEN - 1 - i];
+}
+
+static inline uint8_t hci_event_packet_get_type(const uint8_t *event) {
+    return event[0];
+}
+
+static inline uint8_t btstack_event_state_get_state(const uint8_t *event) {
+    return event[2];
+}
+
+static inline uint8_t hci_event_le_meta_get_subevent_code(const uint8_t *event) {
+    return event[2];
+}
+
+static inline uint8_t hci_event_hids_meta_get_subevent_code(const uint8_t *event) {
+    return event[2];
+}
+
+static inline hci_con_handle_t hci_event_disconnection_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+
+static inline uint8_t hci_subevent_le_connection_complete_get_status(const uint8_t *event) {
+    return event[3];
+}
+static inline hci_con_handle_t hci_subevent_le_connection_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint8_t hci_subevent_le_connection_complete_get_peer_address_type(const uint8_t *event) {
+    return event[7];
+}
+static inline void hci_subevent_le_connection_complete_get_peer_address(const uint8_t *event, bd_addr_t address) {
+    reverse_bd_addr(&event[8], address);
+}
+static inline uint16_t hci_subevent_le_connection_complete_get_conn_interval(const uint8_t *event) {
+    return little_endian_read_16(event, 14);
+}
+
+static inline hci_con_handle_t hci_subevent_le_connection_update_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint16_t hci_subevent_le_connection_update_complete_get_conn_interval(const uint8_t *event) {
+    return little_endian_read_16(event, 6);
+}
+
+static inline uint8_t hci_subevent_le_phy_update_complete_get_status(const uint8_t *event) {
+    return event[3];
+}
+static inline hci_con_handle_t hci_subevent_le_phy_update_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint8_t hci_subevent_le_phy_update_complete_get_tx_phy(const uint8_t *event) {
+    return event[6];
+}
+static inline uint8_t hci_subevent_le_phy_update_complete_get_rx_phy(const uint8_t *event) {
+    return event[7];
+}
+
+static inline hci_con_handle_t hci_subevent_le_data_length_change_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint16_t hci_subevent_le_data_length_change_get_max_tx_octets(const uint8_t *event) {
+    return little_endian_read_16(event, 5);
+}
+static inline uint16_t hci_subevent_le_data_length_change_get_max_rx_octets(const uint8_t *event) {
+    return little_endian_read_16(event, 9);
+}
+
+static inline hci_con_handle_t att_event_mtu_exchange_complete_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint16_t att_event_mtu_exchange_complete_get_MTU(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+
+static inline hci_con_handle_t gatt_event_mtu_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint16_t gatt_event_mtu_get_MTU(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+
+static inline hci_con_handle_t sm_event_just_works_request_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline hci_con_handle_t sm_event_identity_resolving_failed_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline hci_con_handle_t sm_event_identity_resolving_succeeded_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint16_t sm_event_identity_resolving_succeeded_get_index(const uint8_t *event) {
+    return little_endian_read_16(event, 18);
+}
+static inline hci_con_handle_t sm_event_pairing_complete_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint8_t sm_event_pairing_complete_get_status(const uint8_t *event) {
+    return event[11];
+}
+
+static inline hci_con_handle_t hids_subevent_can_send_now_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline hci_con_handle_t hids_subevent_protocol_mode_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_protocol_mode_get_protocol_mode(const uint8_t *event) {
+    return event[5];
+}
+static inline hci_con_handle_t hids_subevent_boot_keyboard_input_report_enable_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_boot_keyboard_input_report_enable_get_enable(const uint8_t *event) {
+    return event[5];
+}
+static inline hci_con_handle_t hids_subevent_input_report_enable_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_input_report_enable_get_enable(const uint8_t *event) {
+    return event[5];
+}
+
+/* ============================================================
+ * コールバック登録・タイマー (sim_ble.c)
+ * ============================================================ */
+typedef void (*btstack_packet_handler_t)(uint8_t packet_type, uint16_t channel,
+                                         uint8_t *packet, uint16_t size);
+
+typedef struct btstack_packet_callback_registration {
+    struct btstack_packet_callback_registration *next;
+    btstack_packet_handler_t callback;
+} btstack_packet_callback_registration_t;
+
+typedef struct btstack_timer_source {
+    struct btstack_timer_source *next;
+    uint32_t timeout;                   /* btstack_run_loop_get_time_ms() 基準 */
+    void (*process)(struct btstack_timer_source *ts);
+    void *context;
+} btstack_timer_source_t;
+
+void btstack_run_loop_set_timer(btstack_timer_source_t *ts, uint32_t timeout_in_ms);
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t *ts,
+                                        void (*process)(btstack_timer_source_t *ts));
+void btstack_run_loop_add_timer(btstack_timer_source_t *ts);
+int  btstack_run_loop_remove_timer(btstack_timer_source_t *ts);
+uint32_t btstack_run_loop_get_time_ms(void);
+
+/* ============================================================
+ * HCI / GAP / L2CAP / SM / ATT / GATT Client (sim_ble.c)
+ * ============================================================ */
+typedef struct {
+    uint16_t opcode;
+    const char *format;
+} hci_cmd_t;
+
+extern const hci_cmd_t hci_le_set_data_length;
+
+void hci_add_event_handler(btstack_packet_callback_registration_t *callback_handler);
+int  hci_power_on(void);
+int  hci_can_send_command_packet_now(void);
+uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...);
+
+uint8_t gap_disconnect(hci_con_handle_t handle);
+void gap_set_connection_parameters(uint16_t conn_interval_min, uint16_t conn_interval_max,
+                                   uint16_t conn_latency, uint16_t supervision_timeout);
+uint8_t gap_le_set_phy(hci_con_handle_t con_handle, uint8_t all_phys, uint8_t tx_phys,
+                       uint8_t rx_phys, uint8_t phy_options);
+void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max,
+                                   uint8_t adv_type, uint8_t direct_address_typ,
+                                   bd_addr_t direct_address, uint8_t channel_map,
+                                   uint8_t filter_policy);
+void gap_advertisements_set_data(uint8_t advertising_data_length, const uint8_t *advertising_data);
+void gap_advertisements_enable(int enabled);
+int  gap_whitelist_clear(void);
+int  gap_whitelist_add(bd_addr_type_t address_type, const bd_addr_t address);
+
+void l2cap_init(void);
+
+void sm_init(void);
+void sm_set_io_capabilities(int io_capability);
+void sm_set_authentication_requirements(uint8_t auth_req);
+void sm_add_event_handler(btstack_packet_callback_registration_t *callback_handler);
+void sm_just_works_confirm(hci_con_handle_t con_handle);
+int  sm_le_device_index(hci_con_handle_t con_handle);
+
+void att_server_init(const uint8_t *db, void *read_callback, void *write_callback);
+void att_server_register_packet_handler(btstack_packet_handler_t handler);
+uint16_t att_server_get_mtu(hci_con_handle_t con_handle);
+
+void gatt_client_init(void);
+uint8_t gatt_client_send_mtu_negotiation(btstack_packet_handler_t callback,
+                                         hci_con_handle_t con_handle);
+
+#endif /* SIM_BTSTACK_MAIN_H */
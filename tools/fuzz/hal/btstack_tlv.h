@@ -0,0 +1,20 @@
+/**
+ * @file btstack_tlv.h
+ * @brief BTstack btstack_tlv.h の代替 (インタフェースは BTstack と同じ)
+ */
+
+#ifndef SIM_BTSTACK_TLV_H
+#define SIM_BTSTACK_TLV_H
+
+#include <stdint.h>
+
+typedef struct {
+    int  (*get_tag)(void *context, uint32_t tag, uint8_t *buffer, uint32_t buffer_size);
+    int  (*store_tag)(void *context, uint32_t tag, const uint8_t *data, uint32_t data_size);
+    void (*delete_tag)(void *context, uint32_t tag);
+} btstack_tlv_t;
+
+void btstack_tlv_set_instance(const btstack_tlv_t *tlv_impl, void *tlv_context);
+void btstack_tlv_get_instance(const btstack_tlv_t **tlv_impl, void **tlv_context);
+
+#endif /* SIM_BTSTACK_TLV_H */
@@ -0,0 +1,28 @@
+/**
+ * @file flash.h
+ * @brief hardware/flash.h の代替 (RAM 上の NOR Flash, sim_flash.c)
+ *
+ * XIP 領域は RAM 配列 sim_flash_mem を指す。プログラムは実機と同じく
+ * ビットを 1→0 にしかできず (AND), 消去で 0xFF に戻る。
+ */
+
+#ifndef SIM_HARDWARE_FLASH_H
+#define SIM_HARDWARE_FLASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_PAGE_SIZE    256u
+#define FLASH_SECTOR_SIZE  4096u
+
+/* シミュレートする Flash 全体 (pico_flash_bank + flash_log が収まる大きさ) */
+#define SIM_FLASH_SIZE     (16u * FLASH_SECTOR_SIZE)
+
+extern uint8_t sim_flash_mem[SIM_FLASH_SIZE];
+
+#define XIP_BASE  ((uintptr_t)sim_flash_mem)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#endif /* SIM_HARDWARE_FLASH_H */
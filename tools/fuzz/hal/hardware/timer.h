@@ -0,0 +1,11 @@
+/**
+ * @file timer.h
+ * @brief hardware/timer.h の代替 (仮想時刻, tools/replay/sim_hal.c)
+ */
+
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include "pico/time.h"
+
+#endif /* SIM_HARDWARE_TIMER_H */
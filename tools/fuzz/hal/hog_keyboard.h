@@ -0,0 +1,13 @@
+/**
+ * @file hog_keyboard.h
+ * @brief hog_keyboard.gatt から生成されるヘッダの代替 (ATT データベースは使わない)
+ */
+
+#ifndef SIM_HOG_KEYBOARD_H
+#define SIM_HOG_KEYBOARD_H
+
+#include <stdint.h>
+
+static const uint8_t profile_data[] = { 0 };
+
+#endif /* SIM_HOG_KEYBOARD_H */
@@ -0,0 +1,46 @@
+/**
+ * @file async_context.h
+ * @brief pico/async_context.h の代替 (ワーカーは sim_ble.c が呼び出す, ロックは何もしない)
+ */
+
+#ifndef SIM_PICO_ASYNC_CONTEXT_H
+#define SIM_PICO_ASYNC_CONTEXT_H
+
+#include <stdbool.h>
+
+#include "pico/time.h"
+
+typedef struct async_context async_context_t;
+
+typedef struct async_when_pending_worker {
+    struct async_when_pending_worker *next;
+    void (*do_work)(async_context_t *context, struct async_when_pending_worker *worker);
+    bool work_pending;
+    void *user_data;
+} async_when_pending_worker_t;
+
+typedef struct async_at_time_worker {
+    struct async_at_time_worker *next;
+    void (*do_work)(async_context_t *context, struct async_at_time_worker *worker);
+    absolute_time_t next_time;
+    void *user_data;
+} async_at_time_worker_t;
+
+static inline void async_context_acquire_lock_blocking(async_context_t *context) {
+    (void)context;
+}
+
+static inline void async_context_release_lock(async_context_t *context) {
+    (void)context;
+}
+
+bool async_context_add_when_pending_worker(async_context_t *context,
+                                           async_when_pending_worker_t *worker);
+void async_context_set_work_pending(async_context_t *context,
+                                    async_when_pending_worker_t *worker);
+bool async_context_add_at_time_worker_at(async_context_t *context,
+                                         async_at_time_worker_t *worker, absolute_time_t at);
+bool async_context_remove_at_time_worker(async_context_t *context,
+                                         async_at_time_worker_t *worker);
+
+#endif /* SIM_PICO_ASYNC_CONTEXT_H */
@@ -0,0 +1,9 @@
+/**
+ * @file btstack_cyw43.h
+ * @brief pico/btstack_cyw43.h の代替 (中身なし)
+ */
+
+#ifndef SIM_PICO_BTSTACK_CYW43_H
+#define SIM_PICO_BTSTACK_CYW43_H
+
+#endif /* SIM_PICO_BTSTACK_CYW43_H */
@@ -0,0 +1,16 @@
+/**
+ * @file btstack_flash_bank.h
+ * @brief pico/btstack_flash_bank.h の代替
+ *
+ * SDK と同じく Flash 末尾の 2 セクタを pico_flash_bank 用とする。
+ */
+
+#ifndef SIM_PICO_BTSTACK_FLASH_BANK_H
+#define SIM_PICO_BTSTACK_FLASH_BANK_H
+
+#include "hardware/flash.h"
+
+#define PICO_FLASH_BANK_TOTAL_SIZE      (2u * FLASH_SECTOR_SIZE)
+#define PICO_FLASH_BANK_STORAGE_OFFSET  (SIM_FLASH_SIZE - PICO_FLASH_BANK_TOTAL_SIZE)
+
+#endif /* SIM_PICO_BTSTACK_FLASH_BANK_H */
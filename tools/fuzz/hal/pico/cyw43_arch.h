@@ -0,0 +1,25 @@
+/**
+ * @file cyw43_arch.h
+ * @brief pico/cyw43_arch.h の代替 (async_context のロックは何もしない)
+ */
+
+#ifndef SIM_PICO_CYW43_ARCH_H
+#define SIM_PICO_CYW43_ARCH_H
+
+#include "pico/async_context.h"
+
+/* 中身は使わない (NULL だと ble_hid.c が未初期化とみなす) */
+static inline async_context_t *cyw43_arch_async_context(void) {
+    static char context;
+    return (async_context_t *)&context;
+}
+
+static inline int cyw43_arch_init(void) {
+    return 0;
+}
+
+/* ポーリングビルドの BTstack 処理 (イベントはファズターゲットが直接渡す) */
+static inline void cyw43_arch_poll(void) {
+}
+
+#endif /* SIM_PICO_CYW43_ARCH_H */
@@ -0,0 +1,19 @@
+/**
+ * @file flash.h
+ * @brief pico/flash.h の代替 (sim_flash.c)
+ *
+ * flash_safe_execute() は関数をそのまま呼ぶ。sim_flash_fail_after() で
+ * 電源断を注入した場合は、途中まで書いた/消した時点でエラーを返す。
+ */
+
+#ifndef SIM_PICO_FLASH_H
+#define SIM_PICO_FLASH_H
+
+#include <stdint.h>
+
+#define PICO_OK              0
+#define PICO_ERROR_TIMEOUT  (-1)
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+#endif /* SIM_PICO_FLASH_H */
@@ -0,0 +1,458 @@
+/**
+ * @file sim_ble.c
+ * @brief BTstack (HCI/GAP/SM/ATT/HIDS, run loop) と async_context の代替 (ファズ用)
+ *
+ * ble_hid.c が呼ぶ API を、コントローラの接続状態を持つだけの小さなモデルで置き換える。
+ * 無線・ATT データベース・ペアリングの中身は持たない。イベントはファズターゲットが
+ * 組み立てて sim_ble_deliver() で渡す。
+ */
+
+#include "sim_ble.h"
+#include "fuzz_common.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "pico/time.h"
+#include "pico/async_context.h"
+#include "ble/gatt-service/battery_service_server.h"
+#include "ble/gatt-service/device_information_service_server.h"
+#include "ble/gatt-service/hids_device.h"
+
+const hci_cmd_t hci_le_set_data_length = { 0x2022, "H22" };
+
+static sim_ble_link_t links[SIM_BLE_LINKS];
+
+static btstack_packet_callback_registration_t *hci_handlers = NULL;
+static btstack_packet_callback_registration_t *sm_handlers = NULL;
+static btstack_packet_handler_t hids_handler = NULL;
+static btstack_packet_handler_t att_handler = NULL;
+static btstack_packet_handler_t mtu_handler[SIM_BLE_LINKS];
+
+static btstack_timer_source_t *timers = NULL;
+static async_when_pending_worker_t *pending_workers = NULL;
+static async_at_time_worker_t *time_workers = NULL;
+
+static bool command_ready = true;
+static bool advertising = false;
+static uint32_t whitelist_count = 0;
+
+/* ファームウェアが操作してよいハンドル (コントローラで接続中) */
+static sim_ble_link_t *connected_link(hci_con_handle_t handle, const char *what) {
+    sim_ble_link_t *link = sim_ble_link(handle);
+    FUZZ_CHECK(link && link->connected, "%s on handle 0x%04x (not connected)", what, handle);
+    return link;
+}
+
+void sim_ble_reset(void) {
+    memset(links, 0, sizeof(links));
+    for (int i = 0; i < SIM_BLE_LINKS; i++) {
+        links[i].att_mtu = ATT_DEFAULT_MTU;
+        links[i].db_index = -1;
+        mtu_handler[i] = NULL;
+    }
+    hci_handlers = NULL;
+    sm_handlers = NULL;
+    hids_handler = NULL;
+    att_handler = NULL;
+    timers = NULL;
+    pending_workers = NULL;
+    time_workers = NULL;
+    command_ready = true;
+    advertising = false;
+    whitelist_count = 0;
+}
+
+sim_ble_link_t *sim_ble_link(hci_con_handle_t handle) {
+    int i = (int)handle - SIM_BLE_HANDLE(0);
+    return (i >= 0 && i < SIM_BLE_LINKS) ? &links[i] : NULL;
+}
+
+static void call_list(btstack_packet_callback_registration_t *list,
+                      uint8_t *packet, uint16_t size) {
+    for (btstack_packet_callback_registration_t *r = list; r; r = r->next) {
+        r->callback(HCI_EVENT_PACKET, 0, packet, size);
+    }
+}
+
+bool sim_ble_deliver(uint8_t *packet, uint16_t size) {
+    FUZZ_CHECK(size >= 2 && packet[1] == size - 2, "event 0x%02x size %u", packet[0], size);
+
+    uint8_t type = hci_event_packet_get_type(packet);
+    if (type == HCI_EVENT_LE_META &&
+        hci_event_le_meta_get_subevent_code(packet) == HCI_SUBEVENT_LE_CONNECTION_COMPLETE &&
+        hci_subevent_le_connection_complete_get_status(packet) == ERROR_CODE_SUCCESS) {
+        sim_ble_link_t *link =
+            sim_ble_link(hci_subevent_le_connection_complete_get_connection_handle(packet));
+        if (link) {
+            memset(link, 0, sizeof(*link));
+            link->connected = true;
+            link->att_mtu = ATT_DEFAULT_MTU;
+            link->db_index = -1;
+        }
+        advertising = false;
+    }
+    if (type == HCI_EVENT_DISCONNECTION_COMPLETE) {
+        sim_ble_link_t *link =
+            sim_ble_link(hci_event_disconnection_complete_get_connection_handle(packet));
+        if (link) link->connected = false;
+    }
+
+    switch (type) {
+    case SM_EVENT_JUST_WORKS_REQUEST:
+    case SM_EVENT_IDENTITY_RESOLVING_FAILED:
+    case SM_EVENT_IDENTITY_RESOLVING_SUCCEEDED:
+    case SM_EVENT_PAIRING_COMPLETE:
+        if (!sm_handlers) return false;
+        call_list(sm_handlers, packet, size);
+        return true;
+    case HCI_EVENT_HIDS_META:
+        if (!hids_handler) return false;
+        if (hci_event_hids_meta_get_subevent_code(packet) == HIDS_SUBEVENT_CAN_SEND_NOW) {
+            sim_ble_link_t *link = sim_ble_link(hids_subevent_can_send_now_get_con_handle(packet));
+            if (link) {
+                link->can_send_requested = false;
+                link->can_send_granted = true;
+            }
+        }
+        hids_handler(HCI_EVENT_PACKET, 0, packet, size);
+        return true;
+    case ATT_EVENT_MTU_EXCHANGE_COMPLETE:
+        if (!att_handler) return false;
+        att_handler(HCI_EVENT_PACKET, 0, packet, size);
+        return true;
+    default:
+        if (!hci_handlers) return false;
+        call_list(hci_handlers, packet, size);
+        return true;
+    }
+}
+
+bool sim_ble_deliver_gatt_mtu(hci_con_handle_t handle, uint16_t mtu) {
+    sim_ble_link_t *link = sim_ble_link(handle);
+    if (!link || !link->mtu_requested) return false;
+
+    int i = (int)handle - SIM_BLE_HANDLE(0);
+    btstack_packet_handler_t handler = mtu_handler[i];
+    link->mtu_requested = false;
+    mtu_handler[i] = NULL;
+    link->att_mtu = mtu;
+
+    uint8_t event[6] = { GATT_EVENT_MTU, 4 };
+    event[2] = (uint8_t)handle;
+    event[3] = (uint8_t)(handle >> 8);
+    event[4] = (uint8_t)mtu;
+    event[5] = (uint8_t)(mtu >> 8);
+    handler(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    return true;
+}
+
+void sim_ble_set_command_ready(bool ready) {
+    command_ready = ready;
+}
+
+void sim_ble_run_pending(void) {
+    for (async_when_pending_worker_t *w = pending_workers; w; w = w->next) {
+        if (!w->work_pending) continue;
+        w->work_pending = false;
+        w->do_work(NULL, w);
+    }
+}
+
+void sim_ble_run_due(void) {
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+    bool fired = true;
+
+    /* 呼び出し先でタイマーの追加/削除があるので、1つ実行するごとに先頭から探し直す */
+    while (fired) {
+        fired = false;
+        for (btstack_timer_source_t *ts = timers; ts; ts = ts->next) {
+            if ((int32_t)(ts->timeout - now_ms) > 0) continue;
+            btstack_run_loop_remove_timer(ts);
+            if (ts->process) ts->process(ts);
+            fired = true;
+            break;
+        }
+        for (async_at_time_worker_t *w = time_workers; w && !fired; w = w->next) {
+            if (w->next_time > time_us_64()) continue;
+            async_context_remove_at_time_worker(NULL, w);
+            w->do_work(NULL, w);
+            fired = true;
+        }
+    }
+}
+
+bool sim_ble_advertising(void) {
+    return advertising;
+}
+
+uint32_t sim_ble_whitelist_count(void) {
+    return whitelist_count;
+}
+
+/* ============================================================
+ * run loop
+ * ============================================================ */
+
+void btstack_run_loop_set_timer(btstack_timer_source_t *ts, uint32_t timeout_in_ms) {
+    ts->timeout = btstack_run_loop_get_time_ms() + timeout_in_ms;
+}
+
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t *ts,
+                                        void (*process)(btstack_timer_source_t *ts)) {
+    ts->process = process;
+}
+
+void btstack_run_loop_add_timer(btstack_timer_source_t *ts) {
+    /* BTstack と同じく登録済みなら何もしない */
+    for (btstack_timer_source_t *t = timers; t; t = t->next) {
+        if (t == ts) return;
+    }
+    ts->next = timers;
+    timers = ts;
+}
+
+int btstack_run_loop_remove_timer(btstack_timer_source_t *ts) {
+    for (btstack_timer_source_t **p = &timers; *p; p = &(*p)->next) {
+        if (*p == ts) {
+            *p = ts->next;
+            ts->next = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t btstack_run_loop_get_time_ms(void) {
+    return (uint32_t)(time_us_64() / 1000);
+}
+
+/* ============================================================
+ * async_context
+ * ============================================================ */
+
+bool async_context_add_when_pending_worker(async_context_t *context,
+                                           async_when_pending_worker_t *worker) {
+    (void)context;
+    worker->next = pending_workers;
+    pending_workers = worker;
+    return true;
+}
+
+void async_context_set_work_pending(async_context_t *context,
+                                    async_when_pending_worker_t *worker) {
+    (void)context;
+    worker->work_pending = true;
+}
+
+bool async_context_add_at_time_worker_at(async_context_t *context,
+                                         async_at_time_worker_t *worker, absolute_time_t at) {
+    (void)context;
+    for (async_at_time_worker_t *w = time_workers; w; w = w->next) {
+        FUZZ_CHECK(w != worker, "at-time worker added twice");
+    }
+    worker->next_time = at;
+    worker->next = time_workers;
+    time_workers = worker;
+    return true;
+}
+
+bool async_context_remove_at_time_worker(async_context_t *context,
+                                         async_at_time_worker_t *worker) {
+    (void)context;
+    for (async_at_time_worker_t **p = &time_workers; *p; p = &(*p)->next) {
+        if (*p == worker) {
+            *p = worker->next;
+            worker->next = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* ============================================================
+ * HCI / GAP / L2CAP
+ * ============================================================ */
+
+void hci_add_event_handler(btstack_packet_callback_registration_t *callback_handler) {
+    callback_handler->next = hci_handlers;
+    hci_handlers = callback_handler;
+}
+
+int hci_power_on(void) {
+    return 0;
+}
+
+int hci_can_send_command_packet_now(void) {
+    return command_ready;
+}
+
+uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...) {
+    FUZZ_CHECK(command_ready, "HCI command 0x%04x without a free command slot", cmd->opcode);
+    if (cmd == &hci_le_set_data_length) {
+        va_list ap;
+        va_start(ap, cmd);
+        hci_con_handle_t handle = (hci_con_handle_t)va_arg(ap, int);
+        va_end(ap);
+        connected_link(handle, "LE Set Data Length");
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_disconnect(hci_con_handle_t handle) {
+    connected_link(handle, "gap_disconnect")->disconnect_requested = true;
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_set_connection_parameters(uint16_t conn_interval_min, uint16_t conn_interval_max,
+                                   uint16_t conn_latency, uint16_t supervision_timeout) {
+    (void)conn_latency;
+    (void)supervision_timeout;
+    FUZZ_CHECK(conn_interval_min <= conn_interval_max, "conn interval %u > %u",
+               conn_interval_min, conn_interval_max);
+}
+
+uint8_t gap_le_set_phy(hci_con_handle_t con_handle, uint8_t all_phys, uint8_t tx_phys,
+                       uint8_t rx_phys, uint8_t phy_options) {
+    (void)all_phys;
+    (void)tx_phys;
+    (void)rx_phys;
+    (void)phy_options;
+    connected_link(con_handle, "gap_le_set_phy");
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max,
+                                   uint8_t adv_type, uint8_t direct_address_typ,
+                                   bd_addr_t direct_address, uint8_t channel_map,
+                                   uint8_t filter_policy) {
+    (void)direct_address;
+    (void)channel_map;
+    (void)filter_policy;
+    FUZZ_CHECK(!advertising, "advertising parameters changed while enabled");
+    FUZZ_CHECK(adv_int_min <= adv_int_max, "adv interval %u > %u", adv_int_min, adv_int_max);
+    FUZZ_CHECK(adv_type > 0x04 || direct_address_typ <= 1, "direct address type %u",
+               direct_address_typ);
+}
+
+void gap_advertisements_set_data(uint8_t advertising_data_length, const uint8_t *advertising_data) {
+    (void)advertising_data;
+    FUZZ_CHECK(advertising_data_length <= 31, "adv data %u bytes", advertising_data_length);
+}
+
+void gap_advertisements_enable(int enabled) {
+    advertising = enabled != 0;
+}
+
+int gap_whitelist_clear(void) {
+    whitelist_count = 0;
+    return 0;
+}
+
+int gap_whitelist_add(bd_addr_type_t address_type, const bd_addr_t address) {
+    (void)address;
+    FUZZ_CHECK(address_type <= BD_ADDR_TYPE_LE_RANDOM, "whitelist address type %d", address_type);
+    whitelist_count++;
+    FUZZ_CHECK(whitelist_count <= MAX_NR_WHITELIST_ENTRIES, "whitelist overflow (%u)",
+               (unsigned)whitelist_count);
+    return 0;
+}
+
+void l2cap_init(void) {}
+
+/* ============================================================
+ * SM / ATT / GATT Client
+ * ============================================================ */
+
+void sm_init(void) {}
+void sm_set_io_capabilities(int io_capability) { (void)io_capability; }
+void sm_set_authentication_requirements(uint8_t auth_req) { (void)auth_req; }
+
+void sm_add_event_handler(btstack_packet_callback_registration_t *callback_handler) {
+    callback_handler->next = sm_handlers;
+    sm_handlers = callback_handler;
+}
+
+void sm_just_works_confirm(hci_con_handle_t con_handle) {
+    connected_link(con_handle, "sm_just_works_confirm");
+}
+
+int sm_le_device_index(hci_con_handle_t con_handle) {
+    sim_ble_link_t *link = sim_ble_link(con_handle);
+    return link ? link->db_index : -1;
+}
+
+void att_server_init(const uint8_t *db, void *read_callback, void *write_callback) {
+    (void)db;
+    (void)read_callback;
+    (void)write_callback;
+}
+
+void att_server_register_packet_handler(btstack_packet_handler_t handler) {
+    att_handler = handler;
+}
+
+uint16_t att_server_get_mtu(hci_con_handle_t con_handle) {
+    return connected_link(con_handle, "att_server_get_mtu")->att_mtu;
+}
+
+void gatt_client_init(void) {}
+
+uint8_t gatt_client_send_mtu_negotiation(btstack_packet_handler_t callback,
+                                         hci_con_handle_t con_handle) {
+    sim_ble_link_t *link = connected_link(con_handle, "gatt_client_send_mtu_negotiation");
+    link->mtu_requested = true;
+    mtu_handler[con_handle - SIM_BLE_HANDLE(0)] = callback;
+    return ERROR_CODE_SUCCESS;
+}
+
+/* ============================================================
+ * GATT サービス
+ * ============================================================ */
+
+void battery_service_server_init(uint8_t battery_value) {
+    FUZZ_CHECK(battery_value <= 100, "battery %u", battery_value);
+}
+
+void battery_service_server_set_battery_value(uint8_t battery_value) {
+    FUZZ_CHECK(battery_value <= 100, "battery %u", battery_value);
+}
+
+void device_information_service_server_init(void) {}
+
+void hids_device_init(uint8_t hid_country_code, const uint8_t *hid_descriptor,
+                      uint16_t hid_descriptor_size) {
+    (void)hid_country_code;
+    FUZZ_CHECK(hid_descriptor && hid_descriptor_size > 0, "empty HID descriptor");
+}
+
+void hids_device_register_packet_handler(btstack_packet_handler_t callback) {
+    hids_handler = callback;
+}
+
+void hids_device_request_can_send_now_event(hci_con_handle_t con_handle) {
+    sim_ble_link_t *link = connected_link(con_handle, "request_can_send_now");
+    if (!link->can_send_granted) link->can_send_requested = true;
+}
+
+/* 1回の CAN_SEND_NOW で送れるのは1通知だけ */
+static void notify(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len,
+                   const char *what) {
+    sim_ble_link_t *link = connected_link(con_handle, what);
+    FUZZ_CHECK(link->can_send_granted, "%s on 0x%04x without CAN_SEND_NOW", what, con_handle);
+    FUZZ_CHECK(report && report_len > 0, "%s: empty report", what);
+    link->can_send_granted = false;
+    link->notifications++;
+}
+
+void hids_device_send_input_report(hci_con_handle_t con_handle, const uint8_t *report,
+                                   uint16_t report_len) {
+    notify(con_handle, report, report_len, "send_input_report");
+}
+
+void hids_device_send_boot_keyboard_input_report(hci_con_handle_t con_handle,
+                                                 const uint8_t *report, uint16_t report_len) {
+    notify(con_handle, report, report_len, "send_boot_keyboard_input_report");
+    FUZZ_CHECK(report_len == 8, "boot keyboard report %u bytes", report_len);
+}
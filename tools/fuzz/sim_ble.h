@@ -0,0 +1,76 @@
+/**
+ * @file sim_ble.h
+ * @brief BTstack (HCI/GAP/SM/ATT/HIDS, run loop) と async_context の代替の操作 API (ファズ用)
+ *
+ * コントローラ側の接続は固定のハンドル SIM_BLE_HANDLE(i) で持つ。ファームウェアから
+ * 呼ばれる API は接続していないハンドルへの操作や CAN_SEND_NOW を待たない送信を
+ * 不変条件違反として報告する。
+ */
+
+#ifndef SIM_BLE_H
+#define SIM_BLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "btstack.h"
+
+/* コントローラの接続数 (ファームウェアの接続テーブルより1本多い: 満杯時の経路を通す) */
+#define SIM_BLE_LINKS        (MAX_NR_HCI_CONNECTIONS + 1)
+#define SIM_BLE_HANDLE(i)    ((hci_con_handle_t)(0x0040 + (i)))
+
+typedef struct {
+    bool     connected;
+    bool     can_send_requested;    /* CAN_SEND_NOW 要求済み (未通知) */
+    bool     can_send_granted;      /* CAN_SEND_NOW 通知済み (未送信) */
+    bool     disconnect_requested;
+    bool     mtu_requested;         /* MTU 交換要求済み (GATT_EVENT_MTU 未通知) */
+    uint16_t att_mtu;               /* att_server_get_mtu() の値 */
+    int      db_index;              /* sm_le_device_index() の値 */
+    uint32_t notifications;
+} sim_ble_link_t;
+
+/**
+ * 全状態を初期化 (登録済みハンドラ, タイマー, ワーカー, 接続)
+ */
+void sim_ble_reset(void);
+
+/**
+ * ハンドルの接続状態 (SIM_BLE_HANDLE の範囲外なら NULL)
+ */
+sim_ble_link_t *sim_ble_link(hci_con_handle_t handle);
+
+/**
+ * イベントを登録済みのハンドラへ渡す (HCI / SM / ATT / HIDS の登録先に振り分け)
+ * 接続完了/切断完了ではコントローラ側の接続状態も更新する。
+ * @return false: 渡す先のハンドラが未登録
+ */
+bool sim_ble_deliver(uint8_t *packet, uint16_t size);
+
+/**
+ * GATT_EVENT_MTU を MTU 交換の要求元へ渡す (要求が無ければ何もしない)
+ */
+bool sim_ble_deliver_gatt_mtu(hci_con_handle_t handle, uint16_t mtu);
+
+/**
+ * HCI コマンドの送信枠 (hci_can_send_command_packet_now() の値)
+ */
+void sim_ble_set_command_ready(bool ready);
+
+/**
+ * 通知待ちの async_context ワーカーを実行
+ */
+void sim_ble_run_pending(void);
+
+/**
+ * 現在時刻までに期限の来た btstack タイマーと時刻指定ワーカーを実行
+ */
+void sim_ble_run_due(void);
+
+/**
+ * アドバタイジング中か / フィルタ受理リストの登録数
+ */
+bool sim_ble_advertising(void);
+uint32_t sim_ble_whitelist_count(void);
+
+#endif /* SIM_BLE_H */
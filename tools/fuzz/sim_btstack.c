@@ -0,0 +1,74 @@
+/**
+ * @file sim_btstack.c
+ * @brief BTstack の TLV 登録とボンドDB (le_device_db) の代替 (ファズ用)
+ *
+ * ボンドDBは BTstack の le_device_db_tlv と同じく登録された TLV の 'BTD' + n タグに置く。
+ * 値の形式は簡略化しており、先頭7バイト = [アドレスタイプ][ID アドレス 6] だけを使う
+ * (鍵は持たない)。短いエントリはボンド無しとして扱う。
+ */
+
+#include "sim_btstack.h"
+#include "fuzz_common.h"
+
+#include <string.h>
+
+#include "btstack.h"
+#include "btstack_tlv.h"
+#include "ble/le_device_db.h"
+#include "ble/le_device_db_tlv.h"
+
+#define TAG_BOND(n)  (((uint32_t)'B' << 24) | ((uint32_t)'T' << 16) | \
+                      ((uint32_t)'D' << 8) | (uint32_t)(n))
+
+#define BOND_ENTRY_SIZE  (1 + BD_ADDR_LEN)
+
+static const btstack_tlv_t *tlv_impl = NULL;
+static void *tlv_context = NULL;
+static const btstack_tlv_t *db_impl = NULL;
+static void *db_context = NULL;
+
+void btstack_tlv_set_instance(const btstack_tlv_t *impl, void *context) {
+    tlv_impl = impl;
+    tlv_context = context;
+}
+
+void btstack_tlv_get_instance(const btstack_tlv_t **impl, void **context) {
+    *impl = tlv_impl;
+    *context = tlv_context;
+}
+
+void le_device_db_tlv_configure(const btstack_tlv_t *impl, void *context) {
+    db_impl = impl;
+    db_context = context;
+}
+
+int le_device_db_max_count(void) {
+    return NVM_NUM_DEVICE_DB_ENTRIES;
+}
+
+void le_device_db_info(int index, int *addr_type, bd_addr_t addr, sm_key_t irk) {
+    FUZZ_CHECK(index >= 0 && index < NVM_NUM_DEVICE_DB_ENTRIES,
+               "le_device_db_info index %d", index);
+    *addr_type = BD_ADDR_TYPE_UNKNOWN;
+    if (irk) memset(irk, 0, sizeof(sm_key_t));
+    if (!db_impl) return;
+
+    uint8_t entry[BOND_ENTRY_SIZE];
+    int len = db_impl->get_tag(db_context, TAG_BOND(index), entry, sizeof(entry));
+    if (len < (int)sizeof(entry)) return;
+    *addr_type = entry[0] & 1;
+    if (addr) memcpy(addr, entry + 1, BD_ADDR_LEN);
+}
+
+void le_device_db_remove(int index) {
+    FUZZ_CHECK(index >= 0 && index < NVM_NUM_DEVICE_DB_ENTRIES,
+               "le_device_db_remove index %d", index);
+    if (db_impl) db_impl->delete_tag(db_context, TAG_BOND(index));
+}
+
+void sim_btstack_reset(void) {
+    tlv_impl = NULL;
+    tlv_context = NULL;
+    db_impl = NULL;
+    db_context = NULL;
+}
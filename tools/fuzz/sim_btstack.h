@@ -0,0 +1,14 @@
+/**
+ * @file sim_btstack.h
+ * @brief BTstack 代替の操作 API (ファズ用)
+ */
+
+#ifndef SIM_BTSTACK_H
+#define SIM_BTSTACK_H
+
+/**
+ * TLV とボンドDBの登録を解除する (起動し直しの前に呼ぶ)
+ */
+void sim_btstack_reset(void);
+
+#endif /* SIM_BTSTACK_H */
@@ -0,0 +1,80 @@
+/**
+ * @file sim_flash.c
+ * @brief RAM 上の NOR Flash と電源断の注入 (ファズ用)
+ *
+ * 消去/プログラムの単位と境界は実機の制約どおりに検査し、違反は不変条件違反として止める。
+ */
+
+#include "sim_flash.h"
+#include "fuzz_common.h"
+
+#include <string.h>
+
+#include "pico/flash.h"
+
+uint8_t sim_flash_mem[SIM_FLASH_SIZE];
+
+static bool     fail_armed = false;
+static uint32_t fail_countdown = 0;
+static uint32_t fail_torn_bytes = 0;
+static bool     down = false;
+
+void sim_flash_reset(void) {
+    memset(sim_flash_mem, 0xFF, sizeof(sim_flash_mem));
+    sim_flash_power_cycle();
+}
+
+void sim_flash_fail_after(uint32_t ops, uint32_t torn_bytes) {
+    fail_armed = true;
+    fail_countdown = ops;
+    fail_torn_bytes = torn_bytes;
+}
+
+void sim_flash_power_cycle(void) {
+    fail_armed = false;
+    down = false;
+}
+
+bool sim_flash_is_down(void) {
+    return down;
+}
+
+/* この操作で何バイト反映するか (電源断の注入) */
+static size_t op_bytes(size_t count) {
+    if (down) return 0;
+    if (fail_armed) {
+        if (fail_countdown == 0) {
+            down = true;
+            fail_armed = false;
+            return (fail_torn_bytes < count) ? fail_torn_bytes : count;
+        }
+        fail_countdown--;
+    }
+    return count;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    FUZZ_CHECK(flash_offs % FLASH_SECTOR_SIZE == 0 && count % FLASH_SECTOR_SIZE == 0,
+               "erase 0x%lx+%zu not sector aligned", (unsigned long)flash_offs, count);
+    FUZZ_CHECK(flash_offs + count <= SIM_FLASH_SIZE,
+               "erase 0x%lx+%zu out of flash", (unsigned long)flash_offs, count);
+    memset(sim_flash_mem + flash_offs, 0xFF, op_bytes(count));
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    FUZZ_CHECK(flash_offs % FLASH_PAGE_SIZE == 0 && count % FLASH_PAGE_SIZE == 0,
+               "program 0x%lx+%zu not page aligned", (unsigned long)flash_offs, count);
+    FUZZ_CHECK(flash_offs + count <= SIM_FLASH_SIZE,
+               "program 0x%lx+%zu out of flash", (unsigned long)flash_offs, count);
+    size_t n = op_bytes(count);
+    for (size_t i = 0; i < n; i++) {
+        sim_flash_mem[flash_offs + i] &= data[i];   /* NOR: 1→0 のみ */
+    }
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms) {
+    (void)enter_exit_timeout_ms;
+    if (down) return PICO_ERROR_TIMEOUT;
+    func(param);
+    return down ? PICO_ERROR_TIMEOUT : PICO_OK;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file sim_flash.h
+ * @brief RAM 上の NOR Flash と電源断の注入 (ファズ用)
+ *
+ * ファームウェア側は hal/ の hardware/flash.h, pico/flash.h 経由でこの Flash を使う。
+ */
+
+#ifndef SIM_FLASH_H
+#define SIM_FLASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hardware/flash.h"
+
+/**
+ * 全面を消去状態 (0xFF) に戻し、電源断の注入を解除する
+ */
+void sim_flash_reset(void);
+
+/**
+ * 電源断を予約する
+ * ops 回の Flash 操作が成功した次の操作を途中で打ち切り (プログラムは先頭 torn_bytes バイト,
+ * 消去はセクタ先頭 torn_bytes バイトだけ反映), 以降の操作は全て失敗させる。
+ */
+void sim_flash_fail_after(uint32_t ops, uint32_t torn_bytes);
+
+/**
+ * 電源を入れ直す (失敗状態と予約を解除, Flash の内容はそのまま)
+ */
+void sim_flash_power_cycle(void);
+
+/**
+ * 電源断が起きたか (sim_flash_power_cycle() まで true)
+ */
+bool sim_flash_is_down(void);
+
+#endif /* SIM_FLASH_H */
@@ -0,0 +1,40 @@
+/**
+ * @file gpio.h
+ * @brief hardware/gpio.h の代替 (仮想 GPIO + キースイッチ, sim_hal.c)
+ *
+ * 入力ピンは内部プルアップとして扱い、LOW を出力しているピンと
+ * 閉じたスイッチでつながっていれば LOW を読む。
+ */
+
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define GPIO_IN   false
+#define GPIO_OUT  true
+
+#define GPIO_IRQ_LEVEL_LOW   0x1u
+#define GPIO_IRQ_LEVEL_HIGH  0x2u
+#define GPIO_IRQ_EDGE_FALL   0x4u
+#define GPIO_IRQ_EDGE_RISE   0x8u
+
+typedef void (*irq_handler_t)(void);
+
+void gpio_init(unsigned int gpio);
+void gpio_set_dir(unsigned int gpio, bool out);
+void gpio_put(unsigned int gpio, bool value);
+bool gpio_get(unsigned int gpio);
+void gpio_pull_up(unsigned int gpio);
+void gpio_set_mask(uint32_t mask);
+void gpio_clr_mask(uint32_t mask);
+uint32_t gpio_get_all(void);
+
+/* 割り込みは再生では使わない (登録だけ受け付ける) */
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool enabled);
+uint32_t gpio_get_irq_event_mask(unsigned int gpio);
+void gpio_add_raw_irq_handler_masked(uint32_t gpio_mask, irq_handler_t handler);
+void gpio_set_dormant_irq_enabled(unsigned int gpio, uint32_t events, bool enabled);
+
+#endif /* SIM_HARDWARE_GPIO_H */
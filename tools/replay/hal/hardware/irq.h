@@ -0,0 +1,15 @@
+/**
+ * @file irq.h
+ * @brief hardware/irq.h の代替 (ホスト再生ハーネス用)
+ */
+
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include <stdbool.h>
+
+#define IO_IRQ_BANK0  13
+
+void irq_set_enabled(unsigned int num, bool enabled);
+
+#endif /* SIM_HARDWARE_IRQ_H */
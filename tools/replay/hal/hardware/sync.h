@@ -0,0 +1,19 @@
+/**
+ * @file sync.h
+ * @brief hardware/sync.h の代替 (シングルスレッドなので何もしない)
+ */
+
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
+
+#endif /* SIM_HARDWARE_SYNC_H */
@@ -0,0 +1,14 @@
+/**
+ * @file stdlib.h
+ * @brief pico/stdlib.h の代替 (ホスト再生ハーネス用)
+ */
+
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdio.h>
+
+#include "pico/time.h"
+#include "hardware/gpio.h"
+
+#endif /* SIM_PICO_STDLIB_H */
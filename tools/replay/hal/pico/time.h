@@ -0,0 +1,26 @@
+/**
+ * @file time.h
+ * @brief pico/time.h の代替 (仮想時刻, sim_hal.c)
+ *
+ * 待ち関数は実時間を使わず仮想時刻を進める。
+ */
+
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include <stdint.h>
+
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_us(uint64_t us);
+void busy_wait_us(uint64_t us);
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us) {
+    return time_us_64() + us;
+}
+
+#endif /* SIM_PICO_TIME_H */
@@ -0,0 +1,885 @@
+/**
+ * @file replay.c
+ * @brief キー入力トレース再生ハーネス (ホスト用, 仮想時刻)
+ *
+ * 記録済み/合成のキー入力トレースを、接点バウンスを付けて仮想時刻上で再生し、
+ * ファームウェアの実コード (keyboard_matrix.c のスキャン+デバウンス, keymap.c,
+ * hid_pipeline.c のレポート組立て/上書き) に通す。無線の代わりに BLE シンクの
+ * シミュレーション (接続間隔, CAN_SEND_NOW による送信許可, コントローラのバッファ) を置き、
+ * ホストが受け取ったレポートから押下/解放を復元して元のトレースと突き合わせる。
+ *
+ * 突き合わせは2段階: 物理的な押下/解放 → デバウンスの確定 (スキャンごとに記録) →
+ * ホストでの変化 (そのレポートに反映済みの確定と照合)。欠落と遅延は段階ごとにも出す。
+ *
+ * 出力: 持続キーストローク/秒, 欠落・順序入れ替わり・余分なイベント数, 遅延分布。
+ * 欠落・入れ替わり・余分が1件でもあれば終了コード 1。
+ *
+ * ビルド (リポジトリのルートで):
+ *   mkdir -p build && cc -std=c11 -O2 -Itools/replay/hal -Iinclude -o build/replay \
+ *      tools/replay/replay.c tools/replay/sim_hal.c \
+ *      src/keyboard_matrix.c src/keymap.c src/hid_pipeline.c src/perf.c
+ *
+ * トレース形式 (--trace, '#' 以降はコメント):
+ *   <時刻ms> <行> <列> <d|u>      例: 125.5 2 1 d
+ * 物理的な押下/解放だけを書く (バウンスはハーネスが付ける。--bounce-us 0 で無効)。
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim_hal.h"
+#include "pico/time.h"
+#include "project_config.h"
+#include "keyboard_matrix.h"
+#include "hid_keycodes.h"
+#include "hid_pipeline.h"
+#include "config_store.h"
+#include "perf.h"
+
+/* keyboard_matrix.c と同じ配線 (行 GP0-7, 列 GP8-21) */
+#define ROW_GPIO(r)  (r)
+#define COL_GPIO(c)  (8 + (c))
+
+#define ACL_MAX          16     /* コントローラのバッファ数の上限 */
+#define DRAIN_US         1000000 /* 最後の入力から送信しきるまで待つ時間 */
+#define HIST_BIN_US      2000
+#define HIST_BINS        25
+
+/* ============================================================
+ * オプション
+ * ============================================================ */
+typedef struct {
+    const char *trace_path;
+    const char *save_path;
+    const char *csv_path;
+    uint32_t seed;
+    uint32_t keys;           /* 合成するキーストローク数 */
+    double   rate;           /* 合成: キーストローク/秒 */
+    uint32_t hold_min_ms;
+    uint32_t hold_max_ms;
+    uint32_t bounce_us;      /* 接点バウンスの最大継続時間 */
+    uint32_t interval_us;    /* 接続間隔 */
+    uint32_t per_event;      /* 1接続イベントで送れる通知数 */
+    uint32_t acl;            /* コントローラのバッファ数 */
+    double   loss;           /* 接続イベントが失敗する割合 (%) */
+    uint32_t debounce_ms;
+    bool     adaptive;       /* CFG_DEBOUNCE_ADAPT */
+    bool     boot;           /* ホストが Boot Protocol */
+} options_t;
+
+static options_t opt = {
+    .seed        = 1,
+    .keys        = 2000,
+    .rate        = 12.0,
+    .hold_min_ms = 40,
+    .hold_max_ms = 120,
+    .bounce_us   = 3000,
+    .interval_us = BLE_CONN_INTERVAL_MIN * 1250,
+    .per_event   = 1,
+    .acl         = 2,
+    .loss        = 0.0,
+    .debounce_ms = DEBOUNCE_MS,
+    .adaptive    = false,
+    .boot        = false,
+};
+
+/* ============================================================
+ * 乱数 (xorshift32, シードが同じなら結果も同じ)
+ * ============================================================ */
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng_state = x;
+    return x;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) {
+    return (hi <= lo) ? lo : lo + rng() % (hi - lo + 1);
+}
+
+/* ============================================================
+ * トレース (物理的な押下/解放) と接点変化
+ * ============================================================ */
+typedef struct {
+    uint64_t t_us;
+    uint8_t  row;
+    uint8_t  col;
+    bool     down;
+    uint64_t settle_scan_us; /* スキャンから見てバウンスが収まった時刻 (確定順序の基準)。
+                              * スキャンの間に収まった跳ね返りは見えないので含めない */
+    uint8_t  usage;          /* ホストに届くはずの Usage (0 = 届かないキー) */
+    int      commit;         /* デバウンスで確定した変化 (-1 = 確定せず) */
+} key_event_t;
+
+typedef struct {
+    uint64_t t_us;
+    uint32_t seq;            /* 同時刻の並びを保つ */
+    uint8_t  row;
+    uint8_t  col;
+    bool     closed;
+} contact_t;
+
+static key_event_t *events = NULL;
+static size_t event_count = 0, event_cap = 0;
+static contact_t *contacts = NULL;
+static size_t contact_count = 0, contact_cap = 0;
+
+static void *grow(void *ptr, size_t *cap, size_t elem) {
+    size_t n = *cap ? *cap * 2 : 1024;
+    void *p = realloc(ptr, n * elem);
+    if (!p) {
+        fprintf(stderr, "replay: out of memory\n");
+        exit(2);
+    }
+    *cap = n;
+    return p;
+}
+
+static void add_event(uint64_t t_us, uint8_t row, uint8_t col, bool down) {
+    if (event_count == event_cap) events = grow(events, &event_cap, sizeof(*events));
+    key_event_t *e = &events[event_count++];
+    e->t_us = t_us;
+    e->row = row;
+    e->col = col;
+    e->down = down;
+    e->settle_scan_us = t_us;
+    e->usage = 0;
+    e->commit = -1;
+}
+
+static void add_contact(uint64_t t_us, uint8_t row, uint8_t col, bool state) {
+    if (contact_count == contact_cap) contacts = grow(contacts, &contact_cap, sizeof(*contacts));
+    contact_t *c = &contacts[contact_count];
+    c->t_us = t_us;
+    c->seq = (uint32_t)contact_count;
+    c->row = row;
+    c->col = col;
+    c->closed = state;
+    contact_count++;
+}
+
+static int cmp_event(const void *a, const void *b) {
+    const key_event_t *x = a, *y = b;
+    if (x->t_us != y->t_us) return x->t_us < y->t_us ? -1 : 1;
+    return 0;
+}
+
+static int cmp_contact(const void *a, const void *b) {
+    const contact_t *x = a, *y = b;
+    if (x->t_us != y->t_us) return x->t_us < y->t_us ? -1 : 1;
+    return x->seq < y->seq ? -1 : (x->seq > y->seq);
+}
+
+/* レポートに出るキーか (Fn と空き位置は出ない) */
+static uint8_t usage_of(uint8_t row, uint8_t col) {
+    uint8_t kc = keymap_get_keycode(row, col);
+    return (kc == KEY_NONE || kc == KEY_FN) ? 0 : kc;
+}
+
+static bool load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        double t_ms;
+        unsigned row, col;
+        char state;
+        int n = sscanf(line, "%lf %u %u %c", &t_ms, &row, &col, &state);
+        if (n <= 0) continue;
+        if (n != 4 || t_ms < 0 || row >= MATRIX_ROWS || col >= MATRIX_COLS ||
+            (state != 'd' && state != 'u')) {
+            fprintf(stderr, "%s:%d: expected \"<ms> <row> <col> <d|u>\"\n", path, lineno);
+            fclose(f);
+            return false;
+        }
+        add_event((uint64_t)(t_ms * 1000.0 + 0.5), (uint8_t)row, (uint8_t)col, state == 'd');
+    }
+    fclose(f);
+    qsort(events, event_count, sizeof(*events), cmp_event);
+    return true;
+}
+
+/* 合成トレース: 押下間隔は平均 1/rate の一様分布, 押下時間は hold_min-hold_max。
+ * 押している間に次のキーを押す (ロールオーバー) こともある。 */
+static void synth_trace(void) {
+    uint8_t pool[MATRIX_ROWS * MATRIX_COLS][2];
+    int pool_n = 0;
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+            uint8_t kc = usage_of(r, c);
+            if (kc == 0 || IS_MODIFIER(kc)) continue;
+            pool[pool_n][0] = r;
+            pool[pool_n][1] = c;
+            pool_n++;
+        }
+    }
+
+    static uint64_t free_at[MATRIX_ROWS][MATRIX_COLS];
+    memset(free_at, 0, sizeof(free_at));
+    uint32_t mean_us = (uint32_t)(1e6 / opt.rate);
+    uint64_t t = 100000;
+
+    for (uint32_t k = 0; k < opt.keys; k++) {
+        t += rng_range(mean_us / 2, mean_us + mean_us / 2);
+        int pick = -1;
+        for (int tries = 0; tries < 8 && pick < 0; tries++) {
+            int i = (int)(rng() % (uint32_t)pool_n);
+            if (free_at[pool[i][0]][pool[i][1]] <= t) pick = i;
+        }
+        if (pick < 0) continue;   /* 同じキーを押したままなので見送る */
+        uint8_t r = pool[pick][0], c = pool[pick][1];
+        uint64_t hold = (uint64_t)rng_range(opt.hold_min_ms, opt.hold_max_ms) * 1000;
+        add_event(t, r, c, true);
+        add_event(t + hold, r, c, false);
+        /* 指を離してから同じキーを押し直すまでの最短時間 */
+        free_at[r][c] = t + hold + (uint64_t)opt.hold_min_ms * 1000;
+    }
+    qsort(events, event_count, sizeof(*events), cmp_event);
+}
+
+/* 時刻 t 以降の最初のスキャン (スキャンは SCHED_MATRIX_PERIOD_US の倍数の時刻) */
+static uint64_t scan_at_or_after(uint64_t t) {
+    uint64_t s = (t + SCHED_MATRIX_PERIOD_US - 1) / SCHED_MATRIX_PERIOD_US * SCHED_MATRIX_PERIOD_US;
+    return s ? s : SCHED_MATRIX_PERIOD_US;
+}
+
+/* 押下/解放ごとに接点の変化列を作る (バウンスは次の同じキーの変化の半分まで) */
+static void build_contacts(void) {
+    for (size_t i = 0; i < event_count; i++) {
+        key_event_t *e = &events[i];
+        add_contact(e->t_us, e->row, e->col, e->down);
+        e->settle_scan_us = scan_at_or_after(e->t_us);
+        if (opt.bounce_us == 0) continue;
+
+        uint64_t window = opt.bounce_us;
+        for (size_t j = i + 1; j < event_count; j++) {
+            if (events[j].row == e->row && events[j].col == e->col) {
+                uint64_t half = (events[j].t_us - e->t_us) / 2;
+                if (half < window) window = half;
+                break;
+            }
+        }
+
+        /* 最後は必ず目的の状態で終わるよう、離れる/戻るを対で入れる */
+        uint32_t pairs = rng_range(0, 3);
+        uint64_t t = e->t_us;
+        for (uint32_t p = 0; p < pairs; p++) {
+            uint64_t step = window / (2 * pairs + 1);
+            if (step < 2) break;
+            t += rng_range(1, (uint32_t)step);
+            add_contact(t, e->row, e->col, !e->down);
+            uint64_t back = t;
+            t += rng_range(1, (uint32_t)step);
+            add_contact(t, e->row, e->col, e->down);
+            /* 離れていた間 [back, t) にスキャンがあればそのスキャンには見える */
+            if (scan_at_or_after(back) < t) e->settle_scan_us = scan_at_or_after(t);
+        }
+    }
+    qsort(contacts, contact_count, sizeof(*contacts), cmp_contact);
+}
+
+static bool save_trace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "# t_ms row col d|u (seed %u)\n", (unsigned)opt.seed);
+    for (size_t i = 0; i < event_count; i++) {
+        fprintf(f, "%.3f %u %u %c\n", events[i].t_us / 1000.0,
+                events[i].row, events[i].col, events[i].down ? 'd' : 'u');
+    }
+    fclose(f);
+    return true;
+}
+
+/* ============================================================
+ * デバウンスで確定した変化 (スキャンごとに matrix_key_is_pressed() の変化を記録)
+ * ============================================================ */
+typedef struct {
+    uint64_t t_us;
+    uint8_t  row;
+    uint8_t  col;
+    bool     down;
+    uint8_t  usage;
+    int      event;          /* 元の押下/解放 (-1 = 対応なし, バウンスの漏れなど) */
+    int      host;           /* ホストに届いた変化 (-1 = 未着) */
+} commit_t;
+
+static commit_t *commits = NULL;
+static size_t commit_count = 0, commit_cap = 0;
+static int last_event[MATRIX_ROWS][MATRIX_COLS][2];   /* 現在時刻までの最後の [解放, 押下] */
+static bool committed[MATRIX_ROWS][MATRIX_COLS];
+static size_t keys_commit_seq = 0;   /* 最後に hid_pipeline_set_keys() へ渡した時点の確定数 */
+
+static void record_commits(void) {
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+            bool pressed = matrix_key_is_pressed(r, c);
+            if (pressed == committed[r][c]) continue;
+            committed[r][c] = pressed;
+
+            if (commit_count == commit_cap) commits = grow(commits, &commit_cap, sizeof(*commits));
+            commit_t *cm = &commits[commit_count];
+            cm->t_us = sim_now_us();
+            cm->row = r;
+            cm->col = c;
+            cm->down = pressed;
+            cm->usage = usage_of(r, c);
+            cm->host = -1;
+            cm->event = -1;
+
+            /* キーと向き (押下/解放) で元の変化に対応させる。確定はデバウンス時間だけ遅れるので、
+             * 押下時間がそれに近いと確定時点では解放も起きている。時刻の近さでは対応させない。
+             * 同じ向きの最後の変化が対応済みなら、この確定は余分 (チャタリングの漏れなど) */
+            int ev = last_event[r][c][pressed];
+            if (ev >= 0 && events[ev].commit < 0) {
+                events[ev].commit = (int)commit_count;
+                cm->event = ev;
+            }
+            commit_count++;
+        }
+    }
+}
+
+/* ============================================================
+ * ホスト側: 受け取ったレポートから押下/解放を復元
+ * ============================================================ */
+typedef struct {
+    uint8_t  usage;
+    bool     down;
+    uint64_t t_us;           /* 受信時刻 */
+    uint32_t report;         /* 何番目のレポートか */
+    bool     matched;
+} host_event_t;
+
+static host_event_t *host_events = NULL;
+static size_t host_count = 0, host_cap = 0;
+static bool host_keys[256];
+static uint32_t host_reports = 0;
+
+/* レポートは commit_seq 件目までの確定を反映したキー状態。
+ * 変化したキーはその中で同じ Usage の最後の確定に対応付ける */
+static void host_match(host_event_t *he, int h, size_t commit_seq) {
+    for (size_t i = commit_seq; i-- > 0;) {
+        commit_t *cm = &commits[i];
+        if (cm->usage != he->usage) continue;
+        if (cm->down == he->down && cm->host < 0) {
+            cm->host = h;
+            he->matched = true;
+        }
+        return;
+    }
+}
+
+static void host_receive(const uint8_t *data, uint8_t len, hid_frame_kind_t kind,
+                         size_t commit_seq, uint64_t now) {
+    bool keys[256];
+    memset(keys, 0, sizeof(keys));
+
+    if (kind == HID_FRAME_MOUSE) return;
+    if (kind == HID_FRAME_BOOT_KEYBOARD) {
+        for (int b = 0; b < 8; b++) if (data[0] & (1u << b)) keys[0xE0 + b] = true;
+        for (int i = 2; i < len; i++) if (data[i]) keys[data[i]] = true;
+    } else {
+        /* [Report ID][modifier][bitmap] */
+        for (int b = 0; b < 8; b++) if (data[1] & (1u << b)) keys[0xE0 + b] = true;
+        for (int i = 0; i < NKRO_BITMAP_BYTES && 2 + i < len; i++) {
+            for (int b = 0; b < 8; b++) if (data[2 + i] & (1u << b)) keys[i * 8 + b] = true;
+        }
+    }
+
+    for (int u = 1; u < 256; u++) {
+        if (keys[u] == host_keys[u]) continue;
+        if (host_count == host_cap) host_events = grow(host_events, &host_cap, sizeof(*host_events));
+        host_event_t *h = &host_events[host_count];
+        h->usage = (uint8_t)u;
+        h->down = keys[u];
+        h->t_us = now;
+        h->report = host_reports;
+        h->matched = false;
+        host_match(h, (int)host_count, commit_seq);
+        host_count++;
+    }
+    memcpy(host_keys, keys, sizeof(host_keys));
+    host_reports++;
+}
+
+/* ============================================================
+ * BLE シンク (無線の代わり)
+ *
+ * ble_hid.c と同じく、CAN_SEND_NOW (コントローラのバッファに空きがある) のたびに
+ * パイプラインから1フレームを取り出して渡す。コントローラは接続イベントごとに
+ * per_event 件まで送り、loss の割合で接続イベントが失敗すると次のイベントで再送する。
+ * ============================================================ */
+typedef struct {
+    uint8_t data[1 + NKRO_REPORT_SIZE];
+    uint8_t len;
+    hid_frame_kind_t kind;
+    size_t  commit_seq;      /* このフレームに反映済みの確定数 */
+} acl_packet_t;
+
+static acl_packet_t acl[ACL_MAX];
+static uint32_t acl_head = 0, acl_used = 0;
+static int sim_sink = HID_SINK_NONE;
+static uint32_t conn_events = 0, conn_events_lost = 0;
+
+static bool sink_is_ready(void *ctx) {
+    (void)ctx;
+    return true;
+}
+
+static bool sink_wants_boot(void *ctx) {
+    (void)ctx;
+    return opt.boot;
+}
+
+static void sink_notify(void *ctx) {
+    (void)ctx;
+    /* 送信はループ側の sink_service() で行う (ble_hid.c の送信ワーカー相当) */
+}
+
+static const hid_sink_t sim_sink_def = {
+    .name       = "sim",
+    .is_ready   = sink_is_ready,
+    .wants_boot = sink_wants_boot,
+    .notify     = sink_notify,
+    .ctx        = NULL,
+};
+
+/* CAN_SEND_NOW: 空きがある限りフレームをコントローラへ渡す */
+static void sink_service(void) {
+    hid_frame_t frame;
+    while (acl_used < opt.acl &&
+           hid_pipeline_peek(sim_sink, HID_FRAME_MASK_ALL, &frame)) {
+        acl_packet_t *p = &acl[(acl_head + acl_used) % ACL_MAX];
+        memcpy(p->data, frame.data, frame.len);
+        p->len = frame.len;
+        p->kind = frame.kind;
+        p->commit_seq = keys_commit_seq;
+        acl_used++;
+        hid_pipeline_consume(sim_sink, frame.kind);
+    }
+}
+
+static void conn_event(uint64_t now) {
+    conn_events++;
+    if (acl_used == 0) return;
+    if (opt.loss > 0 && (rng() % 10000) < (uint32_t)(opt.loss * 100.0)) {
+        conn_events_lost++;
+        return;
+    }
+    for (uint32_t n = 0; n < opt.per_event && acl_used > 0; n++) {
+        const acl_packet_t *p = &acl[acl_head];
+        host_receive(p->data, p->len, p->kind, p->commit_seq, now);
+        acl_head = (acl_head + 1) % ACL_MAX;
+        acl_used--;
+    }
+}
+
+/* ============================================================
+ * ファームウェア側のスタブ / プラットフォーム依存部
+ * ============================================================ */
+
+uint32_t config_get(config_key_t key) {
+    if (key == CFG_DEBOUNCE_MS) return opt.debounce_ms;
+    if (key == CFG_DEBOUNCE_ADAPT) return opt.adaptive;
+    return 0;
+}
+
+static void pipeline_on_queued(bool coalesced) {
+    perf_count(PERF_CNT_REPORTS_QUEUED);
+    if (coalesced) perf_count(PERF_CNT_REPORTS_COALESCED);
+}
+
+static const hid_pipeline_port_t pipeline_port = {
+    .lock      = NULL,
+    .unlock    = NULL,
+    .now_us    = time_us_32,
+    .on_queued = pipeline_on_queued,
+};
+
+/* main.c の matrix タスクのうちキーボードレポート送信部分 */
+static void matrix_step(void) {
+    static uint8_t report[NKRO_REPORT_SIZE];
+    matrix_scan();
+    record_commits();
+    if (matrix_has_changed() && !matrix_fn_is_pressed()) {
+        matrix_build_nkro_report(report);
+        keys_commit_seq = commit_count;
+        hid_pipeline_set_keys(report);
+    }
+}
+
+/* ============================================================
+ * 再生ループ
+ * ============================================================ */
+static void run(void) {
+    sim_hal_reset();
+    matrix_init();
+    hid_pipeline_init(&pipeline_port);
+    sim_sink = hid_pipeline_add_sink(&sim_sink_def);
+    hid_pipeline_set_active(sim_sink);
+    sink_service();
+    perf_snapshot_t discard;
+    perf_snapshot(&discard, true);
+
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) last_event[r][c][0] = last_event[r][c][1] = -1;
+    }
+
+    uint64_t end = (event_count ? events[event_count - 1].t_us : 0) + DRAIN_US;
+    uint64_t next_scan = SCHED_MATRIX_PERIOD_US;
+    uint64_t next_conn = rng_range(1, opt.interval_us);   /* 接続イベントの位相 */
+    size_t ci = 0, ei = 0;
+
+    for (;;) {
+        uint64_t next = next_scan < next_conn ? next_scan : next_conn;
+        if (ci < contact_count && contacts[ci].t_us < next) next = contacts[ci].t_us;
+        if (next > end && ci >= contact_count) break;
+        sim_set_time_us(next);
+        uint64_t now = sim_now_us();
+
+        while (ci < contact_count && contacts[ci].t_us <= now) {
+            const contact_t *c = &contacts[ci++];
+            sim_set_switch(ROW_GPIO(c->row), COL_GPIO(c->col), c->closed);
+        }
+        while (ei < event_count && events[ei].t_us <= now) {
+            last_event[events[ei].row][events[ei].col][events[ei].down] = (int)ei;
+            ei++;
+        }
+        if (now >= next_scan) {
+            matrix_step();
+            while (next_scan <= sim_now_us()) next_scan += SCHED_MATRIX_PERIOD_US;
+        }
+        sink_service();
+        if (now >= next_conn) {
+            conn_event(now);
+            next_conn += opt.interval_us;
+            sink_service();
+        }
+    }
+}
+
+/* ============================================================
+ * 集計
+ * ============================================================ */
+typedef struct {
+    uint32_t *samples;
+    size_t    count;
+} latency_t;
+
+static void latency_add(latency_t *l, uint64_t from_us, uint64_t to_us) {
+    l->samples[l->count++] = (uint32_t)(to_us - from_us);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(const latency_t *l, double p) {
+    if (l->count == 0) return 0.0;
+    size_t i = (size_t)(p / 100.0 * (double)(l->count - 1) + 0.5);
+    return l->samples[i] / 1000.0;
+}
+
+static void print_latency(const char *label, latency_t *l) {
+    qsort(l->samples, l->count, sizeof(uint32_t), cmp_u32);
+    printf("latency %-9s: p50 %6.2f  p90 %6.2f  p99 %6.2f  max %6.2f ms (n=%zu)\n", label,
+           percentile_ms(l, 50), percentile_ms(l, 90), percentile_ms(l, 99),
+           percentile_ms(l, 100), l->count);
+}
+
+static int cmp_settle(const void *a, const void *b) {
+    const key_event_t *x = &events[*(const size_t *)a], *y = &events[*(const size_t *)b];
+    if (x->settle_scan_us != y->settle_scan_us) return x->settle_scan_us < y->settle_scan_us ? -1 : 1;
+    return x->t_us < y->t_us ? -1 : (x->t_us > y->t_us);
+}
+
+/*
+ * デバウンスでの前後入れ替わり: バウンスが (スキャンから見て) 収まった順と確定順が逆のもの。
+ * 収まりの差が1スキャン周期 (SCHED_MATRIX_PERIOD_US) 以内ならスキャンでは区別できないので
+ * *within に数える (参考値)。それより離れたものは戻り値 (入れ替わり) に数え、失敗扱いにする
+ */
+static uint32_t count_debounce_swaps(uint32_t *within) {
+    size_t *order = malloc((event_count + 1) * sizeof(size_t));
+    for (size_t i = 0; i < event_count; i++) order[i] = i;
+    qsort(order, event_count, sizeof(size_t), cmp_settle);
+
+    uint32_t swaps = 0;
+    *within = 0;
+    uint64_t max_t = 0;       /* 先に収まった全変化の確定時刻の最大 */
+    uint64_t max_far = 0;     /* 1スキャン周期より前に収まった変化の確定時刻の最大 */
+    size_t far = 0;
+    for (size_t i = 0; i < event_count; i++) {
+        const key_event_t *e = &events[order[i]];
+        while (far < i &&
+               events[order[far]].settle_scan_us + SCHED_MATRIX_PERIOD_US < e->settle_scan_us) {
+            const key_event_t *f = &events[order[far++]];
+            if (f->commit >= 0 && commits[f->commit].t_us > max_far) {
+                max_far = commits[f->commit].t_us;
+            }
+        }
+        if (e->commit < 0) continue;
+        uint64_t t = commits[e->commit].t_us;
+        if (t < max_far) swaps++;
+        else if (t < max_t) (*within)++;
+        if (t > max_t) max_t = t;
+    }
+    free(order);
+    return swaps;
+}
+
+/* 送信での入れ替わり: 確定順に見て、後の確定が先のレポートで届いたもの
+ * (同じレポートで届いたものは同時扱い) */
+static uint32_t count_reordered(void) {
+    uint32_t reordered = 0;
+    int64_t max_report = -1;
+    for (size_t i = 0; i < commit_count; i++) {
+        if (commits[i].host < 0) continue;
+        int64_t r = host_events[commits[i].host].report;
+        if (r < max_report) reordered++;
+        else max_report = r;
+    }
+    return reordered;
+}
+
+static void print_histogram(const uint32_t *hist) {
+    printf("press latency histogram (%u ms bins):\n", HIST_BIN_US / 1000);
+    uint32_t peak = 1;
+    for (int b = 0; b <= HIST_BINS; b++) if (hist[b] > peak) peak = hist[b];
+    for (int b = 0; b <= HIST_BINS; b++) {
+        if (hist[b] == 0) continue;
+        int bar = (int)((uint64_t)hist[b] * 50 / peak);
+        if (b < HIST_BINS) printf("  %3u-%3u ms |", b * HIST_BIN_US / 1000, (b + 1) * HIST_BIN_US / 1000);
+        else               printf("  >=%3u ms   |", HIST_BINS * HIST_BIN_US / 1000);
+        printf("%.*s %u\n", bar, "##################################################", (unsigned)hist[b]);
+    }
+}
+
+/* キーごとのデバウンス時間 (使われたキーのみ) */
+static void print_debounce_windows(void) {
+    uint32_t keys = 0, sum = 0, wmin = UINT32_MAX, wmax = 0;
+    for (int r = 0; r < MATRIX_ROWS; r++) {
+        for (int c = 0; c < MATRIX_COLS; c++) {
+            matrix_debounce_stats_t st;
+            matrix_get_debounce_stats(r, c, &st);
+            if (st.samples == 0) continue;
+            keys++;
+            sum += st.window_ms;
+            if (st.window_ms < wmin) wmin = st.window_ms;
+            if (st.window_ms > wmax) wmax = st.window_ms;
+        }
+    }
+    if (keys == 0) return;
+    printf("windows  : %s, %u keys, min/avg/max %u/%.1f/%u ms\n",
+           opt.adaptive ? "adaptive" : "fixed", (unsigned)keys, (unsigned)wmin,
+           (double)sum / keys, (unsigned)wmax);
+}
+
+static int report(void) {
+    size_t n = event_count + 1;
+    latency_t press = { calloc(n, sizeof(uint32_t)), 0 };
+    latency_t release = { calloc(n, sizeof(uint32_t)), 0 };
+    latency_t debounce = { calloc(n, sizeof(uint32_t)), 0 };
+    latency_t transport = { calloc(n, sizeof(uint32_t)), 0 };
+    uint32_t hist[HIST_BINS + 1] = {0};
+    uint32_t offered = 0, delivered = 0, ignored = 0;
+    uint32_t lost_db[2] = {0}, lost_tx[2] = {0};   /* [0]=解放, [1]=押下 */
+    uint32_t extra_commits = 0, extra_host = 0;
+    uint64_t first_press = UINT64_MAX, last_recv = 0;
+
+    FILE *csv = opt.csv_path ? fopen(opt.csv_path, "w") : NULL;
+    if (opt.csv_path && !csv) perror(opt.csv_path);
+    if (csv) fprintf(csv, "t_us,usage,state,debounce_us,transport_us,latency_us\n");
+
+    for (size_t i = 0; i < event_count; i++) {
+        const key_event_t *e = &events[i];
+        if (e->usage == 0) {
+            ignored++;
+            continue;
+        }
+        if (e->down) {
+            offered++;
+            if (e->t_us < first_press) first_press = e->t_us;
+        }
+        if (e->commit < 0) {
+            lost_db[e->down]++;
+            continue;
+        }
+        const commit_t *cm = &commits[e->commit];
+        if (cm->host < 0) {
+            lost_tx[e->down]++;
+            continue;
+        }
+
+        const host_event_t *he = &host_events[cm->host];
+        uint32_t lat = (uint32_t)(he->t_us - e->t_us);
+        if (e->down) {
+            delivered++;
+            latency_add(&press, e->t_us, he->t_us);
+            latency_add(&debounce, e->t_us, cm->t_us);
+            latency_add(&transport, cm->t_us, he->t_us);
+            uint32_t bin = lat / HIST_BIN_US;
+            hist[bin < HIST_BINS ? bin : HIST_BINS]++;
+            if (he->t_us > last_recv) last_recv = he->t_us;
+        } else {
+            latency_add(&release, e->t_us, he->t_us);
+        }
+        if (csv) fprintf(csv, "%llu,0x%02x,%c,%u,%u,%u\n", (unsigned long long)e->t_us,
+                         e->usage, e->down ? 'd' : 'u', (unsigned)(cm->t_us - e->t_us),
+                         (unsigned)(he->t_us - cm->t_us), lat);
+    }
+    if (csv) fclose(csv);
+    for (size_t i = 0; i < commit_count; i++) {
+        if (commits[i].event < 0 && commits[i].usage != 0) extra_commits++;
+    }
+    for (size_t h = 0; h < host_count; h++) {
+        if (!host_events[h].matched) extra_host++;
+    }
+    uint32_t swaps_within = 0;
+    uint32_t debounce_swaps = count_debounce_swaps(&swaps_within);
+    uint32_t reordered = count_reordered() + debounce_swaps;
+
+    double span_in = (event_count > 1)
+        ? (events[event_count - 1].t_us - events[0].t_us) / 1e6 : 0.0;
+    double span_out = (last_recv > first_press && first_press != UINT64_MAX)
+        ? (last_recv - first_press) / 1e6 : 0.0;
+
+    printf("link     : interval %u us, %u notif/event, %u ACL buffers, loss %.1f%% "
+           "(%u/%u events failed), %s\n",
+           (unsigned)opt.interval_us, (unsigned)opt.per_event, (unsigned)opt.acl, opt.loss,
+           (unsigned)conn_events_lost, (unsigned)conn_events, opt.boot ? "boot" : "NKRO");
+    printf("keys     : offered %u (%.2f/s), delivered %u (%.2f/s sustained)",
+           (unsigned)offered, span_in > 0 ? offered / span_in : 0.0,
+           (unsigned)delivered, span_out > 0 ? delivered / span_out : 0.0);
+    if (ignored) printf(", %u Fn/unmapped events ignored", (unsigned)ignored);
+    printf("\n");
+    printf("lost     : debounce %u presses / %u releases, transport %u presses / %u releases\n",
+           (unsigned)lost_db[1], (unsigned)lost_db[0], (unsigned)lost_tx[1], (unsigned)lost_tx[0]);
+    printf("reordered: %u (debounce %u, transport %u; debounce swaps within scan resolution: %u)\n",
+           (unsigned)reordered, (unsigned)debounce_swaps, (unsigned)(reordered - debounce_swaps),
+           (unsigned)swaps_within);
+    printf("extra    : %u commits without a key event, %u host events without a commit\n",
+           (unsigned)extra_commits, (unsigned)extra_host);
+    print_latency("press", &press);
+    print_latency("release", &release);
+    print_latency("debounce", &debounce);
+    print_latency("transport", &transport);
+    print_histogram(hist);
+
+    hid_pipeline_stats_t ps;
+    hid_pipeline_get_stats(sim_sink, &ps, false);
+    perf_snapshot_t snap;
+    perf_snapshot(&snap, false);
+    printf("pipeline : queued %u, coalesced %u, sent %u, dropped %u, host reports %u\n",
+           (unsigned)ps.queued, (unsigned)ps.coalesced, (unsigned)ps.sent,
+           (unsigned)ps.dropped, (unsigned)host_reports);
+    printf("perf     : debounce_commits %u, debounce_chatter %u\n",
+           (unsigned)snap.counters[PERF_CNT_DEBOUNCE_COMMITS],
+           (unsigned)snap.counters[PERF_CNT_DEBOUNCE_CHATTER]);
+    print_debounce_windows();
+
+    free(press.samples);
+    free(release.samples);
+    free(debounce.samples);
+    free(transport.samples);
+    return (lost_db[0] || lost_db[1] || lost_tx[0] || lost_tx[1] || reordered ||
+            extra_commits || extra_host) ? 1 : 0;
+}
+
+/* ============================================================
+ * main
+ * ============================================================ */
+static void usage(void) {
+    fprintf(stderr,
+        "usage: replay [options]\n"
+        "  --trace FILE        replay a recorded trace (default: synthetic)\n"
+        "  --keys N            synthetic keystrokes (default %u)\n"
+        "  --rate R            synthetic keystrokes per second (default %.1f)\n"
+        "  --hold MIN MAX      synthetic hold time in ms (default %u %u)\n"
+        "  --seed N            random seed (default %u)\n"
+        "  --save-trace FILE   write the key trace that was replayed\n"
+        "  --bounce-us N       max contact bounce per transition, 0 = none (default %u)\n"
+        "  --debounce-ms N     CFG_DEBOUNCE_MS (default %u)\n"
+        "  --adaptive          CFG_DEBOUNCE_ADAPT = 1 (per-key adaptive debounce)\n"
+        "  --interval-us N     connection interval (default %u)\n"
+        "  --per-event N       notifications per connection event (default %u)\n"
+        "  --acl N             controller buffers, 1-%d (default %u)\n"
+        "  --loss PCT          failed connection events in percent (default 0)\n"
+        "  --boot              host uses the boot protocol (6KRO)\n"
+        "  --latency-csv FILE  write per-event latencies\n",
+        (unsigned)opt.keys, opt.rate, (unsigned)opt.hold_min_ms, (unsigned)opt.hold_max_ms,
+        (unsigned)opt.seed, (unsigned)opt.bounce_us, (unsigned)opt.debounce_ms,
+        (unsigned)opt.interval_us, (unsigned)opt.per_event, ACL_MAX, (unsigned)opt.acl);
+}
+
+static bool parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        bool has1 = i + 1 < argc, has2 = i + 2 < argc;
+        if      (!strcmp(a, "--trace") && has1)       opt.trace_path = argv[++i];
+        else if (!strcmp(a, "--save-trace") && has1)  opt.save_path = argv[++i];
+        else if (!strcmp(a, "--latency-csv") && has1) opt.csv_path = argv[++i];
+        else if (!strcmp(a, "--keys") && has1)        opt.keys = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--rate") && has1)        opt.rate = strtod(argv[++i], NULL);
+        else if (!strcmp(a, "--seed") && has1)        opt.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--bounce-us") && has1)   opt.bounce_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--debounce-ms") && has1) opt.debounce_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--interval-us") && has1) opt.interval_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--per-event") && has1)   opt.per_event = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--acl") && has1)         opt.acl = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (!strcmp(a, "--loss") && has1)        opt.loss = strtod(argv[++i], NULL);
+        else if (!strcmp(a, "--adaptive"))            opt.adaptive = true;
+        else if (!strcmp(a, "--boot"))                opt.boot = true;
+        else if (!strcmp(a, "--hold") && has2) {
+            opt.hold_min_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+            opt.hold_max_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else {
+            return false;
+        }
+    }
+    return opt.rate > 0 && opt.interval_us > 0 && opt.per_event > 0 &&
+           opt.acl >= 1 && opt.acl <= ACL_MAX && opt.hold_min_ms <= opt.hold_max_ms &&
+           opt.loss >= 0 && opt.loss < 100 && opt.seed != 0;
+}
+
+int main(int argc, char **argv) {
+    if (!parse_args(argc, argv)) {
+        usage();
+        return 2;
+    }
+    rng_state = opt.seed;
+
+    if (opt.trace_path) {
+        if (!load_trace(opt.trace_path)) return 2;
+    } else {
+        synth_trace();
+    }
+    for (size_t i = 0; i < event_count; i++) {
+        events[i].usage = usage_of(events[i].row, events[i].col);
+    }
+    if (opt.save_path && !save_trace(opt.save_path)) return 2;
+    build_contacts();
+
+    printf("replay   : %zu key events from %s, bounce <= %u us, debounce %u ms%s\n",
+           event_count, opt.trace_path ? opt.trace_path : "synthetic trace",
+           (unsigned)opt.bounce_us, (unsigned)opt.debounce_ms, opt.adaptive ? " (adaptive)" : "");
+    run();
+    return report();
+}
@@ -0,0 +1,153 @@
+/**
+ * @file sim_hal.c
+ * @brief 再生ハーネスの HAL 実装 (仮想時刻・GPIO・キースイッチ)
+ *
+ * sleep_us() などの待ちは仮想時刻を進めるだけなので、
+ * 同じ入力からは常に同じ結果になる。
+ */
+
+#include "sim_hal.h"
+
+#include <string.h>
+
+#include "pico/time.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+static uint64_t now_us = 0;
+static bool dir_out[SIM_GPIO_COUNT];
+static bool out_level[SIM_GPIO_COUNT];
+static bool closed[SIM_GPIO_COUNT][SIM_GPIO_COUNT];
+
+void sim_hal_reset(void) {
+    now_us = 0;
+    memset(dir_out, 0, sizeof(dir_out));
+    memset(out_level, 0, sizeof(out_level));
+    memset(closed, 0, sizeof(closed));
+}
+
+uint64_t sim_now_us(void) {
+    return now_us;
+}
+
+void sim_set_time_us(uint64_t t_us) {
+    if (t_us > now_us) now_us = t_us;
+}
+
+void sim_set_switch(unsigned int gpio_a, unsigned int gpio_b, bool state) {
+    if (gpio_a >= SIM_GPIO_COUNT || gpio_b >= SIM_GPIO_COUNT) return;
+    closed[gpio_a][gpio_b] = state;
+    closed[gpio_b][gpio_a] = state;
+}
+
+/* ============================================================
+ * pico/time.h
+ * ============================================================ */
+
+absolute_time_t get_absolute_time(void) {
+    return now_us;
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t) {
+    return (uint32_t)(t / 1000);
+}
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)now_us;
+}
+
+void sleep_us(uint64_t us) {
+    now_us += us;
+}
+
+void busy_wait_us(uint64_t us) {
+    now_us += us;
+}
+
+/* ============================================================
+ * hardware/gpio.h
+ * ============================================================ */
+
+void gpio_init(unsigned int gpio) {
+    if (gpio >= SIM_GPIO_COUNT) return;
+    dir_out[gpio] = false;
+    out_level[gpio] = false;
+}
+
+void gpio_set_dir(unsigned int gpio, bool out) {
+    if (gpio < SIM_GPIO_COUNT) dir_out[gpio] = out;
+}
+
+void gpio_put(unsigned int gpio, bool value) {
+    if (gpio < SIM_GPIO_COUNT) out_level[gpio] = value;
+}
+
+bool gpio_get(unsigned int gpio) {
+    if (gpio >= SIM_GPIO_COUNT) return true;
+    if (dir_out[gpio]) return out_level[gpio];
+
+    /* プルアップ入力: LOW 出力のピンとスイッチでつながっていれば LOW */
+    for (unsigned int p = 0; p < SIM_GPIO_COUNT; p++) {
+        if (closed[gpio][p] && dir_out[p] && !out_level[p]) return false;
+    }
+    return true;
+}
+
+void gpio_pull_up(unsigned int gpio) {
+    (void)gpio;
+}
+
+void gpio_set_mask(uint32_t mask) {
+    for (unsigned int p = 0; p < SIM_GPIO_COUNT; p++) {
+        if (mask & (1u << p)) out_level[p] = true;
+    }
+}
+
+void gpio_clr_mask(uint32_t mask) {
+    for (unsigned int p = 0; p < SIM_GPIO_COUNT; p++) {
+        if (mask & (1u << p)) out_level[p] = false;
+    }
+}
+
+uint32_t gpio_get_all(void) {
+    uint32_t all = 0;
+    for (unsigned int p = 0; p < SIM_GPIO_COUNT; p++) {
+        if (gpio_get(p)) all |= 1u << p;
+    }
+    return all;
+}
+
+void gpio_set_irq_enabled(unsigned int gpio, uint32_t events, bool enabled) {
+    (void)gpio;
+    (void)events;
+    (void)enabled;
+}
+
+uint32_t gpio_get_irq_event_mask(unsigned int gpio) {
+    (void)gpio;
+    return 0;
+}
+
+void gpio_add_raw_irq_handler_masked(uint32_t gpio_mask, irq_handler_t handler) {
+    (void)gpio_mask;
+    (void)handler;
+}
+
+void gpio_set_dormant_irq_enabled(unsigned int gpio, uint32_t events, bool enabled) {
+    (void)gpio;
+    (void)events;
+    (void)enabled;
+}
+
+/* ============================================================
+ * hardware/irq.h
+ * ============================================================ */
+
+void irq_set_enabled(unsigned int num, bool enabled) {
+    (void)num;
+    (void)enabled;
+}
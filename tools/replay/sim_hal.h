@@ -0,0 +1,36 @@
+/**
+ * @file sim_hal.h
+ * @brief 再生ハーネスの HAL 操作 API (仮想時刻・キースイッチ)
+ *
+ * ファームウェア側のコードは hal/ の代替ヘッダ経由でこの状態を見る。
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_GPIO_COUNT  30
+
+/**
+ * 仮想時刻・GPIO・スイッチを初期状態に戻す
+ */
+void sim_hal_reset(void);
+
+/**
+ * 仮想時刻 (us)
+ */
+uint64_t sim_now_us(void);
+
+/**
+ * 仮想時刻を進める (戻すことはできない)
+ */
+void sim_set_time_us(uint64_t t_us);
+
+/**
+ * 2本の GPIO 間のスイッチ接点を開閉する (行ピン-列ピン)
+ */
+void sim_set_switch(unsigned int gpio_a, unsigned int gpio_b, bool closed);
+
+#endif /* SIM_HAL_H */
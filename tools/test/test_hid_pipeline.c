@@ -0,0 +1,217 @@
+/**
+ * @file test_hid_pipeline.c
+ * @brief hid_pipeline.c の単体テスト (ホスト用)
+ *
+ * 1回の送信 (接続間隔) の間に届いた入力が送信待ちの上書き/加算で失われないことを確かめる。
+ *   - タップ: 押下と解放が送信前にそろっても、押下フレーム → 解放フレームの順に届く
+ *   - クリック: ボタン押下と解放が送信前にそろっても、両方のフレームと移動量が届く
+ *   - 上書き: 変化を失わない入力 (同時押しの追加, 同じボタンでの移動) は1フレームにまとまる
+ *   - 再送用レポート: 現在のキー状態を積まずに組み立てる (スループット計測の埋め草)
+ *
+ * hid_pipeline.c は Pico SDK に依存しないため、そのままリンクする。
+ *
+ * ビルドと実行 (リポジトリのルートで):
+ *   mkdir -p build && cc -std=c11 -Wall -Iinclude -o build/test_hid_pipeline \
+ *      tools/test/test_hid_pipeline.c src/hid_pipeline.c
+ *   build/test_hid_pipeline
+ * 失敗があれば内容を表示して終了コード 1。
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hid_pipeline.h"
+#include "hid_keycodes.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) do {                                   \
+    if (!(cond)) {                                              \
+        printf("%s:%d: ", __func__, __LINE__);                  \
+        printf(__VA_ARGS__);                                    \
+        printf("\n");                                           \
+        failures++;                                             \
+    }                                                           \
+} while (0)
+
+/* ============================================================
+ * テスト用シンク (送信はテストが peek/consume で行う)
+ * ============================================================ */
+static bool sink_ready = true;
+static bool sink_boot = false;
+
+static bool test_is_ready(void *ctx) {
+    (void)ctx;
+    return sink_ready;
+}
+
+static bool test_wants_boot(void *ctx) {
+    (void)ctx;
+    return sink_boot;
+}
+
+static const hid_sink_t test_sink = {
+    .name       = "test",
+    .is_ready   = test_is_ready,
+    .wants_boot = test_wants_boot,
+    .notify     = NULL,
+    .ctx        = NULL,
+};
+
+static int sink;
+
+static void setup(bool boot) {
+    sink_ready = true;
+    sink_boot = boot;
+    hid_pipeline_init(NULL);
+    sink = hid_pipeline_add_sink(&test_sink);
+    hid_pipeline_set_active(sink);
+    /* set_active で積まれる初期状態 (全キー解放) を送っておく */
+    hid_frame_t f;
+    while (hid_pipeline_peek(sink, HID_FRAME_MASK_ALL, &f)) hid_pipeline_consume(sink, f.kind);
+}
+
+/* 次のフレームを取り出す (接続イベントで1件送る) */
+static bool send_one(uint8_t mask, hid_frame_t *f) {
+    if (!hid_pipeline_peek(sink, mask, f)) return false;
+    hid_pipeline_consume(sink, f->kind);
+    return true;
+}
+
+static void nkro_with(uint8_t *nkro, uint8_t usage) {
+    memset(nkro, 0, NKRO_REPORT_SIZE);
+    if (usage) nkro[1 + usage / 8] |= (uint8_t)(1u << (usage % 8));
+}
+
+static bool frame_has_key(const hid_frame_t *f, uint8_t usage) {
+    if (f->kind == HID_FRAME_BOOT_KEYBOARD) {
+        for (int i = 2; i < BOOT_REPORT_SIZE; i++) {
+            if (f->data[i] == usage) return true;
+        }
+        return false;
+    }
+    return (f->data[1 + 1 + usage / 8] >> (usage % 8)) & 1;
+}
+
+/* ============================================================
+ * テスト
+ * ============================================================ */
+
+/* 押下と解放が1回の送信の間にそろう */
+static void test_tap_within_interval(bool boot) {
+    setup(boot);
+    uint8_t nkro[NKRO_REPORT_SIZE];
+    hid_frame_t f;
+
+    nkro_with(nkro, KEY_A);
+    hid_pipeline_set_keys(nkro);
+    nkro_with(nkro, 0);
+    hid_pipeline_set_keys(nkro);
+
+    CHECK(send_one(HID_FRAME_MASK_KEYBOARD, &f), "no frame for the press");
+    CHECK(frame_has_key(&f, KEY_A), "first frame lacks the press (boot=%d)", boot);
+    CHECK(send_one(HID_FRAME_MASK_KEYBOARD, &f), "no frame for the release");
+    CHECK(!frame_has_key(&f, KEY_A), "second frame still has the key (boot=%d)", boot);
+    CHECK(!hid_pipeline_has_pending(sink, HID_FRAME_MASK_ALL), "unexpected extra frame");
+}
+
+/* キーの追加だけなら1フレームにまとまる (送信数を増やさない) */
+static void test_roll_coalesces(void) {
+    setup(false);
+    uint8_t nkro[NKRO_REPORT_SIZE];
+    hid_frame_t f;
+
+    nkro_with(nkro, KEY_A);
+    hid_pipeline_set_keys(nkro);
+    nkro[1 + KEY_B / 8] |= (uint8_t)(1u << (KEY_B % 8));
+    hid_pipeline_set_keys(nkro);
+
+    CHECK(send_one(HID_FRAME_MASK_KEYBOARD, &f), "no frame");
+    CHECK(frame_has_key(&f, KEY_A) && frame_has_key(&f, KEY_B), "keys not merged");
+    CHECK(!hid_pipeline_has_pending(sink, HID_FRAME_MASK_ALL), "roll was not coalesced");
+}
+
+/* ボタン押下と解放が1回の送信の間にそろう (間の移動量も失わない) */
+static void test_click_within_interval(void) {
+    setup(false);
+    hid_frame_t f;
+
+    hid_pipeline_add_mouse(0x00, 3, 0, 0, 0);
+    hid_pipeline_add_mouse(0x01, 2, 1, 0, 0);
+    hid_pipeline_add_mouse(0x00, 0, 0, 0, 0);
+    hid_pipeline_add_mouse(0x00, 1, 1, 0, 0);
+
+    /* 1件目: 移動 + 押下 (押下前の移動は押下のフレームへ加算済み) */
+    CHECK(send_one(HID_FRAME_MASK_MOUSE, &f), "no mouse frame");
+    CHECK(f.data[0] == HID_REPORT_ID_MOUSE, "report id %u", f.data[0]);
+    int pressed_at = (f.data[1] & 0x01) ? 0 : -1;
+    int dx = (int8_t)f.data[2], dy = (int8_t)f.data[3];
+    int frames = 1;
+    bool released_after_press = false;
+    while (send_one(HID_FRAME_MASK_MOUSE, &f)) {
+        if (pressed_at < 0 && (f.data[1] & 0x01)) pressed_at = frames;
+        if (pressed_at >= 0 && !(f.data[1] & 0x01)) released_after_press = true;
+        dx += (int8_t)f.data[2];
+        dy += (int8_t)f.data[3];
+        frames++;
+    }
+    CHECK(pressed_at >= 0, "button press lost");
+    CHECK(released_after_press, "button release lost (%d frames)", frames);
+    CHECK(frames <= 3, "%d mouse frames for one click", frames);
+    CHECK(dx == 6 && dy == 2, "motion lost: dx=%d dy=%d", dx, dy);
+}
+
+/* 同じボタンでの移動は加算して1フレーム */
+static void test_motion_coalesces(void) {
+    setup(false);
+    hid_frame_t f;
+
+    hid_pipeline_add_mouse(0x00, 10, -5, 0, 0);
+    hid_pipeline_add_mouse(0x00, 20, -5, 1, 0);
+
+    CHECK(send_one(HID_FRAME_MASK_MOUSE, &f), "no mouse frame");
+    CHECK((int8_t)f.data[2] == 30 && (int8_t)f.data[3] == -10 && (int8_t)f.data[4] == 1,
+          "motion not accumulated");
+    CHECK(!hid_pipeline_has_pending(sink, HID_FRAME_MASK_ALL), "motion was not coalesced");
+}
+
+/* 現在のキー状態の組み立ては送信待ちを増やさない */
+static void test_build_keys(void) {
+    setup(false);
+    uint8_t nkro[NKRO_REPORT_SIZE];
+    uint8_t report[1 + NKRO_REPORT_SIZE];
+    hid_frame_t f;
+
+    nkro_with(nkro, KEY_A);
+    nkro[0] = 0x02;   /* Left Shift */
+    hid_pipeline_set_keys(nkro);
+    send_one(HID_FRAME_MASK_KEYBOARD, &f);
+
+    uint8_t len = hid_pipeline_build_keys(false, report);
+    CHECK(len == 1 + NKRO_REPORT_SIZE, "NKRO length %u", len);
+    CHECK(report[0] == HID_REPORT_ID_KEYBOARD && memcmp(report + 1, nkro, NKRO_REPORT_SIZE) == 0,
+          "NKRO report differs from the key state");
+
+    len = hid_pipeline_build_keys(true, report);
+    CHECK(len == BOOT_REPORT_SIZE, "boot length %u", len);
+    CHECK(report[0] == 0x02 && report[2] == KEY_A && report[3] == 0, "boot report differs");
+    CHECK(!hid_pipeline_has_pending(sink, HID_FRAME_MASK_ALL), "build_keys queued a frame");
+}
+
+int main(void) {
+    test_tap_within_interval(false);
+    test_tap_within_interval(true);
+    test_roll_coalesces();
+    test_click_within_interval();
+    test_motion_coalesces();
+    test_build_keys();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("hid_pipeline: all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+トレース "#T" 行のデコーダ
+
+ファームウェアの trace コマンドが出力する
+    #T <時刻us(16進)> <ID(10進)> <引数(16進)>...
+の行を include/trace_ids.h の書式で文字列に戻す。それ以外の行はそのまま出力する。
+
+使い方:
+    python3 tools/trace_decode.py [ログファイル] [--ids include/trace_ids.h]
+    (ログファイル省略時は標準入力。シリアルポートを直接指定してもよい)
+"""
+
+import argparse
+import os
+import re
+import sys
+
+DEFAULT_IDS = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                           "..", "include", "trace_ids.h")
+
+EVENT_RE = re.compile(r'^\s*TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+ENUM_RE = re.compile(r'^\s*TRACE_ENUM\(\s*(\w+)\s*,(.*)\)\s*$')
+STRING_RE = re.compile(r'"((?:[^"\\]|\\.)*)"')
+# printf 変換指定 (l/h 修飾子は読み捨てる) または %{列挙名}
+SPEC_RE = re.compile(r'%%|%\{(\w+)\}|%([-+ #0]*\d*)(?:hh|h|ll|l)?([diuxXc])')
+
+
+def load_ids(path):
+    """trace_ids.h を読み、(イベント [(名前, 書式)], 列挙 {名前: [値の名前]}) を返す"""
+    events = []
+    enums = {}
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = EVENT_RE.match(line)
+            if m:
+                events.append((m.group(1), m.group(2)))
+                continue
+            m = ENUM_RE.match(line)
+            if m:
+                enums[m.group(1)] = STRING_RE.findall(m.group(2))
+    return events, enums
+
+
+def format_event(fmt, args, enums):
+    """書式に引数 (32bit 符号なし) を当てはめる"""
+    it = iter(args)
+
+    def repl(m):
+        if m.group(0) == "%%":
+            return "%"
+        value = next(it, 0)
+        if m.group(1):
+            names = enums.get(m.group(1), [])
+            return names[value] if value < len(names) else str(value)
+        flags, conv = m.group(2), m.group(3)
+        if conv in "di" and value & 0x80000000:
+            value -= 1 << 32
+        return ("%" + flags + conv) % value
+
+    return SPEC_RE.sub(repl, fmt)
+
+
+def decode_line(line, events, enums):
+    """1行をデコード ("#T" 行でなければ None)"""
+    fields = line.split()
+    if not fields:
+        return None
+    if fields[0] == "#T!":
+        return "[TRACE] " + " ".join(fields[1:])
+    if fields[0] != "#T" or len(fields) < 3:
+        return None
+    try:
+        ts = int(fields[1], 16)
+        eid = int(fields[2])
+        args = [int(a, 16) for a in fields[3:]]
+    except ValueError:
+        return None
+
+    if eid < len(events):
+        name, fmt = events[eid]
+        text = format_event(fmt, args, enums)
+    else:
+        text = "unknown event %d %s" % (eid, " ".join(fields[3:]))
+    return "[%10.6f] %s" % (ts / 1e6, text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode firmware trace records")
+    parser.add_argument("input", nargs="?", help="capture file or serial port (default: stdin)")
+    parser.add_argument("--ids", default=DEFAULT_IDS, help="path to trace_ids.h")
+    opts = parser.parse_args()
+
+    events, enums = load_ids(opts.ids)
+    src = open(opts.input, encoding="utf-8", errors="replace") if opts.input else sys.stdin
+    try:
+        for line in src:
+            line = line.rstrip("\r\n")
+            decoded = decode_line(line, events, enums)
+            print(decoded if decoded is not None else line, flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if src is not sys.stdin:
+            src.close()
+
+
+if __name__ == "__main__":
+    main()